@@ -1,60 +1,145 @@
+#include <string.h>
 #include "cc2520ll.h"
 #include "msp430_arch.h"
-#include "utils/sense_utils.h"
+#include "cc2520ll_src.h"
+#include "cc2520ll_nbr.h"
+#include "cc2520ll_scan.h"
+#include "cc2520ll_tsync.h"
+#include "cc2520ll_tsch.h"
+#include "rtimer.h"
+#ifdef CC2520_HOST
+#include <assert.h>
+#endif
+#ifdef SECURITY_CCM
+#include "cc2520ll_sec.h"
+#endif
 
 /***********************************************************************************
 * LOCAL VARIABLES
 */
 static cc2520ll_cfg_t pConfig;
 static uint8_t rxMpdu[128];
-static ringBuf_t rxBuffer;
-static uint8_t ringBuffer[CC2520_BUF_LEN];
+// Received frames, one per slot. Only the RX interrupt moves rxqTail and only
+// the reader moves rxqHead; both run freely and wrap at 256.
+static cc2520ll_frame_t rxQueue[CC2520_RXQ_SLOTS];
+static volatile uint8_t rxqHead, rxqTail;
+static uint8_t txMode;                  // Keep GPIO2 on TX_FRM_DONE between frames
+static cc2520ll_rxStats_t rxStats;
+static cc2520ll_filter_t filter;
+static cc2520ll_filterStats_t filterStats[CC2520_FILT_MODES];
+// Frame in the TX FIFO and its CSMA-CA state (see cc2520ll_transmitAsync)
+static volatile uint8_t txBusy;
+static uint8_t txLen;                   // PHR of the frame
+static uint8_t csmaNb, csmaBe;
+static cc2520ll_txCallback_t txCallback;
+static uint8_t txStatus;
+// Acknowledged transmission of the frame in the TX FIFO
+static uint8_t txAckReq;                // The frame requests an ACK
+static uint8_t txSeq;                   // Its sequence number
+static uint16_t txDst;                  // Its short destination address
+static uint8_t txRetries;
+static volatile uint8_t txOnAir;        // STXONCCA went through, no TX_FRM_DONE yet
+static volatile uint8_t txAckWait;      // Sent, ACK window open
+static volatile uint8_t txAcked;        // Matching ACK received
+static uint8_t txStrobe;                // Repeat the frame until txStrobeEnd
+static rtimer_clock_t txStrobeEnd;
+static uint8_t txSlot, txSlotCca;       // One attempt at once, STXON unless txSlotCca
+static rtimer_clock_t txTime;           // STXONCCA of the last frame put on air
+// SFD captures: the last frame sent, and received frames not read yet,
+// oldest at sfdTail. Both indices run freely and wrap at 256.
+static uint32_t txSfd;
+static cc2520ll_sfdHook_t sfdHook;
+#ifndef INCLUDE_PA
+static uint32_t sfdRing[CC2520_SFD_SLOTS];
+static volatile uint8_t sfdHead, sfdTail;
+static uint16_t sfdSkip;                // FIFO bytes of frames whose capture was given up
+#endif
+static uint8_t macDsn;
+static cc2520ll_ackStats_t ackStats[CC2520_ACK_STATS_ENTRIES];
+// TX queue (cc2520ll_txqPut): txqOrder lists the queued slots by priority;
+// its head is on air while txqActive and the next one may already be in the
+// TX FIFO (txqPreloaded)
+static cc2520ll_txqSlot_t txQueue[CC2520_TXQ_SLOTS];
+static uint8_t txqOrder[CC2520_TXQ_SLOTS];
+static volatile uint8_t txqCount;
+static uint8_t txqActive, txqPreloaded;
+#ifdef SECURITY_CCM
+static const uint8_t secKey[CC2520_SEC_KEY_LEN] = SECURITY_KEY;
+#endif
+#ifndef SECURITY_CCM
+// Frames staged in radio RAM, oldest at stageFirst (see cc2520ll_setStaging)
+static uint8_t stageOn;
+static uint16_t stageAddr[CC2520_STAGE_FRAMES];
+static uint8_t stageLen[CC2520_STAGE_FRAMES];
+static uint32_t stageTime[CC2520_STAGE_FRAMES];
+static uint32_t stageSfd[CC2520_STAGE_FRAMES];
+static uint8_t stageSfdValid[CC2520_STAGE_FRAMES];
+static uint8_t stageFirst, stageCount;
+static volatile uint8_t stageDraining;   // A drain has claimed the oldest frames
+static uint8_t stageBuf[CC2520_STAGE_END - CC2520_STAGE_START];   // Read back in one MEMRD
+#endif
 
-// Recommended register settings which differ from the data sheet
+static void cc2520ll_rxFrameDone(uint8_t exc);
+static uint8_t cc2520ll_txLenOk(uint8_t len);
+static uint8_t cc2520ll_txPhr(uint8_t len);
+static uint8_t cc2520ll_txWrite(const uint8_t *packet, uint8_t len);
+static void cc2520ll_txAckSetup(const uint8_t *pHdr, uint8_t len);
+static void cc2520ll_rxOverflow(uint8_t exc);
+#ifndef SECURITY_CCM
+static void cc2520ll_stageFrame(uint8_t n, uint8_t later);
+#endif
+#ifndef INCLUDE_PA
+static void cc2520ll_sfdCapture(void);
+#endif
 
-static regVal_t regval[]= {   
-							 
-    // Tuning settings
+// Recommended register settings which differ from the data sheet.
+// Keep the table sorted by address: consecutive registers are written in one burst.
+
+static regVal_t regval[]= {
+    // CC2520_FRMFILT0,	0,		// enables promiscuous mode
+
+    // Configuration for applications using cc2520ll_init()
+    { CC2520_FRMCTRL0,    0x40 },               // auto crc
+    { CC2520_EXCMASKA0,   1 << CC2520_EXC_RX_OVERFLOW },
+    { CC2520_EXCMASKA1,   1 << (CC2520_EXC_RX_FRM_DONE - 8) },
+    { CC2520_GPIOCTRL0,   CC2520_GPIO_EXC_CH_A },   // RX_FRM_DONE or RX_OVERFLOW
+    { CC2520_GPIOCTRL1,   CC2520_GPIO_SAMPLED_CCA },
+    { CC2520_GPIOCTRL2,   CC2520_GPIO_RSSI_VALID },
 #ifdef INCLUDE_PA
-    CC2520_TXPOWER,     0xF9,       // Max TX output power
-    CC2520_TXCTRL,      0xC1,
+    { CC2520_GPIOCTRL3,   CC2520_GPIO_HIGH },   // CC2590 HGM
+    { CC2520_GPIOCTRL4,   0x46 },               // EN set to lna_pd[1] inverted
+    { CC2520_GPIOCTRL5,   0x47 },               // PAEN set to pa_pd inverted
+    { CC2520_GPIOPOLARITY,0x0F },               // Invert GPIO4 and GPIO5
 #else
-    CC2520_TXPOWER,     0xF7,       // Max TX output power
+    { CC2520_GPIOCTRL3,   CC2520_GPIO_SFD },
+    { CC2520_GPIOCTRL4,   CC2520_GPIO_SNIFFER_DATA },
+    { CC2520_GPIOCTRL5,   CC2520_GPIO_SNIFFER_CLK },
 #endif
-    CC2520_CCACTRL0,    0xF8,       // CCA threshold -80dBm
 
-    // Recommended RX settings
-    CC2520_MDMCTRL0,    0x85,
-    CC2520_MDMCTRL1,    0x14,
-    CC2520_RXCTRL,      0x3F,
-    CC2520_FSCTRL,      0x5A,
-    CC2520_FSCAL1,      0x03,
-    // CC2520_FRMFILT0,	0,		// enables promiscuous mode
+    // Tuning settings
 #ifdef INCLUDE_PA
-    CC2520_AGCCTRL1,    0x16,
+    { CC2520_TXPOWER,     0xF9 },       // Max TX output power
+    { CC2520_TXCTRL,      0xC1 },
 #else
-    CC2520_AGCCTRL1,    0x11,
+    { CC2520_TXPOWER,     0xF7 },       // Max TX output power
 #endif
-    CC2520_ADCTEST0,    0x10,
-    CC2520_ADCTEST1,    0x0E,
-    CC2520_ADCTEST2,    0x03, 
+    { CC2520_CCACTRL0,    0xF8 },       // CCA threshold -80dBm
+    { CC2520_EXTCLOCK,    0x00 },
 
-    // Configuration for applications using cc2520ll_init()
-    CC2520_FRMCTRL0,    0x40,               // auto crc
-    CC2520_EXTCLOCK,    0x00,
-    CC2520_GPIOCTRL0,   1 + CC2520_EXC_RX_FRM_DONE, 
-    CC2520_GPIOCTRL1,   CC2520_GPIO_SAMPLED_CCA,
-    CC2520_GPIOCTRL2,   CC2520_GPIO_RSSI_VALID,
+    // Recommended RX settings
+    { CC2520_MDMCTRL0,    0x85 },
+    { CC2520_MDMCTRL1,    0x14 },
+    { CC2520_RXCTRL,      0x3F },
+    { CC2520_FSCTRL,      0x5A },
+    { CC2520_FSCAL1,      0x03 },
 #ifdef INCLUDE_PA
-    CC2520_GPIOCTRL3,   CC2520_GPIO_HIGH,   // CC2590 HGM
-    CC2520_GPIOCTRL4,   0x46,               // EN set to lna_pd[1] inverted
-    CC2520_GPIOCTRL5,   0x47,               // PAEN set to pa_pd inverted
-    CC2520_GPIOPOLARITY,0x0F,               // Invert GPIO4 and GPIO5
+    { CC2520_AGCCTRL1,    0x16 },
 #else
-    CC2520_GPIOCTRL3,   CC2520_GPIO_SFD,
-    CC2520_GPIOCTRL4,   CC2520_GPIO_SNIFFER_DATA,
-    CC2520_GPIOCTRL5,   CC2520_GPIO_SNIFFER_CLK,
+    { CC2520_AGCCTRL1,    0x11 },
 #endif
+    { CC2520_ADCTEST0,    0x10 },
+    { CC2520_ADCTEST1,    0x0E },
+    { CC2520_ADCTEST2,    0x03 },
 
 };
 
@@ -86,31 +171,31 @@ static uint8_t cc2520ll_waitRadioReady(void)
 /***********************************************************************************
 * @fn      cc2520ll_waitTransceiverReady
 *
-* @brief   Wait until the transceiver is ready (SFD low).
+* @brief   Wait until the transceiver is ready (SFD low). No frame keeps SFD
+*          high for longer than the longest one takes on air.
 *
 * @param   none
 *
-* @return  none
+* @return  uint8_t - SUCCESS, or FAILED if SFD stayed high
 */
-void cc2520ll_waitTransceiverReady(void)
+uint8_t cc2520ll_waitTransceiverReady(void)
 {
+    rtimer_clock_t start;
+
+    start = rtimer_now();
 #ifdef INCLUDE_PA
-    // GPIO3 is not conncted to combo board; use SFD at GPIO2 instead
-    _disable_interrupts();
-    // GPIO2 = SFD
-    CC2520_REGWR8(CC2520_GPIOCTRL0 + 2, CC2520_GPIO_SFD);
-    //CC2520_GPIO_DIR_OUT(2);
-    //P2DIR &= ~BIT2;
-    //CC2520_CFG_GPIO_OUT(2,CC2520_GPIO_SFD);
-    while (CC2520_SFD_PIN);
-    // GPIO2 = default (RSSI_VALID)
-    CC2520_CFG_GPIO_OUT(2,CC2520_GPIO_RSSI_VALID);
-    _enable_interrupts();
+    // GPIO3 is not conncted to combo board. Rather than moving SFD to GPIO2
+    // and back for every frame, poll it in FSMSTAT1; the status shadow
+    // answers without a read while RX is off, and FSMSTAT1 is read once
+    // per rtimer tick while it is on
+    while (cc2520ll_rx_active()) {
 #else
-    //while (CC2520_SFD_PIN);
-    while (P2IN & BIT3);
-	//_delay_cycles(4000);
+    while (P2IN & BIT3) {
 #endif
+        if ((rtimer_clock_t)(rtimer_now() - start) > RTIMER_US_TO_TICKS(CC2520_SFD_MAX_US))
+            return FAILED;
+    }
+    return SUCCESS;
 }
 
 /***********************************************************************************
@@ -188,6 +273,64 @@ void cc2520ll_interfaceInit(void)
     P5OUT |= (1 << CC2520_CS_PIN);		// Set cs high
 }
 
+/***********************************************************************************
+* @fn      cc2520ll_writeRegTable
+*
+* @brief   Write a register table sorted by address. Every run of consecutive
+*          addresses is written with a single REGWR or MEMWR burst.
+*
+* @param   const regVal_t *pTable - register table
+*          uint8_t n - number of entries
+*
+* @return  none
+*/
+static void cc2520ll_writeRegTable(const regVal_t *pTable, uint8_t n)
+{
+    uint8_t buf[CC2520_REG_BURST_LEN];
+    uint8_t i, count;
+
+    for (i = 0; i < n; i += count) {
+        count = 0;
+        do {
+            buf[count] = pTable[i + count].val;
+            count++;
+        } while (i + count < n && count < CC2520_REG_BURST_LEN &&
+                 pTable[i + count].reg == pTable[i].reg + count);
+
+        // REGWR saves the address byte but only reaches the FREG space
+        if (pTable[i].reg + count <= CC2520_CHIPID) {
+            CC2520_REGWR(pTable[i].reg, count, buf);
+        } else {
+            CC2520_MEMWR(pTable[i].reg, count, buf);
+        }
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_verifyRegTable
+*
+* @brief   Read back the whole address span of a sorted register table in one
+*          burst and compare it with the table.
+*
+* @param   const regVal_t *pTable - register table
+*          uint8_t n - number of entries
+*
+* @return  SUCCESS if every register holds its value, FAILED otherwise
+*/
+static uint8_t cc2520ll_verifyRegTable(const regVal_t *pTable, uint8_t n)
+{
+    uint8_t regs[0x80];         // FREG and SREG space
+    uint8_t first, i;
+
+    first = pTable[0].reg;
+    CC2520_MEMRD(first, pTable[n - 1].reg - first + 1, regs);
+    for (i = 0; i < n; i++) {
+        if (regs[pTable[i].reg - first] != pTable[i].val)
+            return FAILED;
+    }
+    return SUCCESS;
+}
+
 /***********************************************************************************
 * @fn      cc2520ll_config
 *
@@ -200,14 +343,17 @@ void cc2520ll_interfaceInit(void)
 */
 uint8_t cc2520ll_config(void)
 {
-    uint8_t val;
-    int i = 0;
+#ifdef CC2520_HOST
+    uint8_t i;
+#endif
 
     // Avoid GPIO0 interrupts during reset
     P2IE &= ~(1 << CC2520_INT_PIN);
 
-    // Make sure to pull the CC2520 RESETn and VREG_EN pins low
+    // Make sure to pull the CC2520 RESETn and VREG_EN pins low. The reset
+    // takes GPIOCTRLn back to their defaults.
    	P4OUT &= ~(1 << CC2520_RESET_PIN); 
+    CC2520_GPIO_INVALIDATE();
    	P5OUT |= (1 << CC2520_CS_PIN);						// Raise CS
     P4OUT &= ~(1 << CC2520_VREG_EN_PIN);
     __delay_cycles(MSP430_USECOND*1100);
@@ -223,22 +369,49 @@ uint8_t cc2520ll_config(void)
     if (cc2520ll_waitRadioReady()==FAILED)
         return FAILED;
 
-    // Write non-default register values
-    for (i = 0; i < sizeof(regval)/sizeof(regVal_t); i++) {
-        CC2520_MEMWR8(regval[i].reg, regval[i].val);
+#ifdef CC2520_HOST
+    // The burst writer and the read-back both need the table in address order
+    for (i = 1; i < sizeof(regval)/sizeof(regVal_t); i++) {
+        assert(regval[i].reg > regval[i - 1].reg);
     }
+#endif
+
+    // Write non-default register values
+    cc2520ll_writeRegTable(regval, sizeof(regval)/sizeof(regVal_t));
 
-    // Verify a register
-    val= CC2520_MEMRD8(CC2520_MDMCTRL0);
+    // Verify all of them. The GPIO mux shadow has followed the writes; it is
+    // only kept if they took.
+    if (cc2520ll_verifyRegTable(regval, sizeof(regval)/sizeof(regVal_t)) == FAILED) {
+        CC2520_GPIO_INVALIDATE();
+        return FAILED;
+    }
+    txMode = FALSE;
+    return SUCCESS;
+}
 
-    return val==0x85? SUCCESS : FAILED;
+#ifdef CC2520_HOST
+/***********************************************************************************
+* @fn      cc2520ll_regTable
+*
+* @brief   Register table written by cc2520ll_config()
+*
+* @param   uint8_t *pCount - number of entries, filled in
+*
+* @return  const regVal_t * - the table
+*/
+const regVal_t *cc2520ll_regTable(uint8_t *pCount)
+{
+    *pCount = sizeof(regval)/sizeof(regVal_t);
+    return regval;
 }
+#endif
 
 /***********************************************************************************
 * @fn      cc2520ll_setChannel
 *
 * @brief   Set RF channel in the 2.4GHz band. The Channel must be in the range 11-26,
-*          11= 2005 MHz, channel spacing 5 MHz.
+*          11= 2005 MHz, channel spacing 5 MHz. The bus lock keeps the
+*          channel and FREQCTRL in step with the timer handlers that retune.
 *
 * @param   channel - logical channel number
 *
@@ -246,7 +419,26 @@ uint8_t cc2520ll_config(void)
 */
 void cc2520ll_setChannel(uint8_t channel)
 {
+    unsigned short istate;
+
+    CC2520_SPI_LOCK(istate);
+    pConfig.channel = channel;
     CC2520_REGWR8(CC2520_FREQCTRL, MIN_CHANNEL + ((channel - MIN_CHANNEL) * CHANNEL_SPACING));
+    CC2520_SPI_UNLOCK(istate);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_getChannel
+*
+* @brief   RF channel last set with cc2520ll_setChannel()
+*
+* @param   none
+*
+* @return  uint8_t - logical channel number, 11-26
+*/
+uint8_t cc2520ll_getChannel(void)
+{
+    return pConfig.channel;
 }
 
 
@@ -265,23 +457,45 @@ void cc2520ll_setShortAddr(uint16_t shortAddr)
 }
 
 /***********************************************************************************
-* @fn      cc2520ll_setShortAddr
+* @fn      cc2520ll_setLongAddr
 *
 * @brief   Write long address to chip
 *
-* @param   none
+* @param   const uint8_t *pLongAddr - 8 bytes, most significant byte first
 *
 * @return  none
 */
-/*void cc2520ll_setLongAddr(rimeaddr_t *longAddr)
+void cc2520ll_setLongAddr(const uint8_t *pLongAddr)
 {
+	uint8_t buf[8];
 	int i = 0;
 
+    // Stored least significant byte first, written in one burst
     for (i = 0; i < 8; i++) {
-    	CC2520_MEMWR8(CC2520_RAM_EXTADDR + i, longAddr->u8[7 - i]);
-    }    
+    	buf[i] = pLongAddr[7 - i];
+    }
+    CC2520_MEMWR(CC2520_RAM_EXTADDR, 8, buf);
 }
+
+/***********************************************************************************
+* @fn      cc2520ll_setAutoAck
+*
+* @brief   Enable or disable automatic acknowledgement. With auto-ack on, the
+*          radio sets the frame pending bit of each ACK from the source match
+*          table (see cc2520ll_src.h).
+*
+* @param   uint8_t enable
+*
+* @return  none
 */
+void cc2520ll_setAutoAck(uint8_t enable)
+{
+    if (enable) {
+        CC2520_BSET(CC2520_MAKE_BIT_ADDR(CC2520_FRMCTRL0, CC2520_FRMCTRL0_AUTOACK_BIT));
+    } else {
+        CC2520_BCLR(CC2520_MAKE_BIT_ADDR(CC2520_FRMCTRL0, CC2520_FRMCTRL0_AUTOACK_BIT));
+    }
+}
 /***********************************************************************************
 * @fn      cc2520ll_setPanId
 *
@@ -313,16 +527,22 @@ cc2520ll_init()
     pConfig.channel = RF_CHANNEL;
     pConfig.ackRequest = FALSE;
     pConfig.myShortAddr = SHORT_ADD;
+    pConfig.minBe = CC2520_MAC_MIN_BE;
+    pConfig.maxBe = CC2520_MAC_MAX_BE;
+    pConfig.maxCsmaBackoffs = CC2520_MAC_MAX_CSMA_BACKOFFS;
+    pConfig.maxFrameRetries = CC2520_MAC_MAX_FRAME_RETRIES;
     
 	cc2520ll_interfaceInit();	// initialize the rest of the interface. 
 	
 	cc2520ll_spiInit();		// initialize spi.
+
+    rtimer_init();          // CSMA-CA backoffs, SFD capture
 	
     if (cc2520ll_config() == FAILED)
         return FAILED;
 
-	// initialize the ring buffer
-	bufInit(&rxBuffer, ringBuffer, 512);
+    // empty the frame queue
+    rxqHead = rxqTail = 0;
 
     _disable_interrupts();
 
@@ -332,16 +552,43 @@ cc2520ll_init()
     // Write the short address and the PAN ID to the CC2520 RAM
     cc2520ll_setPanId(pConfig.panId);
 	  cc2520ll_setShortAddr(pConfig.myShortAddr);
+
+#ifdef SECURITY_CCM
+    // Key and nonces live in radio RAM
+    cc2520ll_secInit(secKey, pConfig.myShortAddr);
+#endif
 	
     //cc2520ll_setLongAddr(&rimeaddr_node_addr);
 
+    // Empty source match table
+    cc2520ll_srcInit();
+    cc2520ll_nbrInit();
+
+    // Frame filter as after reset: types 0-3, any frame version
+    filter.enable = TRUE;
+    filter.frameTypes = CC2520_FILT_BEACON | CC2520_FILT_DATA | CC2520_FILT_ACK | CC2520_FILT_CMD;
+    filter.panCoord = FALSE;
+    filter.maxVersion = 3;
+    filter.broadcast = TRUE;
+
     // Set up receive interrupt (received data or acknowlegment)
     P2IES &= ~(1 << CC2520_INT_PIN); // Set rising edge
     P2IFG &= ~(1 << CC2520_INT_PIN); 
     P2IE |= (1 << CC2520_INT_PIN);
 
-    // Clear the exception
+#ifndef INCLUDE_PA
+    // SFD to the TA1.2 capture input
+    sfdHead = sfdTail = 0;
+    sfdSkip = 0;
+    P2SEL |= (1 << 3);
+    rtimer_capture(RTIMER_SFD, cc2520ll_sfdCapture);
+#endif
+
+    // Clear the exceptions
     CLEAR_EXC_RX_FRM_DONE();
+    CC2520_CLEAR_EXC(CC2520_EXC_RX_OVERFLOW);
+    CC2520_EXC_REGISTER(CC2520_EXC_RX_OVERFLOW, cc2520ll_rxOverflow);
+    CC2520_EXC_REGISTER(CC2520_EXC_RX_FRM_DONE, cc2520ll_rxFrameDone);
     
 	// Register the interrupt handler for P2.0
 //	register_port2IntHandler(CC2520_INT_PIN, cc2520ll_packetReceivedISR);
@@ -350,6 +597,9 @@ cc2520ll_init()
 	
 	// And enable reception on cc2520
 	cc2520ll_receiveOn();
+
+    // Random initial macDSN
+    macDsn = CC2520_RANDOM8();
 	
 	
 	return SUCCESS;
@@ -387,239 +637,1165 @@ void cc2520ll_writeTxBuf(uint8_t* data, uint8_t length)
 }
 
 /***********************************************************************************
-* @fn      cc2520ll_transmit
+* @fn      cc2520ll_ackStatsUpdate
 *
-* @brief   Transmits frame with Clear Channel Assessment.
+* @brief   Count the outcome of an acknowledged transmission against its
+*          destination, taking over the least recently used entry for a new
+*          one
 *
-* @param   none
+* @param   uint8_t status - CC2520_TX_xxx
 *
-* @return  int - SUCCESS or FAILED
+* @return  none
 */
-int cc2520ll_transmit()
+static void cc2520ll_ackStatsUpdate(uint8_t status)
 {
-    uint16_t timeout = 2500; // 2500 x 20us = 50ms
-    uint8_t status=0;
-
-    // Wait for RSSI to become valid
-    while(!CC2520_RSSI_VALID_PIN);
-
-    // Reuse GPIO2 for TX_FRM_DONE exception
-    _disable_interrupts();
-    CC2520_CFG_GPIO_OUT(2, 1 + CC2520_EXC_TX_FRM_DONE);
-	_enable_interrupts();
+    cc2520ll_ackStats_t *pEntry = NULL;
+    uint8_t i, oldAge = 0xFF;
 
-    // Wait for the transmission to begin before exiting (makes sure that this function cannot be called
-    // a second time, and thereby cancelling the first transmission.
-    while(--timeout > 0) {
-        _disable_interrupts();
-        CC2520_INS_STROBE(CC2520_INS_STXONCCA);
-        _enable_interrupts();
-        if (CC2520_SAMPLED_CCA_PIN) break;
-        __delay_cycles(20*MSP430_USECOND);
+    for (i = 0; i < CC2520_ACK_STATS_ENTRIES; i++) {
+        if (ackStats[i].frames && ackStats[i].dstAddr == txDst) {
+            pEntry = &ackStats[i];
+            oldAge = pEntry->age;
+            break;
+        }
     }
-    if (timeout == 0) {
-        status = FAILED;
-        CC2520_INS_STROBE(CC2520_INS_SFLUSHTX);
-    } else {
-        status = SUCCESS;
-        // Wait for TX_FRM_DONE exception
-        while(!CC2520_TX_FRM_DONE_PIN);
-        _disable_interrupts();
-        CC2520_CLEAR_EXC(CC2520_EXC_TX_FRM_DONE);
-        _enable_interrupts();
+    if (!pEntry) {
+        // A free entry, else the oldest one
+        pEntry = &ackStats[0];
+        for (i = 0; i < CC2520_ACK_STATS_ENTRIES && pEntry->frames; i++) {
+            if (!ackStats[i].frames || ackStats[i].age > pEntry->age)
+                pEntry = &ackStats[i];
+        }
+        pEntry->dstAddr = txDst;
+        pEntry->frames = pEntry->retries = pEntry->noAck = pEntry->channelBusy = 0;
     }
-
-    // Reconfigure GPIO2
-    _disable_interrupts();
-    CC2520_CFG_GPIO_OUT(2, CC2520_GPIO_RSSI_VALID);
-    _enable_interrupts();
-    return status;
+    // Entries used since this one last was grow older
+    for (i = 0; i < CC2520_ACK_STATS_ENTRIES; i++) {
+        if (&ackStats[i] != pEntry && ackStats[i].frames && ackStats[i].age < oldAge)
+            ackStats[i].age++;
+    }
+    pEntry->age = 0;
+    pEntry->frames++;
+    pEntry->retries += txRetries;
+    if (status == CC2520_TX_NOACK)
+        pEntry->noAck++;
+    else if (status == CC2520_TX_CHANNEL_BUSY)
+        pEntry->channelBusy++;
 }
 
 /***********************************************************************************
-* @fn      cc2520ll_packetSend
+* @fn      cc2520ll_txDone
 *
-* @brief   Sends a packet.
+* @brief   End of a transmission attempt: give GPIO2 back unless more frames
+*          are expected, free the transmitter and report the outcome
 *
-* @param   const void* packet - the packet to be sent.
-* @param   unsigned short len - teh length of the packet to be sent.
+* @param   uint8_t status - CC2520_TX_xxx
 *
-* @return  uint8_t - SUCCESS or FAILED
+* @return  none
 */
-int 
-cc2520ll_packetSend(const void* packet, unsigned short len) 
+static void cc2520ll_txDone(uint8_t status)
 {
-    if (cc2520ll_prepare(packet, len)) {
-	    return cc2520ll_transmit();
-    } else {
-		return FAILED;
+    cc2520ll_txCallback_t callback = txCallback;
+
+    P2IE &= ~(1 << CC2520_TX_INT_PIN);
+    txOnAir = txAckWait = txStrobe = txSlot = FALSE;
+    if (txAckReq)
+        cc2520ll_ackStatsUpdate(status);
+    if (status != CC2520_TX_OK) {
+        CC2520_INS_STROBE(CC2520_INS_SFLUSHTX);
+        txqPreloaded = FALSE;
+    }
+    // Keep GPIO2 while queued frames follow
+    if (!txMode && !(txqActive && txqCount > 1)) {
+        CC2520_CFG_GPIO_OUT(2, CC2520_GPIO_RSSI_VALID);
     }
+    txStatus = status;
+    txCallback = NULL;
+    txBusy = FALSE;
+    if (callback)
+        callback(status);
 }
 
 /***********************************************************************************
-* @fn      cc2520ll_packetSend
+* @fn      cc2520ll_txAbort
 *
-* @brief   Prepares a packet to be sent.
+* @brief   Free the transmitter before the first CCA without calling back, for
+*          a send refused because the receiver is off. The frame stays in the
+*          TX FIFO.
 *
-* @param   const void* packet - the packet to be sent.
-* @param   unsigned short len - teh length of the packet to be sent.
+* @return  none
+*/
+static void cc2520ll_txAbort(void)
+{
+    txStrobe = txSlot = FALSE;
+    txCallback = NULL;
+    txStatus = CC2520_TX_RADIO_OFF;
+    txBusy = FALSE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_ackTimeout
 *
-* @return  uint8_t - SUCCESS or FAILED
+* @brief   Timer callback at the end of the ACK window: retransmit the frame,
+*          which the radio keeps in the TX FIFO unless the next queued frame
+*          was preloaded, after a new CSMA-CA round, or give up after
+*          macMaxFrameRetries retransmissions. A strobe repeats the frame
+*          at once, with a CCA but no backoff, until its end time.
+*
+* @return  none
 */
-int cc2520ll_prepare(const void *packet, uint8_t len){
-	// Check packet length
-    if (len + 3 > MAX_802154_PACKET_SIZE + 1) {
-    	return FAILED;
+static void cc2520ll_csmaBackoff(void);
+static void cc2520ll_csmaAttempt(void);
+static void cc2520ll_ackTimeout(void)
+{
+    txAckWait = FALSE;
+    if (txStrobe) {
+        if (RTIMER_CLOCK_LT(rtimer_now(), txStrobeEnd)) {
+            txRetries++;
+            csmaNb = 0;
+            csmaBe = pConfig.minBe;
+            cc2520ll_csmaAttempt();
+        } else {
+            cc2520ll_txDone(txAckReq ? CC2520_TX_NOACK : CC2520_TX_OK);
+        }
+    } else if (txRetries < pConfig.maxFrameRetries && !txSlot) {
+        txRetries++;
+        if (txqPreloaded) {
+            // The next frame took its place in the TX FIFO. It has not been
+            // sent, so the radio would append to it: flush first.
+            CC2520_INS_STROBE(CC2520_INS_SFLUSHTX);
+            txqPreloaded = FALSE;
+            if (cc2520ll_txWrite(txQueue[txqOrder[0]].mpdu, txQueue[txqOrder[0]].len) == FAILED) {
+                cc2520ll_txDone(CC2520_TX_NO_COUNTER);
+                return;
+            }
+        }
+        csmaNb = 0;
+        csmaBe = pConfig.minBe;
+        cc2520ll_csmaBackoff();
     } else {
-	    // Wait until the transceiver is idle
-	    cc2520ll_waitTransceiverReady();
-	
-	    // Turn off RX frame done interrupt to avoid interference on the SPI interface
-	    cc2520ll_disableRxInterrupt();
-	
-	    len += 2; // auto crc enabled
-	    cc2520ll_writeTxBuf(&len, 1);
-	    cc2520ll_writeTxBuf((uint8_t*)packet, len-2);
-	
-	    // Turn on RX frame done interrupt for ACK reception
-	    cc2520ll_enableRxInterrupt();
-	    return SUCCESS;
+        cc2520ll_txDone(CC2520_TX_NOACK);
     }
 }
-/**********************************************************************************
-* @fn          cc2520ll_channel_clear
+
+/***********************************************************************************
+* @fn      cc2520ll_txSent
 *
-* @brief       Performs a clear channel assesment (CCA)
-* @return      int - 1 if channel clear, 0 otherwise.
+* @brief   The frame is on air: done, unless it asked for an ACK that has not
+*          come yet, in which case the ACK window opens. The next queued frame
+*          is loaded into the TX FIFO while the window is open, under the bus
+*          lock like every TX FIFO load. A strobe without ACK request keeps
+*          the same gap between its frames.
+*
+* @return  none
 */
-int
-cc2520ll_channel_clear(){
+static void cc2520ll_txSent(void)
+{
+    unsigned short istate;
 
-	CC2520_INS_STROBE(CC2520_INS_SSAMPLECCA);	
-	return CC2520_SAMPLED_CCA_PIN;
+    CC2520_CLEAR_EXC(CC2520_EXC_TX_FRM_DONE);
+    txOnAir = FALSE;
+    if ((!txAckReq && !txStrobe) || txAcked) {
+        cc2520ll_txDone(CC2520_TX_OK);
+    } else {
+        txAckWait = TRUE;
+        rtimer_set(RTIMER_MAC, rtimer_now() + RTIMER_US_TO_TICKS(CC2520_ACK_WAIT_US), \
+            cc2520ll_ackTimeout);
+        if (txqActive && txqCount > 1 && !txqPreloaded) {
+            CC2520_SPI_LOCK(istate);
+            txqPreloaded = cc2520ll_txWrite(txQueue[txqOrder[1]].mpdu, txQueue[txqOrder[1]].len);
+            CC2520_SPI_UNLOCK(istate);
+        }
+    }
 }
 
-/**********************************************************************************
-* @fn          cc2520ll_rx_active
+/***********************************************************************************
+* @fn      cc2520ll_rxAck
 *
-* @brief       Returns non-zero if reception in progress
-* @return      uint8_t - 1 if reception in progress, 0 otherwise.
-*/
-uint8_t
-cc2520ll_rx_active() {
-	return (CC2520_REGRD8(CC2520_FSMSTAT1) & HI_UINT16(CC2520_FSMSTAT_SFD_BV));
-}
-
-/**********************************************************************************
-* @fn          cc2520ll_tx_active
+* @brief   Match a received ACK against the frame being sent. An ACK that
+*          comes late, after the retransmission has begun, still counts.
 *
-* @brief       Returns non-zero transmission in progress
-* @return      uint8_t - 1 if transmission in progress, 0 otherwise.
+* @param   const uint8_t *pMpdu - length byte, FCF, sequence number and footer
+*
+* @return  none
 */
-uint8_t
-cc2520ll_tx_active() {
-	return (CC2520_REGRD8(CC2520_FSMSTAT1) & 0x02);
+static void cc2520ll_rxAck(const uint8_t *pMpdu)
+{
+    if (!txBusy || !txAckReq || txAcked)
+        return;
+    if ((pMpdu[1] & CC2520_FCF_TYPE_BM_L) != CC2520_FCF_TYPE_ACK || pMpdu[3] != txSeq || \
+        !(pMpdu[CC2520_ACK_PACKET_SIZE] & CC2520_CRC_OK_BM))
+        return;
+    txAcked = TRUE;
+    if (!txOnAir) {
+        // In the ACK window or backing off for a retransmission
+        rtimer_cancel(RTIMER_MAC);
+        cc2520ll_txDone(CC2520_TX_OK);
+    }
 }
 
-/**********************************************************************************
-* @fn          cc2520ll_idle
+/***********************************************************************************
+* @fn      cc2520ll_txWaitDone
 *
-* @brief       Returns non-zero if cc2520 is in receive mode and no SFD has been
-* 			   received (neither transmiting nor receiving).
-* @return      uint8_t - 1 if idle, 0 otherwise.
+* @brief   Timer callback one backoff period after the frame should have
+*          ended, in case the TX_FRM_DONE edge was missed. Looks at the pin
+*          and checks again later if the radio is not done yet.
+*
+* @return  none
 */
-uint8_t
-cc2520ll_idle() {
-	return (!cc2520ll_rx_active() && !cc2520ll_tx_active());
+static void cc2520ll_txWaitDone(void)
+{
+    if (CC2520_TX_FRM_DONE_PIN) {
+        cc2520ll_txSent();
+    } else {
+        rtimer_set(RTIMER_MAC, rtimer_now() + RTIMER_US_TO_TICKS(CC2520_UNIT_BACKOFF_US), \
+            cc2520ll_txWaitDone);
+    }
 }
 
-
-/**********************************************************************************
-* @fn          cc2520ll_packetReceived
+/***********************************************************************************
+* @fn      cc2520ll_csmaBackoff
 *
-* @brief       Returns true if there is data to be read in the receive buffer.
-* @return      u8_t - a number != 0 if there isnew data to be read, 0 otherwise.
+* @brief   Wait a random number of backoff periods, 0 to 2^BE - 1, drawn from
+*          the radio's random generator, then try the channel
+*
+* @return  none
 */
-int cc2520ll_packetReceived(void) {
-	return bufNumBytes(&rxBuffer);
+static void cc2520ll_csmaBackoff(void)
+{
+    uint8_t periods;
+
+    periods = CC2520_RANDOM8() & ((1 << csmaBe) - 1);
+    rtimer_set(RTIMER_MAC, rtimer_now() + \
+        RTIMER_US_TO_TICKS((uint32_t)periods * CC2520_UNIT_BACKOFF_US), cc2520ll_csmaAttempt);
 }
 
-/**********************************************************************************
-* @fn          cc2520ll_packetReceive
+/***********************************************************************************
+* @fn      cc2520ll_csmaAttempt
 *
-* @brief       Copies the payload of the last incoming packet into a buffer
+* @brief   Timer callback at the end of a backoff: STXONCCA transmits only if
+*          the channel is clear. On a busy channel NB and BE grow and another
+*          backoff starts, until macMaxCSMABackoffs is exceeded. A slot
+*          transmission has no backoff: STXON, or one STXONCCA.
 *
-* @param       packet - pointer to data buffer to fill. This buffer must be
-*                        allocated by higher layer.
-*              maxlen - Maximum number of bytes to read from buffer
-*              
-* @return      uint8_t - number of bytes actually copied into buffer
+* @return  none
 */
-int
-cc2520ll_packetReceive(uint8_t* packet, uint8_t maxlen)
+static void cc2520ll_csmaAttempt(void)
 {
-	uint8_t len = 0;
-	
-	_disable_interrupts();
-    if(bufNumBytes(&rxBuffer)) {
-    	bufGet(&rxBuffer, &len, 1);
-    	            // The first byte in the packet is the packet's length
-    				// but it does not count the length field itself 
-    	if (len > maxlen) {
-    		bufFlush(&rxBuffer);
-    		len = 0;
-    	}
-    	else {
-    		len = bufGet(&rxBuffer, packet, len);
-    	}    	
+    uint8_t cca = !txSlot || txSlotCca;
+
+    CC2520_INS_STROBE(cca ? CC2520_INS_STXONCCA : CC2520_INS_STXON);
+    if (!cca || CC2520_SAMPLED_CCA_PIN) {
+        // Transmitting: TX_FRM_DONE interrupts at the end of the frame
+        txOnAir = TRUE;
+        txTime = rtimer_now();
+#ifdef INCLUDE_PA
+        // No SFD capture: the SFD follows the strobe by the turnaround and SHR
+        txSfd = rtimer_extend(txTime) + RTIMER_US_TO_TICKS(CC2520_TX_TURNAROUND_US + CC2520_SHR_US);
+        if (sfdHook)
+            sfdHook(txSfd);
+#endif
+        rtimer_set(RTIMER_MAC, rtimer_now() + RTIMER_US_TO_TICKS(CC2520_TX_TURNAROUND_US + \
+            CC2520_TX_TIME_US(txLen) + CC2520_UNIT_BACKOFF_US), cc2520ll_txWaitDone);
+        return;
+    }
+    csmaNb++;
+    if (csmaBe < pConfig.maxBe)
+        csmaBe++;
+    if (csmaNb > pConfig.maxCsmaBackoffs || txSlot) {
+        cc2520ll_txDone(CC2520_TX_CHANNEL_BUSY);
+    } else {
+        cc2520ll_csmaBackoff();
     }
-    _enable_interrupts();
-    return len;
 }
+
 /***********************************************************************************
-* @fn      cc2520ll_receiveOn
-*
-* @brief   Turn receiver on
+* @fn      cc2520ll_txStart
 *
-* @param   none
+* @brief   Start CSMA-CA for the frame in the TX FIFO, or send a slot
+*          transmission at once. Runs with interrupts disabled and txBusy set.
 *
 * @return  none
 */
-void
-cc2520ll_receiveOn(void)
+static void cc2520ll_txStart(void)
 {
-    CC2520_INS_STROBE(CC2520_INS_SRXON);
-    cc2520ll_enableRxInterrupt();
+    txRetries = 0;
+    txAcked = FALSE;
+    // Reuse GPIO2 for TX_FRM_DONE exception (no SPI access if already there)
+    // and interrupt on its rising edge
+    CC2520_CFG_GPIO_OUT(2, 1 + CC2520_EXC_TX_FRM_DONE);
+    P2IES &= ~(1 << CC2520_TX_INT_PIN);
+    P2IFG &= ~(1 << CC2520_TX_INT_PIN);
+    P2IE |= (1 << CC2520_TX_INT_PIN);
+    csmaNb = 0;
+    csmaBe = pConfig.minBe;
+    if (txSlot)
+        cc2520ll_csmaAttempt();
+    else
+        cc2520ll_csmaBackoff();
 }
 
 /***********************************************************************************
-* @fn      cc2520ll_receiveOff
-*
-* @brief   Turn receiver off
+* @fn      cc2520ll_txRssiWait
 *
-* @param   none
+* @brief   Wait for RSSI_VALID before the first CCA. GPIO2 may already carry
+*          TX_FRM_DONE, so ask the status byte; it is served from the shadow
+*          once valid. The wait is bounded: with the receiver off RSSI never
+*          becomes valid. Safe with interrupts disabled.
 *
-* @return  none
+* @return  uint8_t - SUCCESS, or FAILED if the receiver is not on
 */
-void
-cc2520ll_receiveOff(void)
+static uint8_t cc2520ll_txRssiWait(void)
 {
-	// wait until we finish receiving/transmitting
-	while(cc2520ll_rx_active());
-	cc2520ll_disableRxInterrupt();
-    CC2520_SRFOFF();
+    rtimer_clock_t start;
+
+    start = rtimer_now();
+    while (!CC2520_STATUS_QUERY(CC2520_STB_RSSI_VALID_BV)) {
+        if ((rtimer_clock_t)(rtimer_now() - start) > RTIMER_US_TO_TICKS(CC2520_RSSI_VALID_MAX_US))
+            return FAILED;
+    }
+    return SUCCESS;
 }
 
 /***********************************************************************************
-* @fn      cc2520ll_disableRxInterrupt
+* @fn      cc2520ll_txqNext
 *
-* @brief   Clear and disable RX interrupt.
-*
-* @param   none
+* @brief   Send the frame at the head of the TX queue if the transmitter is
+*          free. Runs under the bus lock. With the receiver off the
+*          frame completes at once with CC2520_TX_RADIO_OFF.
 *
 * @return  none
 */
-void cc2520ll_disableRxInterrupt()
+static void cc2520ll_txqSent(uint8_t status);
+static void cc2520ll_txqNext(void)
+{
+    cc2520ll_txqSlot_t *pSlot;
+
+    if (txBusy || txqCount == 0)
+        return;
+    pSlot = &txQueue[txqOrder[0]];
+    txBusy = TRUE;
+    txCallback = cc2520ll_txqSent;
+    txqActive = TRUE;
+    cc2520ll_txAckSetup(pSlot->mpdu, pSlot->len);
+    txLen = cc2520ll_txPhr(pSlot->len);
+    if (!txqPreloaded && cc2520ll_txWrite(pSlot->mpdu, pSlot->len) == FAILED) {
+        cc2520ll_txDone(CC2520_TX_NO_COUNTER);
+        return;
+    }
+    txqPreloaded = FALSE;
+    if (cc2520ll_txRssiWait() == FAILED) {
+        cc2520ll_txDone(CC2520_TX_RADIO_OFF);
+        return;
+    }
+    cc2520ll_txStart();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txqSent
+*
+* @brief   Transmission callback for queued frames: free the head slot, start
+*          the next frame under the bus lock and report to the caller of
+*          cc2520ll_txqPut()
+*
+* @param   uint8_t status - CC2520_TX_xxx
+*
+* @return  none
+*/
+static void cc2520ll_txqSent(uint8_t status)
+{
+    cc2520ll_txqSlot_t *pSlot = &txQueue[txqOrder[0]];
+    cc2520ll_txCallback_t callback = pSlot->callback;
+    unsigned short istate;
+    uint8_t i;
+
+    CC2520_SPI_LOCK(istate);
+    pSlot->len = 0;
+    txqCount--;
+    for (i = 0; i < txqCount; i++) {
+        txqOrder[i] = txqOrder[i + 1];
+    }
+    txqActive = FALSE;
+    cc2520ll_txqNext();
+    CC2520_SPI_UNLOCK(istate);
+    if (callback)
+        callback(status);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txqPut
+*
+* @brief   Queue a frame for transmission. Frames are sent one after another
+*          without further calls, highest priority first and in order within
+*          a priority. The frame following one that waits for its ACK is
+*          loaded into the TX FIFO during the ACK window, by the timer
+*          handler. The queue and the radio are updated under the bus lock,
+*          so this may also be called from interrupt context, including a
+*          transmission callback. Do not mix with cc2520ll_prepare() while
+*          frames are queued.
+*
+* @param   const void *packet - MPDU without FCS, copied
+*          uint8_t len - number of bytes
+*          uint8_t priority - higher is sent first
+*          cc2520ll_txCallback_t callback - outcome, from interrupt context;
+*          NULL if not needed
+*
+* @return  int - SUCCESS, or FAILED if the frame is too long or the queue full
+*/
+int cc2520ll_txqPut(const void *packet, uint8_t len, uint8_t priority, \
+    cc2520ll_txCallback_t callback)
+{
+    cc2520ll_txqSlot_t *pSlot = NULL;
+    unsigned short istate;
+    uint8_t i, pos, first;
+
+    if (!cc2520ll_txLenOk(len))
+        return FAILED;
+
+    // Take a free slot; the copy is made outside the critical section
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    for (i = 0; i < CC2520_TXQ_SLOTS && !pSlot; i++) {
+        if (txQueue[i].len == 0)
+            pSlot = &txQueue[i];
+    }
+    if (!pSlot) {
+        __set_interrupt_state(istate);
+        return FAILED;
+    }
+    pSlot->len = len;
+    __set_interrupt_state(istate);
+    for (i = 0; i < len; i++) {
+        pSlot->mpdu[i] = ((const uint8_t*)packet)[i];
+    }
+    pSlot->priority = priority;
+    pSlot->callback = callback;
+
+    // Behind every frame of the same or higher priority, and behind the
+    // frames already in the radio. The bus lock keeps the timer handlers,
+    // which preload TXBUF, out until the head frame is in the radio.
+    CC2520_SPI_LOCK(istate);
+    first = (txqActive ? 1 : 0) + (txqPreloaded ? 1 : 0);
+    for (pos = txqCount; pos > first && txQueue[txqOrder[pos - 1]].priority < priority; pos--) {
+        txqOrder[pos] = txqOrder[pos - 1];
+    }
+    txqOrder[pos] = pSlot - txQueue;
+    txqCount++;
+    cc2520ll_txqNext();
+    CC2520_SPI_UNLOCK(istate);
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txqCount
+*
+* @brief   Frames in the TX queue, the one being sent included
+*
+* @return  uint8_t
+*/
+uint8_t cc2520ll_txqCount(void)
+{
+    return txqCount;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_transmitAsync
+*
+* @brief   Send the frame loaded by cc2520ll_prepare() with unslotted CSMA-CA
+*          and return at once. Backoffs run from Timer_A1 and the end of the
+*          frame interrupts on GPIO2 (TX_FRM_DONE), so the CPU is free
+*          meanwhile. A frame with the ACK request bit set is retransmitted
+*          until its ACK comes or macMaxFrameRetries is reached. callback
+*          runs from interrupt context with the outcome; cc2520ll_txBusy()
+*          and cc2520ll_txResult() serve as flags instead.
+*
+* @param   cc2520ll_txCallback_t callback - NULL if not needed
+*
+* @return  int - SUCCESS if CSMA-CA started, FAILED if a frame is still
+*          being sent or the receiver is off (cc2520ll_txResult() then
+*          gives CC2520_TX_RADIO_OFF)
+*/
+int cc2520ll_transmitAsync(cc2520ll_txCallback_t callback)
+{
+    _disable_interrupts();
+    if (txBusy) {
+        _enable_interrupts();
+        return FAILED;
+    }
+    txBusy = TRUE;
+    txCallback = callback;
+    _enable_interrupts();
+
+    _disable_interrupts();
+    if (cc2520ll_txRssiWait() == FAILED) {
+        cc2520ll_txAbort();
+        _enable_interrupts();
+        return FAILED;
+    }
+    cc2520ll_txStart();
+    _enable_interrupts();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_transmit
+*
+* @brief   Transmits frame with CSMA-CA, sleeping in LPM0 until it is done.
+*          The timer and port 2 handlers leave LPM0 on exit, so the loop
+*          wakes at least once per radio or timer event.
+*
+* @param   none
+*
+* @return  int - SUCCESS or FAILED
+*/
+int cc2520ll_transmit()
+{
+    if (cc2520ll_transmitAsync(NULL) == FAILED)
+        return FAILED;
+    _disable_interrupts();
+    while (txBusy) {
+        __bis_SR_register(LPM0_bits + GIE);
+        _disable_interrupts();
+    }
+    _enable_interrupts();
+    return txStatus == CC2520_TX_OK ? SUCCESS : FAILED;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_transmitStrobe
+*
+* @brief   Send the frame loaded by cc2520ll_prepare() over and over, for a
+*          receiver that only listens now and then (see cc2520ll_lpl.h). The
+*          first frame goes out after a CSMA-CA backoff, the next ones one
+*          ACK window apart with a CCA only. The strobe ends with the first
+*          ACK (CC2520_TX_OK) or at the end time (CC2520_TX_NOACK, or
+*          CC2520_TX_OK for a frame that asks for no ACK). Repetitions count
+*          as retries in cc2520ll_getAckStats(). May be called from
+*          interrupt context, including a transmission callback.
+*
+* @param   cc2520ll_txCallback_t callback - NULL if not needed
+*          rtimer_clock_t end - no repetition starts from this time on;
+*          less than 1 s ahead
+*
+* @return  int - SUCCESS if the strobe started, FAILED if a frame is still
+*          being sent or the receiver is off (see cc2520ll_transmitAsync)
+*/
+int cc2520ll_transmitStrobe(cc2520ll_txCallback_t callback, rtimer_clock_t end)
+{
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    if (txBusy) {
+        __set_interrupt_state(istate);
+        return FAILED;
+    }
+    txBusy = TRUE;
+    txCallback = callback;
+    txStrobe = TRUE;
+    txStrobeEnd = end;
+    if (cc2520ll_txRssiWait() == FAILED) {
+        cc2520ll_txAbort();
+        __set_interrupt_state(istate);
+        return FAILED;
+    }
+    cc2520ll_txStart();
+    __set_interrupt_state(istate);
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_transmitSlot
+*
+* @brief   Send the frame loaded by cc2520ll_prepare() now, for time-slotted
+*          access (see cc2520ll_tsch.h): STXON without CCA in a cell that
+*          belongs to this link alone, or a single CCA in a shared one. There
+*          is no backoff and no retransmission; the caller retries in a later
+*          cell. A missing ACK gives CC2520_TX_NOACK, a busy channel
+*          CC2520_TX_CHANNEL_BUSY. The radio must be on. The strobe goes out
+*          under the bus lock. May be called from interrupt context.
+*
+* @param   cc2520ll_txCallback_t callback - NULL if not needed
+*          uint8_t cca - TRUE to send only on a clear channel
+*
+* @return  int - SUCCESS if the frame went to the radio, FAILED if a frame is
+*          still being sent or, with cca, the receiver is off (see
+*          cc2520ll_transmitAsync)
+*/
+int cc2520ll_transmitSlot(cc2520ll_txCallback_t callback, uint8_t cca)
+{
+    unsigned short istate;
+
+    CC2520_SPI_LOCK(istate);
+    if (txBusy) {
+        CC2520_SPI_UNLOCK(istate);
+        return FAILED;
+    }
+    txBusy = TRUE;
+    txCallback = callback;
+    txSlot = TRUE;
+    txSlotCca = cca;
+    if (cca && cc2520ll_txRssiWait() == FAILED) {
+        cc2520ll_txAbort();
+        CC2520_SPI_UNLOCK(istate);
+        return FAILED;
+    }
+    cc2520ll_txStart();
+    CC2520_SPI_UNLOCK(istate);
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txBusy
+*
+* @brief   Is a frame waiting for the channel or on air?
+*
+* @return  uint8_t - TRUE while cc2520ll_transmitAsync() has not called back
+*/
+uint8_t cc2520ll_txBusy(void)
+{
+    return txBusy;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txResult
+*
+* @brief   Outcome of the last transmission
+*
+* @return  uint8_t - CC2520_TX_xxx, valid once cc2520ll_txBusy() is FALSE
+*/
+uint8_t cc2520ll_txResult(void)
+{
+    return txStatus;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txTime
+*
+* @brief   When the last frame went on air: the STXONCCA (or STXON) that
+*          started it. After an acknowledged transmission, the frame that got
+*          the ACK.
+*
+* @return  rtimer_clock_t - Timer_A1 time
+*/
+rtimer_clock_t cc2520ll_txTime(void)
+{
+    return txTime;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txSfdTime
+*
+* @brief   When the SFD of the last frame sent was on air: the timer capture,
+*          or with INCLUDE_PA the strobe time plus turnaround and SHR
+*
+* @return  uint32_t - rtimer_now32() ticks
+*/
+uint32_t cc2520ll_txSfdTime(void)
+{
+    return txSfd;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_setSfdHook
+*
+* @brief   Run hook from the SFD capture interrupt of every frame sent (with
+*          INCLUDE_PA, right after the strobe). The rest of the frame is
+*          still to go out, so the hook can put the SFD time into it with
+*          cc2520ll_txPatch() (MAC-layer time stamping).
+*
+* @param   cc2520ll_sfdHook_t hook - NULL to stop
+*
+* @return  none
+*/
+void cc2520ll_setSfdHook(cc2520ll_sfdHook_t hook)
+{
+    _disable_interrupts();
+    sfdHook = hook;
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txPatch
+*
+* @brief   Overwrite bytes of the frame in the TX FIFO, in radio RAM. Bytes
+*          already sent are not changed on air: from the SFD on, byte pos
+*          leaves the radio pos * 32 us later. A frame secured with
+*          SECURITY_CCM no longer authenticates once patched.
+*
+* @param   uint8_t pos - offset from the PHR; the MPDU starts at 1
+*          const uint8_t *pData
+*          uint8_t n - number of bytes
+*
+* @return  none
+*/
+void cc2520ll_txPatch(uint8_t pos, const uint8_t *pData, uint8_t n)
+{
+    CC2520_MEMWR(CC2520_RAM_TXBUF + pos, n, (uint8_t *)pData);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_setCsma
+*
+* @brief   Set the CSMA-CA parameters. Out of range exponents are clamped to
+*          minBe <= maxBe <= CC2520_MAC_BE_LIMIT.
+*
+* @param   uint8_t minBe - macMinBE
+*          uint8_t maxBe - macMaxBE
+*          uint8_t maxBackoffs - macMaxCSMABackoffs
+*
+* @return  int - SUCCESS, or FAILED if an exponent had to be clamped
+*/
+int cc2520ll_setCsma(uint8_t minBe, uint8_t maxBe, uint8_t maxBackoffs)
+{
+    int ret = SUCCESS;
+
+    if (maxBe > CC2520_MAC_BE_LIMIT) {
+        maxBe = CC2520_MAC_BE_LIMIT;
+        ret = FAILED;
+    }
+    if (minBe > maxBe) {
+        minBe = maxBe;
+        ret = FAILED;
+    }
+    pConfig.minBe = minBe;
+    pConfig.maxBe = maxBe;
+    pConfig.maxCsmaBackoffs = maxBackoffs;
+    return ret;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_setRetries
+*
+* @brief   Set macMaxFrameRetries, the retransmissions of a frame whose ACK
+*          did not come
+*
+* @param   uint8_t maxRetries
+*
+* @return  none
+*/
+void cc2520ll_setRetries(uint8_t maxRetries)
+{
+    pConfig.maxFrameRetries = maxRetries;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nextSeq
+*
+* @brief   Sequence number for the next frame (macDSN), for callers that
+*          build the MAC header
+*
+* @return  uint8_t - sequence number
+*/
+uint8_t cc2520ll_nextSeq(void)
+{
+    return macDsn++;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_getAckStats
+*
+* @brief   Acknowledged transmission counters for one destination
+*
+* @param   uint16_t dstAddr - short address, 0xFFFE for extended addresses
+*          cc2520ll_ackStats_t *pStats - filled in
+*
+* @return  int - SUCCESS, or FAILED if nothing was sent there (or the entry
+*          was reused)
+*/
+int cc2520ll_getAckStats(uint16_t dstAddr, cc2520ll_ackStats_t *pStats)
+{
+    uint8_t i;
+
+    for (i = 0; i < CC2520_ACK_STATS_ENTRIES; i++) {
+        if (ackStats[i].frames && ackStats[i].dstAddr == dstAddr) {
+            _disable_interrupts();
+            *pStats = ackStats[i];
+            _enable_interrupts();
+            return SUCCESS;
+        }
+    }
+    return FAILED;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_setTxMode
+*
+* @brief   In TX mode GPIO2 stays bound to TX_FRM_DONE after a frame, so
+*          back-to-back transmissions do not reprogram the GPIO mux. Leaving
+*          TX mode gives GPIO2 back to RSSI_VALID.
+*
+* @param   uint8_t enable - TRUE to enter TX mode, FALSE to leave it
+*
+* @return  none
+*/
+void cc2520ll_setTxMode(uint8_t enable)
+{
+    txMode = enable;
+    if (!enable) {
+        _disable_interrupts();
+        CC2520_CFG_GPIO_OUT(2, CC2520_GPIO_RSSI_VALID);
+        _enable_interrupts();
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_packetSend
+*
+* @brief   Sends a packet.
+*
+* @param   const void* packet - the packet to be sent.
+* @param   unsigned short len - teh length of the packet to be sent.
+*
+* @return  uint8_t - SUCCESS or FAILED
+*/
+int 
+cc2520ll_packetSend(const void* packet, unsigned short len) 
+{
+    if (cc2520ll_prepare(packet, len)) {
+	    return cc2520ll_transmit();
+    } else {
+		return FAILED;
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txLenOk
+*
+* @brief   Does a frame of this length fit, security overhead included?
+*
+* @param   uint8_t len - MPDU length without FCS
+*
+* @return  uint8_t - TRUE if it fits
+*/
+static uint8_t cc2520ll_txLenOk(uint8_t len)
+{
+#ifdef SECURITY_CCM
+    return len >= CC2520_HDR_SIZE - 1 && \
+        len + 3 + CC2520_AUX_HDR_LENGTH + CC2520_LEN_MIC <= MAX_802154_PACKET_SIZE + 1;
+#else
+    return len + 3 <= MAX_802154_PACKET_SIZE + 1;
+#endif
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txPhr
+*
+* @brief   PHR (frame length on air) of a frame
+*
+* @param   uint8_t len - MPDU length without FCS
+*
+* @return  uint8_t
+*/
+static uint8_t cc2520ll_txPhr(uint8_t len)
+{
+#ifdef SECURITY_CCM
+    return len + CC2520_AUX_HDR_LENGTH + CC2520_LEN_MIC + CC2520_FOOTER_SIZE;
+#else
+    return len + CC2520_FOOTER_SIZE;    // auto crc enabled
+#endif
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txWrite
+*
+* @brief   Load a frame into the TX FIFO. A frame already there, sent or not,
+*          is flushed by the radio first.
+*
+* @param   const uint8_t *packet - MPDU without FCS
+*          uint8_t len - number of bytes
+*
+* @return  uint8_t - SUCCESS, or FAILED if SECURITY_CCM refused the frame
+*          (MHR layout, frame counter) and nothing was written
+*/
+static uint8_t cc2520ll_txWrite(const uint8_t *packet, uint8_t len)
+{
+#ifdef SECURITY_CCM
+    // Secured in radio RAM and copied to the TX FIFO from there
+    return cc2520ll_secWriteTxBuf(packet, len);
+#else
+    uint8_t phr = cc2520ll_txPhr(len);
+
+    cc2520ll_writeTxBuf(&phr, 1);
+    cc2520ll_writeTxBuf((uint8_t*)packet, len);
+    return SUCCESS;
+#endif
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_txAckSetup
+*
+* @brief   Note whether the frame asks for an ACK, its sequence number and its
+*          destination. Broadcast frames are never acknowledged.
+*
+* @param   const uint8_t *pHdr - MPDU from the frame control field on
+*          uint8_t len - MPDU length without FCS
+*
+* @return  none
+*/
+static void cc2520ll_txAckSetup(const uint8_t *pHdr, uint8_t len)
+{
+    uint8_t dstMode;
+
+    txAckReq = len >= 3 && (pHdr[0] & CC2520_FCF_ACK_BM_L) && \
+        (pHdr[0] & CC2520_FCF_TYPE_BM_L) != CC2520_FCF_TYPE_ACK;
+    txSeq = len >= 3 ? pHdr[2] : 0;
+    dstMode = (pHdr[1] >> 2) & 0x03;
+    if (dstMode == CC2520_SRC_MODE_SHORT && len >= 7) {
+        txDst = pHdr[5] | ((uint16_t)pHdr[6] << 8);
+        if (txDst == 0xFFFF)
+            txAckReq = FALSE;
+    } else {
+        txDst = 0xFFFE;
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_packetSend
+*
+* @brief   Prepares a packet to be sent. The frame is loaded under the bus
+*          lock, so neither the RX interrupt nor a timer handler touches the
+*          radio or the transmitter state halfway through.
+*
+* @param   const void* packet - the packet to be sent.
+* @param   unsigned short len - teh length of the packet to be sent.
+*
+* @return  uint8_t - SUCCESS or FAILED
+*/
+int cc2520ll_prepare(const void *packet, uint8_t len){
+    unsigned short istate;
+    int ret = SUCCESS;
+
+	// Check packet length
+    if (!cc2520ll_txLenOk(len)) {
+    	return FAILED;
+    }
+
+    // Wait until the transceiver is idle
+    if (cc2520ll_waitTransceiverReady() == FAILED)
+        return FAILED;
+
+    CC2520_SPI_LOCK(istate);
+    if (txBusy) {
+        // The TX FIFO still holds the frame being sent
+        ret = FAILED;
+    } else if (cc2520ll_txWrite((const uint8_t*)packet, len) == FAILED) {
+        // No frame counter: do not leave an older frame to be sent
+        CC2520_INS_STROBE(CC2520_INS_SFLUSHTX);
+        ret = FAILED;
+    } else {
+        cc2520ll_txAckSetup((const uint8_t*)packet, len);
+        txLen = cc2520ll_txPhr(len);
+        // Turn on RX frame done interrupt for ACK reception
+        cc2520ll_enableRxInterrupt();
+    }
+    CC2520_SPI_UNLOCK(istate);
+    return ret;
+}
+/**********************************************************************************
+* @fn          cc2520ll_channel_clear
+*
+* @brief       Performs a clear channel assesment (CCA)
+* @return      int - 1 if channel clear, 0 otherwise.
+*/
+int
+cc2520ll_channel_clear(){
+	unsigned short istate;
+	int clear;
+
+	// No strobe from a timer handler between the sample and the pin
+	CC2520_SPI_LOCK(istate);
+	CC2520_INS_STROBE(CC2520_INS_SSAMPLECCA);	
+	clear = CC2520_SAMPLED_CCA_PIN;
+	CC2520_SPI_UNLOCK(istate);
+	return clear;
+}
+
+/**********************************************************************************
+* @fn          cc2520ll_rx_active
+*
+* @brief       Returns non-zero if reception in progress
+* @return      uint8_t - 1 if reception in progress, 0 otherwise.
+*/
+uint8_t
+cc2520ll_rx_active() {
+#ifdef INCLUDE_PA
+	// No frame can be on the air while the receiver is off. With it on,
+	// FSMSTAT1 is read at most once per rtimer tick while the shadow is fresh.
+	if (!CC2520_STATUS_QUERY(CC2520_STB_RX_ACTIVE_BV | CC2520_STB_TX_ACTIVE_BV))
+		return 0;
+	return CC2520_SFD_QUERY(rtimer_now());
+#else
+	// GPIO3 follows SFD
+	return CC2520_SFD_PIN;
+#endif
+}
+
+/**********************************************************************************
+* @fn          cc2520ll_tx_active
+*
+* @brief       Returns non-zero transmission in progress
+* @return      uint8_t - 1 if transmission in progress, 0 otherwise.
+*/
+uint8_t
+cc2520ll_tx_active() {
+	return CC2520_STATUS_QUERY(CC2520_STB_TX_ACTIVE_BV);
+}
+
+/**********************************************************************************
+* @fn          cc2520ll_idle
+*
+* @brief       Returns non-zero if cc2520 is in receive mode and no SFD has been
+* 			   received (neither transmiting nor receiving).
+* @return      uint8_t - 1 if idle, 0 otherwise.
+*/
+uint8_t
+cc2520ll_idle() {
+	return (!cc2520ll_rx_active() && !cc2520ll_tx_active());
+}
+
+
+/**********************************************************************************
+* @fn          cc2520ll_packetReceived
+*
+* @brief       Number of received frames waiting to be read, queued or staged.
+* @return      int - a number != 0 if there is new data to be read, 0 otherwise.
+*/
+int cc2520ll_packetReceived(void) {
+	uint8_t n;
+
+	n = rxqTail - rxqHead;
+#ifndef SECURITY_CCM
+	n += stageCount;
+#endif
+	return n;
+}
+
+/**********************************************************************************
+* @fn          cc2520ll_frameGet
+*
+* @brief       Oldest received frame, left in its queue slot until
+*              cc2520ll_frameFree() is called
+*
+* @return      cc2520ll_frame_t* - the frame, NULL if none was received
+*/
+cc2520ll_frame_t *cc2520ll_frameGet(void)
+{
+#ifndef SECURITY_CCM
+    // Staged frames follow the ones already queued; move them into the
+    // free slots whenever there are some
+    if (stageCount) {
+    	cc2520ll_stageDrain();
+    }
+#endif
+    if (rxqHead == rxqTail)
+        return NULL;
+    return &rxQueue[rxqHead & (CC2520_RXQ_SLOTS - 1)];
+}
+
+/**********************************************************************************
+* @fn          cc2520ll_frameFree
+*
+* @brief       Give the slot of the frame returned by cc2520ll_frameGet() back
+*              to the RX interrupt
+*
+* @return      none
+*/
+void cc2520ll_frameFree(void)
+{
+    if (rxqHead != rxqTail) {
+        rxqHead++;
+    }
+}
+
+/**********************************************************************************
+* @fn          cc2520ll_packetReceive
+*
+* @brief       Copies the oldest incoming packet, from the frame control field
+*              to the RSSI and CRC/correlation bytes, into a buffer
+*
+* @param       packet - pointer to data buffer to fill. This buffer must be
+*                        allocated by higher layer.
+*              maxlen - Maximum number of bytes to read from buffer
+*              
+* @return      uint8_t - number of bytes actually copied into buffer; 0 if
+*              there was no packet or it was longer than maxlen, in which
+*              case that packet alone is dropped
+*/
+int
+cc2520ll_packetReceive(uint8_t* packet, uint8_t maxlen)
+{
+	cc2520ll_frame_t *pFrame;
+	uint8_t len = 0, i;
+	
+    pFrame = cc2520ll_frameGet();
+    if (pFrame) {
+    	// The first byte in the packet is the packet's length
+    	// but it does not count the length field itself 
+    	len = pFrame->mpdu[0];
+    	if (len > maxlen) {
+    		len = 0;
+    	}
+    	for (i = 0; i < len; i++) {
+    		packet[i] = pFrame->mpdu[1 + i];
+    	}
+    	cc2520ll_frameFree();
+    }
+    return len;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_receiveOn
+*
+* @brief   Turn receiver on
+*
+* @param   none
+*
+* @return  none
+*/
+void
+cc2520ll_receiveOn(void)
+{
+    unsigned short istate;
+
+    CC2520_SPI_LOCK(istate);
+    CC2520_INS_STROBE(CC2520_INS_SRXON);
+    cc2520ll_enableRxInterrupt();
+    CC2520_SPI_UNLOCK(istate);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_receiveOff
+*
+* @brief   Turn receiver off
+*
+* @param   none
+*
+* @return  none
+*/
+void
+cc2520ll_receiveOff(void)
+{
+	unsigned short istate;
+
+	// wait until we finish receiving/transmitting
+	while(cc2520ll_rx_active());
+	CC2520_SPI_LOCK(istate);
+	cc2520ll_disableRxInterrupt();
+    CC2520_SRFOFF();
+	CC2520_SPI_UNLOCK(istate);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_disableRxInterrupt
+*
+* @brief   Clear and disable RX interrupt.
+*
+* @param   none
+*
+* @return  none
+*/
+void cc2520ll_disableRxInterrupt()
 {
     // Clear the exception and the IRQ
     CLEAR_EXC_RX_FRM_DONE();
@@ -646,18 +1822,27 @@ void cc2520ll_enableRxInterrupt()
 * @fn      cc2520ll_enter_lpm1
 *
 * @brief   Enters low power mode 1. In this mode no clocks are running but data
-* 		   is retained.
+* 		   is retained. The wait for a frame in progress is bounded by the
+* 		   longest frame and its ACK; a radio still busy by then is left on.
 *
 * @param   none
 *
-* @return  none
+* @return  uint8_t - SUCCESS, or FAILED if the radio did not become idle
 */
 
-void cc2520ll_enter_lpm1() 
+uint8_t cc2520ll_enter_lpm1() 
 {
+	rtimer_clock_t start;
+	unsigned short istate;
+
 	// wait until we finish receiving/transmitting
-	while(!cc2520ll_idle());
+	start = rtimer_now();
+	while (!cc2520ll_idle()) {
+		if ((rtimer_clock_t)(rtimer_now() - start) > RTIMER_US_TO_TICKS(CC2520_LPM1_IDLE_MAX_US))
+			return FAILED;
+	}
 	
+	CC2520_SPI_LOCK(istate);
 #ifdef INCLUDE_PA
 	// Set PAEN and EN low to power down cc2591 (SWRS070A)
     CC2520_CFG_GPIO_OUT(4, CC2520_GPIO_HIGH);	// GPIO4 and GPIO have inverted polarity
@@ -668,79 +1853,680 @@ void cc2520ll_enter_lpm1()
 	CC2520_SRFOFF();
 	// turn off crystal oscilator 
 	CC2520_SXOSCOFF();
+	CC2520_SPI_UNLOCK(istate);
+	return SUCCESS;
 }
 
 /***********************************************************************************
 * @fn      cc2520ll_exit_lpm1
 *
-* @brief   Leaves low power mode 1.
+* @brief   Leaves low power mode 1. The wait for the crystal oscillator is
+* 		   bounded by its startup time; a crystal that is not stable by then
+* 		   is turned off again. The status byte is polled one instruction at a
+* 		   time, so interrupts are served during the wait. Interrupt handlers
+* 		   use cc2520ll_exit_lpm1_start() and cc2520ll_exit_lpm1_finish() with
+* 		   a timer event in between instead.
 *
 * @param   none
 *
-* @return  none
+* @return  uint8_t - SUCCESS, or FAILED if XOSC did not become stable
 */
 
-void cc2520ll_exit_lpm1() 
+uint8_t cc2520ll_exit_lpm1() 
+{
+	uint8_t i;
+
+	cc2520ll_exit_lpm1_start();
+	// wait for XOSC to become stable, 10 us at a time
+	i = CC2520_XOSC_MAX_STARTUP_TIME / 10;
+	while (i > 0 && !(CC2520_SNOP() & CC2520_STB_XOSC_STABLE_BV)) {
+		__delay_cycles(10*MSP430_USECOND);
+		--i;
+	}
+	return cc2520ll_exit_lpm1_finish();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_exit_lpm1_start
+*
+* @brief   First half of leaving low power mode 1: start the crystal
+* 		   oscillator. Call cc2520ll_exit_lpm1_finish() once
+* 		   CC2520_XOSC_MAX_STARTUP_TIME has passed.
+*
+* @param   none
+*
+* @return  none
+*/
+void cc2520ll_exit_lpm1_start(void)
 {
-	// send SXOSCOFF command
+	// send SXOSCON command
 	CC2520_SXOSCON();
-	// send SNOP command (as said in SWRS068)
-	CC2520_SNOP();
-	// wait for XOSC to become stable
-	CC2520_SPI_BEGIN(); 	// set cs low
-	while ((P5IN & (1 << CC2520_MISO_PIN)) == 0);
-	CC2520_SPI_END();	 	// set cs high
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_exit_lpm1_finish
+*
+* @brief   Second half of leaving low power mode 1: with the crystal stable,
+* 		   restore the PA control and turn the receiver on; without it, turn
+* 		   the crystal off again. Does not wait.
+*
+* @param   none
+*
+* @return  uint8_t - SUCCESS, or FAILED if XOSC is not stable
+*/
+uint8_t cc2520ll_exit_lpm1_finish(void)
+{
+	unsigned short istate;
+	uint8_t ret = SUCCESS;
+
+	CC2520_SPI_LOCK(istate);
+	// SNOP returns the status byte (as said in SWRS068)
+	if (!(CC2520_SNOP() & CC2520_STB_XOSC_STABLE_BV)) {
+		CC2520_SXOSCOFF();
+		ret = FAILED;
+	} else {
 #ifdef INCLUDE_PA	
-	// Restore PAEN and EN values
-	CC2520_CFG_GPIO_OUT(4, 0x46);
-    CC2520_CFG_GPIO_OUT(5, 0x47);
+		// Restore PAEN and EN values
+		CC2520_CFG_GPIO_OUT(4, 0x46);
+	    CC2520_CFG_GPIO_OUT(5, 0x47);
 #endif	
-	// turn on frequency synthesizer
-	CC2520_SRXON();
+		// turn on frequency synthesizer
+		CC2520_SRXON();
+	}
+	CC2520_SPI_UNLOCK(istate);
+	return ret;
+}
+
+#ifndef INCLUDE_PA
+/***********************************************************************************
+* @fn          cc2520ll_sfdCapture
+*
+* @brief       Timer callback on the rising SFD edge. The SFD of a frame being
+*              sent goes to the hook; that of a frame being received waits for
+*              cc2520ll_sfdMatch(), the oldest capture making room if frames
+*              go unread.
+*
+* @return      none
+*/
+static void cc2520ll_sfdCapture(void)
+{
+    uint32_t t = rtimer_captureTime(RTIMER_SFD);
+
+    if (txOnAir) {
+        txSfd = t;
+        if (sfdHook)
+            sfdHook(t);
+        return;
+    }
+    sfdRing[sfdHead & (CC2520_SFD_SLOTS - 1)] = t;
+    sfdHead++;
+    if ((uint8_t)(sfdHead - sfdTail) > CC2520_SFD_SLOTS)
+        sfdTail++;
+}
+#endif
+
+/***********************************************************************************
+* @fn          cc2520ll_sfdMatch
+*
+* @brief       Find the SFD capture of the frame at the head of the RX FIFO.
+*              The frame ended at least the airtime of its own bytes and of the
+*              frames behind it ago, so its SFD is a capture older than that.
+*              Captures of frames the filter rejected, and of an automatic ACK
+*              sent for the frame, cannot be told from it by time alone once
+*              the handler runs late: the frame only gets a capture if exactly
+*              one is that old. Otherwise they are all dropped, and so is the
+*              time of every frame already behind it in the FIFO, whose
+*              capture may have gone with them. Without the capture
+*              (INCLUDE_PA) the last frame in the FIFO is taken to have ended
+*              now.
+*
+* @param       uint8_t len - frame length from the length byte
+*              uint8_t later - bytes of later frames behind it in the FIFO
+*              uint32_t *pTime - SFD time
+*
+* @return      uint8_t - TRUE if a capture was found
+*/
+static uint8_t cc2520ll_sfdMatch(uint8_t len, uint8_t later, uint32_t *pTime)
+{
+    uint32_t latest;
+#ifndef INCLUDE_PA
+    uint8_t i, n = 0;
+#endif
+
+    latest = rtimer_now32() - RTIMER_US_TO_TICKS(((uint16_t)len + 1 + later) * CC2520_BYTE_US);
+#ifdef INCLUDE_PA
+    if (later)
+        return FALSE;
+    *pTime = latest;
+    return TRUE;
+#else
+    // One tick of slack for the rounding
+    latest++;
+    // Captures old enough, oldest first
+    for (i = sfdTail; i != sfdHead; i++) {
+        if ((int32_t)(sfdRing[i & (CC2520_SFD_SLOTS - 1)] - latest) > 0)
+            break;
+        n++;
+    }
+    if (n == 1)
+        *pTime = sfdRing[(uint8_t)(i - 1) & (CC2520_SFD_SLOTS - 1)];
+    sfdTail = i;
+    if (sfdSkip) {
+        sfdSkip = (uint16_t)len + 1 >= sfdSkip ? 0 : sfdSkip - ((uint16_t)len + 1);
+        return FALSE;
+    }
+    if (n > 1) {
+        rxStats.sfdRejected++;
+        sfdSkip = later;
+    }
+    return n == 1;
+#endif
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_rxqSlot
+*
+* @brief       Free slot at the tail of the frame queue
+*
+* @return      cc2520ll_frame_t* - the slot, NULL if the queue is full
+*/
+static cc2520ll_frame_t *cc2520ll_rxqSlot(void)
+{
+    if ((uint8_t)(rxqTail - rxqHead) == CC2520_RXQ_SLOTS)
+        return NULL;
+    return &rxQueue[rxqTail & (CC2520_RXQ_SLOTS - 1)];
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_rxqPut
+*
+* @brief       Queue the frame just read into the slot from cc2520ll_rxqSlot().
+*              RSSI (in dBm) and LQI are taken from the status bytes and
+*              averaged into the neighbor table entry of a short source
+*              address. A channel move announced by the PAN coordinator is
+*              noted for cc2520ll_scanPoll(), a time sync record for
+*              cc2520ll_tsyncPoll(); TSCH takes its slot timing from it.
+*
+* @param       cc2520ll_frame_t *pFrame - the slot, NULL if there was none
+*              uint32_t timestamp
+*
+* @return      none
+*/
+static void cc2520ll_rxqPut(cc2520ll_frame_t *pFrame, uint32_t timestamp)
+{
+    uint8_t len, corr, i;
+    int16_t rssi;
+    uint16_t panId;
+
+    if (pFrame == NULL) {
+        rxStats.queueFull++;
+        return;
+    }
+    len = pFrame->mpdu[0];
+    pFrame->timestamp = timestamp;
+    rssi = (int8_t)pFrame->mpdu[len - 1] - CC2520_RSSI_OFFSET;
+    pFrame->rssi = rssi < -128 ? -128 : rssi;
+    // Correlation from CC2520_CORR_MIN up scaled to 0-255
+    corr = pFrame->mpdu[len] & ~CC2520_CRC_OK_BM;
+    if (corr <= CC2520_CORR_MIN)
+        pFrame->lqi = 0;
+    else if (corr >= CC2520_CORR_MAX)
+        pFrame->lqi = 255;
+    else
+        pFrame->lqi = (uint16_t)(corr - CC2520_CORR_MIN) * 255 / (CC2520_CORR_MAX - CC2520_CORR_MIN);
+    if (((pFrame->mpdu[2] >> 6) & 0x03) == CC2520_SRC_MODE_SHORT) {
+        i = cc2520ll_srcAddrPos(pFrame->mpdu, &panId);
+        if (i)
+            cc2520ll_nbrUpdate(pFrame->mpdu[i] | ((uint16_t)pFrame->mpdu[i + 1] << 8), \
+                pFrame->rssi, pFrame->lqi, timestamp);
+    }
+    cc2520ll_scanRxFrame(pFrame->mpdu);
+#ifndef SECURITY_CCM
+    cc2520ll_tsyncRxFrame(pFrame);
+#endif
+    cc2520ll_tschRxFrame(pFrame);
+    rxqTail++;
+}
+
+#ifndef SECURITY_CCM
+/***********************************************************************************
+* @fn          cc2520ll_stageAlloc
+*
+* @brief       Find room for n contiguous bytes in the staging area. Frames are
+*              never split: a frame that does not fit before the end of the
+*              area goes to its start.
+*
+* @param       uint8_t n - bytes needed
+*
+* @return      uint16_t - radio RAM address, 0 if the area is full
+*/
+static uint16_t cc2520ll_stageAlloc(uint8_t n)
+{
+    uint16_t head, tail;
+    uint8_t last;
+
+    if (stageCount == CC2520_STAGE_FRAMES)
+        return 0;
+    if (stageCount == 0)
+        return CC2520_STAGE_START;
+    head = stageAddr[stageFirst];
+    last = (stageFirst + stageCount - 1) % CC2520_STAGE_FRAMES;
+    tail = stageAddr[last] + stageLen[last];
+    if (tail > head) {
+        if (tail + n <= CC2520_STAGE_END)
+            return tail;
+        if (CC2520_STAGE_START + n <= head)
+            return CC2520_STAGE_START;
+    } else if (tail + n <= head) {
+        return tail;
+    }
+    return 0;
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_stageFrame
+*
+* @brief       Move the frame at the head of the RX FIFO, length byte and
+*              status bytes included, into the staging area with RXBUFMOV.
+*              The area is drained to the frame queue first if it is full.
+*
+* @param       uint8_t n - frame size, length byte included
+*              uint8_t later - bytes of later frames behind it in the FIFO
+*
+* @return      none
+*/
+static void cc2520ll_stageFrame(uint8_t n, uint8_t later)
+{
+    uint16_t addr;
+    uint32_t sfd = 0;
+    uint8_t i, sfdValid;
+
+    sfdValid = cc2520ll_sfdMatch(n - 1, later, &sfd);
+    addr = cc2520ll_stageAlloc(n);
+    if (addr == 0) {
+        cc2520ll_stageDrain();
+        addr = cc2520ll_stageAlloc(n);
+    }
+    if (addr == 0) {
+        // Queue and staging area both full: take the frame out of the FIFO
+        cc2520ll_readRxBuf(rxMpdu, n);
+        rxStats.queueFull++;
+        return;
+    }
+    CC2520_RXBUFMOV(1, addr, n, NULL);
+    i = (stageFirst + stageCount) % CC2520_STAGE_FRAMES;
+    stageAddr[i] = addr;
+    stageLen[i] = n;
+    stageTime[i] = CC2520_RX_TIMESTAMP();
+    stageSfd[i] = sfd;
+    stageSfdValid[i] = sfdValid;
+    stageCount++;
+    // RXFIFOCNT only drops once the move is done
+    WAIT_DPU_DONE_H();
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_stageDrain
+*
+* @brief       Copy staged frames with a good CRC and an accepted source from
+*              radio RAM into free queue slots. The oldest frames that lie
+*              back to back in the area, as many as there are free slots,
+*              come over in one MEMRD. Interrupts are only disabled to claim
+*              them and to hand each one to the queue; the MEMRD holds the
+*              bus lock for its own length (with CC2520_SPI_DMA the transfer
+*              runs with interrupts enabled). Frames that find no free slot
+*              stay staged. From the RX interrupt while a drain is running,
+*              nothing is done.
+*
+* @return      uint8_t - number of frames copied
+*/
+uint8_t cc2520ll_stageDrain(void)
+{
+    unsigned short istate;
+    cc2520ll_frame_t *pFrame;
+    uint16_t addr, total, pos;
+    uint8_t *pMpdu;
+    uint8_t first, count, free, len, i, n = 0;
+
+    // Claim the run: the RX interrupt neither drains nor overwrites it
+    // while stageFirst stays put
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    free = CC2520_RXQ_SLOTS - (uint8_t)(rxqTail - rxqHead);
+    if (stageDraining || stageCount == 0 || free == 0) {
+        __set_interrupt_state(istate);
+        return 0;
+    }
+    first = stageFirst;
+    addr = stageAddr[first];
+    total = stageLen[first];
+    for (count = 1; count < stageCount && count < free; count++) {
+        i = (first + count) % CC2520_STAGE_FRAMES;
+        if (stageAddr[i] != addr + total)
+            break;
+        total += stageLen[i];
+    }
+    stageDraining = TRUE;
+    __set_interrupt_state(istate);
+
+    CC2520_MEMRD(addr, total, stageBuf);
+
+    for (pos = 0; count > 0; count--, pos += len) {
+        len = stageLen[stageFirst];
+        pMpdu = &stageBuf[pos];
+        // The last byte holds CRC_OK and the correlation value
+        pMpdu[0] &= CC2520_PLD_LEN_MASK;
+        __disable_interrupt();
+        pFrame = cc2520ll_rxqSlot();
+        if (pFrame == NULL) {
+            __set_interrupt_state(istate);
+            break;
+        }
+        if ((pMpdu[len - 1] & CC2520_CRC_OK_BM) && cc2520ll_srcAccept(pMpdu)) {
+            memcpy(pFrame->mpdu, pMpdu, len);
+            pFrame->sfdTime = stageSfd[stageFirst];
+            pFrame->sfdValid = stageSfdValid[stageFirst];
+            cc2520ll_rxqPut(pFrame, stageTime[stageFirst]);
+            n++;
+        }
+        stageFirst = (stageFirst + 1) % CC2520_STAGE_FRAMES;
+        stageCount--;
+        __set_interrupt_state(istate);
+    }
+    stageDraining = FALSE;
+    return n;
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_setStaging
+*
+* @brief       In staging mode the RX interrupt moves received frames into a
+*              ring of slots in radio RAM instead of reading them over SPI.
+*              They are drained to the frame queue when the application reads
+*              a frame, when the area fills up, or by cc2520ll_stageDrain().
+*              Leaving staging mode drains what is left.
+*
+* @param       uint8_t enable - TRUE to stage frames in radio RAM
+*
+* @return      none
+*/
+void cc2520ll_setStaging(uint8_t enable)
+{
+    _disable_interrupts();
+    stageOn = enable;
+    if (!enable) {
+        cc2520ll_stageDrain();
+    }
+    _enable_interrupts();
 }
+#endif
 
 /***********************************************************************************
 * @fn          cc2520ll_packetReceivedISR
 *
-* @brief       Interrupt service routine for received frame from radio
-*              (either data or acknowlegdement)
+* @brief       Interrupt service routine for the radio exception pin (GPIO0,
+*              exception channel A). Reads the exception flags once and runs
+*              the registered handlers; the RX_FRM_DONE and RX_OVERFLOW
+*              handlers empty the RX FIFO.
 *
 * @return      none
 */
 void cc2520ll_packetReceivedISR(void)
 {
-    cc2520ll_packetHdr_t *pHdr;
-    uint8_t *pStatusWord;
-    
-    // Map header to packet buffer
-	pHdr = (cc2520ll_packetHdr_t*)rxMpdu;
-    // Clear interrupt and disable new RX frame done interrupt
-    cc2520ll_disableRxInterrupt();
+    // Clear the flag first, so an exception raised from here on interrupts again
+    P2IFG &= ~(1 << CC2520_INT_PIN);
+    CC2520_EXC_DISPATCH();
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_txFrameDoneISR
+*
+* @brief       Interrupt service routine for GPIO2 while a frame is sent
+*              (TX_FRM_DONE): the frame is on air, so report success or wait
+*              for its ACK.
+*
+* @return      none
+*/
+void cc2520ll_txFrameDoneISR(void)
+{
+    P2IFG &= ~(1 << CC2520_TX_INT_PIN);
+    if (!txOnAir)
+        return;
+    rtimer_cancel(RTIMER_MAC);
+    cc2520ll_txSent();
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_isBroadcast
+*
+* @brief       Is the frame sent to the broadcast short address?
+*
+* @param       const uint8_t *pMpdu - length byte and MPDU
+*
+* @return      uint8_t - TRUE for broadcast
+*/
+static uint8_t cc2520ll_isBroadcast(const uint8_t *pMpdu)
+{
+    // Destination PAN ID at 4-5, short address at 6-7
+    return ((pMpdu[2] >> 2) & 0x03) == CC2520_SRC_MODE_SHORT && pMpdu[0] >= 9 && \
+        pMpdu[6] == 0xFF && pMpdu[7] == 0xFF;
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_rxFrame
+*
+* @brief       Take the frame at the head of the RX FIFO, and nothing more,
+*              out of the FIFO. Data frames are read straight into a free
+*              queue slot (or moved to the staging area) and queued if the
+*              CRC is good and the source is accepted; acknowledgements are
+*              matched against the frame being sent and discarded. Every
+*              frame takes its SFD capture along.
+*
+* @param       uint8_t len - frame length from the length byte
+*              uint8_t later - bytes of later frames behind it in the FIFO
+*
+* @return      none
+*/
+static void cc2520ll_rxFrame(uint8_t len, uint8_t later)
+{
+    cc2520ll_frame_t *pFrame;
+    uint8_t *pMpdu;
+    uint8_t accept;
+    uint32_t sfd = 0;
+    uint8_t sfdValid;
+
+#ifndef SECURITY_CCM
+    if (stageOn && len != CC2520_ACK_PACKET_SIZE) {
+        // Move the whole frame to radio RAM; the MCU reads it when the
+        // application asks for it
+        cc2520ll_stageFrame(len + 1, later);
+        return;
+    }
+#endif
+    sfdValid = cc2520ll_sfdMatch(len, later, &sfd);
+
+    // With every slot taken the frame is still read, into scratch space
+    pFrame = cc2520ll_rxqSlot();
+    pMpdu = pFrame ? pFrame->mpdu : rxMpdu;
+
     // Read payload length.
-    cc2520ll_readRxBuf(rxMpdu, 1);
-    rxMpdu[0] &= CC2520_PLD_LEN_MASK;	 // Ignore MSB
-    pHdr->packetLength = rxMpdu[0];
+    cc2520ll_readRxBuf(pMpdu, 1);
+    pMpdu[0] &= CC2520_PLD_LEN_MASK;	 // Ignore MSB
 
     // Is this an acknowledgment packet?
     // Only ack packets may be 5 bytes in total.
-    if (pHdr->packetLength != CC2520_ACK_PACKET_SIZE) {
-        // It is assumed that the radio rejects packets with invalid length.
-        // Subtract the number of bytes in the frame overhead to get actual payload.
-        cc2520ll_readRxBuf(&rxMpdu[1], pHdr->packetLength);
-        // Read the FCS to get the RSSI and CRC
-        pStatusWord = rxMpdu + pHdr->packetLength + 1 - 2;
-        // Notify the application about the received data packet if the CRC is OK
-        if(pStatusWord[1] & CC2520_CRC_OK_BM) {
-            // All ok; copy received frame to ring buffer
-	        bufPut(&rxBuffer, rxMpdu, rxMpdu[0] + 1);
-	        // call process_poll() on behalf of cc2520_process
-	        //process_poll(&cc2520_process);
+    if (len == CC2520_ACK_PACKET_SIZE) {
+        cc2520ll_readRxBuf(&pMpdu[1], len);
+        cc2520ll_rxAck(pMpdu);
+        return;
+    }
+#ifdef SECURITY_CCM
+    // Authenticated and decrypted in radio RAM; only the plaintext is read
+    accept = cc2520ll_secReadRxBuf(pMpdu, len);
+#else
+    // It is assumed that the radio rejects packets with invalid length.
+    cc2520ll_readRxBuf(&pMpdu[1], len);
+    // The last byte holds CRC_OK and the correlation value
+    accept = pMpdu[len] & CC2520_CRC_OK_BM;
+#endif
+    // The radio has no switch for broadcast frames
+    if (accept && !filter.broadcast && cc2520ll_isBroadcast(pMpdu))
+        accept = FALSE;
+    if (accept && cc2520ll_srcAccept(pMpdu)) {
+        if (pFrame) {
+            pFrame->sfdTime = sfd;
+            pFrame->sfdValid = sfdValid;
         }
-        // Flush the cc2520 rx buffer to prevent residual data
-        CC2520_SFLUSHRX();
+        cc2520ll_rxqPut(pFrame, CC2520_RX_TIMESTAMP());
+        // call process_poll() on behalf of cc2520_process
+        //process_poll(&cc2520_process);
+    } else {
+        filterStats[filter.enable ? CC2520_FILT_MODE_ON : CC2520_FILT_MODE_OFF].dropped++;
     }
-    // Enable RX frame done interrupt again   
-    cc2520ll_enableRxInterrupt();
-    // Clear interrupt flag
-    P2IFG &= ~(1 << CC2520_INT_PIN);
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_rxDrain
+*
+* @brief       Take every complete frame out of the RX FIFO. RXFIRST and
+*              RXFIFOCNT are read in one burst before each frame; a frame
+*              whose bytes have not all arrived is left for the next
+*              RX_FRM_DONE.
+*
+* @return      none
+*/
+static void cc2520ll_rxDrain(void)
+{
+    uint8_t fifo[3];    // RXFIRST, reserved, RXFIFOCNT
+    uint8_t len, n = 0, mode;
+
+    for (;;) {
+        CC2520_REGRD(CC2520_RXFIRST, sizeof(fifo), fifo);
+        len = fifo[0] & CC2520_PLD_LEN_MASK;
+        if (fifo[2] == 0 || fifo[2] < len + 1)
+            break;
+        cc2520ll_rxFrame(len, fifo[2] - (len + 1));
+        n++;
+    }
+    rxStats.interrupts++;
+    rxStats.frames += n;
+    mode = filter.enable ? CC2520_FILT_MODE_ON : CC2520_FILT_MODE_OFF;
+    filterStats[mode].interrupts++;
+    filterStats[mode].frames += n;
+    if (n > rxStats.maxPerInterrupt)
+        rxStats.maxPerInterrupt = n;
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_rxOverflow
+*
+* @brief       RX_OVERFLOW handler. The radio stops receiving until the FIFO
+*              is flushed: keep the complete frames, then flush the frame
+*              that did not fit. Runs before the RX_FRM_DONE handler, which
+*              then finds the FIFO empty.
+*
+* @param       uint8_t exc - CC2520_EXC_RX_OVERFLOW
+*
+* @return      none
+*/
+static void cc2520ll_rxOverflow(uint8_t exc)
+{
+    (void)exc;
+    cc2520ll_rxDrain();
+    CC2520_SFLUSHRX();
+#ifndef INCLUDE_PA
+    // The captures left belong to the frames just flushed
+    sfdTail = sfdHead;
+    sfdSkip = 0;
+#endif
+    rxStats.overflows++;
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_rxFrameDone
+*
+* @brief       RX_FRM_DONE handler: copy the received frames (either data or
+*              acknowlegdement) to the ring buffer. The exception has already
+*              been cleared by the dispatcher, so frames completed while the
+*              FIFO is being read raise it again.
+*
+* @param       uint8_t exc - CC2520_EXC_RX_FRM_DONE
+*
+* @return      none
+*/
+static void cc2520ll_rxFrameDone(uint8_t exc)
+{
+    (void)exc;
+    cc2520ll_rxDrain();
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_setFilter
+*
+* @brief       Program the frame filter. Frames it rejects are dropped by the
+*              radio and never raise RX_FRM_DONE; broadcast frames can only be
+*              dropped in software. Takes effect from the next frame.
+*
+* @param       const cc2520ll_filter_t *pFilter
+*
+* @return      none
+*/
+void cc2520ll_setFilter(const cc2520ll_filter_t *pFilter)
+{
+    uint8_t frmfilt0, frmfilt1;
+
+    frmfilt0 = ((pFilter->maxVersion & 0x03) << CC2520_FRMFILT0_MAX_FRAME_VERSION) | \
+        (pFilter->panCoord ? CC2520_FRMFILT0_PAN_COORDINATOR : 0) | \
+        (pFilter->enable ? CC2520_FRMFILT0_FRM_FILTER_EN : 0);
+    frmfilt1 = pFilter->frameTypes & CC2520_FRMFILT1_ACCEPT_BM;
+    _disable_interrupts();
+    filter = *pFilter;
+    // FRMFILT0 and FRMFILT1 in one burst
+    CC2520_REGWR16(CC2520_FRMFILT0, frmfilt0 | ((uint16_t)frmfilt1 << 8));
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_getFilter
+*
+* @brief       Copy the frame filter settings
+*
+* @param       cc2520ll_filter_t *pFilter
+*
+* @return      none
+*/
+void cc2520ll_getFilter(cc2520ll_filter_t *pFilter)
+{
+    *pFilter = filter;
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_getFilterStats
+*
+* @brief       Copy the RX counters kept while a filter mode was set
+*
+* @param       uint8_t mode - CC2520_FILT_MODE_xxx
+*              cc2520ll_filterStats_t *pStats
+*
+* @return      none
+*/
+void cc2520ll_getFilterStats(uint8_t mode, cc2520ll_filterStats_t *pStats)
+{
+    _disable_interrupts();
+    *pStats = filterStats[mode];
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn          cc2520ll_getRxStats
+*
+* @brief       Copy the RX interrupt counters
+*
+* @param       cc2520ll_rxStats_t *pStats
+*
+* @return      none
+*/
+void cc2520ll_getRxStats(cc2520ll_rxStats_t *pStats)
+{
+    *pStats = rxStats;
 }
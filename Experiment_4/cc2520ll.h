@@ -1,9 +1,9 @@
 #ifndef CC2520_H_
 #define CC2520_H_
 
-#include <msp430f5435.h>
 #include <inttypes.h>
 #include "hal_cc2520.h"
+#include "rtimer.h"
 
 
 
@@ -11,6 +11,7 @@
 #define CC2520_RESET_PIN		1
 #define CC2520_VREG_EN_PIN		7
 #define CC2520_INT_PIN			0
+#define CC2520_TX_INT_PIN		2       // GPIO2, TX_FRM_DONE while sending
 
 /* spi pin definitions */
 #define CC2520_CS_PIN			5
@@ -23,8 +24,54 @@
 #define MSP430_USECOND			16
 /* A milisecond in msp430 cycles at 16MHz */
 #define MSP430_MSECOND			16000
-/* Ring buffer length */
-#define CC2520_BUF_LEN					512
+/* Transmit queue slots (cc2520ll_txqPut). One slot holds a whole frame */
+#define CC2520_TXQ_SLOTS					4
+/* Received frame queue slots (a power of two). One slot holds a whole frame */
+#define CC2520_RXQ_SLOTS					8
+/* Longest register run written in one burst by cc2520ll_config() */
+#define CC2520_REG_BURST_LEN				8
+/* Radio RAM staging area for received frames (see cc2520ll_setStaging). It
+   shares the general purpose RAM with the link security buffers, so staging
+   is not available with SECURITY_CCM */
+#define CC2520_STAGE_START					0x200
+#define CC2520_STAGE_END					CC2520_RAM_CBCTEMPL
+#define CC2520_STAGE_FRAMES					8
+/* Time stamp taken for each received frame when it leaves the RX FIFO. By
+   default the extended Timer_A1 count (rtimer_now32(), ACLK ticks); the
+   application may define another 32-bit clock */
+#ifndef CC2520_RX_TIMESTAMP
+#define CC2520_RX_TIMESTAMP()				rtimer_now32()
+#endif
+/* SFD time stamps. GPIO3 drives SFD onto P2.3, the TA1.2 capture input of
+   rtimer channel RTIMER_SFD, so the timer latches the end of the SFD field of
+   every frame sent or received. Captures of received frames wait here until
+   their frame is read. Captures of frames the filter rejected look the
+   same, so a frame read while more than one capture is old enough to be its
+   own gets no SFD time (rxStats.sfdRejected). With INCLUDE_PA GPIO3 drives
+   the CC2590 instead: the SFD of a frame sent is then reckoned from its
+   strobe, and that of a frame received from the RX_FRM_DONE interrupt, which
+   is only exact if it runs at once. */
+#define CC2520_SFD_SLOTS					4		// Power of 2
+#define CC2520_BYTE_US						32		// 2 symbols
+#define CC2520_SHR_US						(5 * CC2520_BYTE_US)	// Preamble and SFD
+/* Unslotted CSMA-CA defaults (IEEE 802.15.4 macMinBE, macMaxBE,
+   macMaxCSMABackoffs) and timing in microseconds */
+#define CC2520_MAC_MIN_BE					3
+#define CC2520_MAC_MAX_BE					5
+#define CC2520_MAC_MAX_CSMA_BACKOFFS		4
+#define CC2520_MAC_BE_LIMIT					8       // Largest macMaxBE: 8-bit random backoff
+#define CC2520_UNIT_BACKOFF_US				320     // aUnitBackoffPeriod, 20 symbols
+#define CC2520_TX_TURNAROUND_US				192     // STXONCCA to first preamble symbol
+#define CC2520_RSSI_VALID_MAX_US			640     // SRXON to RSSI_VALID (192 + 128 us), doubled
+#define CC2520_SFD_MAX_US					CC2520_TX_TIME_US(MAX_802154_PACKET_SIZE)  // SFD high, longest frame
+#define CC2520_LPM1_IDLE_MAX_US				(CC2520_TX_TIME_US(MAX_802154_PACKET_SIZE) + CC2520_ACK_WAIT_US)
+#define CC2520_TX_TIME_US(len)				(((uint16_t)(len) + 6) * 32)    // SHR, PHR and PSDU on air
+/* Acknowledged transmission: macMaxFrameRetries and macAckWaitDuration (54
+   symbols: turnaround, the ACK frame and one backoff period of slack) */
+#define CC2520_MAC_MAX_FRAME_RETRIES		3
+#define CC2520_ACK_WAIT_US					(CC2520_TX_TURNAROUND_US + CC2520_ACK_DURATION + CC2520_UNIT_BACKOFF_US)
+/* Destinations tracked by cc2520ll_getAckStats (least recently used replaced) */
+#define CC2520_ACK_STATS_ENTRIES			8
 /* Startup time values (in microseconds) */
 #define CC2520_XOSC_MAX_STARTUP_TIME        300
 #define CC2520_VREG_MAX_STARTUP_TIME        200
@@ -44,13 +91,18 @@
 */
 
 // Application parameters
-#define RF_CHANNEL              11      // 2.4 GHz RF channel
+#ifndef RF_CHANNEL
+#define RF_CHANNEL              11      // 2.4 GHz RF channel at init, see cc2520ll_scan.h
+#endif
 
 // BasicRF address definitions
 #define PAN_ID                	0xabcd
 
 #define SHORT_ADD								0x1234
 
+// Secure every data frame with AES-CCM* in the radio (see cc2520ll_sec.h)
+//#define SECURITY_CCM
+
 // Node's address
 #ifdef UIP_LLADDR0
 #define CC2520_LLADDR0	UIP_LLADDR0
@@ -146,6 +198,30 @@
 #define CC2520_FCF_ACK_BM_L               LO_UINT16(CC2520_FCF_ACK_BM)
 #define CC2520_FCF_BM_L                   LO_UINT16(CC2520_FCF_BM)
 #define CC2520_SEC_ENABLED_FCF_BM_L       LO_UINT16(CC2520_SEC_ENABLED_FCF_BM)
+#define CC2520_FCF_TYPE_BM_L              0x07
+#define CC2520_FCF_TYPE_ACK               0x02
+
+// FRMFILT0 and FRMFILT1
+#define CC2520_FRMFILT0_FRM_FILTER_EN     0x01
+#define CC2520_FRMFILT0_PAN_COORDINATOR   0x02
+#define CC2520_FRMFILT0_MAX_FRAME_VERSION 2     // Bit position
+#define CC2520_FRMFILT1_ACCEPT_BM         0xF8
+
+// Frame types accepted by the frame filter (FRMFILT1 ACCEPT_FT_xxx bits)
+#define CC2520_FILT_BEACON                0x08
+#define CC2520_FILT_DATA                  0x10
+#define CC2520_FILT_ACK                   0x20
+#define CC2520_FILT_CMD                   0x40
+#define CC2520_FILT_RESERVED              0x80  // Frame types 4-7
+#define CC2520_FILT_ALL                   0xF8
+
+// Frame filter modes, for cc2520ll_getFilterStats
+#define CC2520_FILT_MODE_OFF              0     // Promiscuous
+#define CC2520_FILT_MODE_ON               1     // Filtered in the radio
+#define CC2520_FILT_MODES                 2
+
+// FRMCTRL0
+#define CC2520_FRMCTRL0_AUTOACK_BIT       5
 
 // Auxiliary Security header
 #define CC2520_AUX_HDR_LENGTH             5
@@ -157,6 +233,17 @@
 // Footer
 #define CC2520_CRC_OK_BM                  0x80
 
+// Correlation values mapped to LQI 0 and 255 (frame_t lqi)
+#define CC2520_CORR_MIN                   50
+#define CC2520_CORR_MAX                   110
+
+// Transmission outcome passed to cc2520ll_txCallback_t
+#define CC2520_TX_OK                      0
+#define CC2520_TX_CHANNEL_BUSY            1     // CCA failed macMaxCSMABackoffs + 1 times
+#define CC2520_TX_NOACK                   2     // No ACK after macMaxFrameRetries retransmissions
+#define CC2520_TX_RADIO_OFF               3     // XOSC did not start, or the receiver is off
+#define CC2520_TX_NO_COUNTER              4     // SECURITY_CCM frame counter used up, not sent
+
 // IEEE 802.15.4 defined constants (2.4 GHz logical channels)
 #define MIN_CHANNEL 				        11    // 2405 MHz
 #define MAX_CHANNEL                         26    // 2480 MHz
@@ -175,6 +262,10 @@ typedef struct {
     uint8_t channel;
     uint8_t ackRequest;
     uint16_t myShortAddr;
+    uint8_t minBe;              // CSMA-CA, see cc2520ll_setCsma
+    uint8_t maxBe;
+    uint8_t maxCsmaBackoffs;
+    uint8_t maxFrameRetries;    // see cc2520ll_setRetries
 } cc2520ll_cfg_t;
 
 // The receive struct
@@ -206,25 +297,123 @@ typedef struct {
     uint8_t   seqNumber;
 } cc2520ll_packetHdr_t;
 
+// Received frame queue slot
+typedef struct {
+    uint32_t sfdTime;           // End of the SFD field, rtimer_now32() ticks, if sfdValid
+    uint32_t timestamp;         // CC2520_RX_TIMESTAMP() when the frame left the RX FIFO
+    int8_t rssi;                // dBm (CC2520_RSSI_OFFSET applied)
+    uint8_t lqi;                // 0-255, scaled from the correlation value
+    uint8_t sfdValid;           // An SFD capture was matched to the frame
+    uint8_t mpdu[128];          // Length byte, MPDU, RSSI and CRC_OK/correlation
+} cc2520ll_frame_t;
+
+// Frame filter settings (cc2520ll_setFilter)
+typedef struct {
+    uint8_t enable;             // FALSE: promiscuous, every frame with a good length
+    uint8_t frameTypes;         // CC2520_FILT_xxx
+    uint8_t panCoord;           // Accept data and command frames without destination
+    uint8_t maxVersion;         // Highest frame version accepted, 0-3
+    uint8_t broadcast;          // Accept frames to the broadcast short address
+} cc2520ll_filter_t;
+
+// Received frames per filter mode
+typedef struct {
+    uint16_t interrupts;        // RX handler runs while the mode was set
+    uint16_t frames;            // Frames taken from the RX FIFO
+    uint16_t dropped;           // Of those, rejected in software
+} cc2520ll_filterStats_t;
+
+// Transmission done, status is CC2520_TX_xxx. Called from interrupt context.
+typedef void (*cc2520ll_txCallback_t)(uint8_t status);
+// Called from the SFD capture interrupt while a frame is sent
+typedef void (*cc2520ll_sfdHook_t)(uint32_t sfdTime);
+
+// Transmit queue slot
+typedef struct {
+    uint8_t len;                // MPDU length without FCS, 0 if the slot is free
+    uint8_t priority;
+    cc2520ll_txCallback_t callback;
+    uint8_t mpdu[MAX_802154_PACKET_SIZE - CC2520_FOOTER_SIZE];
+} cc2520ll_txqSlot_t;
+
+// Acknowledged transmissions to one short address (0xFFFE: extended address)
+typedef struct {
+    uint16_t dstAddr;
+    uint16_t frames;            // Frames that requested an ACK
+    uint16_t retries;           // Retransmissions after a missing ACK
+    uint16_t noAck;             // Frames given up without an ACK
+    uint16_t channelBusy;       // Frames given up on CSMA-CA failure
+    uint8_t age;                // 0 for the most recently used entry
+} cc2520ll_ackStats_t;
+
+// RX interrupt counters
+typedef struct {
+    uint16_t interrupts;        // RX_FRM_DONE and RX_OVERFLOW handler runs
+    uint16_t frames;            // Frames taken from the RX FIFO
+    uint8_t maxPerInterrupt;    // Most frames taken in one handler run
+    uint16_t overflows;         // RX FIFO overflows, each losing the frame that did not fit
+    uint16_t queueFull;         // Good frames dropped because every queue slot was taken
+    uint16_t sfdRejected;       // Frames read too late to tell their SFD capture apart
+} cc2520ll_rxStats_t;
+
 /* External functions */
 
 int cc2520ll_init();
+void cc2520ll_setChannel(uint8_t channel);
+uint8_t cc2520ll_getChannel(void);
 int cc2520ll_prepare(const void *packet, uint8_t len);
 int cc2520ll_transmit(void);
+int cc2520ll_transmitAsync(cc2520ll_txCallback_t callback);
+int cc2520ll_transmitStrobe(cc2520ll_txCallback_t callback, rtimer_clock_t end);
+int cc2520ll_transmitSlot(cc2520ll_txCallback_t callback, uint8_t cca);
+rtimer_clock_t cc2520ll_txTime(void);
+uint32_t cc2520ll_txSfdTime(void);
+void cc2520ll_setSfdHook(cc2520ll_sfdHook_t hook);
+void cc2520ll_txPatch(uint8_t pos, const uint8_t *pData, uint8_t n);
+uint8_t cc2520ll_txBusy(void);
+uint8_t cc2520ll_txResult(void);
+int cc2520ll_txqPut(const void *packet, uint8_t len, uint8_t priority, cc2520ll_txCallback_t callback);
+uint8_t cc2520ll_txqCount(void);
+int cc2520ll_setCsma(uint8_t minBe, uint8_t maxBe, uint8_t maxBackoffs);
+void cc2520ll_setRetries(uint8_t maxRetries);
+uint8_t cc2520ll_nextSeq(void);
+int cc2520ll_getAckStats(uint16_t dstAddr, cc2520ll_ackStats_t *pStats);
+void cc2520ll_setTxMode(uint8_t enable);
+void cc2520ll_setLongAddr(const uint8_t *pLongAddr);
+void cc2520ll_setAutoAck(uint8_t enable);
 int cc2520ll_packetSend(const void* packet, unsigned short len);
 int cc2520ll_packetReceive(uint8_t* packet, uint8_t maxlen);
 int cc2520ll_packetReceived(void);
+cc2520ll_frame_t *cc2520ll_frameGet(void);
+void cc2520ll_frameFree(void);
 void cc2520ll_receiveOn(void);
 void cc2520ll_receiveOff(void);
 void cc2520ll_disableRxInterrupt(void);
 void cc2520ll_enableRxInterrupt(void);
-void cc2520ll_enter_lpm1(void);
-void cc2520ll_exit_lpm1(void); 
+void cc2520ll_getRxStats(cc2520ll_rxStats_t *pStats);
+void cc2520ll_setFilter(const cc2520ll_filter_t *pFilter);
+void cc2520ll_getFilter(cc2520ll_filter_t *pFilter);
+void cc2520ll_getFilterStats(uint8_t mode, cc2520ll_filterStats_t *pStats);
+uint8_t cc2520ll_enter_lpm1(void);
+uint8_t cc2520ll_exit_lpm1(void);
+void cc2520ll_exit_lpm1_start(void);
+uint8_t cc2520ll_exit_lpm1_finish(void);
 uint8_t cc2520ll_tx_active(void);
 uint8_t cc2520ll_rx_active(void);
 uint8_t cc2520ll_idle(void);
+int cc2520ll_channel_clear(void);
+#ifndef SECURITY_CCM
+void cc2520ll_setStaging(uint8_t enable);
+uint8_t cc2520ll_stageDrain(void);
+#endif
+#ifdef CC2520_HOST
+// Register set-up, for the host tests
+uint8_t cc2520ll_config(void);
+const regVal_t *cc2520ll_regTable(uint8_t *pCount);
+#endif
 
 // Interrupt handler routines
 void cc2520ll_packetReceivedISR(void);
+void cc2520ll_txFrameDoneISR(void);
 
 #endif /*CC2520_H_*/
@@ -0,0 +1,830 @@
+#include <string.h>
+#include "cc2520ll_lowpan.h"
+#include "cc2520ll_src.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Frame header written by cc2520ll_lowpanSend (see cc2520ll_txAckSetup)
+#define LOWPAN_MHR_LEN          (CC2520_HDR_SIZE - 1)
+// Largest IPHC and NHC header: IPHC, CID, TF, next header, hop limit, two
+// full addresses, UDP ports and checksum
+#define LOWPAN_HC_MAX           (2 + 1 + 4 + 1 + 1 + 16 + 16 + 7)
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static const uint8_t linkLocal[8] = { 0xFE, 0x80, 0, 0, 0, 0, 0, 0 };
+// Interface identifier of a short address: 0000:00ff:fe00:XXXX
+static const uint8_t shortIid[6] = { 0, 0, 0, 0xFF, 0xFE, 0 };
+
+static uint8_t ctxPrefix[CC2520_LOWPAN_CONTEXTS][8];
+static uint8_t ctxValid[CC2520_LOWPAN_CONTEXTS];
+
+static cc2520ll_lowpanStats_t lowpanStats;
+static uint16_t lowpanTag;
+
+// Reassembly of one fragmented packet at a time
+static uint8_t reassBuf[CC2520_LOWPAN_MTU];
+static uint8_t reassUnits[(CC2520_LOWPAN_MTU / 8 + 7) / 8];    // 8-byte units received
+static uint8_t reassSrc[8];
+static uint16_t reassTag, reassSize, reassRecv;
+static uint32_t reassStart;             // rtimer_now32() at the first fragment
+static uint8_t reassUdp;                // UDP header was compressed: fill in its length
+static uint8_t reassOn;
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanIsZero
+*
+* @brief   Are n bytes all zero?
+*/
+static uint8_t cc2520ll_lowpanIsZero(const uint8_t *p, uint8_t n)
+{
+    while (n--) {
+        if (*p++)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanMacIid
+*
+* @brief   Interface identifier implied by a frame address: 0000:00ff:fe00:XXXX
+*          for a short address, the EUI-64 with the U/L bit inverted for an
+*          extended one. Frames carry addresses least significant byte first.
+*/
+static void cc2520ll_lowpanMacIid(const uint8_t *pAddr, uint8_t mode, uint8_t *pIid)
+{
+    uint8_t i;
+
+    if (mode == CC2520_SRC_MODE_EXT) {
+        for (i = 0; i < 8; i++) {
+            pIid[i] = pAddr[7 - i];
+        }
+        pIid[0] ^= 0x02;
+    } else if (mode == CC2520_SRC_MODE_SHORT) {
+        memcpy(pIid, shortIid, 6);
+        pIid[6] = pAddr[1];
+        pIid[7] = pAddr[0];
+    } else {
+        memset(pIid, 0, 8);
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanContext
+*
+* @brief   Context whose prefix covers a unicast address, -1 if none
+*/
+static int8_t cc2520ll_lowpanContext(const uint8_t *pAddr)
+{
+    int8_t i;
+
+    for (i = 0; i < CC2520_LOWPAN_CONTEXTS; i++) {
+        if (ctxValid[i] && memcmp(pAddr, ctxPrefix[i], 8) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanIidCompress
+*
+* @brief   Write as little of an interface identifier as the receiver needs:
+*          nothing if the frame address implies it, 16 bits if it is derived
+*          from a short address, else all 64 bits
+*
+* @return  uint8_t - SAM/DAM mode 1-3
+*/
+static uint8_t cc2520ll_lowpanIidCompress(const uint8_t *pIid, const uint8_t *pMacIid, uint8_t **ppOut)
+{
+    if (memcmp(pIid, pMacIid, 8) == 0)
+        return 3;
+    if (memcmp(pIid, shortIid, 6) == 0) {
+        memcpy(*ppOut, &pIid[6], 2);
+        *ppOut += 2;
+        return 2;
+    }
+    memcpy(*ppOut, pIid, 8);
+    *ppOut += 8;
+    return 1;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanIidDecompress
+*
+* @brief   Inverse of cc2520ll_lowpanIidCompress
+*/
+static const uint8_t *cc2520ll_lowpanIidDecompress(uint8_t mode, const uint8_t *pIn, \
+    const uint8_t *pMacIid, uint8_t *pIid)
+{
+    if (mode == 3) {
+        memcpy(pIid, pMacIid, 8);
+    } else if (mode == 2) {
+        memcpy(pIid, shortIid, 6);
+        memcpy(&pIid[6], pIn, 2);
+        pIn += 2;
+    } else {
+        memcpy(pIid, pIn, 8);
+        pIn += 8;
+    }
+    return pIn;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanCompress
+*
+* @brief   Compress the IPv6 header, and a UDP header right after it, with
+*          IPHC and NHC. Payload lengths are always elided; the receiver
+*          takes them from the frame or from the fragment header.
+*
+* @param   const uint8_t *pIp - IPv6 packet
+*          uint16_t len - its length
+*          const uint8_t *pSrcIid, *pDstIid - identifiers implied by the frame
+*          uint8_t *pHc - LOWPAN_HC_MAX bytes
+*          uint8_t *pUsed - bytes of pIp replaced (40 or 48)
+*
+* @return  uint8_t - bytes written to pHc
+*/
+static uint8_t cc2520ll_lowpanCompress(const uint8_t *pIp, uint16_t len, \
+    const uint8_t *pSrcIid, const uint8_t *pDstIid, uint8_t *pHc, uint8_t *pUsed)
+{
+    const uint8_t *pSrc = &pIp[8], *pDst = &pIp[24], *pUdp = &pIp[40];
+    uint8_t *p = &pHc[2];
+    uint8_t tc, iphc0 = CC2520_LOWPAN_DISPATCH_IPHC, iphc1 = 0;
+    uint32_t fl;
+    uint16_t sport, dport;
+    int8_t sci = -1, dci = -1;
+
+    // Contexts only serve global addresses
+    if (memcmp(pSrc, linkLocal, 8) != 0)
+        sci = cc2520ll_lowpanContext(pSrc);
+    if (pDst[0] != 0xFF && memcmp(pDst, linkLocal, 8) != 0)
+        dci = cc2520ll_lowpanContext(pDst);
+    if (sci > 0 || dci > 0) {
+        iphc1 |= CC2520_LOWPAN_IPHC_CID;
+        *p++ = (sci > 0 ? sci << 4 : 0) | (dci > 0 ? dci : 0);
+    }
+
+    // Traffic class (DSCP and ECN) and flow label; inline in ECN, DSCP order
+    tc = (pIp[0] << 4) | (pIp[1] >> 4);
+    fl = ((uint32_t)(pIp[1] & 0x0F) << 16) | ((uint16_t)pIp[2] << 8) | pIp[3];
+    if (fl == 0 && tc == 0) {
+        iphc0 |= 0x18;
+    } else if (fl == 0) {
+        iphc0 |= 0x10;
+        *p++ = (tc << 6) | (tc >> 2);
+    } else if ((tc >> 2) == 0) {
+        iphc0 |= 0x08;
+        *p++ = (tc << 6) | (uint8_t)(fl >> 16);
+        *p++ = (uint8_t)(fl >> 8);
+        *p++ = (uint8_t)fl;
+    } else {
+        *p++ = (tc << 6) | (tc >> 2);
+        *p++ = (uint8_t)(fl >> 16);
+        *p++ = (uint8_t)(fl >> 8);
+        *p++ = (uint8_t)fl;
+    }
+
+    // Next header: UDP is compressed if its length is the payload length
+    *pUsed = CC2520_LOWPAN_IPV6_HDR_LEN;
+    if (pIp[6] == CC2520_LOWPAN_PROTO_UDP && \
+        len >= CC2520_LOWPAN_IPV6_HDR_LEN + CC2520_LOWPAN_UDP_HDR_LEN && \
+        ((uint16_t)pUdp[4] << 8 | pUdp[5]) == len - CC2520_LOWPAN_IPV6_HDR_LEN) {
+        iphc0 |= CC2520_LOWPAN_IPHC_NH;
+        *pUsed += CC2520_LOWPAN_UDP_HDR_LEN;
+    } else {
+        *p++ = pIp[6];
+    }
+
+    // Hop limit
+    if (pIp[7] == 1)
+        iphc0 |= 0x01;
+    else if (pIp[7] == 64)
+        iphc0 |= 0x02;
+    else if (pIp[7] == 255)
+        iphc0 |= 0x03;
+    else
+        *p++ = pIp[7];
+
+    // Source address
+    if (cc2520ll_lowpanIsZero(pSrc, 16)) {
+        iphc1 |= CC2520_LOWPAN_IPHC_SAC;                // Unspecified
+    } else if (memcmp(pSrc, linkLocal, 8) == 0) {
+        iphc1 |= cc2520ll_lowpanIidCompress(&pSrc[8], pSrcIid, &p) << CC2520_LOWPAN_IPHC_SAM_BIT;
+    } else if (sci >= 0) {
+        iphc1 |= CC2520_LOWPAN_IPHC_SAC | \
+            (cc2520ll_lowpanIidCompress(&pSrc[8], pSrcIid, &p) << CC2520_LOWPAN_IPHC_SAM_BIT);
+    } else {
+        memcpy(p, pSrc, 16);
+        p += 16;
+    }
+
+    // Destination address
+    if (pDst[0] == 0xFF) {
+        iphc1 |= CC2520_LOWPAN_IPHC_M;
+        if (pDst[1] == 0x02 && cc2520ll_lowpanIsZero(&pDst[2], 13)) {
+            iphc1 |= 3;                                 // ff02::00XX
+            *p++ = pDst[15];
+        } else if (cc2520ll_lowpanIsZero(&pDst[2], 11)) {
+            iphc1 |= 2;                                 // ffXX::00XX:XXXX
+            *p++ = pDst[1];
+            memcpy(p, &pDst[13], 3);
+            p += 3;
+        } else if (cc2520ll_lowpanIsZero(&pDst[2], 9)) {
+            iphc1 |= 1;                                 // ffXX::00XX:XXXX:XXXX
+            *p++ = pDst[1];
+            memcpy(p, &pDst[11], 5);
+            p += 5;
+        } else {
+            memcpy(p, pDst, 16);
+            p += 16;
+        }
+    } else if (memcmp(pDst, linkLocal, 8) == 0) {
+        iphc1 |= cc2520ll_lowpanIidCompress(&pDst[8], pDstIid, &p) << CC2520_LOWPAN_IPHC_DAM_BIT;
+    } else if (dci >= 0) {
+        iphc1 |= CC2520_LOWPAN_IPHC_DAC | \
+            (cc2520ll_lowpanIidCompress(&pDst[8], pDstIid, &p) << CC2520_LOWPAN_IPHC_DAM_BIT);
+    } else {
+        memcpy(p, pDst, 16);
+        p += 16;
+    }
+
+    // UDP ports: 4 bits each in 0xF0B0-0xF0BF, 8 bits in 0xF000-0xF0FF.
+    // The checksum is always carried.
+    if (iphc0 & CC2520_LOWPAN_IPHC_NH) {
+        sport = (uint16_t)pUdp[0] << 8 | pUdp[1];
+        dport = (uint16_t)pUdp[2] << 8 | pUdp[3];
+        if ((sport & 0xFFF0) == 0xF0B0 && (dport & 0xFFF0) == 0xF0B0) {
+            *p++ = CC2520_LOWPAN_NHC_UDP | 0x03;
+            *p++ = (uint8_t)(sport << 4) | (dport & 0x0F);
+        } else if ((dport & 0xFF00) == 0xF000) {
+            *p++ = CC2520_LOWPAN_NHC_UDP | 0x01;
+            *p++ = pUdp[0];
+            *p++ = pUdp[1];
+            *p++ = pUdp[3];
+        } else if ((sport & 0xFF00) == 0xF000) {
+            *p++ = CC2520_LOWPAN_NHC_UDP | 0x02;
+            *p++ = pUdp[1];
+            *p++ = pUdp[2];
+            *p++ = pUdp[3];
+        } else {
+            *p++ = CC2520_LOWPAN_NHC_UDP;
+            memcpy(p, pUdp, 4);
+            p += 4;
+        }
+        *p++ = pUdp[6];
+        *p++ = pUdp[7];
+    }
+
+    pHc[0] = iphc0;
+    pHc[1] = iphc1;
+    return p - pHc;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanDecompress
+*
+* @brief   Rebuild the IPv6 header, and the UDP header if it was compressed,
+*          from IPHC and NHC. The payload length fields are left for the
+*          caller.
+*
+* @param   const uint8_t *pHc - dispatch byte on
+*          uint8_t n - bytes available
+*          const uint8_t *pSrcIid, *pDstIid - identifiers implied by the frame
+*          uint8_t *pIp - room for 48 bytes
+*          uint8_t *pHdrLen - header bytes rebuilt (40 or 48)
+*
+* @return  uint8_t - compressed bytes read, 0 if malformed or unsupported
+*/
+static uint8_t cc2520ll_lowpanDecompress(const uint8_t *pHc, uint8_t n, \
+    const uint8_t *pSrcIid, const uint8_t *pDstIid, uint8_t *pIp, uint8_t *pHdrLen)
+{
+    uint8_t hc[LOWPAN_HC_MAX];
+    const uint8_t *p = &hc[2], *pEnd;
+    uint8_t iphc0, iphc1, sci = 0, dci = 0, mode, nhc;
+    uint8_t *pSrc = &pIp[8], *pDst = &pIp[24], *pUdp = &pIp[40];
+
+    // Parse a zero-padded copy, so that a short frame cannot be overrun;
+    // its end is checked once the header is read
+    if (n < 2)
+        return 0;
+    if (n > sizeof(hc))
+        n = sizeof(hc);
+    memset(hc, 0, sizeof(hc));
+    memcpy(hc, pHc, n);
+    pEnd = hc + n;
+
+    iphc0 = hc[0];
+    iphc1 = hc[1];
+    if (iphc1 & CC2520_LOWPAN_IPHC_CID) {
+        sci = *p >> 4;
+        dci = *p++ & 0x0F;
+    }
+
+    // Traffic class and flow label
+    pIp[0] = 0x60;
+    pIp[1] = pIp[2] = pIp[3] = 0;
+    switch (iphc0 & CC2520_LOWPAN_IPHC_TF_BM) {
+    case 0x00:
+        pIp[0] |= (p[0] & 0x3F) >> 2;
+        pIp[1] = (uint8_t)((p[0] & 0x03) << 6 | (p[0] >> 6) << 4) | (p[1] & 0x0F);
+        pIp[2] = p[2];
+        pIp[3] = p[3];
+        p += 4;
+        break;
+    case 0x08:
+        pIp[1] = (uint8_t)((p[0] >> 6) << 4) | (p[0] & 0x0F);
+        pIp[2] = p[1];
+        pIp[3] = p[2];
+        p += 3;
+        break;
+    case 0x10:
+        pIp[0] |= (p[0] & 0x3F) >> 2;
+        pIp[1] = (uint8_t)((p[0] & 0x03) << 6 | (p[0] >> 6) << 4);
+        p++;
+        break;
+    default:
+        break;
+    }
+
+    // Next header and hop limit
+    pIp[6] = (iphc0 & CC2520_LOWPAN_IPHC_NH) ? CC2520_LOWPAN_PROTO_UDP : *p++;
+    switch (iphc0 & CC2520_LOWPAN_IPHC_HLIM_BM) {
+    case 1:  pIp[7] = 1; break;
+    case 2:  pIp[7] = 64; break;
+    case 3:  pIp[7] = 255; break;
+    default: pIp[7] = *p++; break;
+    }
+
+    // Source address
+    mode = (iphc1 >> CC2520_LOWPAN_IPHC_SAM_BIT) & 0x03;
+    if (iphc1 & CC2520_LOWPAN_IPHC_SAC) {
+        if (mode == 0) {
+            memset(pSrc, 0, 16);
+        } else {
+            if (sci >= CC2520_LOWPAN_CONTEXTS || !ctxValid[sci])
+                return 0;
+            memcpy(pSrc, ctxPrefix[sci], 8);
+            p = cc2520ll_lowpanIidDecompress(mode, p, pSrcIid, &pSrc[8]);
+        }
+    } else if (mode == 0) {
+        memcpy(pSrc, p, 16);
+        p += 16;
+    } else {
+        memcpy(pSrc, linkLocal, 8);
+        p = cc2520ll_lowpanIidDecompress(mode, p, pSrcIid, &pSrc[8]);
+    }
+
+    // Destination address
+    mode = (iphc1 >> CC2520_LOWPAN_IPHC_DAM_BIT) & 0x03;
+    if (iphc1 & CC2520_LOWPAN_IPHC_M) {
+        if (iphc1 & CC2520_LOWPAN_IPHC_DAC)
+            return 0;                                   // Unicast-prefix based: not supported
+        memset(pDst, 0, 16);
+        pDst[0] = 0xFF;
+        if (mode == 0) {
+            memcpy(pDst, p, 16);
+            p += 16;
+        } else if (mode == 1) {
+            pDst[1] = *p++;
+            memcpy(&pDst[11], p, 5);
+            p += 5;
+        } else if (mode == 2) {
+            pDst[1] = *p++;
+            memcpy(&pDst[13], p, 3);
+            p += 3;
+        } else {
+            pDst[1] = 0x02;
+            pDst[15] = *p++;
+        }
+    } else if (iphc1 & CC2520_LOWPAN_IPHC_DAC) {
+        if (mode == 0 || dci >= CC2520_LOWPAN_CONTEXTS || !ctxValid[dci])
+            return 0;
+        memcpy(pDst, ctxPrefix[dci], 8);
+        p = cc2520ll_lowpanIidDecompress(mode, p, pDstIid, &pDst[8]);
+    } else if (mode == 0) {
+        memcpy(pDst, p, 16);
+        p += 16;
+    } else {
+        memcpy(pDst, linkLocal, 8);
+        p = cc2520ll_lowpanIidDecompress(mode, p, pDstIid, &pDst[8]);
+    }
+
+    // UDP header
+    *pHdrLen = CC2520_LOWPAN_IPV6_HDR_LEN;
+    if (iphc0 & CC2520_LOWPAN_IPHC_NH) {
+        nhc = *p++;
+        if ((nhc & CC2520_LOWPAN_NHC_UDP_BM) != CC2520_LOWPAN_NHC_UDP || \
+            (nhc & CC2520_LOWPAN_NHC_UDP_C))
+            return 0;                                   // Elided checksum: not supported
+        switch (nhc & CC2520_LOWPAN_NHC_UDP_P_BM) {
+        case 0:
+            memcpy(pUdp, p, 4);
+            p += 4;
+            break;
+        case 1:
+            pUdp[0] = p[0];
+            pUdp[1] = p[1];
+            pUdp[2] = 0xF0;
+            pUdp[3] = p[2];
+            p += 3;
+            break;
+        case 2:
+            pUdp[0] = 0xF0;
+            pUdp[1] = p[0];
+            pUdp[2] = p[1];
+            pUdp[3] = p[2];
+            p += 3;
+            break;
+        default:
+            pUdp[0] = pUdp[2] = 0xF0;
+            pUdp[1] = 0xB0 | (p[0] >> 4);
+            pUdp[3] = 0xB0 | (p[0] & 0x0F);
+            p++;
+            break;
+        }
+        pUdp[6] = p[0];
+        pUdp[7] = p[1];
+        p += 2;
+        *pHdrLen += CC2520_LOWPAN_UDP_HDR_LEN;
+    }
+    if (p > pEnd)
+        return 0;
+    return p - hc;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanSetLengths
+*
+* @brief   Fill in the IPv6 payload length, and the UDP length if the UDP
+*          header was compressed
+*/
+static void cc2520ll_lowpanSetLengths(uint8_t *pIp, uint16_t len, uint8_t udp)
+{
+    len -= CC2520_LOWPAN_IPV6_HDR_LEN;
+    pIp[4] = HI_UINT16(len);
+    pIp[5] = LO_UINT16(len);
+    if (udp) {
+        pIp[44] = HI_UINT16(len);
+        pIp[45] = LO_UINT16(len);
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanSetContext
+*
+* @brief   Set the 64-bit prefix of a compression context. Every node of the
+*          network must use the same contexts.
+*
+* @param   uint8_t id - 0 to CC2520_LOWPAN_CONTEXTS - 1
+*          const uint8_t *pPrefix - 8 bytes
+*
+* @return  none
+*/
+void cc2520ll_lowpanSetContext(uint8_t id, const uint8_t *pPrefix)
+{
+    if (id >= CC2520_LOWPAN_CONTEXTS)
+        return;
+    memcpy(ctxPrefix[id], pPrefix, 8);
+    ctxValid[id] = TRUE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanClearContext
+*
+* @brief   Stop using a compression context
+*
+* @param   uint8_t id
+*
+* @return  none
+*/
+void cc2520ll_lowpanClearContext(uint8_t id)
+{
+    if (id < CC2520_LOWPAN_CONTEXTS)
+        ctxValid[id] = FALSE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanSend
+*
+* @brief   Send an IPv6 packet to a neighbor. The headers are compressed; if
+*          the packet still does not fit one frame it goes out as a FRAG1
+*          fragment, carrying the compressed headers, and FRAGN fragments,
+*          each sent with cc2520ll_packetSend(). Not for interrupt context.
+*
+* @param   const uint8_t *pIp - IPv6 packet, header included
+*          uint16_t len - up to CC2520_LOWPAN_MTU
+*          uint16_t dstAddr - short address of the next hop, 0xFFFF to broadcast
+*
+* @return  int - SUCCESS, or FAILED if the packet is malformed or a frame
+*          could not be sent
+*/
+int cc2520ll_lowpanSend(const uint8_t *pIp, uint16_t len, uint16_t dstAddr)
+{
+    uint8_t frame[LOWPAN_MHR_LEN + CC2520_MAX_PAYLOAD_SIZE];
+    uint8_t srcIid[8], dstIid[8];
+    uint8_t *p = &frame[LOWPAN_MHR_LEN];
+    uint16_t panId, shortAddr, offset, chunk;
+    uint8_t hcLen, used;
+
+    if (len < CC2520_LOWPAN_IPV6_HDR_LEN || len > CC2520_LOWPAN_MTU || (pIp[0] >> 4) != 6)
+        return FAILED;
+    panId = CC2520_MEMRD16(CC2520_RAM_PANID);
+    shortAddr = CC2520_MEMRD16(CC2520_RAM_SHORTADDR);
+
+    // Data frame, short addresses, PAN ID compression, ACK unless broadcast
+    frame[0] = dstAddr == 0xFFFF ? CC2520_FCF_NOACK_L : CC2520_FCF_ACK_L;
+    frame[1] = HI_UINT16(CC2520_FCF_NOACK);
+    frame[3] = LO_UINT16(panId);
+    frame[4] = HI_UINT16(panId);
+    frame[5] = LO_UINT16(dstAddr);
+    frame[6] = HI_UINT16(dstAddr);
+    frame[7] = LO_UINT16(shortAddr);
+    frame[8] = HI_UINT16(shortAddr);
+    cc2520ll_lowpanMacIid(&frame[7], CC2520_SRC_MODE_SHORT, srcIid);
+    cc2520ll_lowpanMacIid(&frame[5], CC2520_SRC_MODE_SHORT, dstIid);
+
+    hcLen = cc2520ll_lowpanCompress(pIp, len, srcIid, dstIid, &p[CC2520_LOWPAN_FRAG1_HDR_LEN], &used);
+    lowpanStats.hcSaved = (int16_t)used - hcLen;
+
+    if (hcLen + len - used <= CC2520_MAX_PAYLOAD_SIZE) {
+        // One frame
+        memmove(p, &p[CC2520_LOWPAN_FRAG1_HDR_LEN], hcLen);
+        memcpy(&p[hcLen], &pIp[used], len - used);
+        frame[2] = cc2520ll_nextSeq();
+        if (cc2520ll_packetSend(frame, LOWPAN_MHR_LEN + hcLen + len - used) == FAILED)
+            return FAILED;
+        lowpanStats.sent++;
+        return SUCCESS;
+    }
+
+    // FRAG1: the compressed headers and payload up to an 8-byte boundary of
+    // the uncompressed packet
+    lowpanTag++;
+    p[0] = CC2520_LOWPAN_DISPATCH_FRAG1 | (uint8_t)(len >> 8);
+    p[1] = (uint8_t)len;
+    p[2] = HI_UINT16(lowpanTag);
+    p[3] = LO_UINT16(lowpanTag);
+    offset = ((CC2520_MAX_PAYLOAD_SIZE - CC2520_LOWPAN_FRAG1_HDR_LEN - hcLen + used) & ~7);
+    chunk = offset - used;
+    memcpy(&p[CC2520_LOWPAN_FRAG1_HDR_LEN + hcLen], &pIp[used], chunk);
+    frame[2] = cc2520ll_nextSeq();
+    if (cc2520ll_packetSend(frame, LOWPAN_MHR_LEN + CC2520_LOWPAN_FRAG1_HDR_LEN + hcLen + chunk) == FAILED)
+        return FAILED;
+    lowpanStats.fragsSent++;
+
+    // FRAGN: the rest in multiples of 8 bytes
+    p[0] = CC2520_LOWPAN_DISPATCH_FRAGN | (uint8_t)(len >> 8);
+    while (offset < len) {
+        chunk = (CC2520_MAX_PAYLOAD_SIZE - CC2520_LOWPAN_FRAGN_HDR_LEN) & ~7;
+        if (chunk > len - offset)
+            chunk = len - offset;
+        p[4] = (uint8_t)(offset >> 3);
+        memcpy(&p[CC2520_LOWPAN_FRAGN_HDR_LEN], &pIp[offset], chunk);
+        frame[2] = cc2520ll_nextSeq();
+        if (cc2520ll_packetSend(frame, LOWPAN_MHR_LEN + CC2520_LOWPAN_FRAGN_HDR_LEN + chunk) == FAILED)
+            return FAILED;
+        lowpanStats.fragsSent++;
+        offset += chunk;
+    }
+    lowpanStats.sent++;
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanReassExpire
+*
+* @brief   Give up a packet whose fragments did not all arrive within
+*          CC2520_LOWPAN_REASS_TIMEOUT seconds, freeing the buffer
+*/
+static void cc2520ll_lowpanReassExpire(void)
+{
+    if (reassOn && (uint32_t)(rtimer_now32() - reassStart) > \
+        (uint32_t)CC2520_LOWPAN_REASS_TIMEOUT * RTIMER_SECOND) {
+        reassOn = FALSE;
+        lowpanStats.dropped++;
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanUnitsFree
+*
+* @brief   Is none of the 8-byte units of n bytes from offset received yet?
+*/
+static uint8_t cc2520ll_lowpanUnitsFree(uint16_t offset, uint16_t n)
+{
+    uint16_t unit;
+
+    for (unit = offset >> 3; unit < (offset + n + 7) >> 3; unit++) {
+        if (reassUnits[unit >> 3] & (1 << (unit & 0x07)))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanReassemble
+*
+* @brief   Store a fragment. A fragment of another packet than the one being
+*          reassembled starts over with that packet, if it is a FRAG1. A
+*          fragment overlapping units already received is dropped as a
+*          repeat.
+*
+* @return  uint16_t - packet length once every fragment is in, else 0
+*/
+static uint16_t cc2520ll_lowpanReassemble(const uint8_t *pFrag, uint8_t n, \
+    const uint8_t *pSrcIid, const uint8_t *pDstIid)
+{
+    uint8_t hdr[CC2520_LOWPAN_IPV6_HDR_LEN + CC2520_LOWPAN_UDP_HDR_LEN];
+    uint16_t size, tag, offset, unit;
+    uint8_t hdrLen, used;
+
+    size = (uint16_t)(pFrag[0] & 0x07) << 8 | pFrag[1];
+    tag = (uint16_t)pFrag[2] << 8 | pFrag[3];
+    if (size < CC2520_LOWPAN_IPV6_HDR_LEN || size > CC2520_LOWPAN_MTU)
+        return 0;
+
+    if ((pFrag[0] & CC2520_LOWPAN_FRAG_BM) == CC2520_LOWPAN_DISPATCH_FRAG1) {
+        if (!reassOn || tag != reassTag || size != reassSize || memcmp(reassSrc, pSrcIid, 8)) {
+            // A packet left incomplete is given up
+            if (reassOn)
+                lowpanStats.dropped++;
+            reassOn = TRUE;
+            reassTag = tag;
+            reassSize = size;
+            reassRecv = 0;
+            reassStart = rtimer_now32();
+            memcpy(reassSrc, pSrcIid, 8);
+            memset(reassUnits, 0, sizeof(reassUnits));
+        }
+        pFrag += CC2520_LOWPAN_FRAG1_HDR_LEN;
+        n -= CC2520_LOWPAN_FRAG1_HDR_LEN;
+        // Rebuilt aside: the buffer is only written once the units are free
+        used = cc2520ll_lowpanDecompress(pFrag, n, pSrcIid, pDstIid, hdr, &hdrLen);
+        if (used == 0 || hdrLen + n - used > size) {
+            reassOn = FALSE;
+            return 0;
+        }
+        offset = 0;
+        if (!cc2520ll_lowpanUnitsFree(offset, hdrLen + n - used))
+            return 0;                                   // Repeated
+        reassUdp = hdrLen > CC2520_LOWPAN_IPV6_HDR_LEN;
+        memcpy(reassBuf, hdr, hdrLen);
+        memcpy(&reassBuf[hdrLen], &pFrag[used], n - used);
+        n = hdrLen + n - used;
+    } else {
+        if (n < CC2520_LOWPAN_FRAGN_HDR_LEN || !reassOn || tag != reassTag || \
+            size != reassSize || memcmp(reassSrc, pSrcIid, 8))
+            return 0;
+        offset = (uint16_t)pFrag[4] << 3;
+        n -= CC2520_LOWPAN_FRAGN_HDR_LEN;
+        if (offset == 0 || offset + n > size)
+            return 0;
+        if (!cc2520ll_lowpanUnitsFree(offset, n))
+            return 0;                                   // Repeated or overlapping
+        memcpy(&reassBuf[offset], &pFrag[CC2520_LOWPAN_FRAGN_HDR_LEN], n);
+    }
+
+    // Mark the 8-byte units the fragment covers
+    for (unit = offset >> 3; unit < (offset + n + 7) >> 3; unit++) {
+        reassUnits[unit >> 3] |= 1 << (unit & 0x07);
+    }
+    reassRecv += n;
+    if (reassRecv < size)
+        return 0;
+    reassOn = FALSE;
+    cc2520ll_lowpanSetLengths(reassBuf, size, reassUdp);
+    return size;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanInput
+*
+* @brief   Take the IPv6 packet out of a received frame, as returned by
+*          cc2520ll_packetReceive(): decompress it, or store a fragment and
+*          return the whole packet with its last fragment. Frames in the
+*          NALP range (time sync records, TSCH beacons) are not LoWPAN frames
+*          and are ignored without counting them as dropped.
+*
+* @param   const uint8_t *pFrame - frame from the frame control field
+*          uint8_t len - bytes in pFrame, status bytes included
+*          uint8_t *pIp - IPv6 packet
+*          uint16_t maxlen - room in pIp
+*
+* @return  uint16_t - IPv6 packet length, 0 if the frame held none, only a
+*          fragment, or a packet longer than maxlen
+*/
+uint16_t cc2520ll_lowpanInput(const uint8_t *pFrame, uint8_t len, uint8_t *pIp, uint16_t maxlen)
+{
+    uint8_t srcIid[8], dstIid[8];
+    uint8_t pos = 3, dstMode, srcMode, dstPos, srcPos, hdrLen, used, n;
+    const uint8_t *p;
+    uint16_t size;
+
+    cc2520ll_lowpanReassExpire();
+    if (len < 3 + CC2520_FOOTER_SIZE || (pFrame[0] & CC2520_FCF_TYPE_BM_L) != 0x01)
+        return 0;
+    len -= CC2520_FOOTER_SIZE;                          // RSSI and CRC/correlation
+
+    // Addresses, to rebuild interface identifiers from
+    dstMode = (pFrame[1] >> 2) & 0x03;
+    srcMode = (pFrame[1] >> 6) & 0x03;
+    dstPos = pos + 2;
+    if (dstMode)
+        pos = dstPos + (dstMode == CC2520_SRC_MODE_EXT ? 8 : 2);
+    if (srcMode && !(pFrame[0] & CC2520_FCF_PANID_COMP_BM_L))
+        pos += 2;
+    srcPos = pos;
+    if (srcMode)
+        pos += srcMode == CC2520_SRC_MODE_EXT ? 8 : 2;
+    if (pFrame[0] & CC2520_SEC_ENABLED_FCF_BM_L)
+        pos += CC2520_AUX_HDR_LENGTH;
+    if (pos >= len)
+        return 0;
+    cc2520ll_lowpanMacIid(&pFrame[srcPos], srcMode, srcIid);
+    cc2520ll_lowpanMacIid(&pFrame[dstPos], dstMode, dstIid);
+    p = &pFrame[pos];
+    n = len - pos;
+
+    if ((p[0] & 0xE0) == CC2520_LOWPAN_DISPATCH_IPHC) {
+        if (maxlen < 48)
+            return 0;
+        used = cc2520ll_lowpanDecompress(p, n, srcIid, dstIid, pIp, &hdrLen);
+        if (used == 0 || hdrLen + n - used > maxlen) {
+            lowpanStats.dropped++;
+            return 0;
+        }
+        memcpy(&pIp[hdrLen], &p[used], n - used);
+        size = hdrLen + n - used;
+        cc2520ll_lowpanSetLengths(pIp, size, hdrLen > CC2520_LOWPAN_IPV6_HDR_LEN);
+    } else if (p[0] == CC2520_LOWPAN_DISPATCH_IPV6) {
+        size = n - 1;
+        if (size < CC2520_LOWPAN_IPV6_HDR_LEN || size > maxlen) {
+            lowpanStats.dropped++;
+            return 0;
+        }
+        memcpy(pIp, &p[1], size);
+    } else if ((p[0] & CC2520_LOWPAN_FRAG_BM) == CC2520_LOWPAN_DISPATCH_FRAG1 || \
+        (p[0] & CC2520_LOWPAN_FRAG_BM) == CC2520_LOWPAN_DISPATCH_FRAGN) {
+        lowpanStats.fragsReceived++;
+        if (n < CC2520_LOWPAN_FRAG1_HDR_LEN + 2)
+            return 0;
+        size = cc2520ll_lowpanReassemble(p, n, srcIid, dstIid);
+        if (size == 0)
+            return 0;
+        if (size > maxlen) {
+            lowpanStats.dropped++;
+            return 0;
+        }
+        memcpy(pIp, reassBuf, size);
+    } else {
+        if ((p[0] & CC2520_LOWPAN_NALP_BM) != CC2520_LOWPAN_DISPATCH_NALP)
+            lowpanStats.dropped++;
+        return 0;
+    }
+    lowpanStats.received++;
+    return size;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanReceive
+*
+* @brief   Read received frames with cc2520ll_packetReceive() until one
+*          completes an IPv6 packet. Frames that carry no IPv6 are dropped,
+*          so this is for nodes that only speak IPv6.
+*
+* @param   uint8_t *pIp - IPv6 packet
+*          uint16_t maxlen - room in pIp
+*
+* @return  uint16_t - IPv6 packet length, 0 if none is complete yet
+*/
+uint16_t cc2520ll_lowpanReceive(uint8_t *pIp, uint16_t maxlen)
+{
+    uint8_t frame[MAX_802154_PACKET_SIZE];
+    uint16_t size;
+    int len;
+
+    while ((len = cc2520ll_packetReceive(frame, sizeof(frame))) > 0) {
+        size = cc2520ll_lowpanInput(frame, len, pIp, maxlen);
+        if (size)
+            return size;
+    }
+    return 0;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lowpanGetStats
+*
+* @brief   Copy the adaptation layer counters
+*
+* @param   cc2520ll_lowpanStats_t *pStats
+*
+* @return  none
+*/
+void cc2520ll_lowpanGetStats(cc2520ll_lowpanStats_t *pStats)
+{
+    *pStats = lowpanStats;
+}
@@ -0,0 +1,77 @@
+#ifndef CC2520LL_LOWPAN_H_
+#define CC2520LL_LOWPAN_H_
+
+#include <inttypes.h>
+#include "cc2520ll.h"
+#include "rtimer.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// IPv6 over IEEE 802.15.4 (RFC 4944, RFC 6282). IPv6 packets are carried in
+// data frames with the driver's header (PAN ID compression, short
+// addresses). The IPv6 header is compressed with IPHC and a UDP header with
+// NHC. A packet whose compressed form does not fit one frame is sent as
+// FRAG1/FRAGN fragments and reassembled at the receiver.
+
+#define CC2520_LOWPAN_MTU                 1280  // IPv6 minimum MTU, reassembly buffer size
+#define CC2520_LOWPAN_CONTEXTS            4     // Context IDs 0-3 (RFC 6282 allows 16)
+#define CC2520_LOWPAN_IPV6_HDR_LEN        40
+#define CC2520_LOWPAN_UDP_HDR_LEN         8
+// A packet whose fragments are not all in by then is given up (RFC 4944)
+#define CC2520_LOWPAN_REASS_TIMEOUT       60    // s
+
+// Dispatch values
+#define CC2520_LOWPAN_DISPATCH_NALP       0x00  // 00xxxxxx: not a LoWPAN frame
+#define CC2520_LOWPAN_NALP_BM             0xC0
+#define CC2520_LOWPAN_DISPATCH_IPV6       0x41  // Uncompressed IPv6
+#define CC2520_LOWPAN_DISPATCH_IPHC       0x60  // 011xxxxx
+#define CC2520_LOWPAN_DISPATCH_FRAG1      0xC0  // 11000xxx
+#define CC2520_LOWPAN_DISPATCH_FRAGN      0xE0  // 11100xxx
+#define CC2520_LOWPAN_FRAG_BM             0xF8
+#define CC2520_LOWPAN_FRAG1_HDR_LEN       4
+#define CC2520_LOWPAN_FRAGN_HDR_LEN       5
+
+// IPHC, first byte: 011 TF NH HLIM
+#define CC2520_LOWPAN_IPHC_TF_BM          0x18
+#define CC2520_LOWPAN_IPHC_NH             0x04
+#define CC2520_LOWPAN_IPHC_HLIM_BM        0x03
+// IPHC, second byte: CID SAC SAM M DAC DAM
+#define CC2520_LOWPAN_IPHC_CID            0x80
+#define CC2520_LOWPAN_IPHC_SAC            0x40
+#define CC2520_LOWPAN_IPHC_SAM_BIT        4
+#define CC2520_LOWPAN_IPHC_M              0x08
+#define CC2520_LOWPAN_IPHC_DAC            0x04
+#define CC2520_LOWPAN_IPHC_DAM_BIT        0
+
+// UDP next header compression: 11110 C PP
+#define CC2520_LOWPAN_NHC_UDP             0xF0
+#define CC2520_LOWPAN_NHC_UDP_BM          0xF8
+#define CC2520_LOWPAN_NHC_UDP_C           0x04
+#define CC2520_LOWPAN_NHC_UDP_P_BM        0x03
+
+#define CC2520_LOWPAN_PROTO_UDP           17
+
+/***********************************************************************************
+* TYPEDEFS
+*/
+typedef struct {
+    uint16_t sent;              // IPv6 packets sent
+    uint16_t fragsSent;         // Of the frames carrying them, fragments
+    uint16_t received;          // IPv6 packets delivered
+    uint16_t fragsReceived;
+    uint16_t dropped;           // Frames not understood, or fragments of a lost or timed out packet
+    int16_t hcSaved;            // Header bytes saved by compression, last packet sent
+} cc2520ll_lowpanStats_t;
+
+/* External functions */
+
+void cc2520ll_lowpanSetContext(uint8_t id, const uint8_t *pPrefix);
+void cc2520ll_lowpanClearContext(uint8_t id);
+int cc2520ll_lowpanSend(const uint8_t *pIp, uint16_t len, uint16_t dstAddr);
+uint16_t cc2520ll_lowpanInput(const uint8_t *pFrame, uint8_t len, uint8_t *pIp, uint16_t maxlen);
+uint16_t cc2520ll_lowpanReceive(uint8_t *pIp, uint16_t maxlen);
+void cc2520ll_lowpanGetStats(cc2520ll_lowpanStats_t *pStats);
+
+#endif /*CC2520LL_LOWPAN_H_*/
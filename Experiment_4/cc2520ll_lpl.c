@@ -0,0 +1,670 @@
+#include "cc2520ll_lpl.h"
+#include "cc2520ll_src.h"
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static cc2520ll_lplCfg_t lplCfg = {
+    CC2520_LPL_WAKE_INTERVAL, CC2520_LPL_CCA_CHECKS, CC2520_LPL_AWAKE_TIME, TRUE
+};
+static cc2520ll_lplPhase_t lplPhase[CC2520_LPL_PHASE_ENTRIES];
+static cc2520ll_lplStats_t lplStats;
+static uint8_t lplOn, lplRadioOn;
+static rtimer_clock_t lplInterval;      // Wake interval in ticks
+static rtimer_clock_t lplWake;          // Next local wake-up
+static uint32_t lplRadioAt;            // Last radio on/off switch, rtimer_now32()
+static uint8_t lplChecks;
+static uint16_t lplRxFrames;            // Received frames seen so far
+static void (*lplUpNext)(void);         // Runs once the crystal is up, or not
+
+// Send in progress
+static volatile uint8_t lplTxBusy;
+static uint8_t lplTxAck, lplLocked;
+static uint16_t lplTxDst;
+static rtimer_clock_t lplTxEnd;
+static cc2520ll_txCallback_t lplCallback;
+
+/***********************************************************************************
+* @fn      cc2520ll_lplListenUs
+*
+* @brief   Radio on time of a quiet wake-up: crystal startup, RSSI settling
+*          and the channel samples
+*/
+static uint16_t cc2520ll_lplListenUs(void)
+{
+    return CC2520_XOSC_MAX_STARTUP_TIME + CC2520_LPL_RSSI_VALID_US + \
+        (lplCfg.ccaChecks - 1) * CC2520_UNIT_BACKOFF_US;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplRxFrames
+*
+* @brief   Frames taken from the RX FIFO since cc2520ll_init(), ACKs included
+*/
+static uint16_t cc2520ll_lplRxFrames(void)
+{
+    cc2520ll_rxStats_t rxStats;
+
+    cc2520ll_getRxStats(&rxStats);
+    return rxStats.frames;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplAccount
+*
+* @brief   Add the time since the last switch to the on or off counter
+*/
+static void cc2520ll_lplAccount(void)
+{
+    uint32_t now = rtimer_now32();
+
+    if (lplRadioOn)
+        lplStats.onTicks += now - lplRadioAt;
+    else
+        lplStats.offTicks += now - lplRadioAt;
+    lplRadioAt = now;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplRadioUp
+*
+* @brief   Leave LPM1 with the receiver on, unless already there. Waits for
+*          the crystal: main context only, with interrupts enabled.
+*
+* @return  uint8_t - SUCCESS, or FAILED if the crystal did not start
+*/
+static uint8_t cc2520ll_lplRadioUp(void)
+{
+    if (lplRadioOn)
+        return SUCCESS;
+    if (cc2520ll_exit_lpm1() == FAILED) {
+        lplStats.xoscFail++;
+        return FAILED;
+    }
+    cc2520ll_lplAccount();
+    lplRadioOn = TRUE;
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplXoscDone
+*
+* @brief   Timer callback once the crystal had its startup time: receiver on
+*          if it is stable, then go on with lplRadioOn telling the outcome
+*/
+static void cc2520ll_lplXoscDone(void)
+{
+    if (cc2520ll_exit_lpm1_finish() == FAILED) {
+        lplStats.xoscFail++;
+    } else {
+        cc2520ll_lplAccount();
+        lplRadioOn = TRUE;
+    }
+    lplUpNext();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplRadioUpLater
+*
+* @brief   Leave LPM1 without waiting, for the timer handlers: start the
+*          crystal and run next from a second timer event after its startup
+*          time, or at once if the radio is on. next finds lplRadioOn FALSE
+*          if the crystal did not start.
+*/
+static void cc2520ll_lplRadioUpLater(void (*next)(void))
+{
+    if (lplRadioOn) {
+        next();
+        return;
+    }
+    lplUpNext = next;
+    cc2520ll_exit_lpm1_start();
+    // One tick more: the current tick is partly gone
+    rtimer_set(RTIMER_LPL, rtimer_now() + RTIMER_US_TO_TICKS(CC2520_XOSC_MAX_STARTUP_TIME) + 1, \
+        cc2520ll_lplXoscDone);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplRadioDown
+*
+* @brief   Enter LPM1. The TX FIFO is kept. A radio still busy after
+*          CC2520_LPM1_IDLE_MAX_US stays on until the next try.
+*/
+static void cc2520ll_lplRadioDown(void)
+{
+    if (!lplRadioOn)
+        return;
+    if (cc2520ll_enter_lpm1() == FAILED)
+        return;
+    cc2520ll_lplAccount();
+    lplRadioOn = FALSE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplAdvance
+*
+* @brief   Move the next local wake-up past the current time. Called at least
+*          once per interval, so the times compared stay less than 1 s apart.
+*/
+static void cc2520ll_lplAdvance(void)
+{
+    rtimer_clock_t now = rtimer_now();
+
+    while (!RTIMER_CLOCK_LT(now, lplWake)) {
+        lplWake += lplInterval;
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplWakeup
+*
+* @brief   Timer callback at the local wake-up: start the crystal, the
+*          receiver follows
+*/
+static void cc2520ll_lplCheck(void);
+static void cc2520ll_lplListen(void);
+static void cc2520ll_lplSchedule(void);
+static void cc2520ll_lplWakeup(void)
+{
+    lplStats.wakeups++;
+    cc2520ll_lplRadioUpLater(cc2520ll_lplListen);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplListen
+*
+* @brief   Receiver on: sample the channel once RSSI is valid
+*/
+static void cc2520ll_lplListen(void)
+{
+    if (!lplRadioOn) {
+        cc2520ll_lplSchedule();
+        return;
+    }
+    lplChecks = 0;
+    lplRxFrames = cc2520ll_lplRxFrames();
+    rtimer_set(RTIMER_LPL, rtimer_now() + RTIMER_US_TO_TICKS(CC2520_LPL_RSSI_VALID_US), \
+        cc2520ll_lplCheck);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplSchedule
+*
+* @brief   Back to LPM1 until the next local wake-up
+*/
+static void cc2520ll_lplSchedule(void)
+{
+    cc2520ll_lplRadioDown();
+    cc2520ll_lplAdvance();
+    rtimer_set(RTIMER_LPL, lplWake, cc2520ll_lplWakeup);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplActive
+*
+* @brief   Is a frame on air, just received, or being sent?
+*/
+static uint8_t cc2520ll_lplActive(void)
+{
+    uint16_t frames = cc2520ll_lplRxFrames();
+    uint8_t active;
+
+    active = frames != lplRxFrames || !cc2520ll_idle() || cc2520ll_txBusy();
+    lplRxFrames = frames;
+    return active;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplAwakeEnd
+*
+* @brief   Timer callback at the end of the awake time: stay in RX while the
+*          traffic goes on, else sleep
+*/
+static void cc2520ll_lplAwakeEnd(void)
+{
+    cc2520ll_lplAdvance();
+    cc2520ll_lplAccount();
+    if (cc2520ll_lplActive()) {
+        rtimer_set(RTIMER_LPL, rtimer_now() + RTIMER_MS_TO_TICKS(lplCfg.awakeTime), \
+            cc2520ll_lplAwakeEnd);
+    } else {
+        cc2520ll_lplSchedule();
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplCheck
+*
+* @brief   Timer callback for one channel sample. Energy on the channel (or a
+*          frame already received) keeps the receiver on for the awake time;
+*          a quiet channel on every sample puts the radio back to sleep.
+*/
+static void cc2520ll_lplCheck(void)
+{
+    if (!cc2520ll_channel_clear() || cc2520ll_lplActive()) {
+        lplStats.wakeBusy++;
+        rtimer_set(RTIMER_LPL, rtimer_now() + RTIMER_MS_TO_TICKS(lplCfg.awakeTime), \
+            cc2520ll_lplAwakeEnd);
+    } else if (++lplChecks < lplCfg.ccaChecks) {
+        rtimer_set(RTIMER_LPL, rtimer_now() + RTIMER_US_TO_TICKS(CC2520_UNIT_BACKOFF_US), \
+            cc2520ll_lplCheck);
+    } else {
+        cc2520ll_lplSchedule();
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplPhaseFind
+*
+* @brief   Phase table entry of a short address
+*
+* @return  uint8_t - index, CC2520_LPL_NONE if not known
+*/
+static uint8_t cc2520ll_lplPhaseFind(uint16_t addr)
+{
+    uint8_t i;
+
+    for (i = 0; i < CC2520_LPL_PHASE_ENTRIES; i++) {
+        if (lplPhase[i].addr == addr && addr != 0xFFFF)
+            return i;
+    }
+    return CC2520_LPL_NONE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplPhaseStore
+*
+* @brief   Record the phase of a neighbor, taking over the least recently
+*          used entry for a new one
+*/
+static void cc2520ll_lplPhaseStore(uint16_t addr, rtimer_clock_t offset)
+{
+    cc2520ll_lplPhase_t *pEntry;
+    uint8_t i, oldAge;
+
+    i = cc2520ll_lplPhaseFind(addr);
+    if (i != CC2520_LPL_NONE) {
+        pEntry = &lplPhase[i];
+        oldAge = pEntry->age;
+    } else {
+        // A free entry, else the oldest one
+        pEntry = &lplPhase[0];
+        for (i = 0; i < CC2520_LPL_PHASE_ENTRIES && pEntry->addr != 0xFFFF; i++) {
+            if (lplPhase[i].addr == 0xFFFF || lplPhase[i].age > pEntry->age)
+                pEntry = &lplPhase[i];
+        }
+        oldAge = 0xFF;
+    }
+    for (i = 0; i < CC2520_LPL_PHASE_ENTRIES; i++) {
+        if (&lplPhase[i] != pEntry && lplPhase[i].addr != 0xFFFF && lplPhase[i].age < oldAge)
+            lplPhase[i].age++;
+    }
+    pEntry->addr = addr;
+    pEntry->offset = offset % lplInterval;
+    pEntry->age = 0;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplSent
+*
+* @brief   Strobe done. An ACK tells when the receiver was awake: the frame it
+*          answered started then, relative to the local wake-ups. A strobe
+*          aimed at a learned phase that went unanswered forgets the phase,
+*          so the next send covers a whole interval again.
+*
+* @param   uint8_t status - CC2520_TX_xxx
+*
+* @return  none
+*/
+static void cc2520ll_lplSent(uint8_t status)
+{
+    cc2520ll_txCallback_t callback = lplCallback;
+    int32_t offset;
+    uint8_t i;
+
+    cc2520ll_lplAdvance();
+    if (status == CC2520_TX_OK && lplTxAck && lplTxDst != 0xFFFE) {
+        offset = (int16_t)(cc2520ll_txTime() - (rtimer_clock_t)(lplWake - lplInterval));
+        while (offset < 0)
+            offset += lplInterval;
+        cc2520ll_lplPhaseStore(lplTxDst, (rtimer_clock_t)offset);
+    } else if (status == CC2520_TX_NOACK && lplLocked) {
+        lplStats.phaseMiss++;
+        i = cc2520ll_lplPhaseFind(lplTxDst);
+        if (i != CC2520_LPL_NONE)
+            lplPhase[i].addr = 0xFFFF;
+    }
+    lplCallback = NULL;
+    lplTxBusy = FALSE;
+    if (lplOn)
+        cc2520ll_lplSchedule();
+    if (callback)
+        callback(status);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplStrobe
+*
+* @brief   Start the strobe of the frame in the TX FIFO, if the radio is up
+*/
+static void cc2520ll_lplStrobe(void)
+{
+    if (!lplRadioOn) {
+        cc2520ll_lplSent(CC2520_TX_RADIO_OFF);
+    } else if (cc2520ll_transmitStrobe(cc2520ll_lplSent, lplTxEnd) == FAILED) {
+        cc2520ll_lplSent(cc2520ll_txBusy() ? CC2520_TX_CHANNEL_BUSY : CC2520_TX_RADIO_OFF);
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplStrobeStart
+*
+* @brief   Wake the radio and start the strobe. Runs from the timer or with
+*          interrupts disabled; the crystal startup time, if the radio
+*          sleeps, is within the guard before the neighbor's wake-up.
+*/
+static void cc2520ll_lplStrobeStart(void)
+{
+    cc2520ll_lplRadioUpLater(cc2520ll_lplStrobe);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplStart
+*
+* @brief   Start duty cycling the radio, after cc2520ll_init(). Received
+*          frames are acknowledged by the radio (AUTOACK), which lets senders
+*          end their strobes. The radio must not be used directly, other than
+*          through cc2520ll_lplSend(), while low-power listening runs.
+*
+* @param   none
+*
+* @return  int - SUCCESS, or FAILED if already running
+*/
+int cc2520ll_lplStart(void)
+{
+    uint8_t i;
+
+    if (lplOn)
+        return FAILED;
+    for (i = 0; i < CC2520_LPL_PHASE_ENTRIES; i++) {
+        lplPhase[i].addr = 0xFFFF;
+    }
+    cc2520ll_setAutoAck(TRUE);
+    _disable_interrupts();
+    lplInterval = RTIMER_MS_TO_TICKS(lplCfg.wakeInterval);
+    lplOn = lplRadioOn = TRUE;
+    lplTxBusy = FALSE;
+    lplRadioAt = rtimer_now32();
+    lplWake = rtimer_now();
+    cc2520ll_lplSchedule();
+    _enable_interrupts();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplStop
+*
+* @brief   Stop duty cycling and leave the receiver on. A send in progress
+*          completes.
+*
+* @param   none
+*
+* @return  none
+*/
+void cc2520ll_lplStop(void)
+{
+    uint8_t idle;
+
+    _disable_interrupts();
+    lplOn = FALSE;
+    idle = !lplTxBusy;
+    if (idle)
+        rtimer_cancel(RTIMER_LPL);
+    _enable_interrupts();
+    // No timer event is left to switch the radio: wait for the crystal with
+    // interrupts enabled
+    if (idle)
+        cc2520ll_lplRadioUp();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplSetConfig
+*
+* @brief   Set the wake interval (clamped to CC2520_LPL_MIN_INTERVAL -
+*          CC2520_LPL_MAX_INTERVAL), channel samples and awake time. A new
+*          interval takes effect from the next wake-up and forgets the
+*          learned phases.
+*
+* @param   const cc2520ll_lplCfg_t *pCfg
+*
+* @return  none
+*/
+void cc2520ll_lplSetConfig(const cc2520ll_lplCfg_t *pCfg)
+{
+    uint16_t interval = pCfg->wakeInterval;
+    uint8_t i;
+
+    if (interval < CC2520_LPL_MIN_INTERVAL)
+        interval = CC2520_LPL_MIN_INTERVAL;
+    if (interval > CC2520_LPL_MAX_INTERVAL)
+        interval = CC2520_LPL_MAX_INTERVAL;
+    _disable_interrupts();
+    if (interval != lplCfg.wakeInterval) {
+        for (i = 0; i < CC2520_LPL_PHASE_ENTRIES; i++) {
+            lplPhase[i].addr = 0xFFFF;
+        }
+    }
+    lplCfg = *pCfg;
+    lplCfg.wakeInterval = interval;
+    if (lplCfg.ccaChecks == 0)
+        lplCfg.ccaChecks = 1;
+    lplInterval = RTIMER_MS_TO_TICKS(interval);
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplGetConfig
+*
+* @brief   Copy the low-power listening settings
+*
+* @param   cc2520ll_lplCfg_t *pCfg
+*
+* @return  none
+*/
+void cc2520ll_lplGetConfig(cc2520ll_lplCfg_t *pCfg)
+{
+    *pCfg = lplCfg;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplSetDutyCycle
+*
+* @brief   Pick the wake interval that gives an idle receiver this radio duty
+*          cycle with the current number of channel samples
+*
+* @param   uint16_t permille - radio on time per 1000
+*
+* @return  none
+*/
+void cc2520ll_lplSetDutyCycle(uint16_t permille)
+{
+    cc2520ll_lplCfg_t cfg = lplCfg;
+
+    if (permille == 0)
+        permille = 1;
+    cfg.wakeInterval = (uint16_t)(((uint32_t)cc2520ll_lplListenUs() + permille / 2) / permille);
+    cc2520ll_lplSetConfig(&cfg);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplSend
+*
+* @brief   Send a frame to a duty-cycled receiver. The frame is repeated until
+*          it is acknowledged; a frame without ACK request (broadcast) is
+*          repeated for a whole wake interval. For a neighbor whose phase is
+*          known the radio sleeps until just before its wake-up and the
+*          strobe only covers the listening time, one frame and a drift
+*          margin on either side. Not for interrupt context.
+*
+* @param   const void *packet - MPDU without FCS
+*          uint8_t len - number of bytes
+*          cc2520ll_txCallback_t callback - outcome, CC2520_TX_xxx, from
+*          interrupt context; NULL if not needed
+*
+* @return  int - SUCCESS if the send started, FAILED if not running, busy, the
+*          frame did not fit or the crystal did not start
+*/
+int cc2520ll_lplSend(const void *packet, uint8_t len, cc2520ll_txCallback_t callback)
+{
+    const uint8_t *pHdr = (const uint8_t*)packet;
+    rtimer_clock_t guard, start;
+    uint8_t i;
+
+    _disable_interrupts();
+    if (!lplOn || lplTxBusy) {
+        _enable_interrupts();
+        return FAILED;
+    }
+    lplTxBusy = TRUE;
+    rtimer_cancel(RTIMER_LPL);
+    _enable_interrupts();
+
+    // No timer event is left to switch the radio: wait for the crystal with
+    // interrupts enabled
+    if (cc2520ll_lplRadioUp() == FAILED) {
+        _disable_interrupts();
+        lplTxBusy = FALSE;
+        cc2520ll_lplSchedule();
+        _enable_interrupts();
+        return FAILED;
+    }
+
+    if (cc2520ll_prepare(packet, len) == FAILED) {
+        _disable_interrupts();
+        lplTxBusy = FALSE;
+        cc2520ll_lplSchedule();
+        _enable_interrupts();
+        return FAILED;
+    }
+    lplTxAck = len >= 3 && (pHdr[0] & CC2520_FCF_ACK_BM_L);
+    if (((pHdr[1] >> 2) & 0x03) == CC2520_SRC_MODE_SHORT && len >= 7) {
+        lplTxDst = pHdr[5] | ((uint16_t)pHdr[6] << 8);
+        if (lplTxDst == 0xFFFF)
+            lplTxAck = FALSE;
+    } else {
+        lplTxDst = 0xFFFE;
+    }
+
+    _disable_interrupts();
+    lplCallback = callback;
+    lplStats.sends++;
+    cc2520ll_lplAdvance();
+    i = lplTxAck && lplCfg.phaseLock ? cc2520ll_lplPhaseFind(lplTxDst) : CC2520_LPL_NONE;
+    if (i != CC2520_LPL_NONE) {
+        guard = RTIMER_US_TO_TICKS(cc2520ll_lplListenUs() + CC2520_TX_TURNAROUND_US + \
+            CC2520_TX_TIME_US(len + CC2520_FOOTER_SIZE) + CC2520_ACK_WAIT_US + CC2520_LPL_DRIFT_US);
+        start = lplWake - lplInterval + lplPhase[i].offset - guard;
+        while (RTIMER_CLOCK_LT(start, rtimer_now())) {
+            start += lplInterval;
+        }
+        lplTxEnd = start + 2 * guard;
+        lplLocked = TRUE;
+        lplStats.phaseSends++;
+        cc2520ll_lplRadioDown();
+        rtimer_set(RTIMER_LPL, start, cc2520ll_lplStrobeStart);
+    } else {
+        lplTxEnd = rtimer_now() + lplInterval + RTIMER_US_TO_TICKS(cc2520ll_lplListenUs());
+        lplLocked = FALSE;
+        cc2520ll_lplStrobeStart();
+    }
+    _enable_interrupts();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplBusy
+*
+* @brief   Is a cc2520ll_lplSend() waiting or strobing?
+*
+* @return  uint8_t - TRUE until its callback has run
+*/
+uint8_t cc2520ll_lplBusy(void)
+{
+    return lplTxBusy;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplGetPhase
+*
+* @brief   Learned wake-up of a neighbor
+*
+* @param   uint16_t addr - short address
+*          rtimer_clock_t *pOffset - ticks after the local wake-up
+*
+* @return  int - SUCCESS, or FAILED if not known
+*/
+int cc2520ll_lplGetPhase(uint16_t addr, rtimer_clock_t *pOffset)
+{
+    uint8_t i = cc2520ll_lplPhaseFind(addr);
+
+    if (i == CC2520_LPL_NONE)
+        return FAILED;
+    *pOffset = lplPhase[i].offset;
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplSetPhase
+*
+* @brief   Enter the wake-up of a neighbor, e.g. one kept across a restart
+*
+* @param   uint16_t addr - short address
+*          rtimer_clock_t offset - ticks after the local wake-up
+*
+* @return  none
+*/
+void cc2520ll_lplSetPhase(uint16_t addr, rtimer_clock_t offset)
+{
+    _disable_interrupts();
+    cc2520ll_lplPhaseStore(addr, offset);
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplClearPhase
+*
+* @brief   Forget the wake-up of a neighbor
+*
+* @param   uint16_t addr - short address, 0xFFFF for every neighbor
+*
+* @return  none
+*/
+void cc2520ll_lplClearPhase(uint16_t addr)
+{
+    uint8_t i;
+
+    _disable_interrupts();
+    for (i = 0; i < CC2520_LPL_PHASE_ENTRIES; i++) {
+        if (addr == 0xFFFF || lplPhase[i].addr == addr)
+            lplPhase[i].addr = 0xFFFF;
+    }
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_lplGetStats
+*
+* @brief   Copy the low-power listening counters. The radio on and off times
+*          give the duty cycle.
+*
+* @param   cc2520ll_lplStats_t *pStats
+*
+* @return  none
+*/
+void cc2520ll_lplGetStats(cc2520ll_lplStats_t *pStats)
+{
+    _disable_interrupts();
+    cc2520ll_lplAccount();
+    *pStats = lplStats;
+    _enable_interrupts();
+}
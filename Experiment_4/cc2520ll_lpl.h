@@ -0,0 +1,75 @@
+#ifndef CC2520LL_LPL_H_
+#define CC2520LL_LPL_H_
+
+#include <inttypes.h>
+#include "cc2520ll.h"
+#include "rtimer.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Low-power listening. The radio sleeps in LPM1 and wakes every wake
+// interval to sample the channel a few times, one backoff period apart. A
+// sender repeats its frame (a strobe) for a whole wake interval, or only
+// around the wake-up of a receiver whose phase it has learned, until the
+// ACK comes. Every node of a network uses the same wake interval.
+
+// Defaults
+#define CC2520_LPL_WAKE_INTERVAL          125   // ms
+#define CC2520_LPL_CCA_CHECKS             5     // Span the gap between strobe frames
+#define CC2520_LPL_AWAKE_TIME             10    // ms in RX after activity
+// Timer_A1 compares times less than 1 s apart; a send may take two intervals
+#define CC2520_LPL_MIN_INTERVAL           8     // ms
+#define CC2520_LPL_MAX_INTERVAL           400   // ms
+// SRXON to a valid RSSI (turnaround and 8 symbols)
+#define CC2520_LPL_RSSI_VALID_US          (CC2520_TX_TURNAROUND_US + 128)
+// Clock drift and wake-up latency allowed around a learned phase
+#define CC2520_LPL_DRIFT_US               1000
+// Neighbors whose wake-up phase is kept (least recently used replaced)
+#define CC2520_LPL_PHASE_ENTRIES          8
+#define CC2520_LPL_NONE                   0xFF
+
+/***********************************************************************************
+* TYPEDEFS
+*/
+typedef struct {
+    uint16_t wakeInterval;      // ms between wake-ups
+    uint8_t ccaChecks;          // Channel samples per wake-up
+    uint8_t awakeTime;          // ms to stay in RX after activity, extended by traffic
+    uint8_t phaseLock;          // Strobe only around the learned wake-up of a neighbor
+} cc2520ll_lplCfg_t;
+
+// Learned wake-up of a neighbor
+typedef struct {
+    uint16_t addr;              // Short address, 0xFFFF if unused
+    rtimer_clock_t offset;      // Ticks after the local wake-up, below one interval
+    uint8_t age;                // 0 for the most recently used entry
+} cc2520ll_lplPhase_t;
+
+typedef struct {
+    uint16_t wakeups;
+    uint16_t wakeBusy;          // Wake-ups that found activity and stayed in RX
+    uint16_t xoscFail;          // XOSC not stable in time, radio left off
+    uint16_t sends;
+    uint16_t phaseSends;        // Strobes aimed at a learned phase
+    uint16_t phaseMiss;         // Of those, unanswered (phase forgotten)
+    uint32_t onTicks;           // Radio on (XOSC running), Timer_A1 ticks
+    uint32_t offTicks;          // Radio in LPM1
+} cc2520ll_lplStats_t;
+
+/* External functions */
+
+int cc2520ll_lplStart(void);
+void cc2520ll_lplStop(void);
+void cc2520ll_lplSetConfig(const cc2520ll_lplCfg_t *pCfg);
+void cc2520ll_lplGetConfig(cc2520ll_lplCfg_t *pCfg);
+void cc2520ll_lplSetDutyCycle(uint16_t permille);
+int cc2520ll_lplSend(const void *packet, uint8_t len, cc2520ll_txCallback_t callback);
+uint8_t cc2520ll_lplBusy(void);
+int cc2520ll_lplGetPhase(uint16_t addr, rtimer_clock_t *pOffset);
+void cc2520ll_lplSetPhase(uint16_t addr, rtimer_clock_t offset);
+void cc2520ll_lplClearPhase(uint16_t addr);
+void cc2520ll_lplGetStats(cc2520ll_lplStats_t *pStats);
+
+#endif /*CC2520LL_LPL_H_*/
@@ -0,0 +1,251 @@
+#include "cc2520ll_nbr.h"
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static cc2520ll_nbr_t nbrTable[CC2520_NBR_SLOTS];
+static uint8_t nbrCount;
+static uint16_t nbrClock;               // Counts updates, orders entries for LRU
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrHash
+*
+* @brief   Home slot of an address (Fibonacci hashing: the top bits of the
+*          product spread sequential addresses over the table)
+*/
+static uint8_t cc2520ll_nbrHash(uint16_t addr)
+{
+    return (uint16_t)(addr * 0x9E37U) >> (16 - CC2520_NBR_BITS);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrFind
+*
+* @brief   Slot holding an address, or the free slot that ends its probe
+*          sequence. The table is never full, so the probe ends.
+*/
+static uint8_t cc2520ll_nbrFind(uint16_t addr)
+{
+    uint8_t i = cc2520ll_nbrHash(addr);
+
+    while (nbrTable[i].addr != addr && nbrTable[i].addr != CC2520_NBR_EMPTY) {
+        i = (i + 1) & (CC2520_NBR_SLOTS - 1);
+    }
+    return i;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrDelete
+*
+* @brief   Free a slot and move later entries of the probe run back into the
+*          gap where their home slot allows, so lookups need no tombstones
+*/
+static void cc2520ll_nbrDelete(uint8_t i)
+{
+    uint8_t j = i, home;
+
+    for (;;) {
+        nbrTable[i].addr = CC2520_NBR_EMPTY;
+        do {
+            j = (j + 1) & (CC2520_NBR_SLOTS - 1);
+            if (nbrTable[j].addr == CC2520_NBR_EMPTY) {
+                nbrCount--;
+                return;
+            }
+            home = cc2520ll_nbrHash(nbrTable[j].addr);
+            // Leave the entry if its home lies cyclically in (i, j]
+        } while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+        nbrTable[i] = nbrTable[j];
+        i = j;
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrEvict
+*
+* @brief   Drop the neighbor heard least recently
+*/
+static void cc2520ll_nbrEvict(void)
+{
+    uint8_t i, oldest = 0;
+    uint16_t age, oldAge = 0;
+
+    for (i = 0; i < CC2520_NBR_SLOTS; i++) {
+        if (nbrTable[i].addr == CC2520_NBR_EMPTY)
+            continue;
+        age = nbrClock - nbrTable[i].used;
+        if (age >= oldAge) {
+            oldAge = age;
+            oldest = i;
+        }
+    }
+    cc2520ll_nbrDelete(oldest);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrInit
+*
+* @brief   Empty the neighbor table
+*
+* @param   none
+*
+* @return  none
+*/
+void cc2520ll_nbrInit(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < CC2520_NBR_SLOTS; i++) {
+        nbrTable[i].addr = CC2520_NBR_EMPTY;
+    }
+    nbrCount = 0;
+    nbrClock = 0;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrUpdate
+*
+* @brief   Account a frame received from a neighbor: average its RSSI and
+*          LQI into the entry, adding the neighbor if new. Called by the RX
+*          interrupt for every queued frame with a short source address.
+*
+* @param   uint16_t addr - source short address
+*          int8_t rssi - dBm
+*          uint8_t lqi - 0-255
+*          uint32_t time - time stamp of the frame
+*
+* @return  none
+*/
+void cc2520ll_nbrUpdate(uint16_t addr, int8_t rssi, uint8_t lqi, uint32_t time)
+{
+    cc2520ll_nbr_t *pNbr;
+    uint8_t i;
+
+    if (addr == CC2520_NBR_EMPTY)
+        return;
+    i = cc2520ll_nbrFind(addr);
+    if (nbrTable[i].addr == CC2520_NBR_EMPTY) {
+        if (nbrCount == CC2520_NBR_MAX) {
+            cc2520ll_nbrEvict();
+            i = cc2520ll_nbrFind(addr);
+        }
+        pNbr = &nbrTable[i];
+        pNbr->addr = addr;
+        pNbr->rssi = rssi * (1 << CC2520_NBR_FRAC_BITS);
+        pNbr->lqi = (uint16_t)lqi << CC2520_NBR_FRAC_BITS;
+        pNbr->frames = 0;
+        nbrCount++;
+    } else {
+        pNbr = &nbrTable[i];
+        pNbr->rssi += (rssi * (1 << CC2520_NBR_FRAC_BITS) - pNbr->rssi) >> CC2520_NBR_EWMA_SHIFT;
+        pNbr->lqi = (uint16_t)((int16_t)pNbr->lqi + \
+            ((((int16_t)lqi << CC2520_NBR_FRAC_BITS) - (int16_t)pNbr->lqi) >> CC2520_NBR_EWMA_SHIFT));
+    }
+    pNbr->lastSeen = time;
+    pNbr->used = ++nbrClock;
+    pNbr->frames++;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrGet
+*
+* @brief   Copy the entry of a neighbor
+*
+* @param   uint16_t addr - short address
+*          cc2520ll_nbr_t *pNbr - filled in
+*
+* @return  int - SUCCESS, or FAILED if the neighbor is not in the table
+*/
+int cc2520ll_nbrGet(uint16_t addr, cc2520ll_nbr_t *pNbr)
+{
+    uint8_t i;
+
+    _disable_interrupts();
+    i = cc2520ll_nbrFind(addr);
+    if (addr == CC2520_NBR_EMPTY || nbrTable[i].addr == CC2520_NBR_EMPTY) {
+        _enable_interrupts();
+        return FAILED;
+    }
+    *pNbr = nbrTable[i];
+    _enable_interrupts();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrLqi
+*
+* @brief   Average link quality of a neighbor
+*
+* @param   uint16_t addr - short address
+*
+* @return  uint8_t - LQI 0-255, 0 if the neighbor is not in the table
+*/
+uint8_t cc2520ll_nbrLqi(uint16_t addr)
+{
+    cc2520ll_nbr_t nbr;
+
+    if (cc2520ll_nbrGet(addr, &nbr) == FAILED)
+        return 0;
+    return (uint8_t)((nbr.lqi + (1 << (CC2520_NBR_FRAC_BITS - 1))) >> CC2520_NBR_FRAC_BITS);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrRemove
+*
+* @brief   Forget a neighbor
+*
+* @param   uint16_t addr - short address
+*
+* @return  int - SUCCESS, or FAILED if it was not in the table
+*/
+int cc2520ll_nbrRemove(uint16_t addr)
+{
+    uint8_t i;
+
+    if (addr == CC2520_NBR_EMPTY)
+        return FAILED;
+    _disable_interrupts();
+    i = cc2520ll_nbrFind(addr);
+    if (nbrTable[i].addr == CC2520_NBR_EMPTY) {
+        _enable_interrupts();
+        return FAILED;
+    }
+    cc2520ll_nbrDelete(i);
+    _enable_interrupts();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrCount
+*
+* @brief   Neighbors in the table
+*
+* @return  uint8_t
+*/
+uint8_t cc2520ll_nbrCount(void)
+{
+    return nbrCount;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_nbrList
+*
+* @brief   Copy the neighbor entries, in table order, e.g. to pick a parent
+*
+* @param   cc2520ll_nbr_t *pList - room for max entries
+*          uint8_t max
+*
+* @return  uint8_t - number of entries copied
+*/
+uint8_t cc2520ll_nbrList(cc2520ll_nbr_t *pList, uint8_t max)
+{
+    uint8_t i, n = 0;
+
+    _disable_interrupts();
+    for (i = 0; i < CC2520_NBR_SLOTS && n < max; i++) {
+        if (nbrTable[i].addr != CC2520_NBR_EMPTY)
+            pList[n++] = nbrTable[i];
+    }
+    _enable_interrupts();
+    return n;
+}
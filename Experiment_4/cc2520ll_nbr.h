@@ -0,0 +1,46 @@
+#ifndef CC2520LL_NBR_H_
+#define CC2520LL_NBR_H_
+
+#include <inttypes.h>
+#include "cc2520ll.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Neighbor table: open addressing with linear probing over 2^CC2520_NBR_BITS
+// slots, keyed by source short address. Kept at most three quarters full;
+// past that the least recently heard neighbor makes room.
+#define CC2520_NBR_BITS                   4
+#define CC2520_NBR_SLOTS                  (1 << CC2520_NBR_BITS)
+#define CC2520_NBR_MAX                    (CC2520_NBR_SLOTS * 3 / 4)
+#define CC2520_NBR_EMPTY                  0xFFFF    // Free slot (broadcast is never a source)
+
+// Link quality averages: new = old + (sample - old) / 2^CC2520_NBR_EWMA_SHIFT,
+// kept with CC2520_NBR_FRAC_BITS fractional bits
+#define CC2520_NBR_EWMA_SHIFT             3
+#define CC2520_NBR_FRAC_BITS              4
+
+/***********************************************************************************
+* TYPEDEFS
+*/
+typedef struct {
+    uint16_t addr;              // Short address, CC2520_NBR_EMPTY if free
+    int16_t rssi;               // dBm, EWMA with CC2520_NBR_FRAC_BITS fraction bits
+    uint16_t lqi;               // 0-255, EWMA with CC2520_NBR_FRAC_BITS fraction bits
+    uint32_t lastSeen;          // Time stamp of the last frame (CC2520_RX_TIMESTAMP)
+    uint16_t used;              // Update count when last heard, for LRU eviction
+    uint16_t frames;
+} cc2520ll_nbr_t;
+
+/* External functions */
+
+void cc2520ll_nbrInit(void);
+void cc2520ll_nbrUpdate(uint16_t addr, int8_t rssi, uint8_t lqi, uint32_t time);
+int cc2520ll_nbrGet(uint16_t addr, cc2520ll_nbr_t *pNbr);
+uint8_t cc2520ll_nbrLqi(uint16_t addr);
+int cc2520ll_nbrRemove(uint16_t addr);
+uint8_t cc2520ll_nbrCount(void);
+uint8_t cc2520ll_nbrList(cc2520ll_nbr_t *pList, uint8_t max);
+
+#endif /*CC2520LL_NBR_H_*/
@@ -0,0 +1,359 @@
+#include "cc2520ll_scan.h"
+#include "cc2520ll_src.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Realignment command in a queued frame: length byte, MHR with short
+// addresses and PAN ID compression, auxiliary security header if any
+#ifdef SECURITY_CCM
+#define SCAN_CMD_POS            (CC2520_HDR_SIZE + CC2520_AUX_HDR_LENGTH)
+#else
+#define SCAN_CMD_POS            CC2520_HDR_SIZE
+#endif
+// MHR and command (id, PAN ID, coordinator short address, channel, short address)
+#define SCAN_REALIGN_LEN        (CC2520_HDR_SIZE - 1 + 8)
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static cc2520ll_scanAuto_t scanAuto = {
+    0, CC2520_SCAN_ALL_CHANNELS, CC2520_SCAN_DWELL, CC2520_SCAN_MARGIN
+};
+static cc2520ll_scanResult_t scanLast;
+static cc2520ll_scanStats_t scanStats;
+static uint16_t scanCount;              // Timer overflows to the next periodic scan
+static volatile uint8_t scanDue;
+
+// Channel announced by a received realignment command, 0 if none
+static volatile uint8_t scanRealign;
+static volatile uint16_t scanRealignPan;
+// Only realignment commands from this short address are followed
+static volatile uint16_t scanCoord = CC2520_SCAN_COORDINATOR;
+
+/***********************************************************************************
+* @fn      cc2520ll_scanChannel
+*
+* @brief   Tune the receiver to a channel and wait until RSSI is valid again.
+*          The wait is bounded by CC2520_RSSI_VALID_MAX_US.
+*
+* @return  uint8_t - SUCCESS, or FAILED if RSSI did not become valid
+*/
+static uint8_t cc2520ll_scanChannel(uint8_t channel)
+{
+    rtimer_clock_t start;
+
+    cc2520ll_setChannel(channel);
+    // The new frequency takes effect with SRXON
+    CC2520_INS_STROBE(CC2520_INS_SRXON);
+    start = rtimer_now();
+    while (!(CC2520_REGRD8(CC2520_RSSISTAT) & 0x01)) {
+        if ((rtimer_clock_t)(rtimer_now() - start) > RTIMER_US_TO_TICKS(CC2520_RSSI_VALID_MAX_US))
+            return FAILED;
+    }
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_scanTick
+*
+* @brief   Timer overflow callback while periodic scans are on
+*/
+static void cc2520ll_scanTick(void)
+{
+    if (--scanCount == 0) {
+        scanDue = TRUE;
+        scanCount = CC2520_SCAN_WRAPS(scanAuto.period);
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_scan
+*
+* @brief   Measure the energy on a set of channels and find the quietest one.
+*          The receiver stays on each channel for the dwell time; frames heard
+*          meanwhile are dropped. A channel whose RSSI does not become valid
+*          is left at CC2520_SCAN_NO_DATA. Returns to the current channel with the
+*          receiver on. Blocks for about dwell ms per channel and is not for
+*          interrupt context; low-power listening must be stopped first.
+*
+* @param   uint32_t channelMask - CC2520_SCAN_CHANNEL_BV bits, 11-26
+*          uint16_t dwell - ms per channel
+*          cc2520ll_scanResult_t *pResult - noise floor table
+*
+* @return  int - SUCCESS, or FAILED if a frame is being sent, the radio is
+*          off or no channel was given
+*/
+int cc2520ll_scan(uint32_t channelMask, uint16_t dwell, cc2520ll_scanResult_t *pResult)
+{
+    uint8_t home, ch, i, best = 0;
+    uint16_t n, samples;
+    int32_t sum;
+    int16_t rssi;
+    int8_t peak;
+
+    channelMask &= CC2520_SCAN_ALL_CHANNELS;
+    if (channelMask == 0 || cc2520ll_txBusy() || \
+        !CC2520_STATUS_QUERY(CC2520_STB_XOSC_STABLE_BV))
+        return FAILED;
+    samples = (uint16_t)(((uint32_t)dwell * 1000 + CC2520_SCAN_SAMPLE_US - 1) / CC2520_SCAN_SAMPLE_US);
+    if (samples == 0)
+        samples = 1;
+    home = cc2520ll_getChannel();
+    cc2520ll_receiveOff();
+
+    pResult->channelMask = channelMask;
+    for (ch = MIN_CHANNEL; ch <= MAX_CHANNEL; ch++) {
+        i = ch - MIN_CHANNEL;
+        if (!(channelMask & CC2520_SCAN_CHANNEL_BV(ch)) || \
+            cc2520ll_scanChannel(ch) == FAILED) {
+            pResult->floor[i] = pResult->peak[i] = CC2520_SCAN_NO_DATA;
+            continue;
+        }
+        sum = 0;
+        peak = -128;
+        for (n = 0; n < samples; n++) {
+            rssi = (int8_t)CC2520_REGRD8(CC2520_RSSI) - CC2520_RSSI_OFFSET;
+            if (rssi < -128)
+                rssi = -128;
+            sum += rssi;
+            if (rssi > peak)
+                peak = rssi;
+            __delay_cycles(CC2520_SCAN_SAMPLE_US * MSP430_USECOND);
+        }
+        // Rounded to the nearest dB (the sum is never positive in practice)
+        pResult->floor[i] = (int8_t)((sum - (int32_t)(samples / 2)) / (int32_t)samples);
+        pResult->peak[i] = peak;
+        if (best == 0 || pResult->floor[i] < pResult->floor[best - MIN_CHANNEL] || \
+            (pResult->floor[i] == pResult->floor[best - MIN_CHANNEL] && \
+             peak < pResult->peak[best - MIN_CHANNEL]))
+            best = ch;
+    }
+    pResult->best = best;
+
+    // Back home; whatever was received elsewhere is thrown away
+    cc2520ll_setChannel(home);
+    CC2520_SRFOFF();
+    CC2520_SFLUSHRX();
+    CC2520_SFLUSHRX();
+    cc2520ll_disableRxInterrupt();
+    cc2520ll_receiveOn();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_scanSetAuto
+*
+* @brief   Scan every period seconds from cc2520ll_scanPoll() and move the
+*          PAN when another channel is quieter by the margin. Only the PAN
+*          coordinator should do this; the other nodes follow its
+*          realignment command as long as they call cc2520ll_scanPoll().
+*
+* @param   const cc2520ll_scanAuto_t *pAuto - period 0 stops the scans
+*
+* @return  none
+*/
+void cc2520ll_scanSetAuto(const cc2520ll_scanAuto_t *pAuto)
+{
+    _disable_interrupts();
+    scanAuto = *pAuto;
+    scanDue = FALSE;
+    if (scanAuto.period) {
+        scanCount = CC2520_SCAN_WRAPS(scanAuto.period);
+        rtimer_setWrap(cc2520ll_scanTick);
+    } else {
+        rtimer_setWrap(NULL);
+    }
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_scanPoll
+*
+* @brief   Main loop work: follow a realignment command received from the
+*          PAN coordinator, or run a periodic scan that is due and move the
+*          PAN if it found a quieter channel. Nothing is done while a frame
+*          is being sent.
+*
+* @param   none
+*
+* @return  uint8_t - TRUE if the channel changed
+*/
+uint8_t cc2520ll_scanPoll(void)
+{
+    uint8_t home, channel;
+    uint16_t panId;
+
+    if (cc2520ll_txBusy())
+        return FALSE;
+
+    _disable_interrupts();
+    channel = scanRealign;
+    panId = scanRealignPan;
+    scanRealign = 0;
+    _enable_interrupts();
+    if (channel && channel != cc2520ll_getChannel() && \
+        panId == CC2520_MEMRD16(CC2520_RAM_PANID)) {
+        cc2520ll_receiveOff();
+        cc2520ll_setChannel(channel);
+        cc2520ll_receiveOn();
+        scanStats.follows++;
+        return TRUE;
+    }
+
+    if (!scanDue)
+        return FALSE;
+    scanDue = FALSE;
+    home = cc2520ll_getChannel();
+    // The current channel is always measured, to compare against
+    if (cc2520ll_scan(scanAuto.channelMask | CC2520_SCAN_CHANNEL_BV(home), \
+        scanAuto.dwell, &scanLast) == FAILED)
+        return FALSE;
+    scanStats.scans++;
+    if (scanLast.best == home || scanLast.floor[scanLast.best - MIN_CHANNEL] + \
+        scanAuto.margin > scanLast.floor[home - MIN_CHANNEL])
+        return FALSE;
+    if (cc2520ll_scanMove(scanLast.best) == FAILED)
+        return FALSE;
+    scanStats.moves++;
+    return TRUE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_scanMove
+*
+* @brief   Move the PAN to another channel. A broadcast coordinator
+*          realignment command naming the channel is sent
+*          CC2520_SCAN_ANNOUNCE times on the current channel, then the radio
+*          retunes. The command uses the driver's frame header (PAN ID
+*          compression, short addresses), so it is secured like any other
+*          frame. Not for interrupt context.
+*
+* @param   uint8_t channel - MIN_CHANNEL - MAX_CHANNEL
+*
+* @return  int - SUCCESS, or FAILED for a bad channel or a frame being sent
+*/
+int cc2520ll_scanMove(uint8_t channel)
+{
+    uint8_t frame[SCAN_REALIGN_LEN];
+    uint16_t panId, shortAddr;
+    uint8_t i;
+
+    if (channel < MIN_CHANNEL || channel > MAX_CHANNEL || cc2520ll_txBusy())
+        return FAILED;
+    panId = CC2520_MEMRD16(CC2520_RAM_PANID);
+    shortAddr = CC2520_MEMRD16(CC2520_RAM_SHORTADDR);
+
+    frame[0] = CC2520_FCF_TYPE_CMD | CC2520_FCF_PANID_COMP_BM_L;
+    frame[1] = 0x88;                        // Short destination and source
+    frame[3] = LO_UINT16(panId);
+    frame[4] = HI_UINT16(panId);
+    frame[5] = 0xFF;                        // Broadcast
+    frame[6] = 0xFF;
+    frame[7] = LO_UINT16(shortAddr);
+    frame[8] = HI_UINT16(shortAddr);
+    frame[9] = CC2520_SCAN_CMD_REALIGN;
+    frame[10] = LO_UINT16(panId);
+    frame[11] = HI_UINT16(panId);
+    frame[12] = LO_UINT16(shortAddr);       // Coordinator short address
+    frame[13] = HI_UINT16(shortAddr);
+    frame[14] = channel;
+    frame[15] = 0xFF;                       // Short address: unchanged
+    frame[16] = 0xFF;
+
+    if (channel != cc2520ll_getChannel()) {
+        for (i = 0; i < CC2520_SCAN_ANNOUNCE; i++) {
+            frame[2] = cc2520ll_nextSeq();
+            // A busy channel is no reason to stay on it
+            cc2520ll_packetSend(frame, sizeof(frame));
+        }
+    }
+    cc2520ll_receiveOff();
+    cc2520ll_setChannel(channel);
+    cc2520ll_receiveOn();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_scanSetCoordinator
+*
+* @brief   Set the short address of the PAN coordinator. Realignment commands
+*          from any other source are ignored.
+*
+* @param   uint16_t shortAddr - CC2520_SCAN_COORDINATOR by default
+*
+* @return  none
+*/
+void cc2520ll_scanSetCoordinator(uint16_t shortAddr)
+{
+    _disable_interrupts();
+    scanCoord = shortAddr;
+    scanRealign = 0;
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_scanGetResult
+*
+* @brief   Copy the noise floor table of the last periodic scan
+*
+* @param   cc2520ll_scanResult_t *pResult
+*
+* @return  none
+*/
+void cc2520ll_scanGetResult(cc2520ll_scanResult_t *pResult)
+{
+    *pResult = scanLast;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_scanGetStats
+*
+* @brief   Copy the scan and migration counters
+*
+* @param   cc2520ll_scanStats_t *pStats
+*
+* @return  none
+*/
+void cc2520ll_scanGetStats(cc2520ll_scanStats_t *pStats)
+{
+    *pStats = scanStats;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_scanRxFrame
+*
+* @brief   Note the channel of a coordinator realignment command addressed to
+*          this PAN. The command must come from the coordinator set with
+*          cc2520ll_scanSetCoordinator() and name it, and with SECURITY_CCM
+*          it must be secured. The channel changes in cc2520ll_scanPoll(),
+*          once no frame is being sent. Called from interrupt context.
+*
+* @param   const uint8_t *pMpdu - length byte and MPDU
+*
+* @return  none
+*/
+void cc2520ll_scanRxFrame(const uint8_t *pMpdu)
+{
+    const uint8_t *pCmd = &pMpdu[SCAN_CMD_POS];
+
+    // Command frame, short addresses, PAN ID compression, payload complete
+    if ((pMpdu[1] & CC2520_FCF_TYPE_BM_L) != CC2520_FCF_TYPE_CMD || \
+        !(pMpdu[1] & CC2520_FCF_PANID_COMP_BM_L) || (pMpdu[2] & 0xCC) != 0x88 || \
+        pMpdu[0] < SCAN_CMD_POS + 7 + CC2520_FOOTER_SIZE || \
+        pCmd[0] != CC2520_SCAN_CMD_REALIGN)
+        return;
+#ifdef SECURITY_CCM
+    if (!(pMpdu[1] & CC2520_SEC_ENABLED_FCF_BM_L))
+        return;
+#endif
+    // Source and coordinator address of the command
+    if ((pMpdu[8] | ((uint16_t)pMpdu[9] << 8)) != scanCoord || \
+        (pCmd[3] | ((uint16_t)pCmd[4] << 8)) != scanCoord)
+        return;
+    if (pCmd[5] < MIN_CHANNEL || pCmd[5] > MAX_CHANNEL)
+        return;
+    scanRealignPan = pCmd[1] | ((uint16_t)pCmd[2] << 8);
+    scanRealign = pCmd[5];
+}
@@ -0,0 +1,77 @@
+#ifndef CC2520LL_SCAN_H_
+#define CC2520LL_SCAN_H_
+
+#include <inttypes.h>
+#include "cc2520ll.h"
+#include "rtimer.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Energy detection scan. The receiver is tuned to each channel in turn and
+// the RSSI register, an average over 8 symbols, is read once per 128 us for
+// the dwell time. The mean of the samples is the noise floor of the channel,
+// the highest sample its peak energy.
+
+// Channel masks: bit n for channel n, as in an IEEE 802.15.4 channel page
+#define CC2520_SCAN_CHANNEL_BV(ch)        (1UL << (ch))
+#define CC2520_SCAN_ALL_CHANNELS          0x07FFF800UL  // 11-26
+#define CC2520_SCAN_CHANNELS              (MAX_CHANNEL - MIN_CHANNEL + 1)
+
+// Defaults
+#define CC2520_SCAN_DWELL                 8     // ms per channel
+#define CC2520_SCAN_MARGIN                6     // dB quieter before a PAN moves
+#define CC2520_SCAN_SAMPLE_US             128   // RSSI averaging period
+// Announcements of a PAN move, sent on the old channel before it is left
+#define CC2520_SCAN_ANNOUNCE              3
+// Periodic scans are counted in timer overflows (RTIMER_WRAP_SECONDS)
+#define CC2520_SCAN_WRAPS(period)         (((period) + RTIMER_WRAP_SECONDS - 1) / RTIMER_WRAP_SECONDS)
+
+// Table entry of a channel that was not scanned
+#define CC2520_SCAN_NO_DATA               (-128)
+
+// Coordinator realignment command (IEEE 802.15.4 MAC command 0x08)
+#define CC2520_SCAN_CMD_REALIGN           0x08
+#define CC2520_FCF_TYPE_CMD               0x03
+// Short address of the PAN coordinator, whose realignment commands are followed
+#define CC2520_SCAN_COORDINATOR           0x0000
+
+/***********************************************************************************
+* TYPEDEFS
+*/
+typedef struct {
+    uint32_t channelMask;       // Channels scanned
+    int8_t floor[CC2520_SCAN_CHANNELS];     // dBm, mean RSSI, index channel - MIN_CHANNEL
+    int8_t peak[CC2520_SCAN_CHANNELS];      // dBm, highest RSSI
+    uint8_t best;               // Quietest channel: lowest floor, then lowest peak
+} cc2520ll_scanResult_t;
+
+// Periodic scan and PAN migration (cc2520ll_scanSetAuto)
+typedef struct {
+    uint16_t period;            // s between scans, rounded up to RTIMER_WRAP_SECONDS; 0 to stop
+    uint32_t channelMask;       // Candidate channels
+    uint16_t dwell;             // ms per channel
+    uint8_t margin;             // dB the best channel must be quieter than the current one
+} cc2520ll_scanAuto_t;
+
+typedef struct {
+    uint16_t scans;             // Periodic scans run
+    uint16_t moves;             // PAN moved after a scan
+    uint16_t follows;           // Channel changed on a received realignment command
+} cc2520ll_scanStats_t;
+
+/* External functions */
+
+int cc2520ll_scan(uint32_t channelMask, uint16_t dwell, cc2520ll_scanResult_t *pResult);
+void cc2520ll_scanSetAuto(const cc2520ll_scanAuto_t *pAuto);
+uint8_t cc2520ll_scanPoll(void);
+int cc2520ll_scanMove(uint8_t channel);
+void cc2520ll_scanSetCoordinator(uint16_t shortAddr);
+void cc2520ll_scanGetResult(cc2520ll_scanResult_t *pResult);
+void cc2520ll_scanGetStats(cc2520ll_scanStats_t *pStats);
+
+// Called by the RX interrupt for every queued frame
+void cc2520ll_scanRxFrame(const uint8_t *pMpdu);
+
+#endif /*CC2520LL_SCAN_H_*/
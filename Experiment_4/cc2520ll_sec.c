@@ -0,0 +1,439 @@
+#include "cc2520ll_sec.h"
+#include "cc2520ll_src.h"
+
+#ifdef SECURITY_CCM
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static uint32_t txFrameCounter;         // Mirrors the counter in the TX nonce
+static uint32_t txCounterLimit;         // First counter not reserved in flash
+static uint8_t counterLoaded;           // Counter taken from flash since reset
+static uint16_t markSeg;                // Segment the highest mark is in
+static uint8_t markSlot;                // Next free word in it
+static volatile uint8_t spareErased;    // The other segment is erased
+static uint16_t replaySrc[CC2520_SEC_REPLAY_LEN];
+static uint32_t replayCounter[CC2520_SEC_REPLAY_LEN];
+static uint8_t replayAge[CC2520_SEC_REPLAY_LEN];   // 0 for the sender heard last
+static uint8_t replayCount;
+static cc2520ll_secStats_t secStats;
+
+/***********************************************************************************
+* @fn      cc2520ll_secMhrOk
+*
+* @brief   Check that an MHR has the layout CC2520_LEN_AUTH and the nonce
+*          source address are taken from: short destination and source
+*          addresses, PAN ID compression
+*
+* @param   const uint8_t *pFcf - frame control field, LSB first
+*
+* @return  uint8_t - TRUE if the layout matches
+*/
+static uint8_t cc2520ll_secMhrOk(const uint8_t *pFcf)
+{
+    return (pFcf[0] & CC2520_FCF_PANID_COMP_BM_L) && \
+        ((pFcf[1] >> 2) & 0x03) == CC2520_SRC_MODE_SHORT && \
+        ((pFcf[1] >> 6) & 0x03) == CC2520_SRC_MODE_SHORT;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secReplayFind
+*
+* @brief   Look up a sender in the replay table
+*
+* @param   uint16_t src - short source address
+*
+* @return  uint8_t - table index, CC2520_SEC_REPLAY_LEN if unknown
+*/
+static uint8_t cc2520ll_secReplayFind(uint16_t src)
+{
+    uint8_t i;
+
+    for (i = 0; i < replayCount; i++) {
+        if (replaySrc[i] == src)
+            return i;
+    }
+    return CC2520_SEC_REPLAY_LEN;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secReplayUpdate
+*
+* @brief   Remember the counter of an authentic frame, taking over the least
+*          recently heard sender's entry for a new sender
+*
+* @param   uint8_t i - table index, CC2520_SEC_REPLAY_LEN for a new sender
+*          uint16_t src - short source address
+*          uint32_t counter - frame counter
+*
+* @return  none
+*/
+static void cc2520ll_secReplayUpdate(uint8_t i, uint16_t src, uint32_t counter)
+{
+    uint8_t j, oldAge = 0xFF;
+
+    if (i < CC2520_SEC_REPLAY_LEN) {
+        oldAge = replayAge[i];
+    } else if (replayCount < CC2520_SEC_REPLAY_LEN) {
+        i = replayCount++;
+        replaySrc[i] = src;
+    } else {
+        i = 0;
+        for (j = 1; j < CC2520_SEC_REPLAY_LEN; j++) {
+            if (replayAge[j] > replayAge[i])
+                i = j;
+        }
+        oldAge = replayAge[i];
+        replaySrc[i] = src;
+    }
+    // Senders heard since this one last was grow older
+    for (j = 0; j < replayCount; j++) {
+        if (j != i && replayAge[j] < oldAge)
+            replayAge[j]++;
+    }
+    replayAge[i] = 0;
+    replayCounter[i] = counter;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secMarkLoad
+*
+* @brief   Find the highest frame counter mark in information memory and the
+*          free word after it
+*
+* @param   none
+*
+* @return  uint32_t - highest mark, 0 if flash holds none
+*/
+static uint32_t cc2520ll_secMarkLoad(void)
+{
+    uint32_t mark, max = 0;
+    uint16_t seg;
+    uint8_t i;
+
+    markSeg = CC2520_SEC_MARK_SEG0;
+    markSlot = 0;
+    for (seg = CC2520_SEC_MARK_SEG0; ; seg = CC2520_SEC_MARK_SEG1) {
+        for (i = 0; i < CC2520_SEC_MARK_SLOTS; i++) {
+            mark = infomem_read32(seg + 4 * i);
+            if (mark == INFOMEM_ERASED32)
+                break;
+            if (mark >= max) {
+                max = mark;
+                markSeg = seg;
+                markSlot = i + 1;
+            }
+        }
+        if (seg == CC2520_SEC_MARK_SEG1)
+            break;
+    }
+    return max;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secSpareErase
+*
+* @brief   Erase the segment the marks move to next, unless it already is.
+*          Holds the CPU for up to 32 ms: not for the send path.
+*
+* @param   none
+*
+* @return  none
+*/
+static void cc2520ll_secSpareErase(void)
+{
+    uint16_t seg;
+    uint8_t i;
+
+    seg = markSeg == CC2520_SEC_MARK_SEG0 ? CC2520_SEC_MARK_SEG1 : CC2520_SEC_MARK_SEG0;
+    for (i = 0; i < CC2520_SEC_MARK_SLOTS; i++) {
+        if (infomem_read32(seg + 4 * i) != INFOMEM_ERASED32)
+            break;
+    }
+    if (i < CC2520_SEC_MARK_SLOTS)
+        infomem_erase(seg);
+    spareErased = TRUE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secReserve
+*
+* @brief   Reserve the next block of frame counters by writing its end to
+*          information memory. A full segment moves the marks to the other
+*          one, which cc2520ll_secInit() or cc2520ll_secPoll() erased
+*          before, so only a word is written here. A word that does not
+*          read back is skipped.
+*
+* @param   none
+*
+* @return  uint8_t - SUCCESS, or FAILED if the counter is exhausted, the
+*          other segment is not erased yet or the mark was not written
+*/
+static uint8_t cc2520ll_secReserve(void)
+{
+    uint32_t limit;
+
+    if (txFrameCounter >= CC2520_SEC_COUNTER_MAX - CC2520_SEC_COUNTER_BLOCK)
+        limit = CC2520_SEC_COUNTER_MAX;
+    else
+        limit = txFrameCounter + CC2520_SEC_COUNTER_BLOCK;
+    if (limit <= txCounterLimit)
+        return FAILED;
+    if (markSlot == CC2520_SEC_MARK_SLOTS) {
+        if (!spareErased)
+            return FAILED;
+        markSeg = markSeg == CC2520_SEC_MARK_SEG0 ? CC2520_SEC_MARK_SEG1 : CC2520_SEC_MARK_SEG0;
+        markSlot = 0;
+        spareErased = FALSE;
+    }
+    if (!infomem_write32(markSeg + 4 * markSlot++, limit))
+        return FAILED;
+    txCounterLimit = limit;
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secInit
+*
+* @brief   Load the key and both nonces into radio RAM. The nonce source
+*          address is the 16-bit short address padded with zeros, see
+*          cc2520ll_sec.h. The TX frame counter is taken from the marks in
+*          information memory on the first call after reset and kept by
+*          later calls, as is the replay table. The first call also erases
+*          the segment the marks move to next, if needed.
+*
+* @param   const uint8_t *pKey - 16-byte key, first byte first
+*          uint16_t shortAddr - this node's short address
+*
+* @return  none
+*/
+void cc2520ll_secInit(const uint8_t *pKey, uint16_t shortAddr)
+{
+    uint8_t buf[CC2520_SEC_NONCE_LEN];
+    uint8_t i;
+
+    // AES operands are stored byte-reversed
+    for (i = 0; i < CC2520_SEC_KEY_LEN; i++) {
+        buf[i] = pKey[CC2520_SEC_KEY_LEN - 1 - i];
+    }
+    CC2520_MEMWR(CC2520_SEC_KEY_ADDR, CC2520_SEC_KEY_LEN, buf);
+
+    if (!counterLoaded) {
+        // Counters below the highest mark may have been used before reset
+        txFrameCounter = txCounterLimit = cc2520ll_secMarkLoad();
+        counterLoaded = TRUE;
+        cc2520ll_secSpareErase();
+        cc2520ll_secReserve();
+    }
+
+    // TX nonce: own address and frame counter. The RX nonce gets the sender
+    // address and counter of every incoming frame.
+    for (i = 0; i < CC2520_SEC_NONCE_LEN; i++) {
+        buf[i] = 0;
+    }
+    buf[CC2520_SEC_NONCE_LEVEL] = CC2520_SEC_LEVEL;
+    buf[CC2520_SEC_NONCE_FLAGS] = CC2520_SEC_NONCE_FLAGS_VAL;
+    CC2520_MEMWR(CC2520_SEC_NONCE_RX_ADDR, CC2520_SEC_NONCE_LEN, buf);
+    buf[CC2520_SEC_NONCE_FRAME_CNT] = (uint8_t)txFrameCounter;
+    buf[CC2520_SEC_NONCE_FRAME_CNT + 1] = (uint8_t)(txFrameCounter >> 8);
+    buf[CC2520_SEC_NONCE_FRAME_CNT + 2] = (uint8_t)(txFrameCounter >> 16);
+    buf[CC2520_SEC_NONCE_FRAME_CNT + 3] = (uint8_t)(txFrameCounter >> 24);
+    buf[CC2520_SEC_NONCE_SRC_ADDR] = LO_UINT16(shortAddr);
+    buf[CC2520_SEC_NONCE_SRC_ADDR + 1] = HI_UINT16(shortAddr);
+    CC2520_MEMWR(CC2520_SEC_NONCE_TX_ADDR, CC2520_SEC_NONCE_LEN, buf);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secPoll
+*
+* @brief   Main loop work: once the marks fill half of their segment, erase
+*          the other one, so that the send path never erases. Holds the CPU
+*          for up to 32 ms when it does. Not for interrupt context.
+*
+* @param   none
+*
+* @return  none
+*/
+void cc2520ll_secPoll(void)
+{
+    // The send path does not move the marks while the other segment is
+    // not erased, so markSeg holds still here
+    if (!spareErased && markSlot >= CC2520_SEC_MARK_SLOTS / 2)
+        cc2520ll_secSpareErase();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secWriteTxBuf
+*
+* @brief   Secure a frame and load it into the TX FIFO. The header and the
+*          payload are written to radio RAM once; CCM, the copy to the TX FIFO
+*          and the nonce increment all run in the radio.
+*
+*          Frame on air: MHR (security enabled) | aux header | encrypted
+*          payload | MIC | FCS
+*
+*          Nothing is written when the frame counter is used up or the MHR
+*          does not have short addresses and PAN ID compression.
+*
+* @param   const uint8_t *pPacket - MHR (CC2520_HDR_SIZE - 1 bytes) and payload
+*          uint8_t len - number of bytes in pPacket
+*
+* @return  uint8_t - SUCCESS, or FAILED if the MHR does not fit or no frame
+*          counter is left
+*/
+uint8_t cc2520ll_secWriteTxBuf(const uint8_t *pPacket, uint8_t len)
+{
+    uint8_t hdr[1 + (CC2520_LEN_AUTH)];
+    uint8_t c, i;
+
+    if (len < CC2520_HDR_SIZE - 1 || !cc2520ll_secMhrOk(pPacket) || \
+        (txFrameCounter >= txCounterLimit && cc2520ll_secReserve() == FAILED)) {
+        secStats.txRefused++;
+        return FAILED;
+    }
+    c = len - (CC2520_HDR_SIZE - 1);
+
+    // PHR, MHR and auxiliary security header
+    hdr[0] = (CC2520_LEN_AUTH) + c + CC2520_LEN_MIC + CC2520_FOOTER_SIZE;
+    for (i = 0; i < CC2520_HDR_SIZE - 1; i++) {
+        hdr[1 + i] = pPacket[i];
+    }
+    hdr[1] |= CC2520_SEC_ENABLED_FCF_BM_L;
+    hdr[CC2520_HDR_SIZE] = CC2520_SEC_LEVEL;
+    hdr[CC2520_HDR_SIZE + 1] = (uint8_t)txFrameCounter;
+    hdr[CC2520_HDR_SIZE + 2] = (uint8_t)(txFrameCounter >> 8);
+    hdr[CC2520_HDR_SIZE + 3] = (uint8_t)(txFrameCounter >> 16);
+    hdr[CC2520_HDR_SIZE + 4] = (uint8_t)(txFrameCounter >> 24);
+    CC2520_MEMWR(CC2520_SEC_WORK_ADDR, sizeof(hdr), hdr);
+    if (c > 0) {
+        CC2520_MEMWR(CC2520_SEC_WORK_ADDR + sizeof(hdr), c, (uint8_t*)pPacket + CC2520_HDR_SIZE - 1);
+    }
+
+    // Encrypt in place and append the MIC, move the frame to the TX FIFO and
+    // step the nonce. Same priority, so the DPU runs them in order.
+    CC2520_CCM(CC2520_SEC_PRI, CC2520_SEC_KEY_ADDR/16, c, CC2520_SEC_NONCE_TX_ADDR/16, \
+        CC2520_SEC_WORK_ADDR + 1, CC2520_SEC_WORK_ADDR + 1, CC2520_LEN_AUTH, CC2520_SECURITY_M);
+    CC2520_TXBUFCP(CC2520_SEC_PRI, CC2520_SEC_WORK_ADDR, hdr[0] - CC2520_FOOTER_SIZE + 1, NULL);
+    CC2520_INC(CC2520_SEC_PRI, 2, CC2520_SEC_NONCE_TX_ADDR + CC2520_SEC_NONCE_FRAME_CNT);
+    WAIT_DPU_DONE_H();
+
+    txFrameCounter++;
+    secStats.txFrames++;
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secReadRxBuf
+*
+* @brief   Read a secured frame whose length byte has been read from the RX
+*          FIFO. The header is copied to the MCU and to radio RAM in one pass;
+*          the rest is moved to radio RAM, checked and decrypted there, and
+*          only the plaintext payload and the status bytes are read back.
+*
+*          On success pMpdu holds PHR | MHR | aux header | payload | RSSI |
+*          CRC/LQI, with the MIC removed and the length byte updated.
+*
+* @param   uint8_t *pMpdu - frame buffer, pMpdu[0] holds the length byte
+*          uint8_t len - frame length from the length byte
+*
+* @return  uint8_t - new frame length, 0 if the frame was dropped
+*/
+uint8_t cc2520ll_secReadRxBuf(uint8_t *pMpdu, uint8_t len)
+{
+    uint8_t *pAux, *pFooter;
+    uint8_t nonce[6];
+    uint32_t counter;
+    uint16_t src;
+    uint8_t c, i;
+    unsigned short istate;
+
+    // Every path takes the whole frame out of the RX FIFO, so the frame
+    // behind it starts at the head
+    if (len < (CC2520_LEN_AUTH) + CC2520_LEN_MIC + CC2520_FOOTER_SIZE) {
+        CC2520_RXBUF(len, pMpdu + 1);
+        secStats.rxUnsecured++;
+        return 0;
+    }
+    c = len - (CC2520_LEN_AUTH) - CC2520_LEN_MIC - CC2520_FOOTER_SIZE;
+
+    // Header to the MCU and to the work buffer; payload, MIC and status bytes
+    // stay in the radio
+    CC2520_SPI_LOCK(istate);
+    CC2520_RXBUFCP_BEGIN(CC2520_SEC_WORK_ADDR, NULL);
+    CC2520_RXBUFCP_END(CC2520_SEC_WORK_ADDR, CC2520_LEN_AUTH, pMpdu + 1);
+    CC2520_SPI_UNLOCK(istate);
+    CC2520_RXBUFMOV(CC2520_SEC_PRI, CC2520_SEC_WORK_ADDR + (CC2520_LEN_AUTH), \
+        c + CC2520_LEN_MIC + CC2520_FOOTER_SIZE, NULL);
+    WAIT_DPU_DONE_H();
+    pAux = pMpdu + CC2520_HDR_SIZE;
+    if (!(pMpdu[1] & CC2520_SEC_ENABLED_FCF_BM_L) || pAux[0] != CC2520_SEC_LEVEL) {
+        secStats.rxUnsecured++;
+        return 0;
+    }
+    // The aux header position and the nonce source address assume one MHR
+    // layout
+    if (!cc2520ll_secMhrOk(pMpdu + 1)) {
+        secStats.rxBadHeader++;
+        return 0;
+    }
+    pFooter = pMpdu + 1 + (CC2520_LEN_AUTH) + c;
+    CC2520_MEMRD(CC2520_SEC_WORK_ADDR + (CC2520_LEN_AUTH) + c + CC2520_LEN_MIC, \
+        CC2520_FOOTER_SIZE, pFooter);
+    if (!(pFooter[1] & CC2520_CRC_OK_BM)) {
+        secStats.rxAuthFailed++;
+        return 0;
+    }
+
+    // Replay check before spending the DPU on the frame
+    counter = pAux[1] | ((uint32_t)pAux[2] << 8) | ((uint32_t)pAux[3] << 16) | \
+        ((uint32_t)pAux[4] << 24);
+    src = pMpdu[CC2520_SEC_SRC_POS] | (pMpdu[CC2520_SEC_SRC_POS + 1] << 8);
+    i = cc2520ll_secReplayFind(src);
+    if (i < CC2520_SEC_REPLAY_LEN && counter <= replayCounter[i]) {
+        secStats.rxReplayed++;
+        return 0;
+    }
+
+    // RX nonce: frame counter and source address are adjacent in RAM
+    nonce[0] = pAux[1];
+    nonce[1] = pAux[2];
+    nonce[2] = pAux[3];
+    nonce[3] = pAux[4];
+    nonce[4] = pMpdu[CC2520_SEC_SRC_POS];
+    nonce[5] = pMpdu[CC2520_SEC_SRC_POS + 1];
+    CC2520_MEMWR(CC2520_SEC_NONCE_RX_ADDR + CC2520_SEC_NONCE_FRAME_CNT, sizeof(nonce), nonce);
+
+    CC2520_UCCM(CC2520_SEC_PRI, CC2520_SEC_KEY_ADDR/16, c, CC2520_SEC_NONCE_RX_ADDR/16, \
+        CC2520_SEC_WORK_ADDR, CC2520_SEC_WORK_ADDR, CC2520_LEN_AUTH, CC2520_SECURITY_M);
+    WAIT_DPU_DONE_H();
+    if (!(CC2520_REGRD8(CC2520_DPUSTAT) & CC2520_DPUSTAT_AUTHSTAT_H_BM)) {
+        secStats.rxAuthFailed++;
+        return 0;
+    }
+    if (c > 0) {
+        CC2520_MEMRD(CC2520_SEC_WORK_ADDR + (CC2520_LEN_AUTH), c, pMpdu + 1 + (CC2520_LEN_AUTH));
+    }
+
+    // Authentic: remember the counter
+    cc2520ll_secReplayUpdate(i, src, counter);
+    secStats.rxFrames++;
+
+    pMpdu[0] = len - CC2520_LEN_MIC;
+    return pMpdu[0];
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_secGetStats
+*
+* @brief   Copy the security counters
+*
+* @param   cc2520ll_secStats_t *pStats
+*
+* @return  none
+*/
+void cc2520ll_secGetStats(cc2520ll_secStats_t *pStats)
+{
+    *pStats = secStats;
+}
+
+#endif
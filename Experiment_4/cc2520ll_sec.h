@@ -0,0 +1,104 @@
+#ifndef CC2520LL_SEC_H_
+#define CC2520LL_SEC_H_
+
+#include <inttypes.h>
+#include "cc2520ll.h"
+#include "infomem.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Radio RAM used by the security pipeline (general purpose RAM from 0x200).
+// AES operands are 16-byte aligned and addressed as addr/16 by the DPU.
+#define CC2520_SEC_KEY_ADDR               0x200
+#define CC2520_SEC_NONCE_TX_ADDR          0x210
+#define CC2520_SEC_NONCE_RX_ADDR          0x220
+// Frame being secured (TX) or unsecured (RX). TX preparation runs with the
+// RX interrupt disabled, so both directions share it.
+#define CC2520_SEC_WORK_ADDR              0x230
+#define CC2520_SEC_WORK_LEN               128
+
+// Nonce, stored byte-reversed: counter(2) | level(1) | frame counter(4) |
+// source address(8) | flags(1). The frame counter is little endian in RAM so
+// CC2520_INC can step it.
+// Deviation from IEEE 802.15.4: the source address field holds the sender's
+// short address padded with zeros, not its extended address. Frames carry
+// short addresses only and a receiver has no table to map them. Nonces then
+// stay unique only while a short address belongs to one node for the life of
+// a key: a key must not span PANs, and a short address given to another node
+// needs a new key.
+#define CC2520_SEC_NONCE_LEN              16
+#define CC2520_SEC_NONCE_LEVEL            2
+#define CC2520_SEC_NONCE_FRAME_CNT        3
+#define CC2520_SEC_NONCE_SRC_ADDR         7
+#define CC2520_SEC_NONCE_FLAGS            15
+#define CC2520_SEC_NONCE_FLAGS_VAL        0x01      // L = 2 bytes of block counter
+
+// Secured frames have short destination and source addresses and PAN ID
+// compression; others are refused on TX and dropped on RX. Source address
+// index in PHR | MHR.
+#define CC2520_SEC_SRC_POS                8
+
+// Auxiliary security header: ENC-MIC-64, key known implicitly
+#define CC2520_SEC_LEVEL                  0x06
+#define CC2520_SEC_KEY_LEN                16
+
+// Senders tracked for replay rejection, the least recently heard one is
+// replaced by a new sender. A sender replaced and heard again starts over, so
+// frames it sent before can be replayed to this node once: size the table for
+// every neighbor.
+#define CC2520_SEC_REPLAY_LEN             8
+
+// A CCM* nonce must never repeat under one key, so the TX frame counter goes on
+// where it stopped before a reset. Blocks of CC2520_SEC_COUNTER_BLOCK counters
+// are reserved ahead by writing the end of the block (a mark) to information
+// memory: one word write per block, in the send path, which can be the RX or
+// timer interrupt. The marks fill segment D, then C, then D again. The
+// segment taken over is erased ahead, by cc2520ll_secInit() or, once the
+// current one is half full, by cc2520ll_secPoll() from the main loop; an
+// erase holds the CPU for up to 32 ms. Frames are refused while the marks
+// need to move on and the other segment is not erased yet. After a reset
+// counting starts from the highest mark, so at most one block is skipped. A
+// frame is refused once the counter reaches CC2520_SEC_COUNTER_MAX or a mark
+// cannot be written; a new key is due then.
+#define CC2520_SEC_MARK_SEG0              INFOMEM_D
+#define CC2520_SEC_MARK_SEG1              INFOMEM_C
+#define CC2520_SEC_MARK_SLOTS             (INFOMEM_SEG_LEN / 4)
+#define CC2520_SEC_COUNTER_BLOCK          1024UL
+#define CC2520_SEC_COUNTER_MAX            0xFFFFFFFEUL  // Highest mark, reads unlike erased flash
+
+// DPUSTAT
+#define CC2520_DPUSTAT_AUTHSTAT_H_BM      0x08
+
+// DPU instruction priority
+#define CC2520_SEC_PRI                    1
+
+// Network key. The default is a test key known to everyone: define
+// SECURITY_KEY for the build of a real network.
+#ifndef SECURITY_KEY
+#define SECURITY_KEY    { 0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, \
+                          0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF }
+#endif
+
+/* Type definitions */
+
+typedef struct {
+    uint16_t txFrames;          // Frames secured
+    uint16_t txRefused;         // MHR layout, or frame counter exhausted or not reserved, not sent
+    uint16_t rxFrames;          // Frames authenticated and decrypted
+    uint16_t rxUnsecured;       // Data frames without security, dropped
+    uint16_t rxBadHeader;       // MHR without short addresses and PAN ID compression, dropped
+    uint16_t rxAuthFailed;      // Bad MIC or CRC, dropped
+    uint16_t rxReplayed;        // Frame counter not above the sender's last, dropped
+} cc2520ll_secStats_t;
+
+/* External functions */
+
+void cc2520ll_secInit(const uint8_t *pKey, uint16_t shortAddr);
+void cc2520ll_secPoll(void);
+uint8_t cc2520ll_secWriteTxBuf(const uint8_t *pPacket, uint8_t len);
+uint8_t cc2520ll_secReadRxBuf(uint8_t *pMpdu, uint8_t len);
+void cc2520ll_secGetStats(cc2520ll_secStats_t *pStats);
+
+#endif /*CC2520LL_SEC_H_*/
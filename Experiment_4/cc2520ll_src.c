@@ -0,0 +1,359 @@
+#include "cc2520ll_src.h"
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+// Copy of the source address table and masks, so lookups need no SPI access
+static uint8_t srcTable[CC2520_SRC_TABLE_LEN];
+static uint32_t shortEn, extEn;
+static uint32_t shortPend, extPend;
+static uint8_t srcFilter;
+
+/***********************************************************************************
+* @fn      cc2520ll_srcShortFree
+*
+* @brief   Is short entry n unused (also not covered by an extended entry)?
+*/
+static uint8_t cc2520ll_srcShortFree(uint8_t n)
+{
+    return !(shortEn & CC2520_SRC_SHORT_BV(n)) && !(extEn & CC2520_SRC_EXT_BV(n >> 1));
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcWritePending
+*
+* @brief   Write both pending masks (SRCEXTPENDEN0-2 and SRCSHORTPENDEN0-2 are
+*          adjacent in RAM) in one burst
+*/
+static void cc2520ll_srcWritePending(void)
+{
+    uint8_t buf[6];
+
+    buf[0] = (uint8_t)extPend;
+    buf[1] = (uint8_t)(extPend >> 8);
+    buf[2] = (uint8_t)(extPend >> 16);
+    buf[3] = (uint8_t)shortPend;
+    buf[4] = (uint8_t)(shortPend >> 8);
+    buf[5] = (uint8_t)(shortPend >> 16);
+    CC2520_MEMWR(CC2520_RAM_SRCEXTPENDEN0, sizeof(buf), buf);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcInit
+*
+* @brief   Empty the source address table and enable source matching with
+*          automatic frame pending for data requests
+*
+* @param   none
+*
+* @return  none
+*/
+void cc2520ll_srcInit(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < CC2520_SRC_TABLE_LEN; i++) {
+        srcTable[i] = 0;
+    }
+    shortEn = extEn = 0;
+    shortPend = extPend = 0;
+    srcFilter = FALSE;
+
+    CC2520_REGWR24(CC2520_SRCSHORTEN0, 0);
+    CC2520_REGWR24(CC2520_SRCEXTEN0, 0);
+    cc2520ll_srcWritePending();
+    CC2520_REGWR8(CC2520_SRCMATCH, CC2520_SRCMATCH_EN_BM | CC2520_SRCMATCH_AUTOPEND_BM | \
+        CC2520_SRCMATCH_PEND_DATAREQ_BM);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcFindShort
+*
+* @brief   Look up a short address entry
+*
+* @param   uint16_t panId
+*          uint16_t shortAddr
+*
+* @return  uint8_t - entry index, CC2520_SRC_NONE if not in the table
+*/
+uint8_t cc2520ll_srcFindShort(uint16_t panId, uint16_t shortAddr)
+{
+    uint8_t *pEntry;
+    uint8_t n;
+
+    for (n = 0; n < CC2520_SRC_SHORT_ENTRIES; n++) {
+        pEntry = &srcTable[n * CC2520_SRC_SHORT_LEN];
+        if ((shortEn & CC2520_SRC_SHORT_BV(n)) && \
+            pEntry[0] == LO_UINT16(panId) && pEntry[1] == HI_UINT16(panId) && \
+            pEntry[2] == LO_UINT16(shortAddr) && pEntry[3] == HI_UINT16(shortAddr))
+            return n;
+    }
+    return CC2520_SRC_NONE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcFindExt
+*
+* @brief   Look up an extended address entry
+*
+* @param   const uint8_t *pExtAddr - extended address, most significant byte first
+*
+* @return  uint8_t - entry index, CC2520_SRC_NONE if not in the table
+*/
+uint8_t cc2520ll_srcFindExt(const uint8_t *pExtAddr)
+{
+    uint8_t *pEntry;
+    uint8_t n, i;
+
+    for (n = 0; n < CC2520_SRC_EXT_ENTRIES; n++) {
+        if (!(extEn & CC2520_SRC_EXT_BV(n)))
+            continue;
+        pEntry = &srcTable[n * CC2520_SRC_EXT_LEN];
+        for (i = 0; i < CC2520_SRC_EXT_LEN; i++) {
+            if (pEntry[i] != pExtAddr[CC2520_SRC_EXT_LEN - 1 - i])
+                break;
+        }
+        if (i == CC2520_SRC_EXT_LEN)
+            return n;
+    }
+    return CC2520_SRC_NONE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcSetPending
+*
+* @brief   Set or clear the frame pending bit the radio puts in ACKs to an entry
+*
+* @param   uint8_t ext - TRUE for an extended entry
+*          uint8_t index - entry index
+*          uint8_t pending - TRUE to announce pending data
+*
+* @return  uint8_t - SUCCESS, or FAILED if the entry is not in use
+*/
+uint8_t cc2520ll_srcSetPending(uint8_t ext, uint8_t index, uint8_t pending)
+{
+    uint32_t *pMask;
+    uint32_t bv;
+
+    if (ext) {
+        if (index >= CC2520_SRC_EXT_ENTRIES || !(extEn & CC2520_SRC_EXT_BV(index)))
+            return FAILED;
+        pMask = &extPend;
+        bv = CC2520_SRC_EXT_BV(index);
+    } else {
+        if (index >= CC2520_SRC_SHORT_ENTRIES || !(shortEn & CC2520_SRC_SHORT_BV(index)))
+            return FAILED;
+        pMask = &shortPend;
+        bv = CC2520_SRC_SHORT_BV(index);
+    }
+    if (((*pMask & bv) != 0) != (pending != 0)) {
+        *pMask = pending ? (*pMask | bv) : (*pMask & ~bv);
+        cc2520ll_srcWritePending();
+    }
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcAddShort
+*
+* @brief   Add a short address entry, or update the pending bit of an existing
+*          one
+*
+* @param   uint16_t panId
+*          uint16_t shortAddr
+*          uint8_t pending - frame pending bit for ACKs to this source
+*
+* @return  uint8_t - entry index, CC2520_SRC_NONE if the table is full
+*/
+uint8_t cc2520ll_srcAddShort(uint16_t panId, uint16_t shortAddr, uint8_t pending)
+{
+    uint8_t *pEntry;
+    uint8_t n;
+
+    n = cc2520ll_srcFindShort(panId, shortAddr);
+    if (n == CC2520_SRC_NONE) {
+        for (n = 0; n < CC2520_SRC_SHORT_ENTRIES && !cc2520ll_srcShortFree(n); n++);
+        if (n == CC2520_SRC_SHORT_ENTRIES)
+            return CC2520_SRC_NONE;
+
+        pEntry = &srcTable[n * CC2520_SRC_SHORT_LEN];
+        pEntry[0] = LO_UINT16(panId);
+        pEntry[1] = HI_UINT16(panId);
+        pEntry[2] = LO_UINT16(shortAddr);
+        pEntry[3] = HI_UINT16(shortAddr);
+        CC2520_MEMWR(CC2520_RAM_SRCTABLEBASE + n * CC2520_SRC_SHORT_LEN, CC2520_SRC_SHORT_LEN, pEntry);
+        shortEn |= CC2520_SRC_SHORT_BV(n);
+        CC2520_REGWR24(CC2520_SRCSHORTEN0, shortEn);
+    }
+    cc2520ll_srcSetPending(FALSE, n, pending);
+    return n;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcAddExt
+*
+* @brief   Add an extended address entry, or update the pending bit of an
+*          existing one
+*
+* @param   const uint8_t *pExtAddr - extended address, most significant byte first
+*          uint8_t pending - frame pending bit for ACKs to this source
+*
+* @return  uint8_t - entry index, CC2520_SRC_NONE if the table is full
+*/
+uint8_t cc2520ll_srcAddExt(const uint8_t *pExtAddr, uint8_t pending)
+{
+    uint8_t *pEntry;
+    uint8_t n, i;
+
+    n = cc2520ll_srcFindExt(pExtAddr);
+    if (n == CC2520_SRC_NONE) {
+        for (n = 0; n < CC2520_SRC_EXT_ENTRIES; n++) {
+            if (cc2520ll_srcShortFree(2 * n) && cc2520ll_srcShortFree(2 * n + 1))
+                break;
+        }
+        if (n == CC2520_SRC_EXT_ENTRIES)
+            return CC2520_SRC_NONE;
+
+        // Stored least significant byte first
+        pEntry = &srcTable[n * CC2520_SRC_EXT_LEN];
+        for (i = 0; i < CC2520_SRC_EXT_LEN; i++) {
+            pEntry[i] = pExtAddr[CC2520_SRC_EXT_LEN - 1 - i];
+        }
+        CC2520_MEMWR(CC2520_RAM_SRCTABLEBASE + n * CC2520_SRC_EXT_LEN, CC2520_SRC_EXT_LEN, pEntry);
+        extEn |= CC2520_SRC_EXT_BV(n);
+        CC2520_REGWR24(CC2520_SRCEXTEN0, extEn);
+    }
+    cc2520ll_srcSetPending(TRUE, n, pending);
+    return n;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcRemoveShort
+*
+* @brief   Remove a short address entry. The table RAM is left as is; clearing
+*          the enable bit is enough for the radio to ignore it.
+*
+* @param   uint16_t panId
+*          uint16_t shortAddr
+*
+* @return  uint8_t - SUCCESS, or FAILED if the entry was not found
+*/
+uint8_t cc2520ll_srcRemoveShort(uint16_t panId, uint16_t shortAddr)
+{
+    uint8_t n;
+
+    n = cc2520ll_srcFindShort(panId, shortAddr);
+    if (n == CC2520_SRC_NONE)
+        return FAILED;
+    cc2520ll_srcSetPending(FALSE, n, FALSE);
+    shortEn &= ~CC2520_SRC_SHORT_BV(n);
+    CC2520_REGWR24(CC2520_SRCSHORTEN0, shortEn);
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcRemoveExt
+*
+* @brief   Remove an extended address entry
+*
+* @param   const uint8_t *pExtAddr - extended address, most significant byte first
+*
+* @return  uint8_t - SUCCESS, or FAILED if the entry was not found
+*/
+uint8_t cc2520ll_srcRemoveExt(const uint8_t *pExtAddr)
+{
+    uint8_t n;
+
+    n = cc2520ll_srcFindExt(pExtAddr);
+    if (n == CC2520_SRC_NONE)
+        return FAILED;
+    cc2520ll_srcSetPending(TRUE, n, FALSE);
+    extEn &= ~CC2520_SRC_EXT_BV(n);
+    CC2520_REGWR24(CC2520_SRCEXTEN0, extEn);
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcSetFilter
+*
+* @brief   With the filter on, frames whose source is not in the table are
+*          dropped in the RX interrupt instead of reaching the ring buffer
+*
+* @param   uint8_t enable
+*
+* @return  none
+*/
+void cc2520ll_srcSetFilter(uint8_t enable)
+{
+    srcFilter = enable;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcAddrPos
+*
+* @brief   Where the source address of a received frame starts
+*
+* @param   const uint8_t *pMpdu - PHR and MPDU as read from the RX FIFO
+*          uint16_t *pPanId - source PAN ID, filled in
+*
+* @return  uint8_t - index of the address in pMpdu, 0 if the frame has no
+*          short or extended source address or is too short to hold it
+*/
+uint8_t cc2520ll_srcAddrPos(const uint8_t *pMpdu, uint16_t *pPanId)
+{
+    uint8_t dstMode, srcMode, i;
+
+    // Addressing fields follow the PHR, the FCF and the sequence number
+    dstMode = (pMpdu[2] >> 2) & 0x03;
+    srcMode = (pMpdu[2] >> 6) & 0x03;
+    if (srcMode != CC2520_SRC_MODE_SHORT && srcMode != CC2520_SRC_MODE_EXT)
+        return 0;
+    i = 4;
+    *pPanId = pMpdu[i] | (pMpdu[i + 1] << 8);
+    if (dstMode != 0) {
+        i += 2 + (dstMode == CC2520_SRC_MODE_EXT ? CC2520_SRC_EXT_LEN : 2);
+    }
+    if (!(pMpdu[1] & CC2520_FCF_PANID_COMP_BM_L)) {
+        *pPanId = pMpdu[i] | (pMpdu[i + 1] << 8);
+        i += 2;
+    }
+    if (i + (srcMode == CC2520_SRC_MODE_SHORT ? 2 : CC2520_SRC_EXT_LEN) - 1 > pMpdu[0])
+        return 0;
+    return i;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_srcAccept
+*
+* @brief   Filter decision for a received frame, looked up in the MCU copy of
+*          the table (no SPI access). The radio's match result only describes
+*          the newest frame, so it cannot be used once several frames are
+*          read per interrupt. Frames without a source address pass.
+*
+* @param   const uint8_t *pMpdu - PHR and MPDU as read from the RX FIFO
+*
+* @return  uint8_t - TRUE if the frame should be kept
+*/
+uint8_t cc2520ll_srcAccept(const uint8_t *pMpdu)
+{
+    uint8_t extAddr[CC2520_SRC_EXT_LEN];
+    uint8_t srcMode, i, n;
+    uint16_t panId;
+
+    if (!srcFilter)
+        return TRUE;
+
+    srcMode = (pMpdu[2] >> 6) & 0x03;
+    if (srcMode != CC2520_SRC_MODE_SHORT && srcMode != CC2520_SRC_MODE_EXT)
+        return TRUE;
+    i = cc2520ll_srcAddrPos(pMpdu, &panId);
+    if (i == 0)
+        return FALSE;
+    if (srcMode == CC2520_SRC_MODE_SHORT)
+        return cc2520ll_srcFindShort(panId, pMpdu[i] | (pMpdu[i + 1] << 8)) != CC2520_SRC_NONE;
+    // Over the air the address is least significant byte first
+    for (n = 0; n < CC2520_SRC_EXT_LEN; n++) {
+        extAddr[n] = pMpdu[i + CC2520_SRC_EXT_LEN - 1 - n];
+    }
+    return cc2520ll_srcFindExt(extAddr) != CC2520_SRC_NONE;
+}
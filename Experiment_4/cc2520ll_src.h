@@ -0,0 +1,50 @@
+#ifndef CC2520LL_SRC_H_
+#define CC2520LL_SRC_H_
+
+#include <inttypes.h>
+#include "cc2520ll.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Source address table at CC2520_RAM_SRCTABLEBASE: 24 short entries (PAN ID,
+// short address) or 12 extended entries. Extended entry n takes the room of
+// short entries 2n and 2n+1.
+#define CC2520_SRC_SHORT_ENTRIES          24
+#define CC2520_SRC_EXT_ENTRIES            12
+#define CC2520_SRC_SHORT_LEN              4
+#define CC2520_SRC_EXT_LEN                8
+#define CC2520_SRC_TABLE_LEN              (CC2520_SRC_SHORT_ENTRIES * CC2520_SRC_SHORT_LEN)
+#define CC2520_SRC_NONE                   0xFF
+
+// Enable and pending masks: bit n for short entry n, bits 2n and 2n+1 for
+// extended entry n
+#define CC2520_SRC_SHORT_BV(n)            (1UL << (n))
+#define CC2520_SRC_EXT_BV(n)              (3UL << (2 * (n)))
+
+// Addressing modes in the frame control field, and PAN ID compression
+#define CC2520_SRC_MODE_SHORT             0x02
+#define CC2520_SRC_MODE_EXT               0x03
+#define CC2520_FCF_PANID_COMP_BM_L        0x40
+
+// SRCMATCH
+#define CC2520_SRCMATCH_EN_BM             0x01
+#define CC2520_SRCMATCH_AUTOPEND_BM       0x02
+#define CC2520_SRCMATCH_PEND_DATAREQ_BM   0x04
+
+/* External functions */
+
+void cc2520ll_srcInit(void);
+uint8_t cc2520ll_srcAddShort(uint16_t panId, uint16_t shortAddr, uint8_t pending);
+uint8_t cc2520ll_srcAddExt(const uint8_t *pExtAddr, uint8_t pending);
+uint8_t cc2520ll_srcRemoveShort(uint16_t panId, uint16_t shortAddr);
+uint8_t cc2520ll_srcRemoveExt(const uint8_t *pExtAddr);
+uint8_t cc2520ll_srcFindShort(uint16_t panId, uint16_t shortAddr);
+uint8_t cc2520ll_srcFindExt(const uint8_t *pExtAddr);
+uint8_t cc2520ll_srcSetPending(uint8_t ext, uint8_t index, uint8_t pending);
+void cc2520ll_srcSetFilter(uint8_t enable);
+uint8_t cc2520ll_srcAddrPos(const uint8_t *pMpdu, uint16_t *pPanId);
+uint8_t cc2520ll_srcAccept(const uint8_t *pMpdu);
+
+#endif /*CC2520LL_SRC_H_*/
@@ -0,0 +1,746 @@
+#include <string.h>
+#include "cc2520ll_tsch.h"
+#include "cc2520ll_src.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Slot template in ticks from the slot start. The sender strobes STXON one
+// turnaround before the TX offset; its SFD follows the SHR later. The
+// receiver wakes early enough for the crystal to start and RX to be on half
+// a guard time before the TX offset, closes the window half a guard time
+// after the expected SFD, and otherwise stays for the longest frame and
+// its ACK.
+#define TSCH_SLOT_TICKS         RTIMER_US_TO_TICKS(CC2520_TSCH_SLOT_US)
+#define TSCH_TX_TICKS           RTIMER_US_TO_TICKS(CC2520_TSCH_TX_OFFSET_US - CC2520_TX_TURNAROUND_US)
+#define TSCH_SFD_TICKS          (TSCH_TX_TICKS + RTIMER_US_TO_TICKS(CC2520_TX_TURNAROUND_US + CC2520_SHR_US))
+#define TSCH_GUARD_TICKS        RTIMER_US_TO_TICKS(CC2520_TSCH_GUARD_US / 2)
+#define TSCH_RXON_TICKS         RTIMER_US_TO_TICKS(CC2520_TSCH_TX_OFFSET_US - CC2520_TSCH_GUARD_US / 2 - \
+                                    CC2520_TX_TURNAROUND_US - CC2520_XOSC_MAX_STARTUP_TIME)
+#define TSCH_RXCHECK_TICKS      (TSCH_SFD_TICKS + TSCH_GUARD_TICKS)
+#define TSCH_RXEND_TICKS        (TSCH_RXCHECK_TICKS + \
+                                    RTIMER_US_TO_TICKS(CC2520_TX_TIME_US(MAX_802154_PACKET_SIZE) + CC2520_ACK_WAIT_US))
+
+#define TSCH_MHR_LEN            (CC2520_HDR_SIZE - 1)
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static const uint8_t tschDefaultHopping[] = CC2520_TSCH_HOPPING;
+static cc2520ll_tschCfg_t tschCfg;
+static uint8_t tschHopping[CC2520_TSCH_HOP_MAX];
+static cc2520ll_tschCell_t tschCells[CC2520_TSCH_CELLS];
+static uint8_t tschNumCells;
+static cc2520ll_tschStats_t tschStats;
+static uint8_t tschOn, tschRadioOn;
+static volatile uint8_t tschInSync;
+static uint8_t tschJoinChannel;         // Channel to listen for EBs on
+static uint32_t tschRadioAt;            // Last radio on/off switch
+
+// Current slot: its ASN and local start time, rtimer_now32() ticks
+static uint32_t tschAsn, tschSlotStart;
+static uint32_t tschLastSync;           // ASN of the last time correction
+static uint32_t tschFrame;              // Slotframe number, for the EB period
+
+// Slot in progress
+static uint8_t tschSlotRx;              // RX window open: frames correct the time
+static uint8_t tschSlotShared;
+static uint8_t tschSlotPkt;             // Queue entry sent, CC2520_TSCH_NONE for an EB
+static uint8_t tschSlotChannel;
+static uint16_t tschRxCount;
+
+// Queued frames, oldest first in tschOrder
+static cc2520ll_tschPacket_t tschQueue[CC2520_TSCH_QUEUE];
+static uint8_t tschOrder[CC2520_TSCH_QUEUE];
+static volatile uint8_t tschQueueCount;
+static uint8_t tschBe, tschBackoff;     // Shared cells to skip after a failure
+static uint8_t tschEbDue;
+static uint8_t tschEb[TSCH_MHR_LEN + CC2520_TSCH_EB_LEN];
+
+/***********************************************************************************
+* @fn      cc2520ll_tschRxFrames
+*
+* @brief   Frames taken from the RX FIFO since cc2520ll_init(), ACKs included
+*/
+static uint16_t cc2520ll_tschRxFrames(void)
+{
+    cc2520ll_rxStats_t rxStats;
+
+    cc2520ll_getRxStats(&rxStats);
+    return rxStats.frames;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschAccount
+*
+* @brief   Add the time since the last switch to the on or off counter
+*/
+static void cc2520ll_tschAccount(void)
+{
+    uint32_t now = rtimer_now32();
+
+    if (tschRadioOn)
+        tschStats.onTicks += now - tschRadioAt;
+    else
+        tschStats.offTicks += now - tschRadioAt;
+    tschRadioAt = now;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschRadioUp
+*
+* @brief   Leave LPM1 with the receiver on, unless already there
+*
+* @return  uint8_t - SUCCESS, or FAILED if the crystal did not start
+*/
+static uint8_t cc2520ll_tschRadioUp(void)
+{
+    if (tschRadioOn)
+        return SUCCESS;
+    if (cc2520ll_exit_lpm1() == FAILED)
+        return FAILED;
+    cc2520ll_tschAccount();
+    tschRadioOn = TRUE;
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschRadioDown
+*
+* @brief   Enter LPM1, unless the radio is still busy (it then stays on
+*          until the next slot)
+*/
+static void cc2520ll_tschRadioDown(void)
+{
+    if (!tschRadioOn)
+        return;
+    if (cc2520ll_enter_lpm1() == FAILED)
+        return;
+    cc2520ll_tschAccount();
+    tschRadioOn = FALSE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschTune
+*
+* @brief   Switch the receiver to a channel. The synthesizer takes the new
+*          frequency at SRXON, so RSSI and CCA are valid for it one
+*          turnaround and 8 symbols later. FREQCTRL and SRXON go out under
+*          one bus lock.
+*/
+static void cc2520ll_tschTune(uint8_t channel)
+{
+    unsigned short istate;
+
+    CC2520_SPI_LOCK(istate);
+    cc2520ll_setChannel(channel);
+    cc2520ll_receiveOn();
+    CC2520_SPI_UNLOCK(istate);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschListen
+*
+* @brief   Receiver on at the join channel, as when TSCH is not running
+*/
+static void cc2520ll_tschListen(void)
+{
+    cc2520ll_tschRadioUp();
+    cc2520ll_tschTune(tschJoinChannel);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschChannel
+*
+* @brief   Channel of a cell in the current slot
+*/
+static uint8_t cc2520ll_tschChannel(uint8_t channelOffset)
+{
+    return tschHopping[(tschAsn + channelOffset) % tschCfg.hopLen];
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschCellAt
+*
+* @brief   Is there a cell at this slot offset?
+*/
+static uint8_t cc2520ll_tschCellAt(uint16_t slotOffset)
+{
+    uint8_t i;
+
+    for (i = 0; i < tschNumCells; i++) {
+        if (tschCells[i].slotOffset == slotOffset)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschPick
+*
+* @brief   Oldest queued frame a TX cell may carry
+*
+* @return  uint8_t - queue entry, CC2520_TSCH_NONE if there is none
+*/
+static uint8_t cc2520ll_tschPick(const cc2520ll_tschCell_t *pCell)
+{
+    uint8_t i;
+
+    for (i = 0; i < tschQueueCount; i++) {
+        if (pCell->neighbor == CC2520_TSCH_ANY || tschQueue[tschOrder[i]].dst == pCell->neighbor)
+            return tschOrder[i];
+    }
+    return CC2520_TSCH_NONE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschRemove
+*
+* @brief   Take a frame out of the queue
+*/
+static void cc2520ll_tschRemove(uint8_t entry)
+{
+    uint8_t i;
+
+    for (i = 0; i < tschQueueCount && tschOrder[i] != entry; i++);
+    for (; i + 1 < tschQueueCount; i++) {
+        tschOrder[i] = tschOrder[i + 1];
+    }
+    tschQueueCount--;
+    tschQueue[entry].len = 0;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschSchedule
+*
+* @brief   Timer callback at the end of a slot's work: radio to LPM1 and the
+*          timer to the start of the next slot that has a cell, at most
+*          CC2520_TSCH_MAX_SKIP slots ahead. A node that has not corrected
+*          its time for too long goes back to listening for an EB.
+*/
+static void cc2520ll_tschSlot(void);
+static void cc2520ll_tschSchedule(void)
+{
+    uint32_t now;
+    uint8_t n = 0;
+
+    tschSlotRx = FALSE;
+    if (!tschOn) {
+        cc2520ll_tschListen();
+        return;
+    }
+    if (tschCfg.timeSource != CC2520_TSCH_ROOT && tschAsn - tschLastSync > CC2520_TSCH_DESYNC_SLOTS) {
+        tschInSync = FALSE;
+        tschStats.desyncs++;
+        cc2520ll_tschListen();
+        return;
+    }
+    cc2520ll_tschRadioDown();
+    now = rtimer_now32();
+    do {
+        tschAsn++;
+        tschSlotStart += TSCH_SLOT_TICKS;
+        n++;
+    } while ((int32_t)(tschSlotStart - now) <= 0 || \
+        (n < CC2520_TSCH_MAX_SKIP && !cc2520ll_tschCellAt(tschAsn % tschCfg.slotframeLen)));
+    rtimer_set(RTIMER_TSCH, (rtimer_clock_t)tschSlotStart, cc2520ll_tschSlot);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschTxDone
+*
+* @brief   Transmission callback. A frame leaves the queue once acknowledged
+*          (sent, if it asks for no ACK) or after CC2520_TSCH_MAX_RETRIES
+*          retries. A failure in a shared cell doubles the backoff window,
+*          a success closes it. An EB is tried once per period, so a busy
+*          channel does not hold back the frames behind it.
+*
+* @param   uint8_t status - CC2520_TX_xxx
+*
+* @return  none
+*/
+static void cc2520ll_tschTxDone(uint8_t status)
+{
+    cc2520ll_tschPacket_t *pPkt;
+    cc2520ll_txCallback_t callback = NULL;
+    uint8_t done = FALSE;
+
+    if (status == CC2520_TX_CHANNEL_BUSY)
+        tschStats.txBusy++;
+    if (tschSlotPkt == CC2520_TSCH_NONE) {
+        tschEbDue = FALSE;
+        if (status == CC2520_TX_OK)
+            tschStats.ebSent++;
+    } else {
+        pPkt = &tschQueue[tschSlotPkt];
+        if (status == CC2520_TX_OK) {
+            tschStats.txOk++;
+            if (tschSlotShared) {
+                tschBe = CC2520_TSCH_MIN_BE;
+                tschBackoff = 0;
+            }
+            done = TRUE;
+        } else {
+            if (status == CC2520_TX_NOACK)
+                tschStats.txNoAck++;
+            if (tschSlotShared) {
+                tschBackoff = CC2520_RANDOM8() & ((1 << tschBe) - 1);
+                if (tschBe < CC2520_TSCH_MAX_BE)
+                    tschBe++;
+            }
+            if (++pPkt->retries > CC2520_TSCH_MAX_RETRIES) {
+                tschStats.dropped++;
+                done = TRUE;
+            }
+        }
+        if (done) {
+            callback = pPkt->callback;
+            cc2520ll_tschRemove(tschSlotPkt);
+        }
+    }
+    cc2520ll_tschSchedule();
+    if (callback)
+        callback(status);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschTxGo
+*
+* @brief   Timer callback one turnaround before the TX offset: send the frame
+*          loaded at the slot start, without CCA in a dedicated cell
+*/
+static void cc2520ll_tschTxGo(void)
+{
+    // STXON or STXONCCA under the bus lock of cc2520ll_transmitSlot().
+    // Refused: the transmitter is still busy, or the receiver is off
+    if (cc2520ll_transmitSlot(cc2520ll_tschTxDone, tschSlotShared) == FAILED)
+        cc2520ll_tschTxDone(cc2520ll_txBusy() ? CC2520_TX_CHANNEL_BUSY : CC2520_TX_RADIO_OFF);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschRxCheck
+*
+* @brief   Timer callback at the end of the guard time: stay for the frame
+*          if one started, else close the slot
+*/
+static void cc2520ll_tschRxCheck(void)
+{
+    if (cc2520ll_tschRxFrames() != tschRxCount || !cc2520ll_idle()) {
+        rtimer_set(RTIMER_TSCH, (rtimer_clock_t)(tschSlotStart + TSCH_RXEND_TICKS), cc2520ll_tschSchedule);
+    } else {
+        tschStats.rxIdle++;
+        cc2520ll_tschSchedule();
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschRxOn
+*
+* @brief   Timer callback before the guard time: receiver on at the channel
+*          of the cell
+*/
+static void cc2520ll_tschRxOn(void)
+{
+    if (cc2520ll_tschRadioUp() == FAILED) {
+        cc2520ll_tschSchedule();
+        return;
+    }
+    cc2520ll_tschTune(tschSlotChannel);
+    tschRxCount = cc2520ll_tschRxFrames();
+    tschSlotRx = TRUE;
+    rtimer_set(RTIMER_TSCH, (rtimer_clock_t)(tschSlotStart + TSCH_RXCHECK_TICKS), cc2520ll_tschRxCheck);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschEbLoad
+*
+* @brief   Build the EB of the current slot
+*/
+static void cc2520ll_tschEbLoad(void)
+{
+    uint16_t panId = CC2520_MEMRD16(CC2520_RAM_PANID);
+    uint16_t myId = CC2520_MEMRD16(CC2520_RAM_SHORTADDR);
+
+    tschEb[0] = CC2520_FCF_NOACK_L;
+    tschEb[1] = HI_UINT16(CC2520_FCF_NOACK);
+    tschEb[2] = cc2520ll_nextSeq();
+    tschEb[3] = LO_UINT16(panId);
+    tschEb[4] = HI_UINT16(panId);
+    tschEb[5] = 0xFF;
+    tschEb[6] = 0xFF;
+    tschEb[7] = LO_UINT16(myId);
+    tschEb[8] = HI_UINT16(myId);
+    tschEb[TSCH_MHR_LEN] = CC2520_TSCH_DISPATCH_EB;
+    tschEb[TSCH_MHR_LEN + 1] = (uint8_t)tschAsn;
+    tschEb[TSCH_MHR_LEN + 2] = (uint8_t)(tschAsn >> 8);
+    tschEb[TSCH_MHR_LEN + 3] = (uint8_t)(tschAsn >> 16);
+    tschEb[TSCH_MHR_LEN + 4] = (uint8_t)(tschAsn >> 24);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschSlot
+*
+* @brief   Timer callback at the slot start. A TX cell with a frame for its
+*          neighbor wins (in a shared cell, a due EB first, and a frame only
+*          once the backoff is over); the frame is loaded now and sent at
+*          the TX offset. Otherwise an RX cell opens its window, or the slot
+*          is skipped. The radio is woken, retuned and loaded under one bus
+*          lock, so no other handler touches it in between.
+*/
+static void cc2520ll_tschSlot(void)
+{
+    cc2520ll_tschCell_t *pCell, *pTx = NULL, *pRx = NULL;
+    uint16_t slotOffset = tschAsn % tschCfg.slotframeLen;
+    uint32_t frame = tschAsn / tschCfg.slotframeLen;
+    uint8_t i, pkt = CC2520_TSCH_NONE, eb = FALSE, shared;
+    unsigned short istate;
+    int r = FAILED;
+
+    tschStats.asn = tschAsn;
+    if (frame != tschFrame) {
+        tschFrame = frame;
+        if (tschCfg.ebPeriod && frame % tschCfg.ebPeriod == 0)
+            tschEbDue = TRUE;
+    }
+    for (i = 0; i < tschNumCells && !pTx; i++) {
+        pCell = &tschCells[i];
+        if (pCell->slotOffset != slotOffset)
+            continue;
+        shared = (pCell->options & CC2520_TSCH_SHARED) != 0;
+        if (pCell->options & CC2520_TSCH_TX) {
+            if (shared && tschEbDue) {
+                eb = TRUE;
+                pTx = pCell;
+            } else if ((pkt = cc2520ll_tschPick(pCell)) != CC2520_TSCH_NONE) {
+                if (shared && tschBackoff) {
+                    tschBackoff--;
+                    pkt = CC2520_TSCH_NONE;
+                } else {
+                    pTx = pCell;
+                }
+            }
+        }
+        if (!pTx && !pRx && (pCell->options & CC2520_TSCH_RX))
+            pRx = pCell;
+    }
+
+    if (pTx) {
+        CC2520_SPI_LOCK(istate);
+        if (cc2520ll_tschRadioUp() == SUCCESS) {
+            cc2520ll_tschTune(cc2520ll_tschChannel(pTx->channelOffset));
+            if (eb) {
+                cc2520ll_tschEbLoad();
+                r = cc2520ll_prepare(tschEb, sizeof(tschEb));
+            } else {
+                r = cc2520ll_prepare(tschQueue[pkt].mpdu, tschQueue[pkt].len);
+            }
+        }
+        CC2520_SPI_UNLOCK(istate);
+        if (r == FAILED) {
+            cc2520ll_tschSchedule();
+            return;
+        }
+        tschSlotPkt = pkt;
+        tschSlotShared = (pTx->options & CC2520_TSCH_SHARED) != 0;
+        if (tschSlotShared)
+            tschStats.txShared++;
+        else
+            tschStats.txDedicated++;
+        rtimer_set(RTIMER_TSCH, (rtimer_clock_t)(tschSlotStart + TSCH_TX_TICKS), cc2520ll_tschTxGo);
+    } else if (pRx) {
+        tschSlotChannel = cc2520ll_tschChannel(pRx->channelOffset);
+        rtimer_set(RTIMER_TSCH, (rtimer_clock_t)(tschSlotStart + TSCH_RXON_TICKS), cc2520ll_tschRxOn);
+    } else {
+        cc2520ll_tschSchedule();
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschStart
+*
+* @brief   Start time-slotted access, after cc2520ll_init() and with the
+*          cells added. The root starts the ASN at 0 now; the other nodes
+*          listen on the current channel until an EB of their time source
+*          comes. Received frames are acknowledged by the radio (AUTOACK).
+*          The radio must not be used directly, other than through
+*          cc2520ll_tschSend(), while TSCH runs. The queue starts empty.
+*
+* @param   const cc2520ll_tschCfg_t *pCfg
+*
+* @return  int - SUCCESS, or FAILED if already running or the slotframe or
+*          hopping sequence is empty or too long
+*/
+int cc2520ll_tschStart(const cc2520ll_tschCfg_t *pCfg)
+{
+    const uint8_t *pHopping = pCfg->pHopping ? pCfg->pHopping : tschDefaultHopping;
+    uint8_t i;
+
+    if (tschOn || pCfg->slotframeLen == 0 || pCfg->hopLen == 0 || pCfg->hopLen > CC2520_TSCH_HOP_MAX)
+        return FAILED;
+    tschCfg = *pCfg;
+    for (i = 0; i < tschCfg.hopLen; i++) {
+        tschHopping[i] = pHopping[i];
+    }
+    tschJoinChannel = cc2520ll_getChannel();
+    cc2520ll_setAutoAck(TRUE);
+
+    _disable_interrupts();
+    for (i = 0; i < CC2520_TSCH_QUEUE; i++) {
+        tschQueue[i].len = 0;
+    }
+    tschQueueCount = 0;
+    tschBe = CC2520_TSCH_MIN_BE;
+    tschBackoff = 0;
+    memset(&tschStats, 0, sizeof(tschStats));
+    tschOn = tschRadioOn = TRUE;
+    tschRadioAt = rtimer_now32();
+    if (tschCfg.timeSource == CC2520_TSCH_ROOT) {
+        tschAsn = tschLastSync = 0;
+        tschFrame = 0;
+        tschSlotStart = tschRadioAt;
+        tschEbDue = tschCfg.ebPeriod != 0;
+        tschInSync = TRUE;
+        cc2520ll_tschSchedule();
+    } else {
+        tschEbDue = FALSE;
+        tschInSync = FALSE;
+        cc2520ll_tschListen();
+    }
+    _enable_interrupts();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschStop
+*
+* @brief   Stop time-slotted access and leave the receiver on at the join
+*          channel. A transmission in progress completes; queued frames are
+*          kept but not sent.
+*
+* @param   none
+*
+* @return  none
+*/
+void cc2520ll_tschStop(void)
+{
+    _disable_interrupts();
+    tschOn = FALSE;
+    tschInSync = FALSE;
+    if (!cc2520ll_txBusy()) {
+        rtimer_cancel(RTIMER_TSCH);
+        cc2520ll_tschListen();
+    }
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschAddCell
+*
+* @brief   Add a cell to the slotframe. Several cells may share a slot
+*          offset; a TX cell with a frame to send wins over an RX cell.
+*
+* @param   const cc2520ll_tschCell_t *pCell
+*
+* @return  int - SUCCESS, or FAILED if the table is full
+*/
+int cc2520ll_tschAddCell(const cc2520ll_tschCell_t *pCell)
+{
+    if (tschNumCells >= CC2520_TSCH_CELLS)
+        return FAILED;
+    _disable_interrupts();
+    tschCells[tschNumCells++] = *pCell;
+    _enable_interrupts();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschRemoveCell
+*
+* @brief   Remove the cells at a slot offset with a neighbor
+*
+* @param   uint16_t slotOffset
+*          uint16_t neighbor - short address, CC2520_TSCH_ANY
+*
+* @return  int - SUCCESS, or FAILED if there was no such cell
+*/
+int cc2520ll_tschRemoveCell(uint16_t slotOffset, uint16_t neighbor)
+{
+    uint8_t i, n = 0;
+
+    _disable_interrupts();
+    for (i = 0; i < tschNumCells; i++) {
+        if (tschCells[i].slotOffset != slotOffset || tschCells[i].neighbor != neighbor)
+            tschCells[n++] = tschCells[i];
+    }
+    i = tschNumCells != n;
+    tschNumCells = n;
+    _enable_interrupts();
+    return i ? SUCCESS : FAILED;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschSend
+*
+* @brief   Queue a frame. It goes out in the next TX cell for its short
+*          destination (or a cell for any neighbor), and is retried in later
+*          cells until acknowledged. Frames to one neighbor keep their
+*          order. Not for interrupt context.
+*
+* @param   const void *packet - MPDU without FCS, copied
+*          uint8_t len - number of bytes
+*          cc2520ll_txCallback_t callback - outcome, CC2520_TX_xxx, from
+*          interrupt context; NULL if not needed
+*
+* @return  int - SUCCESS, or FAILED if the frame is too long or the queue full
+*/
+int cc2520ll_tschSend(const void *packet, uint8_t len, cc2520ll_txCallback_t callback)
+{
+    const uint8_t *pHdr = (const uint8_t*)packet;
+    cc2520ll_tschPacket_t *pPkt = NULL;
+    uint8_t i;
+
+    if (len < 3 || len > sizeof(pPkt->mpdu))
+        return FAILED;
+
+    // Take a free entry; the copy is made outside the critical section
+    _disable_interrupts();
+    for (i = 0; i < CC2520_TSCH_QUEUE && !pPkt; i++) {
+        if (tschQueue[i].len == 0)
+            pPkt = &tschQueue[i];
+    }
+    if (!pPkt) {
+        _enable_interrupts();
+        return FAILED;
+    }
+    pPkt->len = len;
+    _enable_interrupts();
+    for (i = 0; i < len; i++) {
+        pPkt->mpdu[i] = pHdr[i];
+    }
+    if (((pHdr[1] >> 2) & 0x03) == CC2520_SRC_MODE_SHORT && len >= 7)
+        pPkt->dst = pHdr[5] | ((uint16_t)pHdr[6] << 8);
+    else
+        pPkt->dst = 0xFFFE;
+    pPkt->retries = 0;
+    pPkt->callback = callback;
+
+    _disable_interrupts();
+    tschOrder[tschQueueCount++] = pPkt - tschQueue;
+    _enable_interrupts();
+    return SUCCESS;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschQueued
+*
+* @brief   Frames waiting for a cell, the one being sent included
+*
+* @return  uint8_t
+*/
+uint8_t cc2520ll_tschQueued(void)
+{
+    return tschQueueCount;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschSynced
+*
+* @brief   Does the node follow the slots of the network?
+*
+* @return  uint8_t - TRUE for the root, and for a node that has joined
+*/
+uint8_t cc2520ll_tschSynced(void)
+{
+    return tschInSync;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschAsn
+*
+* @brief   Absolute slot number of the current (or last active) slot
+*
+* @return  uint32_t
+*/
+uint32_t cc2520ll_tschAsn(void)
+{
+    return tschAsn;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschGetStats
+*
+* @brief   Copy the TSCH counters. The radio on and off times give the duty
+*          cycle.
+*
+* @param   cc2520ll_tschStats_t *pStats
+*
+* @return  none
+*/
+void cc2520ll_tschGetStats(cc2520ll_tschStats_t *pStats)
+{
+    _disable_interrupts();
+    cc2520ll_tschAccount();
+    *pStats = tschStats;
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tschRxFrame
+*
+* @brief   Take the time from a frame of the time source: join on its EB, or
+*          move the slot edges by how far its SFD was off the expected time.
+*          Called from interrupt context.
+*
+* @param   const cc2520ll_frame_t *pFrame
+*
+* @return  none
+*/
+void cc2520ll_tschRxFrame(const cc2520ll_frame_t *pFrame)
+{
+    const uint8_t *pMpdu = pFrame->mpdu;
+    const uint8_t *pEb = &pMpdu[CC2520_HDR_SIZE];
+    uint16_t panId;
+    int32_t drift;
+    uint32_t us;
+    uint8_t i;
+
+    if (!tschOn)
+        return;
+    if (tschSlotRx)
+        tschStats.rxFrames++;
+    if (tschCfg.timeSource == CC2520_TSCH_ROOT || !pFrame->sfdValid || \
+        ((pMpdu[2] >> 6) & 0x03) != CC2520_SRC_MODE_SHORT)
+        return;
+    i = cc2520ll_srcAddrPos(pMpdu, &panId);
+    if (!i || (pMpdu[i] | ((uint16_t)pMpdu[i + 1] << 8)) != tschCfg.timeSource)
+        return;
+
+    if (!tschInSync) {
+        // EB: data frame, short addresses, PAN ID compression
+        if ((pMpdu[1] & ~CC2520_FCF_ACK_BM_L) != CC2520_FCF_NOACK_L || \
+            pMpdu[2] != HI_UINT16(CC2520_FCF_NOACK) || \
+            pMpdu[0] < CC2520_HDR_SIZE + CC2520_TSCH_EB_LEN - 1 + CC2520_FOOTER_SIZE || \
+            pEb[0] != CC2520_TSCH_DISPATCH_EB)
+            return;
+        tschAsn = pEb[1] | ((uint32_t)pEb[2] << 8) | ((uint32_t)pEb[3] << 16) | ((uint32_t)pEb[4] << 24);
+        tschSlotStart = pFrame->sfdTime - TSCH_SFD_TICKS;
+        tschLastSync = tschAsn;
+        tschFrame = tschAsn / tschCfg.slotframeLen;
+        tschInSync = TRUE;
+        tschStats.syncs++;
+        // The slots start once the RX interrupt is done
+        rtimer_set(RTIMER_TSCH, rtimer_now(), cc2520ll_tschSchedule);
+    } else if (tschSlotRx) {
+        drift = (int32_t)(pFrame->sfdTime - (tschSlotStart + TSCH_SFD_TICKS));
+        if (drift > (int32_t)TSCH_GUARD_TICKS || drift < -(int32_t)TSCH_GUARD_TICKS)
+            return;
+        tschSlotStart += drift;
+        tschLastSync = tschAsn;
+        tschStats.syncs++;
+        us = RTIMER_TICKS_TO_US(drift < 0 ? -drift : drift);
+        tschStats.lastDrift = drift < 0 ? -(int16_t)us : (int16_t)us;
+        if (us > tschStats.maxDrift)
+            tschStats.maxDrift = us;
+    }
+}
@@ -0,0 +1,150 @@
+#ifndef CC2520LL_TSCH_H_
+#define CC2520LL_TSCH_H_
+
+#include <inttypes.h>
+#include "cc2520ll.h"
+#include "rtimer.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Time-slotted channel hopping after IEEE 802.15.4e TSCH. Time is cut into
+// slots numbered by the absolute slot number (ASN) every node shares, and a
+// slotframe of slotframeLen slots repeats. Cells of the slotframe (slot
+// offset, channel offset) are given to links. A dedicated cell belongs to
+// one sender, which sends at once with STXON. A shared cell is open to
+// every node: a sender makes one CCA and, after a failure, skips a random
+// number of shared cells. The channel of a cell is entry (ASN + channel
+// offset) of the hopping sequence, so it changes from slotframe to
+// slotframe.
+//
+// A frame goes on air CC2520_TSCH_TX_OFFSET_US into its slot. The receiver
+// listens from half a guard time before that to half a guard time after,
+// and sleeps through the rest of the slot if nothing came. Each frame heard
+// from the time source neighbor moves the local slot edges by the
+// difference between its SFD time and the expected one. The root (PAN
+// coordinator) keeps its own time; other nodes join on an enhanced beacon
+// (EB) from their time source, heard on the channel set with
+// cc2520ll_setChannel(). Synchronised nodes send EBs in shared cells every
+// ebPeriod slotframes. A slotframe length prime to the hopping sequence
+// length moves the EBs over every channel.
+//
+// Time is only corrected from frames of the time source heard in RX cells,
+// data frames and EBs alike. The radio's automatic ACKs carry no time
+// correction IE, so frames sent to the time source and acknowledged by it
+// do not keep a node in sync. A node that only sends upstream needs an RX
+// cell the time source sends in, for instance a shared cell with
+// CC2520_TSCH_RX that hears its EBs (every ebPeriod slotframes, well within
+// CC2520_TSCH_DESYNC_SLOTS); otherwise it loses sync and rejoins every
+// CC2520_TSCH_DESYNC_SLOTS slots.
+//
+// SFD times come from the timer capture of the SFD pin. With INCLUDE_PA
+// (the default) GPIO3 drives the CC2590 and the time of a received SFD is
+// reckoned back from the clock read in the RX handler. Its error is the time
+// from the end of the frame to that read: interrupt latency and the
+// exception flag and RXFIRST reads, one or two ticks (30.5 us each) on an
+// idle MCU, plus any time other interrupts hold the handler off. The mean of
+// that delay makes every hop's slot edges late by as much; its spread shows
+// in lastDrift and must stay well inside the guard time. A frame read
+// together with a later one gets no time and does not correct. Frames sent
+// are timed from the STXON strobe, exact to a tick.
+//
+// The slot timer is Timer_A1 CCR1, as for low-power listening
+// (cc2520ll_lpl.h): the two do not run together.
+
+// Slot template, us (802.15.4e defaults)
+#define CC2520_TSCH_SLOT_US               10000
+#define CC2520_TSCH_TX_OFFSET_US          2120  // Slot start to the first preamble symbol
+#define CC2520_TSCH_GUARD_US              2200  // RX window around the expected frame
+
+// Defaults
+#define CC2520_TSCH_SLOTFRAME_LEN         17
+#define CC2520_TSCH_EB_PERIOD             4     // Slotframes between EBs
+#define CC2520_TSCH_MAX_RETRIES           4     // Cells a frame is retried in after the first
+#define CC2520_TSCH_MIN_BE                1     // Shared cell backoff exponent
+#define CC2520_TSCH_MAX_BE                5
+#define CC2520_TSCH_DESYNC_SLOTS          1000  // Slots without time correction before rejoining
+
+#define CC2520_TSCH_CELLS                 16
+#define CC2520_TSCH_QUEUE                 8
+#define CC2520_TSCH_HOP_MAX               16
+#define CC2520_TSCH_HOPPING               { 16, 17, 23, 18, 26, 15, 25, 22, 19, 11, 12, 13, 24, 14, 20, 21 }
+// Timer_A1 compares times less than 1 s apart: slots a timer may skip
+#define CC2520_TSCH_MAX_SKIP              64
+
+// Cell options
+#define CC2520_TSCH_TX                    0x01
+#define CC2520_TSCH_RX                    0x02
+#define CC2520_TSCH_SHARED                0x04
+
+#define CC2520_TSCH_ANY                   0xFFFF    // Cell neighbor: every node
+#define CC2520_TSCH_ROOT                  0xFFFF    // Time source of the root
+#define CC2520_TSCH_NONE                  0xFF
+
+// Enhanced beacon, after the MHR: dispatch and ASN
+#define CC2520_TSCH_DISPATCH_EB           0x3E  // 6LoWPAN NALP range, as cc2520ll_tsync
+#define CC2520_TSCH_EB_LEN                5
+
+/***********************************************************************************
+* TYPEDEFS
+*/
+typedef struct {
+    uint16_t slotframeLen;      // Slots per slotframe
+    uint16_t timeSource;        // Short address whose slot edges are followed, CC2520_TSCH_ROOT
+    uint8_t ebPeriod;           // Slotframes between EBs, 0 for none
+    uint8_t hopLen;             // Entries of pHopping, 1 for a single channel
+    const uint8_t *pHopping;    // Hopping sequence, NULL for CC2520_TSCH_HOPPING
+} cc2520ll_tschCfg_t;
+
+typedef struct {
+    uint16_t slotOffset;
+    uint8_t channelOffset;
+    uint8_t options;            // CC2520_TSCH_TX, _RX, _SHARED
+    uint16_t neighbor;          // Short address, CC2520_TSCH_ANY
+} cc2520ll_tschCell_t;
+
+// Queued frame
+typedef struct {
+    uint8_t len;                // MPDU length without FCS, 0 if the entry is free
+    uint8_t retries;
+    uint16_t dst;               // Short destination, 0xFFFE for an extended one
+    cc2520ll_txCallback_t callback;
+    uint8_t mpdu[MAX_802154_PACKET_SIZE - CC2520_FOOTER_SIZE];
+} cc2520ll_tschPacket_t;
+
+typedef struct {
+    uint32_t asn;               // Current slot
+    uint16_t txDedicated;       // Transmissions in dedicated cells
+    uint16_t txShared;          // In shared cells, EBs included
+    uint16_t txOk;
+    uint16_t txNoAck;
+    uint16_t txBusy;            // CCA failures in shared cells
+    uint16_t dropped;           // Frames given up after CC2520_TSCH_MAX_RETRIES
+    uint16_t rxFrames;          // Frames received in RX cells
+    uint16_t rxIdle;            // RX cells closed after the guard time
+    uint16_t ebSent;
+    uint16_t syncs;             // Time corrections and joins
+    uint16_t desyncs;
+    int16_t lastDrift;          // us, last time correction
+    uint16_t maxDrift;          // us, largest one
+    uint32_t onTicks;           // Radio on (XOSC running), Timer_A1 ticks
+    uint32_t offTicks;          // Radio in LPM1
+} cc2520ll_tschStats_t;
+
+/* External functions */
+
+int cc2520ll_tschStart(const cc2520ll_tschCfg_t *pCfg);
+void cc2520ll_tschStop(void);
+int cc2520ll_tschAddCell(const cc2520ll_tschCell_t *pCell);
+int cc2520ll_tschRemoveCell(uint16_t slotOffset, uint16_t neighbor);
+int cc2520ll_tschSend(const void *packet, uint8_t len, cc2520ll_txCallback_t callback);
+uint8_t cc2520ll_tschQueued(void);
+uint8_t cc2520ll_tschSynced(void);
+uint32_t cc2520ll_tschAsn(void);
+void cc2520ll_tschGetStats(cc2520ll_tschStats_t *pStats);
+
+// Called by the RX interrupt for every queued frame
+void cc2520ll_tschRxFrame(const cc2520ll_frame_t *pFrame);
+
+#endif /*CC2520LL_TSCH_H_*/
@@ -0,0 +1,517 @@
+#include <string.h>
+#include "cc2520ll_tsync.h"
+
+#ifndef SECURITY_CCM
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Frame header of the application frames a record is added to, and of beacons
+#define TSYNC_MHR_LEN           (CC2520_HDR_SIZE - 1)
+// Keep sxy << CC2520_TSYNC_SKEW_SHIFT within 63 bits
+#define TSYNC_SXY_MAX           ((int64_t)1 << (62 - CC2520_TSYNC_SKEW_SHIFT))
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static cc2520ll_tsyncCfg_t tsyncCfg;
+static cc2520ll_tsyncStats_t tsyncStats;
+static uint8_t tsyncOn;
+static uint16_t myId;
+static uint16_t rootId;
+static uint8_t seq;
+static uint8_t heartBeats;              // Periods since the root was last heard
+static uint32_t periodStart, periodTicks;
+static uint8_t sentInPeriod;            // A record went out with an application frame
+
+// Regression table: local SFD time and global - local of each record
+static uint32_t entryLocal[CC2520_TSYNC_ENTRIES];
+static int32_t entryOffset[CC2520_TSYNC_ENTRIES];
+static uint8_t entryUsed;               // One bit per entry
+static uint8_t numEntries, numErrors;
+
+// Fitted line, read by the SFD interrupt: global = local + offsetAvg +
+// skew * (local - localAvg)
+static uint32_t localAvg;
+static int32_t offsetAvg;
+static int32_t skew;
+
+// Record received, for cc2520ll_tsyncPoll()
+static volatile uint8_t rxPending;
+static uint16_t rxRoot;
+static uint8_t rxSeq;
+static uint32_t rxGlobal, rxLocal;
+
+// The frame being sent carries a record; global - local time for its SFD
+static volatile uint8_t txArmed;
+static int32_t txOffset;
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncClear
+*
+* @brief   Empty the regression table; global time is local time again
+*/
+static void cc2520ll_tsyncClear(void)
+{
+    _disable_interrupts();
+    entryUsed = 0;
+    numEntries = numErrors = 0;
+    localAvg = 0;
+    offsetAvg = 0;
+    skew = 0;
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncFit
+*
+* @brief   Least squares line through the table entries, offset over local
+*          time, relative to the first entry so the sums stay small
+*/
+static void cc2520ll_tsyncFit(void)
+{
+    uint32_t localRef = 0;
+    int32_t offsetRef = 0, x, y, meanX, meanY;
+    int64_t sumX = 0, sumY = 0, sxx = 0, sxy = 0;
+    uint8_t i, first = TRUE;
+
+    for (i = 0; i < CC2520_TSYNC_ENTRIES; i++) {
+        if (!(entryUsed & (1 << i)))
+            continue;
+        if (first) {
+            localRef = entryLocal[i];
+            offsetRef = entryOffset[i];
+            first = FALSE;
+        }
+        sumX += (int32_t)(entryLocal[i] - localRef);
+        sumY += entryOffset[i] - offsetRef;
+    }
+    // Rounded to the nearest tick
+    meanX = (int32_t)((sumX + (sumX < 0 ? -(numEntries / 2) : numEntries / 2)) / numEntries);
+    meanY = (int32_t)((sumY + (sumY < 0 ? -(numEntries / 2) : numEntries / 2)) / numEntries);
+    for (i = 0; i < CC2520_TSYNC_ENTRIES; i++) {
+        if (!(entryUsed & (1 << i)))
+            continue;
+        x = (int32_t)(entryLocal[i] - localRef) - meanX;
+        y = entryOffset[i] - offsetRef - meanY;
+        sxx += (int64_t)x * x;
+        sxy += (int64_t)x * y;
+    }
+    while (sxy > TSYNC_SXY_MAX || sxy < -TSYNC_SXY_MAX) {
+        sxy /= 2;
+        sxx /= 2;
+    }
+
+    _disable_interrupts();
+    localAvg = localRef + meanX;
+    offsetAvg = offsetRef + meanY;
+    skew = sxx ? (int32_t)((sxy << CC2520_TSYNC_SKEW_SHIFT) / sxx) : 0;
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncAdd
+*
+* @brief   Enter a record into the table, in place of the oldest entry if it
+*          is full. Once synchronised, a record too far off the line is
+*          thrown out; after a few in a row the table is cleared instead.
+*/
+static void cc2520ll_tsyncAdd(uint32_t local, uint32_t global)
+{
+    int32_t err;
+    uint8_t i, slot = 0, age = FALSE;
+
+    if (numEntries >= CC2520_TSYNC_ENTRY_VALID) {
+        err = (int32_t)(global - cc2520ll_tsyncGlobal(local));
+        if (err > (int32_t)CC2520_TSYNC_THROWOUT || err < -(int32_t)CC2520_TSYNC_THROWOUT) {
+            if (++numErrors <= CC2520_TSYNC_MAX_ERRORS) {
+                tsyncStats.rejected++;
+                return;
+            }
+            cc2520ll_tsyncClear();
+            tsyncStats.cleared++;
+        } else {
+            numErrors = 0;
+        }
+    }
+
+    // A free entry, else the oldest one
+    for (i = 0; i < CC2520_TSYNC_ENTRIES; i++) {
+        if (!(entryUsed & (1 << i))) {
+            slot = i;
+            age = FALSE;
+            break;
+        }
+        if (!age || (int32_t)(entryLocal[i] - entryLocal[slot]) < 0) {
+            slot = i;
+            age = TRUE;
+        }
+    }
+    if (!(entryUsed & (1 << slot)))
+        numEntries++;
+    entryUsed |= 1 << slot;
+    entryLocal[slot] = local;
+    entryOffset[slot] = (int32_t)(global - local);
+    tsyncStats.accepted++;
+    cc2520ll_tsyncFit();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncRecord
+*
+* @brief   Sync record with the current root and sequence number. The global
+*          time is filled in at the SFD. The root numbers its records.
+*/
+static void cc2520ll_tsyncRecord(uint8_t *pRec)
+{
+    if (rootId == myId)
+        seq++;
+    pRec[0] = CC2520_TSYNC_DISPATCH;
+    pRec[1] = LO_UINT16(rootId);
+    pRec[2] = HI_UINT16(rootId);
+    pRec[3] = seq;
+    memset(&pRec[4], 0, 4);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncMaySend
+*
+* @brief   Only the root and nodes with enough entries flood the time
+*/
+static uint8_t cc2520ll_tsyncMaySend(void)
+{
+    return rootId == myId || (rootId != CC2520_TSYNC_NO_ROOT && numEntries >= CC2520_TSYNC_ENTRY_SEND);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncArm
+*
+* @brief   Let the SFD hook fill in the record of the next frame sent. The
+*          offset of global time is taken now, so that the hook only adds it:
+*          over a CSMA-CA backoff the skew moves it by well under a tick.
+*/
+static void cc2520ll_tsyncArm(void)
+{
+    uint32_t now = rtimer_now32();
+    int32_t offset = (int32_t)(cc2520ll_tsyncGlobal(now) - now);
+
+    _disable_interrupts();
+    txOffset = offset;
+    txArmed = TRUE;
+    _enable_interrupts();
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncSfd
+*
+* @brief   SFD hook: write the global time of the SFD into the record of the
+*          frame going out. Called from interrupt context.
+*/
+static void cc2520ll_tsyncSfd(uint32_t sfdTime)
+{
+    uint32_t global;
+    uint8_t buf[4];
+
+    if (!txArmed)
+        return;
+    global = sfdTime + txOffset;
+    buf[0] = (uint8_t)global;
+    buf[1] = (uint8_t)(global >> 8);
+    buf[2] = (uint8_t)(global >> 16);
+    buf[3] = (uint8_t)(global >> 24);
+    cc2520ll_txPatch(CC2520_TSYNC_TIME_POS, buf, sizeof(buf));
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncStart
+*
+* @brief   Start time synchronisation with an empty table. The node floods the
+*          time once it is root or synchronised, from cc2520ll_tsyncPoll()
+*          and cc2520ll_tsyncSend(). A node that does not hear the root for
+*          CC2520_TSYNC_ROOT_TIMEOUT periods becomes root itself; of two
+*          roots, the one with the lower short address wins.
+*
+* @param   const cc2520ll_tsyncCfg_t *pCfg
+*
+* @return  none
+*/
+void cc2520ll_tsyncStart(const cc2520ll_tsyncCfg_t *pCfg)
+{
+    tsyncCfg = *pCfg;
+    memset(&tsyncStats, 0, sizeof(tsyncStats));
+    myId = CC2520_MEMRD16(CC2520_RAM_SHORTADDR);
+    cc2520ll_tsyncClear();
+    rootId = tsyncCfg.root ? myId : CC2520_TSYNC_NO_ROOT;
+    seq = 0;
+    heartBeats = 0;
+    sentInPeriod = FALSE;
+    rxPending = FALSE;
+    txArmed = FALSE;
+    periodTicks = (uint32_t)tsyncCfg.period * RTIMER_SECOND;
+    periodStart = rtimer_now32();
+    tsyncOn = tsyncCfg.period != 0;
+    cc2520ll_setSfdHook(tsyncOn ? cc2520ll_tsyncSfd : NULL);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncStop
+*
+* @brief   Stop sending and taking in records. The table is kept, so global
+*          time keeps running from the last fit.
+*
+* @return  none
+*/
+void cc2520ll_tsyncStop(void)
+{
+    tsyncOn = FALSE;
+    cc2520ll_setSfdHook(NULL);
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncPoll
+*
+* @brief   Main loop work: enter the last record received, and once per
+*          period check the root and send a beacon unless a record already
+*          went out with an application frame. Not for interrupt context.
+*
+* @param   none
+*
+* @return  uint8_t - TRUE if a beacon was sent
+*/
+uint8_t cc2520ll_tsyncPoll(void)
+{
+    uint8_t frame[TSYNC_MHR_LEN + CC2520_TSYNC_LEN];
+    uint16_t root, panId;
+    uint8_t recSeq, accept;
+    uint32_t local, global;
+    int r;
+
+    if (!tsyncOn)
+        return FALSE;
+
+    _disable_interrupts();
+    accept = rxPending;
+    rxPending = FALSE;
+    root = rxRoot;
+    recSeq = rxSeq;
+    local = rxLocal;
+    global = rxGlobal;
+    _enable_interrupts();
+    if (accept) {
+        // A lower root takes over, unless this node has just become root;
+        // from the same root only newer records count
+        if (root < rootId && !(rootId == myId && heartBeats < CC2520_TSYNC_IGNORE_ROOT)) {
+            rootId = root;
+            seq = recSeq;
+        } else if (root == rootId && root != myId && (int8_t)(recSeq - seq) > 0) {
+            seq = recSeq;
+        } else {
+            accept = FALSE;
+            tsyncStats.rejected++;
+        }
+        if (accept) {
+            heartBeats = 0;
+            cc2520ll_tsyncAdd(local, global);
+        }
+    }
+
+    if ((uint32_t)(rtimer_now32() - periodStart) < periodTicks)
+        return FALSE;
+    periodStart += periodTicks;
+    if ((uint32_t)(rtimer_now32() - periodStart) >= periodTicks)
+        periodStart = rtimer_now32();
+    if (heartBeats < 0xFF)
+        heartBeats++;
+    if (rootId != myId && heartBeats >= CC2520_TSYNC_ROOT_TIMEOUT) {
+        // The root is gone: carry on with this node's idea of global time
+        heartBeats = 0;
+        rootId = myId;
+    }
+    if (sentInPeriod) {
+        sentInPeriod = FALSE;
+        return FALSE;
+    }
+    if (!cc2520ll_tsyncMaySend() || cc2520ll_txBusy())
+        return FALSE;
+
+    // Broadcast data frame holding only the record
+    panId = CC2520_MEMRD16(CC2520_RAM_PANID);
+    frame[0] = CC2520_FCF_NOACK_L;
+    frame[1] = HI_UINT16(CC2520_FCF_NOACK);
+    frame[2] = cc2520ll_nextSeq();
+    frame[3] = LO_UINT16(panId);
+    frame[4] = HI_UINT16(panId);
+    frame[5] = 0xFF;
+    frame[6] = 0xFF;
+    frame[7] = LO_UINT16(myId);
+    frame[8] = HI_UINT16(myId);
+    cc2520ll_tsyncRecord(&frame[TSYNC_MHR_LEN]);
+    cc2520ll_tsyncArm();
+    r = cc2520ll_packetSend(frame, sizeof(frame));
+    txArmed = FALSE;
+    if (r == FAILED)
+        return FALSE;
+    tsyncStats.beacons++;
+    return TRUE;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncSend
+*
+* @brief   Send an application frame with cc2520ll_packetSend(), adding a sync
+*          record after its MHR if the node floods the time. Receivers find
+*          the record at CC2520_TSYNC_POS, first byte CC2520_TSYNC_DISPATCH,
+*          and the payload after it. A period with such a frame needs no
+*          beacon. Not for interrupt context.
+*
+* @param   const void *packet - data frame with short addresses and PAN ID
+*          compression, MHR and payload
+*          uint8_t len - MPDU length without FCS
+*
+* @return  int - SUCCESS, or FAILED if the frame could not be sent or, while
+*          the node floods the time, has another MHR than the record needs
+*/
+int cc2520ll_tsyncSend(const void *packet, uint8_t len)
+{
+    uint8_t frame[TSYNC_MHR_LEN + CC2520_TSYNC_LEN + CC2520_MAX_PAYLOAD_SIZE];
+    const uint8_t *pMpdu = (const uint8_t *)packet;
+    int r;
+
+    if (!tsyncOn || !cc2520ll_tsyncMaySend())
+        return cc2520ll_packetSend(packet, len);
+    // The record sits at a fixed offset: data frame, short addresses, PAN
+    // ID compression, as cc2520ll_tsyncRxFrame() expects
+    if (len < TSYNC_MHR_LEN || len > TSYNC_MHR_LEN + CC2520_MAX_PAYLOAD_SIZE || \
+        (pMpdu[0] & ~CC2520_FCF_ACK_BM_L) != CC2520_FCF_NOACK_L || \
+        pMpdu[1] != HI_UINT16(CC2520_FCF_NOACK))
+        return FAILED;
+    memcpy(frame, pMpdu, TSYNC_MHR_LEN);
+    cc2520ll_tsyncRecord(&frame[TSYNC_MHR_LEN]);
+    memcpy(&frame[TSYNC_MHR_LEN + CC2520_TSYNC_LEN], pMpdu + TSYNC_MHR_LEN, len - TSYNC_MHR_LEN);
+    cc2520ll_tsyncArm();
+    r = cc2520ll_packetSend(frame, len + CC2520_TSYNC_LEN);
+    txArmed = FALSE;
+    if (r == SUCCESS) {
+        tsyncStats.piggybacked++;
+        sentInPeriod = TRUE;
+    }
+    return r;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncSynced
+*
+* @brief   Is global time valid here: root, or enough entries?
+*
+* @return  uint8_t - TRUE if synchronised
+*/
+uint8_t cc2520ll_tsyncSynced(void)
+{
+    return rootId == myId || numEntries >= CC2520_TSYNC_ENTRY_VALID;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncGlobal
+*
+* @brief   Global time at a local time
+*
+* @param   uint32_t local - rtimer_now32() ticks
+*
+* @return  uint32_t - global ticks
+*/
+uint32_t cc2520ll_tsyncGlobal(uint32_t local)
+{
+    unsigned short istate;
+    int32_t d, corr;
+    uint32_t global;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    d = (int32_t)(local - localAvg);
+    corr = (int32_t)(((int64_t)d * skew) >> CC2520_TSYNC_SKEW_SHIFT);
+    global = local + offsetAvg + corr;
+    __set_interrupt_state(istate);
+    return global;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncLocal
+*
+* @brief   Local time at a global time, e.g. to set an rtimer for a sampling
+*          window that starts at the same global time on every node
+*
+* @param   uint32_t global - global ticks
+*
+* @return  uint32_t - rtimer_now32() ticks
+*/
+uint32_t cc2520ll_tsyncLocal(uint32_t global)
+{
+    uint32_t local;
+
+    // The skew is small: one correction step is exact to the tick
+    local = global - offsetAvg;
+    local += global - cc2520ll_tsyncGlobal(local);
+    return local;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncNow
+*
+* @brief   Current global time
+*
+* @return  uint32_t - global ticks
+*/
+uint32_t cc2520ll_tsyncNow(void)
+{
+    return cc2520ll_tsyncGlobal(rtimer_now32());
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncGetStats
+*
+* @brief   Copy the root, table state and counters
+*
+* @param   cc2520ll_tsyncStats_t *pStats
+*
+* @return  none
+*/
+void cc2520ll_tsyncGetStats(cc2520ll_tsyncStats_t *pStats)
+{
+    *pStats = tsyncStats;
+    pStats->rootId = rootId;
+    pStats->seq = seq;
+    pStats->entries = numEntries;
+    pStats->skew = skew;
+}
+
+/***********************************************************************************
+* @fn      cc2520ll_tsyncRxFrame
+*
+* @brief   Note the sync record of a frame with an SFD time, for
+*          cc2520ll_tsyncPoll(). Called from interrupt context.
+*
+* @param   const cc2520ll_frame_t *pFrame
+*
+* @return  none
+*/
+void cc2520ll_tsyncRxFrame(const cc2520ll_frame_t *pFrame)
+{
+    const uint8_t *pMpdu = pFrame->mpdu;
+    const uint8_t *pRec = &pMpdu[CC2520_TSYNC_POS];
+
+    // Data frame, short addresses, PAN ID compression, record complete
+    if (!tsyncOn || !pFrame->sfdValid || \
+        (pMpdu[1] & ~CC2520_FCF_ACK_BM_L) != CC2520_FCF_NOACK_L || \
+        pMpdu[2] != HI_UINT16(CC2520_FCF_NOACK) || \
+        pMpdu[0] < CC2520_TSYNC_POS + CC2520_TSYNC_LEN - 1 + CC2520_FOOTER_SIZE || \
+        pRec[0] != CC2520_TSYNC_DISPATCH)
+        return;
+    rxRoot = pRec[1] | ((uint16_t)pRec[2] << 8);
+    rxSeq = pRec[3];
+    rxGlobal = pRec[4] | ((uint32_t)pRec[5] << 8) | ((uint32_t)pRec[6] << 16) | ((uint32_t)pRec[7] << 24);
+    rxLocal = pFrame->sfdTime;
+    rxPending = TRUE;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef CC2520LL_TSYNC_H_
+#define CC2520LL_TSYNC_H_
+
+#include <inttypes.h>
+#include "cc2520ll.h"
+#include "rtimer.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+
+// Network time synchronisation after FTSP (flooding time synchronisation
+// protocol). The root's clock is the global time. Every synchronised node
+// floods it: a sync record it sends holds the global time at the SFD of that
+// very frame, written into the TX FIFO while the frame goes out (MAC-layer
+// time stamping). A receiver pairs it with the SFD time of the frame on its
+// own clock and fits offset and skew to the last pairs by linear regression.
+//
+// The record follows the MHR of a data frame (short addresses, PAN ID
+// compression). It goes out with the application's own frames
+// (cc2520ll_tsyncSend); a beacon holding only the record is sent for periods
+// in which none did. Times are rtimer_now32() ticks. Patching a frame on air
+// breaks its MIC, so time sync is not available with SECURITY_CCM.
+
+#define CC2520_TSYNC_DISPATCH             0x3F  // 6LoWPAN NALP range: not a LoWPAN frame
+#define CC2520_TSYNC_LEN                  8     // Dispatch, root, sequence number, global time
+#define CC2520_TSYNC_POS                  CC2520_HDR_SIZE   // In the frame, from the PHR
+#define CC2520_TSYNC_TIME_POS             (CC2520_TSYNC_POS + 4)
+
+// Defaults (FTSP)
+#define CC2520_TSYNC_PERIOD               10    // s between records
+#define CC2520_TSYNC_ENTRIES              8     // Regression table size
+#define CC2520_TSYNC_ENTRY_VALID          4     // Entries before the node counts as synchronised
+#define CC2520_TSYNC_ENTRY_SEND           3     // Entries before a node floods the time
+#define CC2520_TSYNC_ROOT_TIMEOUT         5     // Periods without the root before taking over
+#define CC2520_TSYNC_IGNORE_ROOT          4     // Periods a new root ignores other roots
+#define CC2520_TSYNC_THROWOUT             RTIMER_US_TO_TICKS(500)   // Largest error of a new entry
+#define CC2520_TSYNC_MAX_ERRORS           3     // Outliers in a row before the table is cleared
+
+#define CC2520_TSYNC_NO_ROOT              0xFFFF
+
+// Skew is a fraction scaled by 2^CC2520_TSYNC_SKEW_SHIFT (1 ppm = 16.8)
+#define CC2520_TSYNC_SKEW_SHIFT           24
+
+/***********************************************************************************
+* TYPEDEFS
+*/
+typedef struct {
+    uint16_t period;            // s between records, 0 to stop
+    uint8_t root;               // Start as root (e.g. the PAN coordinator)
+} cc2520ll_tsyncCfg_t;
+
+typedef struct {
+    uint16_t rootId;            // CC2520_TSYNC_NO_ROOT before any record
+    uint8_t seq;                // Root's sequence number last accepted
+    uint8_t entries;            // Regression table entries
+    int32_t skew;               // Global clock rate - 1, scaled (CC2520_TSYNC_SKEW_SHIFT)
+    uint16_t beacons;           // Records sent in beacons of their own
+    uint16_t piggybacked;       // Records sent in application frames
+    uint16_t accepted;          // Records received and entered
+    uint16_t rejected;          // From another root, old, or outliers
+    uint16_t cleared;           // Table thrown away after repeated outliers
+} cc2520ll_tsyncStats_t;
+
+/* External functions */
+
+#ifndef SECURITY_CCM
+void cc2520ll_tsyncStart(const cc2520ll_tsyncCfg_t *pCfg);
+void cc2520ll_tsyncStop(void);
+uint8_t cc2520ll_tsyncPoll(void);
+int cc2520ll_tsyncSend(const void *packet, uint8_t len);
+uint8_t cc2520ll_tsyncSynced(void);
+uint32_t cc2520ll_tsyncGlobal(uint32_t local);
+uint32_t cc2520ll_tsyncLocal(uint32_t global);
+uint32_t cc2520ll_tsyncNow(void);
+void cc2520ll_tsyncGetStats(cc2520ll_tsyncStats_t *pStats);
+
+// Called by the RX interrupt for every queued frame
+void cc2520ll_tsyncRxFrame(const cc2520ll_frame_t *pFrame);
+#endif
+
+#endif /*CC2520LL_TSYNC_H_*/
@@ -1,13 +1,24 @@
 #include <msp430f5435.h>
 #include "msp430_arch.h"
 #include "cc2520ll.h"
+#include "rtimer.h"
+#ifdef SECURITY_CCM
+#include "cc2520ll_sec.h"
+#endif
 
 
 void main(){
 	msp430_init();
 	_enable_interrupts();
 	if (cc2520ll_init() == SUCCESS){
-		LPM0;
+		// Timer and radio interrupts leave LPM0 on exit; go back to sleep
+		for (;;) {
+			LPM0;
+#ifdef SECURITY_CCM
+			// Flash erase for the frame counter marks, out of the send path
+			cc2520ll_secPoll();
+#endif
+		}
 	}
 }
 
@@ -15,6 +26,42 @@ void main(){
 interrupt void port2_interrupt(void) {
 	if (P2IFG & (1 << CC2520_INT_PIN)){
 		cc2520ll_packetReceivedISR();
-		P2IFG &= ~(1 << CC2520_INT_PIN);
 	}
-}
\ No newline at end of file
+	if (P2IFG & (1 << CC2520_TX_INT_PIN)){
+		cc2520ll_txFrameDoneISR();
+	}
+	// Let cc2520ll_transmit() see the end of the frame
+	__bic_SR_register_on_exit(LPM0_bits);
+}
+
+#ifdef CC2520_SPI_DMA
+#pragma vector = DMA_VECTOR
+interrupt void dma_interrupt(void) {
+	if (DMA0CTL & DMAIFG){
+		CC2520_SPI_DMA_ISR();
+	}
+}
+#endif
+
+#ifdef CC2520_SPI_ASYNC
+#pragma vector = USCI_A1_VECTOR
+interrupt void usci_a1_interrupt(void) {
+	if (UCA1IFG & UCRXIFG){
+		CC2520_SPI_ASYNC_ISR();
+	}
+}
+#endif
+
+// Timer_A1: CSMA-CA backoffs and low-power listening (see rtimer.h). Both
+// leave LPM0 so that cc2520ll_transmit() can see a failed send.
+#pragma vector = TIMER1_A0_VECTOR
+interrupt void timer1_a0_interrupt(void) {
+	rtimer_isr_ccr0();
+	__bic_SR_register_on_exit(LPM0_bits);
+}
+
+#pragma vector = TIMER1_A1_VECTOR
+interrupt void timer1_a1_interrupt(void) {
+	rtimer_isr_ccr();
+	__bic_SR_register_on_exit(LPM0_bits);
+}
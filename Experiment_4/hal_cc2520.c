@@ -43,13 +43,69 @@ typedef union {
 /***********************************************************************************
 * LOCAL FUNCTIONS
 */
-static uint8_t GotException(uint8_t index);
-static uint8_t waitException(uint8_t exc, uint16_t timeOut);
 static void clearException(uint32_t dwMap);
+static void CC2520_GPIO_TRACK(uint16_t addr, uint16_t count, const uint8_t *pData, uint32_t value);
 static void CC2520_INS_RD_ARRAY(uint16_t count, uint8_t  *pData);
 static uint8_t CC2520_INS_MEMCP_COMMON(uint8_t instr, uint8_t pri, uint16_t count, \
     uint16_t src, uint16_t dest);
 
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static volatile uint8_t statusShadow;           // Last status byte seen on the bus
+static volatile uint8_t statusFresh;            // FALSE once the radio may have moved on
+static volatile uint32_t statusSaved;           // Queries answered from the shadow
+static volatile uint8_t sfdShadow;              // FSMSTAT1 SFD bit as last read
+static volatile uint8_t sfdFresh;               // FALSE after a strobe or DPU instruction
+static volatile uint16_t sfdTick;               // Caller's clock when it was read
+static uint32_t excSnapshot;                    // EXCFLAG0-2 as last read
+static uint32_t excEvent;                       // Snapshot the running dispatch started from
+static cc2520_excHandler_t excHandler[CC2520_EXC_COUNT];
+static uint8_t gpioFunc[CC2520_GPIO_COUNT];     // GPIOCTRLn as last written
+static uint8_t gpioKnown;                       // Bit n set when gpioFunc[n] is valid
+static uint16_t gpioWrites;                     // GPIOCTRLn writes issued
+
+#ifdef CC2520_SPI_DMA
+static void CC2520_SPI_DMA_START(uint16_t count, uint8_t *pTx, uint8_t *pRx, uint8_t async);
+static void CC2520_SPI_DMA_COMPLETE(void);
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static volatile uint8_t dmaPending;             // Non-blocking transfer holds the bus
+static cc2520_dmaCallback_t dmaCallback;
+static uint8_t dmaStatus;                       // Status byte of the pending instruction
+static uint8_t dmaSink;                         // RX destination while writing
+static const uint8_t dmaZero = 0x00;            // TX source while reading
+#endif
+
+#ifdef CC2520_SPI_ASYNC
+/***********************************************************************************
+* DATATYPES
+*/
+typedef struct {
+    uint8_t hdr[CC2520_SPI_HDR_LEN];            // Opcode and arguments
+    uint8_t hdrLen;
+    uint16_t count;                             // Data phase length
+    uint8_t *pTx;                               // Data to write, NULL sends zeros
+    uint8_t *pRx;                               // Buffer to read into, NULL discards
+    cc2520_spiCallback_t cb;
+} spiTrans_t;
+
+static void CC2520_SPI_QUEUE_START(void);
+static void CC2520_SPI_QUEUE_KICK(void);
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static spiTrans_t spiQueue[CC2520_SPI_QUEUE_LEN];
+static volatile uint8_t spiHead, spiTail, spiCount;
+static uint16_t spiPos;                         // Byte index in the current instruction
+static uint8_t spiStatus;                       // Status byte of the current instruction
+static uint8_t spiDepth;                        // Nested CC2520_SPI_ACQUIRE calls
+static uint8_t spiRunning;                      // Queue head has been started on the bus
+#endif
+
 static uint8_t CC2520_SPI_TXRX(uint8_t x)
 {
     CC2520_SPI_RX_NOT_READY(); 
@@ -59,50 +115,56 @@ static uint8_t CC2520_SPI_TXRX(uint8_t x)
 }
 
 /***********************************************************************************
-* @fn      GotException
+* @fn      CC2520_STATUS_UPDATE
 *
-* @brief   Check if exception is set
+* @brief   Store the status byte returned with an opcode. The byte is sampled
+*          before the instruction runs, so strobes and DPU instructions leave
+*          the shadow stale.
 *
-* @param  uint8_t index
+* @param   uint8_t instr - opcode byte
+*          uint8_t s - status byte
 *
-* @return  uint8_t
+* @return  none
 */
-static uint8_t GotException(uint8_t index)
+static void CC2520_STATUS_UPDATE(uint8_t instr, uint8_t s)
 {
-    uint8_t exceptions = CC2520_REGRD8(CC2520_EXCFLAG0 + (index >> 3));
-    if (exceptions & BV(index & 0x07)) {
-        return TRUE;
+    statusShadow = s;
+    if (instr & CC2520_INS_REGRD) {
+        statusFresh = TRUE;             // REGRD and REGWR
+    } else if (instr >= CC2520_INS_SXOSCON) {
+        statusFresh = FALSE;            // Command strobes and DPU instructions
     } else {
-        return FALSE;
+        statusFresh = instr != CC2520_INS_SIBUFEX && instr != CC2520_INS_SRES && \
+            instr != CC2520_INS_RXBUFCP && instr != CC2520_INS_RXBUFMOV && \
+            instr != CC2520_INS_TXBUFCP;
     }
+    if (!statusFresh)
+        sfdFresh = FALSE;
 }
 
-
 /***********************************************************************************
-* @fn      waitException
+* @fn      CC2520_SPI_OPCODE
 *
-* @brief   Wait for exception
+* @brief   Send the first byte of an instruction and keep its status byte
 *
-* @param  uint8_t exc
-*         uint16_t timeOut
+* @param   uint8_t instr - opcode byte
 *
-* @return  uint8_t
+* @return  uint8_t - status byte
 */
-static uint8_t waitException(uint8_t exc, uint16_t timeOut)
+static uint8_t CC2520_SPI_OPCODE(uint8_t instr)
 {
-    while (--timeOut>0) {
-        if (GotException(exc))
-            break;
-        halMcuWaitUs(10);
-    }
-    return timeOut>0;
+    uint8_t s;
+    s = CC2520_SPI_TXRX(instr);
+    CC2520_STATUS_UPDATE(instr, s);
+    return s;
 }
 
-
 /***********************************************************************************
 * @fn      clearException
 *
-* @brief   Clear exception flag
+* @brief   Clear exception flags in one write. EXCFLAGn bits are cleared by
+*          writing 0 and unaffected by writing 1, so flags raised after the
+*          snapshot survive.
 *
 * @param  uint32_t dwMap
 *
@@ -111,6 +173,7 @@ static uint8_t waitException(uint8_t exc, uint16_t timeOut)
 static void clearException(uint32_t dwMap)
 {
     CC2520_REGWR24(CC2520_EXCFLAG0, ~dwMap);
+    excSnapshot &= ~dwMap;
 }
 
 
@@ -126,6 +189,13 @@ static void clearException(uint32_t dwMap)
 */
 static void CC2520_INS_RD_ARRAY(uint16_t count, uint8_t  *pData)
 {
+#ifdef CC2520_SPI_DMA
+    if (count >= CC2520_DMA_MIN_COUNT) {
+        CC2520_SPI_DMA_START(count, NULL, pData, FALSE);
+        while (DMA0CTL & DMAEN);
+        return;
+    }
+#endif
     while (count--) {
         CC2520_SPI_RX_NOT_READY(); 
         CC2520_SPI_TX_REG = 0x00;
@@ -154,17 +224,189 @@ static uint8_t CC2520_INS_MEMCP_COMMON(uint8_t instr, uint8_t pri, uint16_t coun
     uint16_t src, uint16_t dest)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(instr | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(instr | pri);
     CC2520_SPI_TXRX(count);
     CC2520_SPI_TXRX((HI_UINT16(src) << 4) | HI_UINT16(dest));
     CC2520_SPI_TXRX(LO_UINT16(src));
     CC2520_SPI_TXRX(LO_UINT16(dest));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
 
+#ifdef CC2520_SPI_DMA
+/***********************************************************************************
+* @fn      CC2520_SPI_DMA_START
+*
+* @brief   Start a DMA transfer of count bytes on the SPI bus. The RX channel
+*          (DMA0) stores every received byte, the TX channel (DMA1) feeds the
+*          transmitter. CSn must already be asserted.
+*
+* @param   uint16_t count - number of bytes
+*          uint8_t *pTx - bytes to send, NULL to clock out zeros
+*          uint8_t *pRx - buffer for received bytes, NULL to discard them
+*          uint8_t async - TRUE to raise the DMA interrupt on completion
+*
+* @return  none
+*/
+static void CC2520_SPI_DMA_START(uint16_t count, uint8_t *pTx, uint8_t *pRx, uint8_t async)
+{
+    DMA0CTL = 0;
+    DMA1CTL = 0;
+    DMACTL0 = (CC2520_DMA_TSEL_UCA1TX << 8) | CC2520_DMA_TSEL_UCA1RX;
+    DMACTL4 = DMARMWDIS;
+
+    // RX channel: UCA1RXBUF -> pRx
+    CC2520_DMA_SET_ADDR(DMA0SA, CC2520_SPI_RX_ADDR);
+    CC2520_DMA_SET_ADDR(DMA0DA, pRx ? pRx : &dmaSink);
+    DMA0SZ = count;
+    DMA0CTL = DMADT_0 | DMASRCINCR_0 | (pRx ? DMADSTINCR_3 : DMADSTINCR_0) | \
+        DMASRCBYTE | DMADSTBYTE | (async ? DMAIE : 0) | DMAEN;
+
+    // TX channel: pTx -> UCA1TXBUF
+    CC2520_DMA_SET_ADDR(DMA1SA, pTx ? pTx : &dmaZero);
+    CC2520_DMA_SET_ADDR(DMA1DA, CC2520_SPI_TX_ADDR);
+    DMA1SZ = count;
+    DMA1CTL = DMADT_0 | (pTx ? DMASRCINCR_3 : DMASRCINCR_0) | DMADSTINCR_0 | \
+        DMASRCBYTE | DMADSTBYTE | DMAEN;
+
+    // Drop the stale RX flag and give the TX trigger the edge it needs to start
+    CC2520_SPI_RX_NOT_READY();
+    UCA1IFG &= ~UCTXIFG;
+    UCA1IFG |= UCTXIFG;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SPI_DMA_COMPLETE
+*
+* @brief   Finish a non-blocking transfer: release CSn and run the callback.
+*          Called from the DMA interrupt or from the next instruction that
+*          needs the bus, whichever comes first.
+*
+* @param   none
+*
+* @return  none
+*/
+static void CC2520_SPI_DMA_COMPLETE(void)
+{
+    cc2520_dmaCallback_t cb;
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    if (!dmaPending) {
+        __set_interrupt_state(istate);
+        return;
+    }
+    dmaPending = FALSE;
+    DMA0CTL &= ~(DMAIE | DMAIFG);
+    P5OUT |= BIT5;                              // CSn high; the bus lock went at start
+    cb = dmaCallback;
+#ifdef CC2520_SPI_ASYNC
+    // Instructions queued behind the transfer
+    CC2520_SPI_QUEUE_KICK();
+#endif
+    __set_interrupt_state(istate);
+
+    if (cb) {
+        cb(dmaStatus);
+    }
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_INS_DMA_COMMON
+*
+* @brief   Send an instruction header by polling and move its data phase with
+*          DMA. Returns as soon as the transfer has started.
+*
+* @param   uint8_t *pHdr - instruction header, first byte is the opcode
+*          uint8_t hdrLen - number of header bytes
+*          uint16_t count - number of data bytes
+*          uint8_t *pTx - data to write, NULL on reads
+*          uint8_t *pRx - buffer to read into, NULL on writes
+*          cc2520_dmaCallback_t cb - called with the status byte on completion
+*
+* @return  uint8_t - status byte
+*/
+static uint8_t CC2520_INS_DMA_COMMON(uint8_t *pHdr, uint8_t hdrLen, uint16_t count, \
+    uint8_t *pTx, uint8_t *pRx, cc2520_dmaCallback_t cb)
+{
+    uint8_t s;
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(*pHdr++);
+    while (--hdrLen) {
+        CC2520_SPI_TXRX(*pHdr++);
+    }
+    if (count == 0) {
+        CC2520_SPI_END(istate);
+        if (cb) {
+            cb(s);
+        }
+        return s;
+    }
+    dmaStatus = s;
+    dmaCallback = cb;
+    dmaPending = TRUE;
+    CC2520_SPI_DMA_START(count, pTx, pRx, TRUE);
+    // CSn stays low and dmaPending holds the bus: the next lock waits for the
+    // DMA, and interrupts come back for its completion
+    CC2520_SPI_UNLOCK(istate);
+    return s;
+}
+#endif
+
+
+#ifdef CC2520_SPI_ASYNC
+/***********************************************************************************
+* @fn      CC2520_SPI_QUEUE_START
+*
+* @brief   Assert CSn and send the opcode of the oldest queued instruction. The
+*          rest of it is moved by CC2520_SPI_ASYNC_ISR. Interrupts must be off.
+*
+* @param   none
+*
+* @return  none
+*/
+static void CC2520_SPI_QUEUE_START(void)
+{
+    spiRunning = TRUE;
+    spiPos = 0;
+    P5OUT &= ~BIT5;
+    CC2520_SPI_RX_NOT_READY();
+    UCA1IE |= UCRXIE;
+    CC2520_SPI_TX_REG = spiQueue[spiTail].hdr[0];
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SPI_QUEUE_KICK
+*
+* @brief   Start the queue if it holds instructions and the bus is free: not
+*          acquired, and not held by a non-blocking DMA transfer. Interrupts
+*          must be off.
+*
+* @param   none
+*
+* @return  none
+*/
+static void CC2520_SPI_QUEUE_KICK(void)
+{
+    if (spiCount == 0 || spiRunning || spiDepth)
+        return;
+#ifdef CC2520_SPI_DMA
+    if (dmaPending)
+        return;
+#endif
+    CC2520_SPI_QUEUE_START();
+}
+#endif
+
+
 /***********************************************************************************
 * GLOBAL FUNCTIONS
 */
@@ -181,6 +423,13 @@ static uint8_t CC2520_INS_MEMCP_COMMON(uint8_t instr, uint8_t pri, uint16_t coun
 */
 void CC2520_INS_WR_ARRAY(uint16_t count, uint8_t  *pData)
 {
+#ifdef CC2520_SPI_DMA
+    if (count >= CC2520_DMA_MIN_COUNT) {
+        CC2520_SPI_DMA_START(count, pData, NULL, FALSE);
+        while (DMA0CTL & DMAEN);
+        return;
+    }
+#endif
     while (count--) {
         CC2520_SPI_RX_NOT_READY(); 
         CC2520_SPI_TX_REG = *pData;
@@ -202,9 +451,10 @@ void CC2520_INS_WR_ARRAY(uint16_t count, uint8_t  *pData)
 uint8_t CC2520_INS_STROBE(uint8_t strobe)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(strobe);
-    CC2520_SPI_END();
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(strobe);
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -476,10 +726,11 @@ uint8_t CC2520_SRXMASKBITCLR(void)
 uint8_t CC2520_IBUFLD(uint8_t i)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_IBUFLD);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_IBUFLD);
     CC2520_SPI_TXRX(i);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -496,10 +747,13 @@ uint8_t CC2520_IBUFLD(uint8_t i)
 uint8_t CC2520_SRES(void)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_SRES);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_SRES);
     CC2520_SPI_TXRX(0x00);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
+    // GPIOCTRLn are back to their reset values
+    CC2520_GPIO_INVALIDATE();
     return s;
 }
 
@@ -518,11 +772,12 @@ uint8_t CC2520_SRES(void)
 uint8_t CC2520_MEMRD(uint16_t addr, uint16_t count, uint8_t  *pData)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_MEMRD | HI_UINT16(addr));
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_MEMRD | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
     CC2520_INS_RD_ARRAY(count, pData);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -539,11 +794,12 @@ uint8_t CC2520_MEMRD(uint16_t addr, uint16_t count, uint8_t  *pData)
 uint8_t CC2520_MEMRD8(uint16_t addr)
 {
     uint8_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_MEMRD | HI_UINT16(addr));
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_MEMRD | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
     value = CC2520_SPI_TXRX(0x00);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value;
 }
 
@@ -560,12 +816,13 @@ uint8_t CC2520_MEMRD8(uint16_t addr)
 uint16_t CC2520_MEMRD16(uint16_t addr)
 {
     eword_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_MEMRD | HI_UINT16(addr));
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_MEMRD | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
     value.b.b0 = CC2520_SPI_TXRX(0x00);
     value.b.b1 = CC2520_SPI_TXRX(0x00);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value.w;
 }
 
@@ -582,14 +839,15 @@ uint16_t CC2520_MEMRD16(uint16_t addr)
 uint32_t CC2520_MEMRD24(uint16_t addr)
 {
     edword_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_MEMRD | HI_UINT16(addr));
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_MEMRD | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
     value.b.b0 = CC2520_SPI_TXRX(0x00);
     value.b.b1 = CC2520_SPI_TXRX(0x00);
     value.b.b2 = CC2520_SPI_TXRX(0x00);
     value.b.b3 = 0x00;
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value.dw;
 }
 
@@ -608,11 +866,13 @@ uint32_t CC2520_MEMRD24(uint16_t addr)
 uint8_t CC2520_MEMWR(uint16_t addr, uint16_t count, uint8_t  *pData)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_MEMWR | HI_UINT16(addr));
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_MEMWR | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
     CC2520_INS_WR_ARRAY(count, pData);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
+    CC2520_GPIO_TRACK(addr, count, pData, 0);
     return s;
 }
 
@@ -630,11 +890,13 @@ uint8_t CC2520_MEMWR(uint16_t addr, uint16_t count, uint8_t  *pData)
 uint8_t CC2520_MEMWR8(uint16_t addr, uint8_t value)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_MEMWR | HI_UINT16(addr));
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_MEMWR | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
     CC2520_SPI_TXRX(value);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
+    CC2520_GPIO_TRACK(addr, 1, NULL, value);
     return s;
 }
 
@@ -652,12 +914,14 @@ uint8_t CC2520_MEMWR8(uint16_t addr, uint8_t value)
 uint8_t CC2520_MEMWR16(uint16_t addr, uint16_t value)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_MEMWR | HI_UINT16(addr));
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_MEMWR | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(value));
     CC2520_SPI_TXRX(HI_UINT16(value));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
+    CC2520_GPIO_TRACK(addr, 2, NULL, value);
     return s;
 }
 
@@ -675,13 +939,15 @@ uint8_t CC2520_MEMWR16(uint16_t addr, uint16_t value)
 uint8_t CC2520_MEMWR24(uint16_t addr, uint32_t value)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_MEMWR | HI_UINT16(addr));
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_MEMWR | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(LO_UINT32(value)));
     CC2520_SPI_TXRX(HI_UINT16(LO_UINT32(value)));
     CC2520_SPI_TXRX(LO_UINT16(HI_UINT32(value)));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
+    CC2520_GPIO_TRACK(addr, 3, NULL, value);
     return s;
 }
 
@@ -699,10 +965,11 @@ uint8_t CC2520_MEMWR24(uint16_t addr, uint32_t value)
 uint8_t CC2520_RXBUF(uint8_t count, uint8_t  *pData)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_RXBUF);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_RXBUF);
     CC2520_INS_RD_ARRAY(count, pData);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -719,10 +986,11 @@ uint8_t CC2520_RXBUF(uint8_t count, uint8_t  *pData)
 uint8_t CC2520_RXBUF8(void)
 {
     uint8_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_RXBUF);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_RXBUF);
     value = CC2520_SPI_TXRX(0x00);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value;
 }
 
@@ -739,11 +1007,12 @@ uint8_t CC2520_RXBUF8(void)
 uint16_t CC2520_RXBUF16(void)
 {
     eword_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_RXBUF);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_RXBUF);
     value.b.b0 = CC2520_SPI_TXRX(0x00);
     value.b.b1 = CC2520_SPI_TXRX(0x00);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value.w;
 }
 
@@ -751,7 +1020,9 @@ uint16_t CC2520_RXBUF16(void)
 /***********************************************************************************
 * @fn      CC2520_RXBUFCP_BEGIN
 *
-* @brief   Copy RX buf to memory. Call this routine before CC2520_RXBUFCP_END
+* @brief   Copy RX buf to memory. Call this routine before CC2520_RXBUFCP_END,
+*          with interrupts disabled: the bus stays held until the end of
+*          CC2520_RXBUFCP_END.
 *
 * @param   uint16_t addr - copy destination
 *          uint8_t *pCurrCount - number of bytes in RX buf
@@ -761,8 +1032,10 @@ uint16_t CC2520_RXBUF16(void)
 uint8_t CC2520_RXBUFCP_BEGIN(uint16_t addr, uint8_t *pCurrCount)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_RXBUFCP);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    (void)istate;                               // Off already, CC2520_RXBUFCP_END unlocks
+    s = CC2520_SPI_OPCODE(CC2520_INS_RXBUFCP);
     if (pCurrCount) {
         *pCurrCount = CC2520_SPI_TXRX(HI_UINT16(addr));
     } else {
@@ -787,9 +1060,10 @@ uint8_t CC2520_RXBUFCP_BEGIN(uint16_t addr, uint8_t *pCurrCount)
 uint8_t CC2520_RXBUFCP_END(uint16_t addr, uint8_t count, uint8_t  *pData)
 {
     uint8_t s;
+    unsigned short istate = __get_interrupt_state();
     s = CC2520_SPI_TXRX(LO_UINT16(addr));
     CC2520_INS_RD_ARRAY(count, pData);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -810,8 +1084,9 @@ uint8_t CC2520_RXBUFCP_END(uint16_t addr, uint8_t count, uint8_t  *pData)
 uint8_t CC2520_RXBUFMOV(uint8_t pri, uint16_t addr, uint8_t count, uint8_t *pCurrCount)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_RXBUFMOV | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_RXBUFMOV | pri);
     if (pCurrCount) {
         *pCurrCount = CC2520_SPI_TXRX(count);
     } else {
@@ -819,7 +1094,7 @@ uint8_t CC2520_RXBUFMOV(uint8_t pri, uint16_t addr, uint8_t count, uint8_t *pCur
     }
     CC2520_SPI_TXRX(HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -837,10 +1112,11 @@ uint8_t CC2520_RXBUFMOV(uint8_t pri, uint16_t addr, uint8_t count, uint8_t *pCur
 uint8_t CC2520_TXBUF(uint8_t count, uint8_t  *pData)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_TXBUF);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_TXBUF);
     CC2520_INS_WR_ARRAY(count, pData);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -856,10 +1132,11 @@ uint8_t CC2520_TXBUF(uint8_t count, uint8_t  *pData)
 */
 void CC2520_TXBUF8(uint8_t data)
 {
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_TXBUF);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_TXBUF);
     CC2520_SPI_TXRX(data);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
 }
 
 
@@ -874,11 +1151,12 @@ void CC2520_TXBUF8(uint8_t data)
 */
 void CC2520_TXBUF16(uint16_t data)
 {
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_TXBUF);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_TXBUF);
     CC2520_SPI_TXRX(LO_UINT16(data));
     CC2520_SPI_TXRX(HI_UINT16(data));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
 }
 
 
@@ -897,8 +1175,9 @@ void CC2520_TXBUF16(uint16_t data)
 uint8_t CC2520_TXBUFCP(uint8_t pri, uint16_t addr, uint8_t count, uint8_t *pCurrCount)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_TXBUFCP | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_TXBUFCP | pri);
     if (pCurrCount) {
         *pCurrCount = CC2520_SPI_TXRX(count);
     } else {
@@ -906,7 +1185,7 @@ uint8_t CC2520_TXBUFCP(uint8_t pri, uint16_t addr, uint8_t count, uint8_t *pCurr
     }
     CC2520_SPI_TXRX(HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -924,11 +1203,12 @@ uint8_t CC2520_TXBUFCP(uint8_t pri, uint16_t addr, uint8_t count, uint8_t *pCurr
 uint8_t CC2520_RANDOM(uint8_t count, uint8_t  *pData)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_RANDOM);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_RANDOM);
     CC2520_SPI_TXRX(0x00);
     CC2520_INS_RD_ARRAY(count, pData);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -945,11 +1225,12 @@ uint8_t CC2520_RANDOM(uint8_t count, uint8_t  *pData)
 uint8_t CC2520_RANDOM8(void)
 {
     uint8_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_RANDOM);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_RANDOM);
     CC2520_SPI_TXRX(0x00);
     value = CC2520_SPI_TXRX(0x00);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value;
 }
 
@@ -966,12 +1247,13 @@ uint8_t CC2520_RANDOM8(void)
 uint16_t CC2520_RANDOM16(void)
 {
     eword_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_RANDOM);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_RANDOM);
     CC2520_SPI_TXRX(0x00);
     value.b.b0 = CC2520_SPI_TXRX(0x00);
     value.b.b1 = CC2520_SPI_TXRX(0x00);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value.w;
 }
 
@@ -988,11 +1270,12 @@ uint16_t CC2520_RANDOM16(void)
 uint8_t CC2520_RXMASKOR(uint16_t orMask)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_RXMASKOR);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_RXMASKOR);
     CC2520_SPI_TXRX(HI_UINT16(orMask));
     CC2520_SPI_TXRX(LO_UINT16(orMask));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1009,11 +1292,12 @@ uint8_t CC2520_RXMASKOR(uint16_t orMask)
 uint8_t CC2520_RXMASKAND(uint16_t andMask)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_RXMASKAND);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_RXMASKAND);
     CC2520_SPI_TXRX(HI_UINT16(andMask));
     CC2520_SPI_TXRX(LO_UINT16(andMask));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1086,12 +1370,13 @@ uint8_t CC2520_MEMXCP(uint8_t pri, uint16_t count, uint16_t src, uint16_t dest)
 uint8_t CC2520_MEMXWR(uint16_t addr, uint16_t count, uint8_t  *pData)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_MEMXWR);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_MEMXWR);
     CC2520_SPI_TXRX(HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
     CC2520_INS_WR_ARRAY(count, pData);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1108,10 +1393,11 @@ uint8_t CC2520_MEMXWR(uint16_t addr, uint16_t count, uint8_t  *pData)
 uint8_t CC2520_BSET(uint8_t bitAddr)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_BSET);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_BSET);
     CC2520_SPI_TXRX(bitAddr);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1128,10 +1414,11 @@ uint8_t CC2520_BSET(uint8_t bitAddr)
 uint8_t CC2520_BCLR(uint8_t bitAddr)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_BCLR);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_BCLR);
     CC2520_SPI_TXRX(bitAddr);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1154,15 +1441,16 @@ uint8_t CC2520_BCLR(uint8_t bitAddr)
 uint8_t CC2520_CTR(uint8_t pri, uint8_t k, uint8_t c, uint8_t n, uint16_t src, uint16_t dest)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_CTR | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_CTR | pri);
     CC2520_SPI_TXRX(k);
     CC2520_SPI_TXRX(c);
     CC2520_SPI_TXRX(n);
     CC2520_SPI_TXRX((HI_UINT16(src) << 4) | HI_UINT16(dest));
     CC2520_SPI_TXRX(LO_UINT16(src));
     CC2520_SPI_TXRX(LO_UINT16(dest));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1205,15 +1493,16 @@ uint8_t CC2520_UCTR(uint8_t pri, uint8_t k, uint8_t c, uint8_t n, uint16_t src,
 uint8_t CC2520_CBCMAC(uint8_t pri, uint8_t k, uint8_t c, uint16_t src, uint16_t dest, uint8_t m)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_CBCMAC | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_CBCMAC | pri);
     CC2520_SPI_TXRX(k);
     CC2520_SPI_TXRX(c);
     CC2520_SPI_TXRX((HI_UINT16(src) << 4) | HI_UINT16(dest));
     CC2520_SPI_TXRX(LO_UINT16(src));
     CC2520_SPI_TXRX(LO_UINT16(dest));
     CC2520_SPI_TXRX(m);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1235,14 +1524,15 @@ uint8_t CC2520_CBCMAC(uint8_t pri, uint8_t k, uint8_t c, uint16_t src, uint16_t
 uint8_t CC2520_UCBCMAC(uint8_t pri, uint8_t k, uint8_t c, uint16_t src, uint8_t m)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_UCBCMAC | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_UCBCMAC | pri);
     CC2520_SPI_TXRX(k);
     CC2520_SPI_TXRX(c);
     CC2520_SPI_TXRX(HI_UINT16(src));
     CC2520_SPI_TXRX(LO_UINT16(src));
     CC2520_SPI_TXRX(m);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1268,8 +1558,9 @@ uint8_t CC2520_CCM(uint8_t pri, uint8_t k, uint8_t c, uint8_t n, uint16_t src, \
     uint16_t dest, uint8_t f, uint8_t m)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_CCM | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_CCM | pri);
     CC2520_SPI_TXRX(k);
     CC2520_SPI_TXRX(c);
     CC2520_SPI_TXRX(n);
@@ -1278,7 +1569,7 @@ uint8_t CC2520_CCM(uint8_t pri, uint8_t k, uint8_t c, uint8_t n, uint16_t src, \
     CC2520_SPI_TXRX(LO_UINT16(dest));
     CC2520_SPI_TXRX(f);
     CC2520_SPI_TXRX(m);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1304,8 +1595,9 @@ uint8_t CC2520_UCCM(uint8_t pri, uint8_t k, uint8_t c, uint8_t n, uint16_t src,
     uint16_t dest, uint8_t f, uint8_t m)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_UCCM | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_UCCM | pri);
     CC2520_SPI_TXRX(k);
     CC2520_SPI_TXRX(c);
     CC2520_SPI_TXRX(n);
@@ -1314,7 +1606,7 @@ uint8_t CC2520_UCCM(uint8_t pri, uint8_t k, uint8_t c, uint8_t n, uint16_t src,
     CC2520_SPI_TXRX(LO_UINT16(dest));
     CC2520_SPI_TXRX(f);
     CC2520_SPI_TXRX(m);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1335,14 +1627,15 @@ uint8_t CC2520_UCCM(uint8_t pri, uint8_t k, uint8_t c, uint8_t n, uint16_t src,
 uint8_t CC2520_ECB(uint8_t pri, uint8_t k, uint8_t c, uint16_t src, uint16_t dest)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_ECB | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_ECB | pri);
     CC2520_SPI_TXRX(k);
     CC2520_SPI_TXRX((c << 4) | HI_UINT16(src));
     CC2520_SPI_TXRX(LO_UINT16(src));
     CC2520_SPI_TXRX(HI_UINT16(dest));
     CC2520_SPI_TXRX(LO_UINT16(dest));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1362,12 +1655,13 @@ uint8_t CC2520_ECB(uint8_t pri, uint8_t k, uint8_t c, uint16_t src, uint16_t des
 uint8_t CC2520_ECBO(uint8_t pri, uint8_t k, uint8_t c, uint16_t addr)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_ECBO | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_ECBO | pri);
     CC2520_SPI_TXRX(k);
     CC2520_SPI_TXRX((c << 4) | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1388,14 +1682,15 @@ uint8_t CC2520_ECBO(uint8_t pri, uint8_t k, uint8_t c, uint16_t addr)
 uint8_t CC2520_ECBX(uint8_t pri, uint8_t k, uint8_t c, uint16_t src, uint16_t dest)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_ECBX | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_ECBX | pri);
     CC2520_SPI_TXRX(k);
     CC2520_SPI_TXRX((c << 4) | HI_UINT16(src));
     CC2520_SPI_TXRX(LO_UINT16(src));
     CC2520_SPI_TXRX(HI_UINT16(dest));
     CC2520_SPI_TXRX(LO_UINT16(dest));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1415,12 +1710,13 @@ uint8_t CC2520_ECBX(uint8_t pri, uint8_t k, uint8_t c, uint16_t src, uint16_t de
 uint8_t CC2520_ECBXO(uint8_t pri, uint8_t k, uint8_t c, uint16_t addr)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_ECBXO | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_ECBXO | pri);
     CC2520_SPI_TXRX(k);
     CC2520_SPI_TXRX((c << 4) | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1440,11 +1736,12 @@ uint8_t CC2520_ECBXO(uint8_t pri, uint8_t k, uint8_t c, uint16_t addr)
 uint8_t CC2520_INC(uint8_t pri, uint8_t c, uint16_t addr)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_INC | pri);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_INC | pri);
     CC2520_SPI_TXRX((c << 4) | HI_UINT16(addr));
     CC2520_SPI_TXRX(LO_UINT16(addr));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1461,10 +1758,11 @@ uint8_t CC2520_INC(uint8_t pri, uint8_t c, uint16_t addr)
 uint8_t CC2520_ABORT(uint8_t c)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_ABORT);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_ABORT);
     CC2520_SPI_TXRX(c);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1483,10 +1781,11 @@ uint8_t CC2520_ABORT(uint8_t c)
 uint8_t CC2520_REGRD(uint8_t addr, uint8_t count, uint8_t  *pValues)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_REGRD | addr);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_REGRD | addr);
     CC2520_INS_RD_ARRAY(count, pValues);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return s;
 }
 
@@ -1503,10 +1802,11 @@ uint8_t CC2520_REGRD(uint8_t addr, uint8_t count, uint8_t  *pValues)
 uint8_t CC2520_REGRD8(uint8_t addr)
 {
     uint8_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_REGRD | addr);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_REGRD | addr);
     value = CC2520_SPI_TXRX(0x00);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value;
 }
 
@@ -1523,11 +1823,12 @@ uint8_t CC2520_REGRD8(uint8_t addr)
 uint16_t CC2520_REGRD16(uint8_t addr)
 {
     eword_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_REGRD | addr);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_REGRD | addr);
     value.b.b0 = CC2520_SPI_TXRX(0x00);
     value.b.b1 = CC2520_SPI_TXRX(0x00);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value.w;
 }
 
@@ -1544,13 +1845,14 @@ uint16_t CC2520_REGRD16(uint8_t addr)
 uint32_t CC2520_REGRD24(uint8_t addr)
 {
     edword_t value;
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_REGRD | addr);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_REGRD | addr);
     value.b.b0 = CC2520_SPI_TXRX(0x00);
     value.b.b1 = CC2520_SPI_TXRX(0x00);
     value.b.b2 = CC2520_SPI_TXRX(0x00);
     value.b.b3 = 0x00;
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
     return value.dw;
 }
 
@@ -1569,10 +1871,12 @@ uint32_t CC2520_REGRD24(uint8_t addr)
 uint8_t CC2520_REGWR(uint8_t addr, uint8_t count, uint8_t  *pValues)
 {
     uint8_t s;
-    CC2520_SPI_BEGIN();
-    s = CC2520_SPI_TXRX(CC2520_INS_REGWR | addr);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    s = CC2520_SPI_OPCODE(CC2520_INS_REGWR | addr);
     CC2520_INS_WR_ARRAY(count, pValues);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
+    CC2520_GPIO_TRACK(addr, count, pValues, 0);
     return s;
 }
 
@@ -1589,10 +1893,12 @@ uint8_t CC2520_REGWR(uint8_t addr, uint8_t count, uint8_t  *pValues)
 */
 void CC2520_REGWR8(uint8_t addr, uint8_t value)
 {
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_REGWR | addr);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_REGWR | addr);
     CC2520_SPI_TXRX(value);
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
+    CC2520_GPIO_TRACK(addr, 1, NULL, value);
     return;
 }
 
@@ -1609,11 +1915,13 @@ void CC2520_REGWR8(uint8_t addr, uint8_t value)
 */
 void CC2520_REGWR16(uint8_t addr, uint16_t value)
 {
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_REGWR | addr);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_REGWR | addr);
     CC2520_SPI_TXRX(LO_UINT16(value));
     CC2520_SPI_TXRX(HI_UINT16(value));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
+    CC2520_GPIO_TRACK(addr, 2, NULL, value);
 }
 
 
@@ -1629,15 +1937,832 @@ void CC2520_REGWR16(uint8_t addr, uint16_t value)
 */
 void CC2520_REGWR24(uint8_t addr, uint32_t value)
 {
-    CC2520_SPI_BEGIN();
-    CC2520_SPI_TXRX(CC2520_INS_REGWR | addr);
+    unsigned short istate;
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_OPCODE(CC2520_INS_REGWR | addr);
     CC2520_SPI_TXRX(LO_UINT16(LO_UINT32(value)));
     CC2520_SPI_TXRX(HI_UINT16(LO_UINT32(value)));
     CC2520_SPI_TXRX(LO_UINT16(HI_UINT32(value)));
-    CC2520_SPI_END();
+    CC2520_SPI_END(istate);
+    CC2520_GPIO_TRACK(addr, 3, NULL, value);
+}
+
+
+
+/***********************************************************************************
+* @fn      CC2520_EXC_SNAPSHOT
+*
+* @brief   Read EXCFLAG0-2 in one instruction and keep the result
+*
+* @param   none
+*
+* @return  uint32_t - exception map, bit n is exception n
+*/
+uint32_t CC2520_EXC_SNAPSHOT(void)
+{
+    excSnapshot = CC2520_REGRD24(CC2520_EXCFLAG0);
+    return excSnapshot;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_EXC_CACHED
+*
+* @brief   Exception map of the last snapshot, without SPI traffic
+*
+* @param   none
+*
+* @return  uint32_t - exception map
+*/
+uint32_t CC2520_EXC_CACHED(void)
+{
+    return excSnapshot;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_EXC_EVENT
+*
+* @brief   Exception map that started the dispatch in progress, including the
+*          flags the dispatcher has already cleared. Lets a handler see which
+*          other exceptions came with its own.
+*
+* @param   none
+*
+* @return  uint32_t - exception map
+*/
+uint32_t CC2520_EXC_EVENT(void)
+{
+    return excEvent;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_EXC_CLEAR
+*
+* @brief   Clear a set of exceptions in one write
+*
+* @param   uint32_t dwMap - exceptions to clear, see CC2520_EXC_BV
+*
+* @return  none
+*/
+void CC2520_EXC_CLEAR(uint32_t dwMap)
+{
+    clearException(dwMap);
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_EXC_REGISTER
+*
+* @brief   Install the handler run by CC2520_EXC_DISPATCH for exception exc
+*
+* @param   uint8_t exc - CC2520_EXC_xxx
+*          cc2520_excHandler_t handler - NULL to remove
+*
+* @return  none
+*/
+void CC2520_EXC_REGISTER(uint8_t exc, cc2520_excHandler_t handler)
+{
+    if (exc < CC2520_EXC_COUNT) {
+        excHandler[exc] = handler;
+    }
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_EXC_DISPATCH
+*
+* @brief   Take one exception snapshot, clear every set exception that has a
+*          handler in one write and run the handlers in exception order.
+*          Clearing first means an exception raised while a handler runs is
+*          kept for the next dispatch. Meant to be called from the radio GPIO
+*          interrupt.
+*
+* @param   none
+*
+* @return  uint32_t - exceptions that were handled
+*/
+uint32_t CC2520_EXC_DISPATCH(void)
+{
+    uint32_t pending, handled;
+    uint8_t i;
+
+    pending = CC2520_EXC_SNAPSHOT();
+    handled = 0;
+    for (i = 0; i < CC2520_EXC_COUNT; i++) {
+        if ((pending & CC2520_EXC_BV(i)) && excHandler[i]) {
+            handled |= CC2520_EXC_BV(i);
+        }
+    }
+    if (handled == 0)
+        return 0;
+
+    excEvent = pending;
+    clearException(handled);
+    for (i = 0; i < CC2520_EXC_COUNT; i++) {
+        if (handled & CC2520_EXC_BV(i)) {
+            excHandler[i](i);
+        }
+    }
+    return handled;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_GPIO_SET_FUNC
+*
+* @brief   Bind GPIO pin n to function fn. The register is left alone when the
+*          shadow says it already holds fn.
+*
+* @param   uint8_t n - GPIO number, 0 to 5
+*          uint8_t fn - GPIOCTRLn value
+*
+* @return  uint8_t - TRUE if GPIOCTRLn was written
+*/
+uint8_t CC2520_GPIO_SET_FUNC(uint8_t n, uint8_t fn)
+{
+    unsigned short istate;
+    uint8_t written = FALSE;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    if (!(gpioKnown & (1 << n)) || gpioFunc[n] != fn) {
+        CC2520_REGWR8(CC2520_GPIOCTRL0 + n, fn);
+        CC2520_GPIO_SEED(n, fn);
+        gpioWrites++;
+        written = TRUE;
+    }
+    __set_interrupt_state(istate);
+    return written;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_GPIO_GET_FUNC
+*
+* @brief   Function bound to GPIO pin n according to the shadow
+*
+* @param   uint8_t n - GPIO number, 0 to 5
+*
+* @return  uint8_t - GPIOCTRLn value, 0xFF if unknown
+*/
+uint8_t CC2520_GPIO_GET_FUNC(uint8_t n)
+{
+    return (gpioKnown & (1 << n)) ? gpioFunc[n] : 0xFF;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_GPIO_SEED
+*
+* @brief   Record that GPIOCTRLn holds fn without writing it, e.g. after the
+*          register has been written and verified in a burst
+*
+* @param   uint8_t n - GPIO number, 0 to 5
+*          uint8_t fn - GPIOCTRLn value
+*
+* @return  none
+*/
+void CC2520_GPIO_SEED(uint8_t n, uint8_t fn)
+{
+    gpioFunc[n] = fn;
+    gpioKnown |= 1 << n;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_GPIO_INVALIDATE
+*
+* @brief   Forget the whole shadow, e.g. after a reset of the radio. The next
+*          CC2520_GPIO_SET_FUNC of each pin writes its register.
+*
+* @param   none
+*
+* @return  none
+*/
+void CC2520_GPIO_INVALIDATE(void)
+{
+    gpioKnown = 0;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_GPIO_TRACK
+*
+* @brief   Keep the shadow in step with register and memory writes that reach
+*          GPIOCTRL0-5 without CC2520_GPIO_SET_FUNC, e.g. a register table
+*          burst
+*
+* @param   uint16_t addr - first address written
+*          uint16_t count - number of bytes
+*          const uint8_t *pData - bytes written, NULL to take them from value
+*          uint32_t value - bytes written, least significant first
+*
+* @return  none
+*/
+static void CC2520_GPIO_TRACK(uint16_t addr, uint16_t count, const uint8_t *pData, uint32_t value)
+{
+    uint16_t i;
+
+    if (addr > CC2520_GPIOCTRL5 || addr + count <= CC2520_GPIOCTRL0)
+        return;
+    for (i = 0; i < count; i++, value >>= 8) {
+        if (addr + i >= CC2520_GPIOCTRL0 && addr + i <= CC2520_GPIOCTRL5) {
+            CC2520_GPIO_SEED(addr + i - CC2520_GPIOCTRL0, pData ? pData[i] : (uint8_t)value);
+        }
+    }
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_GPIO_WRITES
+*
+* @brief   Number of GPIOCTRLn writes issued by CC2520_GPIO_SET_FUNC
+*
+* @param   none
+*
+* @return  uint16_t
+*/
+uint16_t CC2520_GPIO_WRITES(void)
+{
+    return gpioWrites;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_STATUS_QUERY
+*
+* @brief   Return status byte bits, from the shadow when it can be trusted.
+*          The bus is only used (SNOP) when the shadow is stale or when one of
+*          the requested bits may have changed on its own since it was read:
+*          TX and DPU activity end, XOSC and RSSI become valid, and exceptions
+*          can be raised at any time.
+*
+* @param   uint8_t mask - CC2520_STB_xxx bits of interest
+*
+* @return  uint8_t - status byte & mask
+*/
+uint8_t CC2520_STATUS_QUERY(uint8_t mask)
+{
+    uint8_t s;
+
+    s = statusShadow;
+    if (!statusFresh || (s & CC2520_STB_TX_ACTIVE_BV) || \
+        (mask & (CC2520_STB_EXC_CHA_BV | CC2520_STB_EXC_CHB_BV)) || \
+        (~s & mask & (CC2520_STB_XOSC_STABLE_BV | CC2520_STB_RSSI_VALID_BV)) || \
+        (s & mask & (CC2520_STB_DPUH_ACTIVE_BV | CC2520_STB_DPUL_ACTIVE_BV))) {
+        s = CC2520_SNOP();
+    } else {
+        statusSaved++;
+    }
+    return s & mask;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_STATUS_INVALIDATE
+*
+* @brief   Force the next CC2520_STATUS_QUERY to read the status byte. For use
+*          when a radio event may have changed the state behind the shadow.
+*
+* @param   none
+*
+* @return  none
+*/
+void CC2520_STATUS_INVALIDATE(void)
+{
+    statusFresh = FALSE;
+    sfdFresh = FALSE;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SFD_QUERY
+*
+* @brief   SFD bit of FSMSTAT1: a frame is being received or sent. A read made
+*          in the same clock tick answers again while the status shadow is
+*          fresh, i.e. no strobe or DPU instruction came since. A frame that
+*          starts or ends within the tick is seen at the next one, as if the
+*          poll had come that much earlier.
+*
+* @param   uint16_t tick - current time, in ticks of the caller's clock
+*
+* @return  uint8_t - non-zero if SFD is high
+*/
+uint8_t CC2520_SFD_QUERY(uint16_t tick)
+{
+    if (!sfdFresh || !statusFresh || tick != sfdTick) {
+        sfdShadow = CC2520_REGRD8(CC2520_FSMSTAT1) & HI_UINT16(CC2520_FSMSTAT_SFD_BV);
+        sfdTick = tick;
+        sfdFresh = statusFresh;
+    }
+    return sfdShadow;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_STATUS_SAVED
+*
+* @brief   Number of status queries answered without an SPI transaction
+*
+* @param   none
+*
+* @return  uint32_t
+*/
+uint32_t CC2520_STATUS_SAVED(void)
+{
+    uint32_t n;
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    n = statusSaved;
+    __set_interrupt_state(istate);
+    return n;
+}
+
+
+#ifdef CC2520_SPI_DMA
+/***********************************************************************************
+* @fn      CC2520_SPI_DMA_BUSY
+*
+* @brief   Check if a non-blocking DMA transfer is still holding the bus
+*
+* @param   none
+*
+* @return  uint8_t - TRUE if a transfer is in progress
+*/
+uint8_t CC2520_SPI_DMA_BUSY(void)
+{
+    return dmaPending;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SPI_DMA_WAIT
+*
+* @brief   Block until a pending non-blocking DMA transfer has finished
+*
+* @param   none
+*
+* @return  none
+*/
+void CC2520_SPI_DMA_WAIT(void)
+{
+    if (dmaPending) {
+        while (DMA0CTL & DMAEN);
+        CC2520_SPI_DMA_COMPLETE();
+    }
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SPI_DMA_ISR
+*
+* @brief   DMA channel 0 interrupt handler. Must be called from DMA_VECTOR when
+*          DMA0IFG is set.
+*
+* @param   none
+*
+* @return  none
+*/
+void CC2520_SPI_DMA_ISR(void)
+{
+    CC2520_SPI_DMA_COMPLETE();
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_RXBUF_DMA
+*
+* @brief   Read bytes from RX buffer without waiting for the transfer
+*
+* @param   uint8_t count - number of bytes
+*          uint8_t  *pData - data buffer, must stay valid until cb is called
+*          cc2520_dmaCallback_t cb - completion callback
+*
+* @return  uint8_t - status byte
+*/
+uint8_t CC2520_RXBUF_DMA(uint8_t count, uint8_t  *pData, cc2520_dmaCallback_t cb)
+{
+    uint8_t hdr[1];
+    hdr[0] = CC2520_INS_RXBUF;
+    return CC2520_INS_DMA_COMMON(hdr, 1, count, NULL, pData, cb);
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_TXBUF_DMA
+*
+* @brief   Write data to TX buffer without waiting for the transfer
+*
+* @param   uint8_t count - number of bytes
+*          uint8_t  *pData - data buffer, must stay valid until cb is called
+*          cc2520_dmaCallback_t cb - completion callback
+*
+* @return  uint8_t - status byte
+*/
+uint8_t CC2520_TXBUF_DMA(uint8_t count, uint8_t  *pData, cc2520_dmaCallback_t cb)
+{
+    uint8_t hdr[1];
+    hdr[0] = CC2520_INS_TXBUF;
+    return CC2520_INS_DMA_COMMON(hdr, 1, count, pData, NULL, cb);
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_MEMRD_DMA
+*
+* @brief   Read memory without waiting for the transfer
+*
+* @param   uint16_t addr
+*          uint16_t count
+*          uint8_t  *pData - data buffer, must stay valid until cb is called
+*          cc2520_dmaCallback_t cb - completion callback
+*
+* @return  uint8_t - status byte
+*/
+uint8_t CC2520_MEMRD_DMA(uint16_t addr, uint16_t count, uint8_t  *pData, cc2520_dmaCallback_t cb)
+{
+    uint8_t hdr[2];
+    hdr[0] = CC2520_INS_MEMRD | HI_UINT16(addr);
+    hdr[1] = LO_UINT16(addr);
+    return CC2520_INS_DMA_COMMON(hdr, 2, count, NULL, pData, cb);
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_MEMWR_DMA
+*
+* @brief   Write memory without waiting for the transfer
+*
+* @param   uint16_t addr
+*          uint16_t count
+*          uint8_t  *pData - data buffer, must stay valid until cb is called
+*          cc2520_dmaCallback_t cb - completion callback
+*
+* @return  uint8_t - status byte
+*/
+uint8_t CC2520_MEMWR_DMA(uint16_t addr, uint16_t count, uint8_t  *pData, cc2520_dmaCallback_t cb)
+{
+    uint8_t hdr[2];
+    hdr[0] = CC2520_INS_MEMWR | HI_UINT16(addr);
+    hdr[1] = LO_UINT16(addr);
+    CC2520_GPIO_TRACK(addr, count, pData, 0);
+    return CC2520_INS_DMA_COMMON(hdr, 2, count, pData, NULL, cb);
+}
+#endif
+
+
+#ifdef CC2520_SPI_ASYNC
+/***********************************************************************************
+* @fn      CC2520_SPI_ACQUIRE
+*
+* @brief   Take the bus for a blocking instruction or a sequence of them.
+*          Interrupts stay disabled until the matching CC2520_SPI_RELEASE, so
+*          no interrupt handler can start an instruction meanwhile; everything
+*          queued or moved by DMA is completed first, so instructions keep
+*          their order. Calls nest; the queue is held off until the outermost
+*          release.
+*
+* @param   none
+*
+* @return  unsigned short - interrupt state to hand to CC2520_SPI_RELEASE
+*/
+unsigned short CC2520_SPI_ACQUIRE(void)
+{
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    if (spiDepth++ == 0) {
+        // Completion callbacks may issue new instructions; loop until all is idle
+        for (;;) {
+#ifdef CC2520_SPI_DMA
+            CC2520_SPI_DMA_WAIT();
+#endif
+            if (spiCount == 0)
+                break;
+            CC2520_SPI_ASYNC_FLUSH();
+        }
+    }
+    return istate;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SPI_RELEASE
+*
+* @brief   Give the bus back and restore the interrupt state saved by the
+*          matching CC2520_SPI_ACQUIRE. The outermost release starts whatever
+*          was queued meanwhile.
+*
+* @param   unsigned short istate - value returned by CC2520_SPI_ACQUIRE
+*
+* @return  none
+*/
+void CC2520_SPI_RELEASE(unsigned short istate)
+{
+    if (spiDepth && --spiDepth == 0) {
+        CC2520_SPI_QUEUE_KICK();
+    }
+    __set_interrupt_state(istate);
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SPI_ASYNC_ISR
+*
+* @brief   USCI_A1 RX interrupt handler. Stores the byte just received, sends
+*          the next one and starts the next queued instruction when the current
+*          one is complete. Must be called from USCI_A1_VECTOR.
+*
+* @param   none
+*
+* @return  none
+*/
+void CC2520_SPI_ASYNC_ISR(void)
+{
+    spiTrans_t *t;
+    cc2520_spiCallback_t cb;
+    uint8_t rx, s;
+
+    if (spiCount == 0) {
+        UCA1IE &= ~UCRXIE;
+        return;
+    }
+    t = &spiQueue[spiTail];
+    rx = CC2520_SPI_RX();
+    if (spiPos == 0) {
+        spiStatus = rx;
+        CC2520_STATUS_UPDATE(t->hdr[0], rx);
+    } else if (spiPos >= t->hdrLen && t->pRx) {
+        t->pRx[spiPos - t->hdrLen] = rx;
+    }
+
+    if (++spiPos < t->hdrLen + t->count) {
+        if (spiPos < t->hdrLen) {
+            CC2520_SPI_TX_REG = t->hdr[spiPos];
+        } else {
+            CC2520_SPI_TX_REG = t->pTx ? t->pTx[spiPos - t->hdrLen] : 0x00;
+        }
+        return;
+    }
+
+    // Instruction complete: frame the next one before running the callback
+    P5OUT |= BIT5;
+    cb = t->cb;
+    s = spiStatus;
+    spiTail = (spiTail + 1) % CC2520_SPI_QUEUE_LEN;
+    spiRunning = FALSE;
+    if (--spiCount && spiDepth == 0) {
+        CC2520_SPI_QUEUE_START();
+    } else {
+        UCA1IE &= ~UCRXIE;
+    }
+    if (cb) {
+        cb(s);
+    }
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SPI_ASYNC_FLUSH
+*
+* @brief   Complete all queued instructions by polling. Safe with interrupts
+*          disabled, e.g. from another ISR.
+*
+* @param   none
+*
+* @return  none
+*/
+void CC2520_SPI_ASYNC_FLUSH(void)
+{
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    while (spiCount) {
+        // Instructions queued while the bus was held have not been started
+        if (!spiRunning) {
+            CC2520_SPI_QUEUE_START();
+        }
+        while (!CC2520_SPI_RX_IS_READY());
+        CC2520_SPI_ASYNC_ISR();
+    }
+    __set_interrupt_state(istate);
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SPI_ASYNC_PENDING
+*
+* @brief   Number of queued instructions not yet complete
+*
+* @param   none
+*
+* @return  uint8_t
+*/
+uint8_t CC2520_SPI_ASYNC_PENDING(void)
+{
+    return spiCount;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_SPI_SUBMIT
+*
+* @brief   Queue an instruction and return without waiting for it. May be
+*          called from interrupt context.
+*
+* @param   uint8_t *pHdr - opcode and arguments, copied into the queue
+*          uint8_t hdrLen - number of header bytes, 1 to CC2520_SPI_HDR_LEN
+*          uint16_t count - number of data bytes
+*          uint8_t *pTx - data to write, NULL to clock out zeros
+*          uint8_t *pRx - buffer for read data, NULL to discard it
+*          cc2520_spiCallback_t cb - called with the status byte on completion
+*
+*          pTx and pRx must stay valid until the callback has run.
+*
+* @return  uint8_t - TRUE if queued, FALSE if the queue is full
+*/
+uint8_t CC2520_SPI_SUBMIT(uint8_t *pHdr, uint8_t hdrLen, uint16_t count, uint8_t *pTx, \
+    uint8_t *pRx, cc2520_spiCallback_t cb)
+{
+    spiTrans_t *t;
+    unsigned short istate;
+    uint8_t i;
+
+    if (hdrLen == 0 || hdrLen > CC2520_SPI_HDR_LEN)
+        return FALSE;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    if (spiCount == CC2520_SPI_QUEUE_LEN) {
+        __set_interrupt_state(istate);
+        return FALSE;
+    }
+    t = &spiQueue[spiHead];
+    for (i = 0; i < hdrLen; i++) {
+        t->hdr[i] = pHdr[i];
+    }
+    t->hdrLen = hdrLen;
+    t->count = count;
+    t->pTx = pTx;
+    t->pRx = pRx;
+    t->cb = cb;
+    spiHead = (spiHead + 1) % CC2520_SPI_QUEUE_LEN;
+    spiCount++;
+    // Waits for a blocking instruction or a DMA transfer holding CSn
+    CC2520_SPI_QUEUE_KICK();
+    __set_interrupt_state(istate);
+    return TRUE;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_STROBE_ASYNC
+*
+* @brief   Queue a command strobe
+*
+* @param   uint8_t strobe - strobe command
+*          cc2520_spiCallback_t cb - completion callback
+*
+* @return  uint8_t - TRUE if queued, FALSE if the queue is full
+*/
+uint8_t CC2520_STROBE_ASYNC(uint8_t strobe, cc2520_spiCallback_t cb)
+{
+    return CC2520_SPI_SUBMIT(&strobe, 1, 0, NULL, NULL, cb);
 }
 
 
+/***********************************************************************************
+* @fn      CC2520_REGRD_ASYNC
+*
+* @brief   Queue a register read
+*
+* @param  uint8_t addr - address
+*         uint8_t count - number of bytes
+*         uint8_t  *pValues - buffer to store result
+*         cc2520_spiCallback_t cb - completion callback
+*
+* @return  uint8_t - TRUE if queued, FALSE if the queue is full
+*/
+uint8_t CC2520_REGRD_ASYNC(uint8_t addr, uint8_t count, uint8_t  *pValues, cc2520_spiCallback_t cb)
+{
+    uint8_t hdr[1];
+    hdr[0] = CC2520_INS_REGRD | addr;
+    return CC2520_SPI_SUBMIT(hdr, 1, count, NULL, pValues, cb);
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_REGWR_ASYNC
+*
+* @brief   Queue a register write. Can only be started from addresses below 0x40
+*
+* @param  uint8_t addr - address
+*         uint8_t count - number of bytes
+*         uint8_t  *pValues - data buffer
+*         cc2520_spiCallback_t cb - completion callback
+*
+* @return  uint8_t - TRUE if queued, FALSE if the queue is full
+*/
+uint8_t CC2520_REGWR_ASYNC(uint8_t addr, uint8_t count, uint8_t  *pValues, cc2520_spiCallback_t cb)
+{
+    uint8_t hdr[1];
+    hdr[0] = CC2520_INS_REGWR | addr;
+    if (!CC2520_SPI_SUBMIT(hdr, 1, count, pValues, NULL, cb))
+        return FALSE;
+    CC2520_GPIO_TRACK(addr, count, pValues, 0);
+    return TRUE;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_MEMRD_ASYNC
+*
+* @brief   Queue a memory read
+*
+* @param   uint16_t addr
+*          uint16_t count
+*          uint8_t  *pData
+*          cc2520_spiCallback_t cb - completion callback
+*
+* @return  uint8_t - TRUE if queued, FALSE if the queue is full
+*/
+uint8_t CC2520_MEMRD_ASYNC(uint16_t addr, uint16_t count, uint8_t  *pData, cc2520_spiCallback_t cb)
+{
+    uint8_t hdr[2];
+    hdr[0] = CC2520_INS_MEMRD | HI_UINT16(addr);
+    hdr[1] = LO_UINT16(addr);
+    return CC2520_SPI_SUBMIT(hdr, 2, count, NULL, pData, cb);
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_MEMWR_ASYNC
+*
+* @brief   Queue a memory write
+*
+* @param   uint16_t addr
+*          uint16_t count
+*          uint8_t  *pData
+*          cc2520_spiCallback_t cb - completion callback
+*
+* @return  uint8_t - TRUE if queued, FALSE if the queue is full
+*/
+uint8_t CC2520_MEMWR_ASYNC(uint16_t addr, uint16_t count, uint8_t  *pData, cc2520_spiCallback_t cb)
+{
+    uint8_t hdr[2];
+    hdr[0] = CC2520_INS_MEMWR | HI_UINT16(addr);
+    hdr[1] = LO_UINT16(addr);
+    if (!CC2520_SPI_SUBMIT(hdr, 2, count, pData, NULL, cb))
+        return FALSE;
+    CC2520_GPIO_TRACK(addr, count, pData, 0);
+    return TRUE;
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_RXBUF_ASYNC
+*
+* @brief   Queue a read from the RX buffer
+*
+* @param   uint8_t count
+*          uint8_t  *pData
+*          cc2520_spiCallback_t cb - completion callback
+*
+* @return  uint8_t - TRUE if queued, FALSE if the queue is full
+*/
+uint8_t CC2520_RXBUF_ASYNC(uint8_t count, uint8_t  *pData, cc2520_spiCallback_t cb)
+{
+    uint8_t hdr[1];
+    hdr[0] = CC2520_INS_RXBUF;
+    return CC2520_SPI_SUBMIT(hdr, 1, count, NULL, pData, cb);
+}
+
+
+/***********************************************************************************
+* @fn      CC2520_TXBUF_ASYNC
+*
+* @brief   Queue a write to the TX buffer
+*
+* @param   uint8_t count
+*          uint8_t  *pData
+*          cc2520_spiCallback_t cb - completion callback
+*
+* @return  uint8_t - TRUE if queued, FALSE if the queue is full
+*/
+uint8_t CC2520_TXBUF_ASYNC(uint8_t count, uint8_t  *pData, cc2520_spiCallback_t cb)
+{
+    uint8_t hdr[1];
+    hdr[0] = CC2520_INS_TXBUF;
+    return CC2520_SPI_SUBMIT(hdr, 1, count, pData, NULL, cb);
+}
+#endif
+
 
 /***********************************************************************************
   Copyright 2007 Texas Instruments Incorporated. All rights reserved.
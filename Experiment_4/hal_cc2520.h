@@ -11,10 +11,21 @@
 * INCLUDES
 */
 #include <inttypes.h>
+#ifdef CC2520_HOST
+#include "host/hal_cc2520_host.h"
+#else
 #include <msp430f5435.h>
+#endif
 
-/* Some general purpose definitions */
+/* Some general purpose definitions. CC2520_NO_PA builds for a board without
+   the CC2590 range extender, where GPIO3 carries SFD */
+#ifndef CC2520_NO_PA
 #define INCLUDE_PA	1
+#endif
+/* Opt-in SPI engines, off until a driver path uses them:
+   -DCC2520_SPI_DMA moves bulk SPI transfers (RXBUF, TXBUF, MEMRD, MEMWR...) with
+   the DMA controller, -DCC2520_SPI_ASYNC queues CC2520 instructions and moves
+   them with the USCI_A1 interrupt */
 
 #ifndef TRUE
 #define TRUE 1
@@ -80,12 +91,53 @@ typedef unsigned long u32_t;
 #define CC2520_SPI_RX_IS_READY()        (UCA1IFG & UCRXIFG)
 #define CC2520_SPI_RX_NOT_READY()       (UCA1IFG &= ~UCRXIFG)
 
-// SPI access macros
-#define CC2520_SPI_BEGIN()              P5OUT &= ~BIT5 		//st( MCU_IO_SET(5,5,0); )
+// SPI access macros. The bus lock keeps interrupts disabled from
+// CC2520_SPI_LOCK to CC2520_SPI_UNLOCK, so no interrupt handler can start an
+// instruction inside another one or inside a sequence that must not be split.
+// s holds the interrupt state saved by each call; locks nest.
+#if defined CC2520_SPI_ASYNC
+// Also completes the queue and any DMA transfer, and holds the queue off until
+// the outermost unlock
+#define CC2520_SPI_LOCK(s)              st( (s) = CC2520_SPI_ACQUIRE(); )
+#define CC2520_SPI_UNLOCK(s)            CC2520_SPI_RELEASE(s)
+#elif defined CC2520_SPI_DMA
+// Also waits for a non-blocking DMA transfer to finish
+#define CC2520_SPI_LOCK(s)              st( (s) = __get_interrupt_state(); __disable_interrupt(); \
+                                            CC2520_SPI_DMA_WAIT(); )
+#define CC2520_SPI_UNLOCK(s)            __set_interrupt_state(s)
+#else
+#define CC2520_SPI_LOCK(s)              st( (s) = __get_interrupt_state(); __disable_interrupt(); )
+#define CC2520_SPI_UNLOCK(s)            __set_interrupt_state(s)
+#endif
+#define CC2520_SPI_BEGIN(s)             st( CC2520_SPI_LOCK(s); P5OUT &= ~BIT5; )
 #define CC2520_SPI_TX(x)                st( CC2520_SPI_RX_NOT_READY(); CC2520_SPI_TX_REG = x; )
 #define CC2520_SPI_RX()                 (CC2520_SPI_RX_REG)
 #define CC2520_SPI_WAIT_RXRDY()         st( while (!CC2520_SPI_RX_IS_READY()); )
-#define CC2520_SPI_END()                P5OUT |= BIT5 		//st( MCU_IO_SET(5,5,1); )
+#define CC2520_SPI_END(s)               st( P5OUT |= BIT5; CC2520_SPI_UNLOCK(s); )
+
+#ifdef CC2520_SPI_DMA
+// SPI DMA engine: channel 0 drains UCA1RXBUF and has priority over channel 1,
+// which feeds UCA1TXBUF. Both channels are reserved for the radio HAL.
+#define CC2520_DMA_TSEL_UCA1RX          20
+#define CC2520_DMA_TSEL_UCA1TX          21
+// Arrays shorter than this are cheaper to move by polling than to set up
+#define CC2520_DMA_MIN_COUNT            8
+#ifdef CC2520_HOST
+#define CC2520_DMA_SET_ADDR(reg, ptr)   ((reg) = (uintptr_t)(ptr))
+#define CC2520_SPI_TX_ADDR              cc2520sim_txbufAddr()
+#define CC2520_SPI_RX_ADDR              cc2520sim_rxbufAddr()
+#else
+#define CC2520_DMA_SET_ADDR(reg, ptr)   __data16_write_addr((unsigned short)&(reg), (unsigned long)(ptr))
+#define CC2520_SPI_TX_ADDR              (&CC2520_SPI_TX_REG)
+#define CC2520_SPI_RX_ADDR              (&CC2520_SPI_RX_REG)
+#endif
+#endif
+
+#ifdef CC2520_SPI_ASYNC
+// Number of queued instructions, and longest opcode + argument header
+#define CC2520_SPI_QUEUE_LEN            8
+#define CC2520_SPI_HDR_LEN              8
+#endif
 
 // Outputs: SPI interface
 
@@ -125,17 +177,18 @@ typedef unsigned long u32_t;
                         if (pin == 4) P2DIR &= ~BIT4; \
                             if (pin == 5) P2DIR &= ~BIT5; \
                                 )
-// Configure a GPIO pin 'n' as output bound to the function 'fn'
+// Configure a GPIO pin 'n' as output bound to the function 'fn'. GPIOCTRLn is
+// only written when the function differs from the one in the HAL shadow.
 
  #define CC2520_CFG_GPIO_OUT(n, fn) \
     st( \
-        CC2520_REGWR8(CC2520_GPIOCTRL0 + (n), (fn)); \
+        CC2520_GPIO_SET_FUNC((n), (fn)); \
             CC2520_GPIO_DIR_OUT(n); \
                 )
            
 // Read exception map
 #define CC2520_GET_EXC(dwMap) \
-    CC2520_REGRD(CC2520_EXCFLAG0, 4, (uint8  *)&(dwMap))
+    st( (dwMap) = CC2520_EXC_SNAPSHOT(); )
 
 // Read FSM state value
 #define CC2520_GET_FSM_STATE() \
@@ -181,6 +234,9 @@ typedef unsigned long u32_t;
 
 #define CC2520_MEMORY_SIZE                  0x400
 
+// MCU cycles per microsecond, for HAL busy waits
+#define CC2520_MCU_USECOND                  16
+
 // Startup time values (in microseconds)
 #define CC2520_XOSC_MAX_STARTUP_TIME        300
 #define CC2520_VREG_MAX_STARTUP_TIME        200
@@ -348,13 +404,18 @@ typedef unsigned long u32_t;
 #define CC2520_EXC_RX_FRM_ABORTED      21
 #define CC2520_EXC_RXBUFMOV_TIMEOUT    22
 
+#define CC2520_EXC_COUNT               23
+
+// Exception 'n' in the 24-bit EXCFLAG0-2 map
+#define CC2520_EXC_BV(n)               (1UL << (n))
+
 // Predefined exception channels
 #define CC2520_EXC_CH_RX_BV           \
-    (BV(CC2520_EXC_RX_UNDERFLOW) | BV(CC2520_EXC_RX_OVERFLOW) \
-        | BV(CC2520_EXC_RX_FRM_ABORTED) | BV(CC2520_EXC_RXBUFMOV_TIMEOUT))
+    (CC2520_EXC_BV(CC2520_EXC_RX_UNDERFLOW) | CC2520_EXC_BV(CC2520_EXC_RX_OVERFLOW) \
+        | CC2520_EXC_BV(CC2520_EXC_RX_FRM_ABORTED) | CC2520_EXC_BV(CC2520_EXC_RXBUFMOV_TIMEOUT))
 #define CC2520_EXC_CH_ERR_BV          \
-    (BV(CC2520_EXC_MEMADDR_ERROR) | BV(CC2520_EXC_USAGE_ERROR) \
-        | BV(CC2520_EXC_OPERAND_ERROR) | BV(CC2520_EXC_SPI_ERROR))
+    (CC2520_EXC_BV(CC2520_EXC_MEMADDR_ERROR) | CC2520_EXC_BV(CC2520_EXC_USAGE_ERROR) \
+        | CC2520_EXC_BV(CC2520_EXC_OPERAND_ERROR) | CC2520_EXC_BV(CC2520_EXC_SPI_ERROR))
 
 // CC2520 FSM state defintions
 #define CC2520_FSM_IDLE                 0
@@ -571,4 +632,63 @@ void   CC2520_REGWR16(uint8_t addr, uint16_t value);
 void   CC2520_REGWR24(uint8_t addr, uint32_t value);
 uint8_t  CC2520_INS_STROBE(uint8_t strobe);
 
+// Exception engine: one EXCFLAG0-2 snapshot per event, handlers per exception
+typedef void (*cc2520_excHandler_t)(uint8_t exc);
+
+uint32_t CC2520_EXC_SNAPSHOT(void);
+uint32_t CC2520_EXC_CACHED(void);
+uint32_t CC2520_EXC_EVENT(void);
+void     CC2520_EXC_CLEAR(uint32_t dwMap);
+void     CC2520_EXC_REGISTER(uint8_t exc, cc2520_excHandler_t handler);
+uint32_t CC2520_EXC_DISPATCH(void);
+
+// GPIO function shadow, written only on change
+#define CC2520_GPIO_COUNT               6
+uint8_t  CC2520_GPIO_SET_FUNC(uint8_t n, uint8_t fn);
+uint8_t  CC2520_GPIO_GET_FUNC(uint8_t n);
+void     CC2520_GPIO_SEED(uint8_t n, uint8_t fn);
+void     CC2520_GPIO_INVALIDATE(void);
+uint16_t CC2520_GPIO_WRITES(void);
+
+// Status byte shadow, updated by every instruction
+uint8_t  CC2520_STATUS_QUERY(uint8_t mask);
+void     CC2520_STATUS_INVALIDATE(void);
+uint32_t CC2520_STATUS_SAVED(void);
+uint8_t  CC2520_SFD_QUERY(uint16_t tick);
+
+#ifdef CC2520_SPI_DMA
+// Non-blocking DMA transfers. The callback gets the instruction status byte.
+typedef void (*cc2520_dmaCallback_t)(uint8_t status);
+
+uint8_t  CC2520_SPI_DMA_BUSY(void);
+void     CC2520_SPI_DMA_WAIT(void);
+void     CC2520_SPI_DMA_ISR(void);
+uint8_t  CC2520_RXBUF_DMA(uint8_t count, uint8_t  *pData, cc2520_dmaCallback_t cb);
+uint8_t  CC2520_TXBUF_DMA(uint8_t count, uint8_t  *pData, cc2520_dmaCallback_t cb);
+uint8_t  CC2520_MEMRD_DMA(uint16_t addr, uint16_t count, uint8_t  *pData, cc2520_dmaCallback_t cb);
+uint8_t  CC2520_MEMWR_DMA(uint16_t addr, uint16_t count, uint8_t  *pData, cc2520_dmaCallback_t cb);
+#endif
+
+#ifdef CC2520_SPI_ASYNC
+// Queued instructions, moved one byte per USCI_A1 RX interrupt. Instructions
+// run in submission order and each one keeps CSn low from opcode to last byte.
+// The callback gets the instruction status byte and runs in interrupt context.
+typedef void (*cc2520_spiCallback_t)(uint8_t status);
+
+unsigned short CC2520_SPI_ACQUIRE(void);
+void     CC2520_SPI_RELEASE(unsigned short istate);
+void     CC2520_SPI_ASYNC_ISR(void);
+void     CC2520_SPI_ASYNC_FLUSH(void);
+uint8_t  CC2520_SPI_ASYNC_PENDING(void);
+uint8_t  CC2520_SPI_SUBMIT(uint8_t *pHdr, uint8_t hdrLen, uint16_t count, uint8_t *pTx, \
+    uint8_t *pRx, cc2520_spiCallback_t cb);
+uint8_t  CC2520_STROBE_ASYNC(uint8_t strobe, cc2520_spiCallback_t cb);
+uint8_t  CC2520_REGRD_ASYNC(uint8_t addr, uint8_t count, uint8_t  *pValues, cc2520_spiCallback_t cb);
+uint8_t  CC2520_REGWR_ASYNC(uint8_t addr, uint8_t count, uint8_t  *pValues, cc2520_spiCallback_t cb);
+uint8_t  CC2520_MEMRD_ASYNC(uint16_t addr, uint16_t count, uint8_t  *pData, cc2520_spiCallback_t cb);
+uint8_t  CC2520_MEMWR_ASYNC(uint16_t addr, uint16_t count, uint8_t  *pData, cc2520_spiCallback_t cb);
+uint8_t  CC2520_RXBUF_ASYNC(uint8_t count, uint8_t  *pData, cc2520_spiCallback_t cb);
+uint8_t  CC2520_TXBUF_ASYNC(uint8_t count, uint8_t  *pData, cc2520_spiCallback_t cb);
+#endif
+
 #endif
@@ -0,0 +1,152 @@
+/***********************************************************************************
+
+  Filename:     bench_ringbuf.c
+
+  Description:  Bytes per cycle of bufPut(), bufPeek() and bufGet() for 1-,
+                16- and 127-byte operations, against the per-byte loops
+                through the volatile data pointer they replaced. Each pass
+                fills the ring with puts, peeks at its head as often and
+                drains it with gets, timing each batch. A pass moves the
+                indices by less than the ring length, so the batches keep
+                crossing the wrap point at different places. The best of
+                PASSES passes is printed. Checks that both versions return
+                the bytes put in.
+
+***********************************************************************************/
+#include <string.h>
+#include "sense_utils.h"
+#include "host_test.h"
+
+#define RING_LEN        512             // As the byte ring in cc2520ll
+#define PASSES          2000
+
+typedef uint16_t (*bufOp_t)(ringBuf_t *pBuf, uint8_t *pData, uint16_t n);
+
+typedef struct {
+    const char *name;
+    uint16_t (*put)(ringBuf_t *pBuf, const uint8_t *pData, uint16_t n);
+    bufOp_t peek;
+    bufOp_t get;
+} impl_t;
+
+static uint8_t ringData[RING_LEN];
+static ringBuf_t ring;
+
+static uint16_t count(ringBuf_t *pBuf)
+{
+    uint16_t head = pBuf->iHead, tail = pBuf->iTail;
+
+    return (tail >= head) ? tail - head : pBuf->len - head + tail;
+}
+
+// Before: one byte per iteration, wrap checked every byte
+static __attribute__((noinline)) uint16_t bytePut(ringBuf_t *pBuf, const uint8_t *pData, uint16_t nBytes)
+{
+    volatile uint8_t *pRing = pBuf->pData;
+    uint16_t i, tail;
+
+    tail = pBuf->iTail;
+    if (count(pBuf) + nBytes >= pBuf->len)
+        return 0;
+    for (i = 0; i < nBytes; i++) {
+        pRing[tail] = pData[i];
+        tail++;
+        if (tail == pBuf->len)
+            tail = 0;
+    }
+    pBuf->iTail = tail;
+    return i;
+}
+
+static __attribute__((noinline)) uint16_t byteGet(ringBuf_t *pBuf, uint8_t *pData, uint16_t nBytes)
+{
+    volatile uint8_t *pRing = pBuf->pData;
+    uint16_t i, head, n;
+
+    head = pBuf->iHead;
+    n = count(pBuf);
+    for (i = 0; i < nBytes && i < n; i++) {
+        pData[i] = pRing[head];
+        head++;
+        if (head == pBuf->len)
+            head = 0;
+    }
+    pBuf->iHead = head;
+    return i;
+}
+
+static __attribute__((noinline)) uint16_t bytePeek(ringBuf_t *pBuf, uint8_t *pData, uint16_t nBytes)
+{
+    volatile uint8_t *pRing = pBuf->pData;
+    uint16_t i, j, n;
+
+    j = pBuf->iHead;
+    n = count(pBuf);
+    for (i = 0; i < nBytes && i < n; i++) {
+        pData[i] = pRing[j];
+        j++;
+        if (j == pBuf->len)
+            j = 0;
+    }
+    return i;
+}
+
+static const impl_t impls[] = {
+    { "per byte", bytePut, bytePeek, byteGet },
+    { "blocks", bufPut, bufPeek, bufGet },
+};
+
+// Best bytes per cycle of each operation over PASSES passes
+static void run(const impl_t *pImpl, uint8_t n, double *pPut, double *pPeek, double *pGet)
+{
+    uint8_t in[128], out[128];
+    uint64_t start, put, peek, get;
+    uint16_t ops, i, p;
+    uint32_t bad = 0;
+
+    for (i = 0; i < n; i++)
+        in[i] = (uint8_t)(i * 7 + n);
+    ops = (RING_LEN - 1) / n;
+    *pPut = *pPeek = *pGet = 0;
+    for (p = 0; p < PASSES; p++) {
+        start = HOST_CYCLES();
+        for (i = 0; i < ops; i++)
+            pImpl->put(&ring, in, n);
+        put = HOST_CYCLES() - start;
+        start = HOST_CYCLES();
+        for (i = 0; i < ops; i++)
+            pImpl->peek(&ring, out, n);
+        peek = HOST_CYCLES() - start;
+        start = HOST_CYCLES();
+        for (i = 0; i < ops; i++)
+            pImpl->get(&ring, out, n);
+        get = HOST_CYCLES() - start;
+        if (count(&ring) != 0 || memcmp(in, out, n) != 0)
+            bad++;
+        if ((double)ops * n / put > *pPut)
+            *pPut = (double)ops * n / put;
+        if ((double)ops * n / peek > *pPeek)
+            *pPeek = (double)ops * n / peek;
+        if ((double)ops * n / get > *pGet)
+            *pGet = (double)ops * n / get;
+    }
+    CHECK_EQ(bad, 0);
+}
+
+int main(void)
+{
+    static const uint8_t sizes[] = { 1, 16, 127 };
+    double put, peek, get;
+    uint8_t s, k;
+
+    bufInit(&ring, ringData, RING_LEN);
+    printf("Bytes per unit of time (" HOST_CYCLE_UNIT "), best of %u passes\n", PASSES);
+    printf("            size     put    peek     get\n");
+    for (s = 0; s < sizeof(sizes); s++) {
+        for (k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+            run(&impls[k], sizes[s], &put, &peek, &get);
+            printf("%-9s %7u %7.3f %7.3f %7.3f\n", impls[k].name, sizes[s], put, peek, get);
+        }
+    }
+    TEST_DONE("bench_ringbuf");
+}
@@ -0,0 +1,184 @@
+/***********************************************************************************
+
+  Filename:     bench_rxq.c
+
+  Description:  Received frame queue (cc2520ll_frame_t slots) against the
+                sense_utils byte ring it replaced. The RX interrupt used to
+                read a frame into a staging buffer and bufPut() its length
+                byte and MPDU; the reader took them out with two bufGet()
+                calls. It now reads straight into the tail slot and fills in
+                RSSI and LQI, and the reader copies the MPDU out of the head
+                slot. The RX FIFO is a volatile array here, so both sides pay
+                the same for the SPI reads.
+
+                Prints the mean and worst interrupt-side cost per frame and
+                the frames per second through both queues, for short, medium
+                and full frames. The worst case is the median over ROUNDS
+                rounds of the largest cost seen in a round, which leaves out
+                the rounds in which the host preempted the benchmark. Checks
+                that every frame comes out as it went in.
+
+***********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cc2520ll.h"
+#include "sense_utils.h"
+#include "host_test.h"
+
+#define FRAMES          200000
+#define ROUNDS          100
+#define RING_LEN        512             // As the byte ring in cc2520ll
+
+typedef struct {
+    uint64_t sum;
+    uint64_t worst;
+    uint64_t ns;
+    uint32_t bad;               // Frames that did not come out as they went in
+} result_t;
+
+static volatile uint8_t rxFifo[128];
+static uint8_t rxMpdu[128];
+static uint8_t ringData[RING_LEN];
+static ringBuf_t ring;
+static cc2520ll_frame_t rxQueue[CC2520_RXQ_SLOTS];
+static volatile uint8_t rxqHead, rxqTail;
+
+static void readRxFifo(uint8_t *pData, uint8_t n, uint8_t offset)
+{
+    uint8_t i;
+
+    for (i = 0; i < n; i++)
+        pData[i] = rxFifo[offset + i];
+}
+
+static int cmpCycles(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Before: staging buffer, then length byte and MPDU into the byte ring
+static void ringIsr(void)
+{
+    uint8_t len;
+
+    readRxFifo(rxMpdu, 1, 0);
+    len = rxMpdu[0];
+    readRxFifo(&rxMpdu[1], len, 1);
+    if ((rxMpdu[len] & CC2520_CRC_OK_BM) && RING_LEN - 1 - bufNumBytes(&ring) >= len + 1u)
+        bufPut(&ring, rxMpdu, len + 1);
+}
+
+static uint8_t ringRead(uint8_t *pPacket)
+{
+    uint8_t len = 0;
+
+    if (bufNumBytes(&ring)) {
+        bufGet(&ring, &len, 1);
+        len = bufGet(&ring, pPacket, len);
+    }
+    return len;
+}
+
+// Now: straight into the tail slot
+static void slotIsr(void)
+{
+    cc2520ll_frame_t *pFrame;
+    uint8_t len;
+
+    if ((uint8_t)(rxqTail - rxqHead) == CC2520_RXQ_SLOTS)
+        return;
+    pFrame = &rxQueue[rxqTail & (CC2520_RXQ_SLOTS - 1)];
+    readRxFifo(pFrame->mpdu, 1, 0);
+    len = pFrame->mpdu[0];
+    readRxFifo(&pFrame->mpdu[1], len, 1);
+    if (!(pFrame->mpdu[len] & CC2520_CRC_OK_BM))
+        return;
+    pFrame->timestamp = 0;
+    pFrame->rssi = (int8_t)pFrame->mpdu[len - 1];
+    pFrame->lqi = pFrame->mpdu[len] & ~CC2520_CRC_OK_BM;
+    rxqTail++;
+}
+
+static uint8_t slotRead(uint8_t *pPacket)
+{
+    cc2520ll_frame_t *pFrame;
+    uint8_t len;
+
+    if (rxqHead == rxqTail)
+        return 0;
+    pFrame = &rxQueue[rxqHead & (CC2520_RXQ_SLOTS - 1)];
+    len = pFrame->mpdu[0];
+    memcpy(pPacket, &pFrame->mpdu[1], len);
+    rxqHead++;
+    return len;
+}
+
+static void run(void (*isr)(void), uint8_t (*read)(uint8_t *), uint8_t len, result_t *pResult)
+{
+    uint8_t packet[128];
+    uint64_t start, cost, worst[ROUNDS];
+    uint32_t k;
+    uint8_t r;
+
+    pResult->sum = 0;
+    pResult->bad = 0;
+    pResult->ns = nowNs();
+    for (r = 0; r < ROUNDS; r++) {
+        worst[r] = 0;
+        for (k = 0; k < FRAMES / ROUNDS; k++) {
+            rxFifo[1] = (uint8_t)k;
+            start = HOST_CYCLES();
+            isr();
+            cost = HOST_CYCLES() - start;
+            pResult->sum += cost;
+            if (cost > worst[r])
+                worst[r] = cost;
+            if (read(packet) != len || packet[0] != (uint8_t)k || packet[len - 2] != rxFifo[len - 1])
+                pResult->bad++;
+        }
+    }
+    pResult->ns = nowNs() - pResult->ns;
+    qsort(worst, ROUNDS, sizeof(worst[0]), cmpCycles);
+    pResult->worst = worst[ROUNDS / 2];
+}
+
+int main(void)
+{
+    static const uint8_t lens[] = { 10, 30, 127 };
+    result_t ringRes, slotRes;
+    uint8_t i, n, len;
+
+    bufInit(&ring, ringData, RING_LEN);
+    for (n = 0; n < sizeof(lens); n++) {
+        len = lens[n];
+        rxFifo[0] = len;
+        for (i = 2; i <= len; i++)
+            rxFifo[i] = i;
+        rxFifo[len - 1] = (uint8_t)-40;             // RSSI
+        rxFifo[len] = CC2520_CRC_OK_BM | 100;       // CRC_OK, correlation
+
+        run(ringIsr, ringRead, len, &ringRes);
+        run(slotIsr, slotRead, len, &slotRes);
+        CHECK_EQ(ringRes.bad, 0);
+        CHECK_EQ(slotRes.bad, 0);
+        CHECK_EQ(bufNumBytes(&ring), 0);
+        CHECK_EQ(rxqHead, rxqTail);
+        printf("%3u-byte frames, ISR " HOST_CYCLE_UNIT " mean/worst: byte ring %.0f/%llu, slots %.0f/%llu; " \
+            "frames/s: byte ring %.2fM, slots %.2fM\n", len, \
+            (double)ringRes.sum / FRAMES, (unsigned long long)ringRes.worst, \
+            (double)slotRes.sum / FRAMES, (unsigned long long)slotRes.worst, \
+            FRAMES * 1e3 / ringRes.ns, FRAMES * 1e3 / slotRes.ns);
+    }
+    TEST_DONE("bench_rxq");
+}
@@ -0,0 +1,1530 @@
+/***********************************************************************************
+
+  Filename:     hal_cc2520_host.c
+
+  Description:  Simulated CC2520 for host builds of the radio HAL. Models the
+                SPI instruction set, register file and RAM, the 128-byte RX
+                and TX FIFOs, exception flags, GPIO mapping and status byte,
+                plus the USCI_A1, DMA, Timer_A1 and port pins the HAL
+                drives.
+
+                Time advances with SPI traffic, __delay_cycles and
+                cc2520sim_advance(). A low power mode entered with
+                __bis_SR_register() skips ahead to the next timer compare.
+
+                The radio FSM is reduced to IDLE, RX and TX: STXON keeps
+                TX_ACTIVE for the turnaround and airtime, then hands the
+                frame to the TX hook and raises TX_FRM_DONE. The TX FIFO is
+                radio RAM at 0x100, so MEMWR can change a frame until it
+                ends. As on the chip, the sent frame stays in the TX FIFO
+                for another STXON until the next write flushes it. With
+                GPIO3 on SFD and P2.3 selected, TA1CCR2 in capture mode
+                latches the end of the SFD field of frames sent and
+                received. An optional peer
+                acknowledges frames that request it (cc2520sim_setPeerAck).
+                Injected frames pass the FRMFILT0/FRMFILT1 frame filter.
+                DPU crypto instructions are decoded and raise DPU_DONE but
+                do not transform data; UCCM and UCBCMAC always authenticate.
+
+***********************************************************************************/
+
+/***********************************************************************************
+* INCLUDES
+*/
+#include <string.h>
+#include "cc2520ll.h"
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+#define SIM_MCLK_KHZ            16000       // MCLK and SMCLK
+#define SIM_ACLK_HZ             32768       // Timer_A1
+#define SIM_FIFO_LEN            128
+#define SIM_MEM_LEN             0x400
+#define SIM_CHIPID              0x84
+
+#define SIM_CS_PIN              BIT5        // P5.5
+#define SIM_MISO_PIN            BIT7        // P5.7
+#define SIM_RESET_PIN           BIT1        // P4.1
+#define SIM_TX_TURNAROUND_US    192         // 12 symbols
+#define SIM_BYTE_US             32          // 2 symbols
+#define SIM_ACK_US              (SIM_TX_TURNAROUND_US + 11 * SIM_BYTE_US)  // Turnaround and ACK frame
+#define SIM_XOSC_STARTUP_US     200         // SXOSCON to XOSC stable
+#define SIM_PEER_AWAKE_US       10000       // Duty-cycled peer stays in RX after activity
+#define SIM_FLASH_BASE          0x1800      // Information memory D-A
+#define SIM_FLASH_LEN           0x200
+#define SIM_FLASH_SEG_LEN       128
+#define SIM_FLASH_WRITE_US      64          // Word write, block write not modeled
+#define SIM_FLASH_ERASE_US      23000       // Segment erase
+
+#define SIM_STATE_IDLE          0
+#define SIM_STATE_RX            1
+
+/***********************************************************************************
+* REGISTERS
+*/
+volatile uint8_t UCA1CTL0, UCA1CTL1, UCA1BR0, UCA1BR1, UCA1IE;
+volatile uint8_t P2OUT, P2DIR, P2SEL, P2IE, P2IES, P2IFG;
+volatile uint8_t P3OUT, P3DIR, P3SEL;
+volatile uint8_t P4OUT, P4DIR;
+volatile uint8_t P5DIR, P5SEL;
+volatile uint16_t DMACTL0, DMACTL4, DMA1CTL, DMA0SZ, DMA1SZ;
+volatile uintptr_t DMA0SA, DMA0DA, DMA1SA, DMA1DA;
+volatile uint16_t TA1CTL, cc2520simTa1cctl[3], cc2520simTa1ccr[3];
+volatile uint16_t FCTL1, FCTL3 = LOCK;
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static volatile uint8_t regTx, regRx, regIfg, regP5out;
+static volatile uint16_t regDma0ctl;
+static uint8_t txPending;                   // UCA1TXBUF written, byte not yet moved
+static uint8_t csSeenHigh;                  // CSn was high since the last byte
+static uint8_t inReset;
+static unsigned short gie;
+static uint8_t inIsr;
+static cc2520sim_isr_t isr[CC2520SIM_IRQ_COUNT];
+static uint64_t nowNs;                      // Simulated time
+static uint64_t timerBase;                  // ACLK tick at which TA1R was 0
+static uint64_t timerSeen;                  // Last ACLK tick checked for compares
+static volatile uint16_t regTa1r;
+static uint8_t woken;                       // An ISR asked to leave the low power mode
+
+// Radio
+static uint8_t mem[SIM_MEM_LEN];            // Registers (0x000-0x07F) and RAM
+static uint8_t flashInv[SIM_FLASH_LEN];     // Information memory, inverted so that 0 is erased
+static uint8_t rxFifo[SIM_FIFO_LEN], rxHead, rxCount;
+static uint8_t *const txFifo = mem + CC2520_RAM_TXBUF;
+static uint8_t txCount;
+static uint8_t state, xoscOn, cca, sampledCca;
+static uint64_t xoscReadyNs, xoscOnNs;      // Crystal stable from, on since
+static uint8_t xoscFail;                    // See cc2520sim_setXoscFail
+static uint8_t txOnAir;                     // Frame sent until txEndNs
+static uint64_t txEndNs;
+static uint8_t txSfdDue;                    // Its SFD is on air at txSfdNs
+static uint64_t txSfdNs;
+static uint8_t txHookLen;
+static uint8_t txRefill;                    // Sent frame kept, flushed by the next write
+static uint8_t peerAck, peerMiss;           // See cc2520sim_setPeerAck
+static uint8_t ackDue, ackSeq;              // Peer ACK received at ackAtNs
+static uint64_t peerIntervalNs, peerListenNs, peerPhaseNs;  // See cc2520sim_setPeerLpl
+static uint64_t peerAwakeNs;                // Duty-cycled peer in RX until
+static uint64_t ackAtNs;
+static uint8_t pinLevel;                    // GPIO0-5 as seen on P2.0-P2.5
+static uint16_t lfsr;
+static int8_t noiseFloor[16], noisePeak[16];    // See cc2520sim_setNoise
+static uint8_t noiseBusy[16];
+static cc2520sim_txHook_t txHook;
+
+// Instruction decoder
+static uint8_t insOp;
+static uint16_t insPos, insAddr;
+static uint8_t insArg[8];
+
+static cc2520sim_stats_t stats;
+
+/***********************************************************************************
+* LOCAL FUNCTIONS
+*/
+static void simRadioReset(void);
+static void simUpdatePins(void);
+static void simDeliver(void);
+static uint8_t cc2520sim_ta1iv_pending(void);
+static void simTxUpdate(void);
+static void simCapture(uint64_t sfdNs);
+static uint64_t simNextEvent(void);
+static uint8_t simFilter(const uint8_t *pMpdu, uint8_t len);
+
+/***********************************************************************************
+* @fn      simExcSet
+*
+* @brief   Raise exception n
+*/
+static void simExcSet(uint8_t n)
+{
+    mem[CC2520_EXCFLAG0 + (n >> 3)] |= 1 << (n & 0x07);
+}
+
+/***********************************************************************************
+* @fn      simExcMap
+*
+* @brief   24-bit exception map
+*/
+static uint32_t simExcMap(uint16_t base)
+{
+    return mem[base] | ((uint32_t)mem[base + 1] << 8) | ((uint32_t)mem[base + 2] << 16);
+}
+
+/***********************************************************************************
+* @fn      simXoscStable
+*
+* @brief   Has the crystal oscillator settled?
+*/
+static uint8_t simXoscStable(void)
+{
+    return xoscOn && !xoscFail && nowNs >= xoscReadyNs;
+}
+
+/***********************************************************************************
+* @fn      simXoscSwitch
+*
+* @brief   Turn the crystal oscillator on or off, counting its on time
+*/
+static void simXoscSwitch(uint8_t on)
+{
+    if (on && !xoscOn) {
+        xoscOnNs = nowNs;
+        xoscReadyNs = nowNs + (uint64_t)SIM_XOSC_STARTUP_US * 1000;
+    } else if (!on && xoscOn) {
+        stats.xoscOnUs += (uint32_t)((nowNs - xoscOnNs) / 1000);
+        state = SIM_STATE_IDLE;
+    }
+    xoscOn = on;
+}
+
+/***********************************************************************************
+* @fn      simPeerAwake
+*
+* @brief   Does the duty-cycled peer receive a whole frame sent from startNs to
+*          endNs? It does if it is in RX when the frame starts: within the
+*          listening time of its last wake-up, or kept awake by earlier
+*          frames. A frame already on air when the peer wakes keeps it awake
+*          for the next one.
+*/
+static uint8_t simPeerAwake(uint64_t startNs, uint64_t endNs)
+{
+    uint64_t wakeNs;
+    uint8_t awake;
+
+    if (peerIntervalNs == 0)
+        return TRUE;
+    if (endNs < peerPhaseNs)
+        return FALSE;
+    wakeNs = peerPhaseNs + (endNs - peerPhaseNs) / peerIntervalNs * peerIntervalNs;
+    awake = startNs < peerAwakeNs || (startNs >= wakeNs && startNs < wakeNs + peerListenNs);
+    if (awake || startNs < wakeNs)
+        peerAwakeNs = endNs + (uint64_t)SIM_PEER_AWAKE_US * 1000;
+    return awake;
+}
+
+/***********************************************************************************
+* @fn      simStatus
+*
+* @brief   Status byte returned with every opcode
+*/
+static uint8_t simStatus(void)
+{
+    uint32_t exc = simExcMap(CC2520_EXCFLAG0);
+    uint8_t s = 0;
+
+    if (simXoscStable())
+        s |= CC2520_STB_XOSC_STABLE_BV;
+    if (state == SIM_STATE_RX)
+        s |= CC2520_STB_RSSI_VALID_BV | CC2520_STB_RX_ACTIVE_BV;
+    if (txOnAir)
+        s |= CC2520_STB_TX_ACTIVE_BV;
+    if (exc & simExcMap(CC2520_EXCMASKA0))
+        s |= CC2520_STB_EXC_CHA_BV;
+    if (exc & simExcMap(CC2520_EXCMASKB0))
+        s |= CC2520_STB_EXC_CHB_BV;
+    return s;
+}
+
+/***********************************************************************************
+* @fn      simRssi
+*
+* @brief   RSSI register on the current channel: the noise floor, within a dB,
+*          or for a share of the samples the interferer's level
+*/
+static uint8_t simRssi(void)
+{
+    uint8_t ch = (uint8_t)(mem[CC2520_FREQCTRL] - 11) / 5 & 0x0F;
+    int16_t dbm;
+
+    if (state != SIM_STATE_RX)
+        return (uint8_t)-128;
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    if ((lfsr & 0xFF) % 100 < noiseBusy[ch])
+        dbm = noisePeak[ch];
+    else
+        dbm = noiseFloor[ch] + (int16_t)(lfsr >> 8) % 3 - 1;
+    return (uint8_t)(int8_t)(dbm + CC2520_RSSI_OFFSET);
+}
+
+/***********************************************************************************
+* @fn      simRegRead
+*
+* @brief   Read register or RAM, computing the live status registers
+*/
+static uint8_t simRegRead(uint16_t addr)
+{
+    addr &= SIM_MEM_LEN - 1;
+    switch (addr) {
+    case CC2520_FSMSTAT0:
+        return state == SIM_STATE_RX ? CC2520_FSM_RX_W_SFD : CC2520_FSM_IDLE;
+    case CC2520_FSMSTAT1:
+        return (state == SIM_STATE_RX ? 0x01 | 0x04 : 0) | (sampledCca ? 0x08 : 0) | \
+            (cca ? 0x10 : 0) | (rxCount ? 0xC0 : 0);
+    case CC2520_RXFIRST:
+        return rxCount ? rxFifo[rxHead] : 0;
+    case CC2520_RXFIFOCNT:
+        return rxCount;
+    case CC2520_TXFIFOCNT:
+        return txCount;
+    case CC2520_RSSI:
+        return simRssi();
+    case CC2520_RSSISTAT:
+        return state == SIM_STATE_RX ? 0x01 : 0;
+    default:
+        return mem[addr];
+    }
+}
+
+/***********************************************************************************
+* @fn      simRegWrite
+*
+* @brief   Write register or RAM. Exception flags can only be cleared.
+*/
+static void simRegWrite(uint16_t addr, uint8_t value)
+{
+    addr &= SIM_MEM_LEN - 1;
+    if (addr >= CC2520_EXCFLAG0 && addr <= CC2520_EXCFLAG2) {
+        mem[addr] &= value;
+    } else if (addr != CC2520_FSMSTAT0 && addr != CC2520_FSMSTAT1 && \
+        addr != CC2520_RXFIFOCNT && addr != CC2520_TXFIFOCNT && addr != CC2520_CHIPID && \
+        addr != CC2520_RSSI && addr != CC2520_RSSISTAT) {
+        mem[addr] = value;
+    }
+}
+
+/***********************************************************************************
+* @fn      simRxPop
+*
+* @brief   Take one byte from the RX FIFO
+*/
+static uint8_t simRxPop(void)
+{
+    uint8_t b;
+    if (rxCount == 0) {
+        simExcSet(CC2520_EXC_RX_UNDERFLOW);
+        return 0;
+    }
+    b = rxFifo[rxHead];
+    rxHead = (rxHead + 1) % SIM_FIFO_LEN;
+    rxCount--;
+    return b;
+}
+
+/***********************************************************************************
+* @fn      simTxPush
+*
+* @brief   Append one byte to the TX FIFO
+*/
+static void simTxPush(uint8_t b)
+{
+    if (txRefill) {
+        txRefill = FALSE;
+        txCount = 0;
+    }
+    if (txCount == SIM_FIFO_LEN) {
+        simExcSet(CC2520_EXC_TX_OVERFLOW);
+        return;
+    }
+    txFifo[txCount++] = b;
+}
+
+/***********************************************************************************
+* @fn      simTransmit
+*
+* @brief   Send the frame at the head of the TX FIFO
+*/
+static void simTransmit(void)
+{
+    uint8_t len, n;
+
+    if (txOnAir)
+        return;
+    if (txCount == 0) {
+        simExcSet(CC2520_EXC_TX_UNDERFLOW);
+        return;
+    }
+    len = txFifo[0] & CC2520_PLD_LEN_MASK;
+    n = len > 2 ? len - 2 : 0;              // FCS is appended by the radio
+    if (txCount < n + 1) {
+        simExcSet(CC2520_EXC_TX_UNDERFLOW);
+        txCount = 0;
+        return;
+    }
+    txHookLen = n + 1;
+    txRefill = TRUE;
+    stats.txFrames++;
+    simExcSet(CC2520_EXC_SFD);
+    // SHR (5 bytes), PHR and PSDU
+    txOnAir = TRUE;
+    txSfdDue = TRUE;
+    txSfdNs = nowNs + (SIM_TX_TURNAROUND_US + 5 * SIM_BYTE_US) * 1000ULL;
+    txEndNs = nowNs + (SIM_TX_TURNAROUND_US + (uint64_t)(len + 6) * SIM_BYTE_US) * 1000;
+    // Data or command frame with the ACK request bit, not an ACK itself
+    if (peerAck && n >= 3 && (txFifo[1] & 0x20) && (txFifo[1] & 0x07) != 0x02 && \
+        simPeerAwake(nowNs, txEndNs)) {
+        if (peerMiss) {
+            peerMiss--;
+        } else {
+            ackDue = TRUE;
+            ackSeq = txFifo[3];
+            ackAtNs = txEndNs + (uint64_t)SIM_ACK_US * 1000;
+        }
+    }
+}
+
+/***********************************************************************************
+* @fn      simTxUpdate
+*
+* @brief   Capture the SFD of the frame on air, end the frame once its
+*          airtime is over, then receive the peer's acknowledgement when it
+*          is due
+*/
+static void simTxUpdate(void)
+{
+    uint8_t ack[3];
+
+    if (txSfdDue && nowNs >= txSfdNs) {
+        txSfdDue = FALSE;
+        simCapture(txSfdNs);
+    }
+    if (txOnAir && nowNs >= txEndNs) {
+        if (txHook) {
+            txHook(txFifo, txHookLen);
+        }
+        txOnAir = FALSE;
+        simExcSet(CC2520_EXC_TX_FRM_DONE);
+        state = SIM_STATE_RX;
+        simUpdatePins();
+    }
+    if (ackDue && !txOnAir && nowNs >= ackAtNs) {
+        ackDue = FALSE;
+        ack[0] = 0x02;
+        ack[1] = 0x00;
+        ack[2] = ackSeq;
+        cc2520sim_rxFrame(ack, sizeof(ack), -40, TRUE);
+    }
+}
+
+/***********************************************************************************
+* @fn      simAddrMatch
+*
+* @brief   Does an address field equal the local one in RAM (or broadcast)?
+*/
+static uint8_t simAddrMatch(const uint8_t *pAddr, uint8_t n, uint16_t ramAddr, uint8_t bcast)
+{
+    uint8_t i, all = TRUE, own = TRUE;
+
+    for (i = 0; i < n; i++) {
+        all = all && pAddr[i] == 0xFF;
+        own = own && pAddr[i] == mem[ramAddr + i];
+    }
+    return own || (bcast && all);
+}
+
+/***********************************************************************************
+* @fn      simFilter
+*
+* @brief   Frame filtering as set by FRMFILT0/FRMFILT1 (MPDU without FCS)
+*/
+static uint8_t simFilter(const uint8_t *pMpdu, uint8_t len)
+{
+    uint8_t type, version, dstMode, srcMode, i;
+
+    if (!(mem[CC2520_FRMFILT0] & 0x01))
+        return TRUE;
+    if (len < 3)
+        return FALSE;
+    type = pMpdu[0] & 0x07;
+    version = (pMpdu[1] >> 4) & 0x03;
+    dstMode = (pMpdu[1] >> 2) & 0x03;
+    srcMode = (pMpdu[1] >> 6) & 0x03;
+    if (version > ((mem[CC2520_FRMFILT0] >> 2) & 0x03))
+        return FALSE;
+    if (!(mem[CC2520_FRMFILT1] & (type < 4 ? 0x08 << type : 0x80)))
+        return FALSE;
+    if (type == 0x02)
+        return TRUE;
+    i = 3;
+    if (dstMode >= 2) {
+        if (!simAddrMatch(pMpdu + i, 2, CC2520_RAM_PANID, TRUE))
+            return FALSE;
+        i += 2;
+        if (dstMode == 2 ? !simAddrMatch(pMpdu + i, 2, CC2520_RAM_SHORTADDR, TRUE) : \
+            !simAddrMatch(pMpdu + i, 8, CC2520_RAM_EXTADDR, FALSE))
+            return FALSE;
+        i += dstMode == 2 ? 2 : 8;
+    } else if (srcMode >= 2 && (type == 0x01 || type == 0x03)) {
+        // No destination: only for the PAN coordinator, from its own PAN
+        if (!(mem[CC2520_FRMFILT0] & 0x02) || !simAddrMatch(pMpdu + i, 2, CC2520_RAM_PANID, FALSE))
+            return FALSE;
+    } else if (type != 0x00) {
+        return FALSE;
+    }
+    return i <= len;
+}
+
+/***********************************************************************************
+* @fn      simNextEvent
+*
+* @brief   Time of the next radio event (end of frame or peer ACK), 0 if none
+*/
+static uint64_t simNextEvent(void)
+{
+    if (txSfdDue)
+        return txSfdNs;
+    if (txOnAir)
+        return txEndNs;
+    if (ackDue)
+        return ackAtNs;
+    return 0;
+}
+
+/***********************************************************************************
+* @fn      simStrobe
+*
+* @brief   Execute a command strobe
+*/
+static void simStrobe(uint8_t op)
+{
+    switch (op) {
+    case CC2520_INS_SXOSCON:    simXoscSwitch(TRUE); break;
+    case CC2520_INS_SRXON:      state = SIM_STATE_RX; break;
+    case CC2520_INS_STXON:      simTransmit(); break;
+    case CC2520_INS_STXONCCA:
+        sampledCca = cca;
+        if (cca)
+            simTransmit();
+        break;
+    case CC2520_INS_SRFOFF:     state = SIM_STATE_IDLE; break;
+    case CC2520_INS_SXOSCOFF:   simXoscSwitch(FALSE); break;
+    case CC2520_INS_SFLUSHRX:   rxHead = 0; rxCount = 0; break;
+    case CC2520_INS_SFLUSHTX:   txCount = 0; txRefill = FALSE; break;
+    case CC2520_INS_SSAMPLECCA: sampledCca = cca; break;
+    default:                    break;
+    }
+}
+
+/***********************************************************************************
+* @fn      simHdrLen
+*
+* @brief   Number of bytes, opcode included, before an instruction with a
+*          fixed header executes. 0 for streaming instructions.
+*/
+static uint8_t simHdrLen(uint8_t op)
+{
+    if (op >= CC2520_INS_REGRD)                         return 0;
+    if (op == CC2520_INS_SRES || op == CC2520_INS_IBUFLD) return 2;
+    if (op < CC2520_INS_MEMRD)                          return 1;
+    if (op < CC2520_INS_RXBUF)                          return 0;
+    if ((op & 0xFE) == CC2520_INS_RXBUFMOV)             return 4;
+    if ((op & 0xFE) == CC2520_INS_TXBUFCP)              return 4;
+    if (op < CC2520_INS_SXOSCON)                        return 0;
+    if (op < CC2520_INS_RXMASKAND)                      return 1;
+    if (op < CC2520_INS_MEMCP)                          return 3;
+    if (op < CC2520_INS_MEMXWR)                         return 5;
+    if (op < CC2520_INS_BCLR)                           return 0;
+    if (op <= CC2520_INS_BSET)                          return 2;
+    if (op < CC2520_INS_UCBCMAC)                        return 7;   // CTR, CBCMAC
+    if (op < CC2520_INS_CCM)                            return 6;   // UCBCMAC
+    if (op < CC2520_INS_ECB)                            return 9;   // CCM, UCCM
+    if ((op & 0xFA) == CC2520_INS_ECB)                  return 6;   // ECB, ECBX
+    if (op < CC2520_INS_INC)                            return 4;   // ECBO, ECBXO
+    if (op < CC2520_INS_ABORT)                          return 3;   // INC
+    return 2;                                                       // ABORT
+}
+
+/***********************************************************************************
+* @fn      simExecute
+*
+* @brief   Execute an instruction once its fixed header is complete
+*/
+static void simExecute(void)
+{
+    uint8_t op = insOp;
+    uint16_t src, dest, i, n;
+
+    if (op < CC2520_INS_MEMRD) {
+        if (op == CC2520_INS_SRES)
+            simRadioReset();
+        else if (op == CC2520_INS_SSAMPLECCA)
+            simStrobe(op);
+        return;
+    }
+    if ((op & 0xFE) == CC2520_INS_RXBUFMOV) {
+        dest = ((insArg[1] & 0x03) << 8) | insArg[2];
+        for (i = 0; i < insArg[0]; i++) {
+            if (rxCount == 0) {
+                simExcSet(CC2520_EXC_RXBUFMOV_TIMEOUT);
+                break;
+            }
+            simRegWrite(dest + i, simRxPop());
+        }
+        return;
+    }
+    if ((op & 0xFE) == CC2520_INS_TXBUFCP) {
+        src = ((insArg[1] & 0x03) << 8) | insArg[2];
+        for (i = 0; i < insArg[0]; i++) {
+            simTxPush(simRegRead(src + i));
+        }
+        return;
+    }
+    if (op >= CC2520_INS_SXOSCON && op < CC2520_INS_RXMASKAND) {
+        simStrobe(op);
+        return;
+    }
+    if (op == CC2520_INS_RXMASKAND || op == CC2520_INS_RXMASKOR) {
+        if (op == CC2520_INS_RXMASKAND) {
+            mem[CC2520_RXENABLE0] &= insArg[1];
+            mem[CC2520_RXENABLE1] &= insArg[0];
+        } else {
+            mem[CC2520_RXENABLE0] |= insArg[1];
+            mem[CC2520_RXENABLE1] |= insArg[0];
+        }
+        return;
+    }
+    if (op < CC2520_INS_MEMXWR) {
+        // MEMCP, MEMCPR, MEMXCP
+        n = insArg[0] ? insArg[0] : 256;
+        src = ((insArg[1] & 0x30) << 4) | insArg[2];
+        dest = ((insArg[1] & 0x03) << 8) | insArg[3];
+        for (i = 0; i < n; i++) {
+            uint8_t b = simRegRead(src + i);
+            if ((op & 0xFE) == CC2520_INS_MEMCPR) {
+                simRegWrite(dest + n - 1 - i, b);
+            } else if ((op & 0xFE) == CC2520_INS_MEMXCP) {
+                simRegWrite(dest + i, simRegRead(dest + i) ^ b);
+            } else {
+                simRegWrite(dest + i, b);
+            }
+        }
+        simExcSet((op & 0x01) ? CC2520_EXC_DPU_DONE_H : CC2520_EXC_DPU_DONE_L);
+        return;
+    }
+    if (op == CC2520_INS_BCLR || op == CC2520_INS_BSET) {
+        src = insArg[0] >> 3;
+        if (op == CC2520_INS_BSET) {
+            simRegWrite(src, simRegRead(src) | (1 << (insArg[0] & 0x07)));
+        } else {
+            simRegWrite(src, simRegRead(src) & ~(1 << (insArg[0] & 0x07)));
+        }
+        return;
+    }
+    if ((op & 0xFE) == CC2520_INS_INC) {
+        // Little-endian counter of 2^c bytes
+        n = 1 << ((insArg[0] >> 4) & 0x03);
+        dest = ((insArg[0] & 0x03) << 8) | insArg[1];
+        for (i = 0; i < n; i++) {
+            uint8_t b = simRegRead(dest + i) + 1;
+            simRegWrite(dest + i, b);
+            if (b != 0)
+                break;
+        }
+    }
+    if ((op & 0xFE) == CC2520_INS_UCCM || (op & 0xFE) == CC2520_INS_UCBCMAC) {
+        // No crypto: every MIC checks out
+        mem[CC2520_DPUSTAT] |= (op & 0x01) ? 0x08 : 0x04;
+    }
+    if (op != CC2520_INS_ABORT) {
+        simExcSet((op & 0x01) ? CC2520_EXC_DPU_DONE_H : CC2520_EXC_DPU_DONE_L);
+    }
+}
+
+/***********************************************************************************
+* @fn      simInstructionByte
+*
+* @brief   Feed one MOSI byte of the current instruction to the radio
+*
+* @return  MISO byte
+*/
+static uint8_t simInstructionByte(uint8_t b)
+{
+    uint8_t op, hdr, r = 0;
+    uint16_t pos = insPos++;
+
+    if (pos == 0) {
+        insOp = b;
+        r = simStatus();
+        if (b >= CC2520_INS_REGRD) {
+            insAddr = b & 0x3F;
+        } else if (b >= CC2520_INS_MEMRD && b < CC2520_INS_RXBUF) {
+            insAddr = (b & 0x0F) << 8;
+        }
+    }
+    op = insOp;
+    hdr = simHdrLen(op);
+    if (hdr) {
+        // Fixed-header instruction: bytes after the header are ignored
+        if (pos > 0 && pos < hdr) {
+            insArg[pos - 1] = b;
+            if ((op & 0xFE) == CC2520_INS_RXBUFMOV && pos == 1)
+                r = rxCount;
+            if ((op & 0xFE) == CC2520_INS_TXBUFCP && pos == 1)
+                r = txCount;
+        }
+        if (pos + 1 == hdr)
+            simExecute();
+        return r;
+    }
+    if (pos == 0)
+        return r;
+
+    // Streaming instructions
+    if ((op & 0xC0) == CC2520_INS_REGRD) {
+        r = simRegRead(insAddr++);
+    } else if ((op & 0xC0) == CC2520_INS_REGWR) {
+        r = simRegRead(insAddr);
+        simRegWrite(insAddr++, b);
+    } else if ((op & 0xF0) == CC2520_INS_MEMRD || (op & 0xF0) == CC2520_INS_MEMWR) {
+        if (pos == 1) {
+            insAddr |= b;
+        } else if ((op & 0xF0) == CC2520_INS_MEMRD) {
+            r = simRegRead(insAddr++);
+        } else {
+            r = simRegRead(insAddr);
+            simRegWrite(insAddr++, b);
+        }
+    } else if (op == CC2520_INS_RXBUF) {
+        r = simRxPop();
+    } else if (op == CC2520_INS_RXBUFCP) {
+        if (pos == 1) {
+            insAddr = (b & 0x03) << 8;
+            r = rxCount;
+        } else if (pos == 2) {
+            insAddr |= b;
+        } else {
+            r = simRxPop();
+            simRegWrite(insAddr++, r);
+        }
+    } else if (op == CC2520_INS_TXBUF) {
+        simTxPush(b);
+        r = simStatus();
+    } else if (op == CC2520_INS_RANDOM) {
+        if (pos > 1) {
+            lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+            r = (uint8_t)lfsr;
+        }
+    } else if (op == CC2520_INS_MEMXWR) {
+        if (pos == 1) {
+            insAddr = (b & 0x03) << 8;
+        } else if (pos == 2) {
+            insAddr |= b;
+        } else {
+            simRegWrite(insAddr, simRegRead(insAddr) ^ b);
+            insAddr++;
+        }
+    }
+    return r;
+}
+
+/***********************************************************************************
+* @fn      simSpiByte
+*
+* @brief   Clock one byte on the SPI bus
+*
+* @return  MISO byte
+*/
+static uint8_t simSpiByte(uint8_t b)
+{
+    uint8_t r;
+
+    if (!(P4OUT & SIM_RESET_PIN)) {
+        inReset = TRUE;
+        return 0x00;
+    }
+    if (inReset) {
+        inReset = FALSE;
+        simRadioReset();
+    }
+    if (regP5out & SIM_CS_PIN) {
+        csSeenHigh = TRUE;
+        return 0xFF;
+    }
+    if (csSeenHigh) {
+        csSeenHigh = FALSE;
+        insPos = 0;
+        stats.spiTransactions++;
+    }
+    stats.spiBytes++;
+    stats.busNs += 8 * 1000 * (UCA1BR0 ? UCA1BR0 : 1) / (SIM_MCLK_KHZ / 1000);
+    nowNs += 8 * 1000 * (UCA1BR0 ? UCA1BR0 : 1) / (SIM_MCLK_KHZ / 1000);
+    r = simInstructionByte(b);
+    simUpdatePins();
+    return r;
+}
+
+/***********************************************************************************
+* @fn      simMoveTx
+*
+* @brief   Move a pending UCA1TXBUF byte to UCA1RXBUF
+*/
+static void simMoveTx(void)
+{
+    if (txPending) {
+        txPending = FALSE;
+        regRx = simSpiByte(regTx);
+        regIfg |= UCRXIFG | UCTXIFG;
+    }
+}
+
+/***********************************************************************************
+* @fn      simRunDma
+*
+* @brief   Run an armed SPI DMA transfer (channel 0 RX, channel 1 TX) to the end
+*/
+static void simRunDma(void)
+{
+    volatile uint8_t *pSrc, *pDst;
+    uint16_t n;
+
+    if (!(regDma0ctl & DMAEN) || !(DMA1CTL & DMAEN))
+        return;
+    pSrc = (volatile uint8_t *)DMA1SA;
+    pDst = (volatile uint8_t *)DMA0DA;
+    for (n = DMA1SZ; n > 0; n--) {
+        uint8_t r = simSpiByte(*pSrc);
+        *pDst = r;
+        if ((DMA1CTL & DMASRCINCR_3) == DMASRCINCR_3)
+            pSrc++;
+        if ((regDma0ctl & DMADSTINCR_3) == DMADSTINCR_3)
+            pDst++;
+    }
+    DMA1CTL &= ~DMAEN;
+    regDma0ctl = (regDma0ctl & ~DMAEN) | DMAIFG;
+}
+
+/***********************************************************************************
+* @fn      simUpdatePins
+*
+* @brief   Recompute GPIO0-5 and latch port 2 interrupt flags on edges
+*/
+static void simUpdatePins(void)
+{
+    uint32_t exc = simExcMap(CC2520_EXCFLAG0);
+    uint8_t n, fn, level, pins = 0, edges;
+
+    for (n = 0; n < 6; n++) {
+        fn = mem[CC2520_GPIOCTRL0 + n];
+        level = 0;
+        if (fn & 0x80) {
+            level = 0;                                  // Input
+        } else if (fn >= 1 && fn <= CC2520_EXC_COUNT) {
+            level = (exc & CC2520_EXC_BV(fn - 1)) != 0;
+        } else {
+            switch (fn) {
+            case CC2520_GPIO_EXC_CH_A:      level = (exc & simExcMap(CC2520_EXCMASKA0)) != 0; break;
+            case CC2520_GPIO_EXC_CH_B:      level = (exc & simExcMap(CC2520_EXCMASKB0)) != 0; break;
+            case CC2520_GPIO_FIFO:          level = rxCount != 0; break;
+            case CC2520_GPIO_FIFOP:         level = rxCount != 0; break;
+            case CC2520_GPIO_CCA:           level = cca; break;
+            case CC2520_GPIO_RSSI_VALID:    level = state == SIM_STATE_RX; break;
+            case CC2520_GPIO_SAMPLED_CCA:   level = sampledCca; break;
+            case CC2520_GPIO_RX_ACTIVE:     level = state == SIM_STATE_RX; break;
+            case CC2520_GPIO_HIGH:          level = 1; break;
+            default:                        level = 0; break;   // SFD, TX_ACTIVE...
+            }
+        }
+        if (!(mem[CC2520_GPIOPOLARITY] & (1 << n)))
+            level = !level;
+        pins |= level << n;
+    }
+    edges = (pins & ~pinLevel & ~P2IES) | (~pins & pinLevel & P2IES);
+    P2IFG |= edges & 0x3F;
+    pinLevel = pins;
+}
+
+/***********************************************************************************
+* @fn      simRadioReset
+*
+* @brief   Power-on state of the radio
+*/
+static void simRadioReset(void)
+{
+    memset(mem, 0, sizeof(mem));
+    mem[CC2520_CHIPID] = SIM_CHIPID;
+    mem[CC2520_GPIOCTRL0] = 1 + CC2520_EXC_RX_FRM_DONE;     // Reset defaults are
+    mem[CC2520_GPIOPOLARITY] = 0x3F;                        // active high
+    mem[CC2520_FRMFILT0] = 0x0D;                            // Filter on, version 3
+    mem[CC2520_FRMFILT1] = 0x78;                            // Types 0-3
+    rxHead = rxCount = txCount = 0;
+    state = SIM_STATE_IDLE;
+    xoscOn = TRUE;
+    xoscReadyNs = xoscOnNs = nowNs;
+    sampledCca = FALSE;
+    txOnAir = txSfdDue = txRefill = ackDue = FALSE;
+    insPos = 0;
+    simUpdatePins();
+}
+
+/***********************************************************************************
+* @fn      simTicks
+*
+* @brief   ACLK ticks since the start of the simulation
+*/
+static uint64_t simTicks(void)
+{
+    return nowNs * SIM_ACLK_HZ / 1000000000ULL;
+}
+
+/***********************************************************************************
+* @fn      simTimerUpdate
+*
+* @brief   Latch CCIFG for every TA1CCRn compare value and TAIFG for every
+*          overflow TA1R went through since the last call
+*/
+static void simTimerUpdate(void)
+{
+    uint64_t now = simTicks();
+    uint16_t ahead;
+    uint8_t n;
+
+    if (TA1CTL & TACLR) {
+        TA1CTL &= ~TACLR;
+        timerBase = now;
+    }
+    if (!(TA1CTL & MC_2)) {
+        timerSeen = now;
+        return;
+    }
+    if (now == timerSeen)
+        return;
+    if ((now - timerBase) >> 16 != (timerSeen - timerBase) >> 16)
+        TA1CTL |= TAIFG;
+    for (n = 0; n < 3; n++) {
+        if (cc2520simTa1cctl[n] & CAP)
+            continue;
+        // Ticks from the first unchecked one to the compare value
+        ahead = (uint16_t)(cc2520simTa1ccr[n] - (uint16_t)(timerSeen + 1 - timerBase));
+        if (now - timerSeen >= 0x10000 || ahead < now - timerSeen)
+            cc2520simTa1cctl[n] |= CCIFG;
+    }
+    timerSeen = now;
+}
+
+/***********************************************************************************
+* @fn      simTimerNext
+*
+* @brief   Ticks until the next enabled compare or overflow, 0 if none is armed
+*/
+static uint32_t simTimerNext(void)
+{
+    uint32_t next = 0, d;
+    uint8_t n;
+
+    if (!(TA1CTL & MC_2))
+        return 0;
+    if ((TA1CTL & TAIE) && !(TA1CTL & TAIFG))
+        next = (uint16_t)(0 - (uint16_t)(timerSeen + 1 - timerBase)) + 1;
+    for (n = 0; n < 3; n++) {
+        if ((cc2520simTa1cctl[n] & CCIE) && !(cc2520simTa1cctl[n] & (CCIFG | CAP))) {
+            d = (uint16_t)(cc2520simTa1ccr[n] - (uint16_t)(timerSeen + 1 - timerBase)) + 1;
+            if (next == 0 || d < next)
+                next = d;
+        }
+    }
+    return next;
+}
+
+/***********************************************************************************
+* @fn      simCapture
+*
+* @brief   SFD edge at sfdNs: latch TA1R into TA1CCR2 if it captures from
+*          P2.3 and GPIO3 carries SFD
+*/
+static void simCapture(uint64_t sfdNs)
+{
+    volatile uint16_t *pCctl = &cc2520simTa1cctl[2];
+
+    if (!(TA1CTL & MC_2) || !(*pCctl & CAP) || !(P2SEL & BIT3) || \
+        mem[CC2520_GPIOCTRL3] != CC2520_GPIO_SFD)
+        return;
+    if (*pCctl & CCIFG)
+        *pCctl |= COV;
+    cc2520simTa1ccr[2] = (uint16_t)(sfdNs * SIM_ACLK_HZ / 1000000000ULL - timerBase);
+    *pCctl |= CCIFG;
+}
+
+/***********************************************************************************
+* @fn      simDeliver
+*
+* @brief   Run the handlers of pending, enabled interrupts while GIE is set
+*/
+static void simDeliver(void)
+{
+    uint8_t again;
+
+    simTxUpdate();
+    simTimerUpdate();
+    if (!gie || inIsr)
+        return;
+    inIsr = TRUE;
+    do {
+        again = FALSE;
+        simMoveTx();
+        if (isr[CC2520SIM_IRQ_TIMER1_A0] && (cc2520simTa1cctl[0] & CCIE) && \
+            (cc2520simTa1cctl[0] & CCIFG)) {
+            cc2520simTa1cctl[0] &= ~CCIFG;
+            gie = 0;
+            isr[CC2520SIM_IRQ_TIMER1_A0]();
+            gie = 1;
+            again = TRUE;
+        }
+        if (isr[CC2520SIM_IRQ_TIMER1_A1] && cc2520sim_ta1iv_pending()) {
+            gie = 0;
+            isr[CC2520SIM_IRQ_TIMER1_A1]();
+            gie = 1;
+            again = TRUE;
+        }
+        if (isr[CC2520SIM_IRQ_USCI_A1] && (UCA1IE & UCRXIE) && (regIfg & UCRXIFG)) {
+            gie = 0;
+            isr[CC2520SIM_IRQ_USCI_A1]();
+            gie = 1;
+            again = TRUE;
+        }
+        simRunDma();
+        if (isr[CC2520SIM_IRQ_DMA] && (regDma0ctl & DMAIE) && (regDma0ctl & DMAIFG)) {
+            gie = 0;
+            isr[CC2520SIM_IRQ_DMA]();
+            gie = 1;
+            again = TRUE;
+        }
+        if (isr[CC2520SIM_IRQ_PORT2] && (P2IE & P2IFG)) {
+            gie = 0;
+            isr[CC2520SIM_IRQ_PORT2]();
+            gie = 1;
+            again = TRUE;
+        }
+    } while (again);
+    inIsr = FALSE;
+}
+
+/***********************************************************************************
+* GLOBAL FUNCTIONS
+*/
+
+volatile uint8_t *cc2520sim_txbuf(void)
+{
+    simMoveTx();
+    txPending = TRUE;
+    regIfg &= ~UCTXIFG;
+    return &regTx;
+}
+
+volatile uint8_t *cc2520sim_rxbuf(void)
+{
+    simMoveTx();
+    regIfg &= ~UCRXIFG;
+    return &regRx;
+}
+
+volatile uint8_t *cc2520sim_ifg(void)
+{
+    simMoveTx();
+    simDeliver();
+    return &regIfg;
+}
+
+volatile uint8_t *cc2520sim_p5out(void)
+{
+    if (regP5out & SIM_CS_PIN)
+        csSeenHigh = TRUE;
+    return &regP5out;
+}
+
+volatile uint16_t *cc2520sim_dma0ctl(void)
+{
+    simRunDma();
+    simDeliver();
+    return &regDma0ctl;
+}
+
+volatile uint8_t *cc2520sim_txbufAddr(void)
+{
+    return &regTx;
+}
+
+volatile uint8_t *cc2520sim_rxbufAddr(void)
+{
+    return &regRx;
+}
+
+uint8_t cc2520sim_p5in(void)
+{
+    // SO goes high while CSn is low and the crystal is stable
+    if (!(regP5out & SIM_CS_PIN) && simXoscStable() && (P4OUT & SIM_RESET_PIN))
+        return SIM_MISO_PIN;
+    return 0;
+}
+
+uint8_t cc2520sim_p2in(void)
+{
+    simMoveTx();
+    simTxUpdate();
+    simUpdatePins();
+    simDeliver();
+    return pinLevel;
+}
+
+volatile uint16_t *cc2520sim_ta1r(void)
+{
+    simTimerUpdate();
+    regTa1r = (TA1CTL & MC_2) ? (uint16_t)(simTicks() - timerBase) : 0;
+    return &regTa1r;
+}
+
+static uint8_t cc2520sim_ta1iv_pending(void)
+{
+    uint8_t n;
+
+    for (n = 1; n < 3; n++) {
+        if ((cc2520simTa1cctl[n] & CCIE) && (cc2520simTa1cctl[n] & CCIFG))
+            return TRUE;
+    }
+    return (TA1CTL & TAIE) && (TA1CTL & TAIFG);
+}
+
+uint16_t cc2520sim_ta1iv(void)
+{
+    uint8_t n;
+
+    // Highest priority pending flag; reading clears it
+    for (n = 1; n < 3; n++) {
+        if ((cc2520simTa1cctl[n] & CCIE) && (cc2520simTa1cctl[n] & CCIFG)) {
+            cc2520simTa1cctl[n] &= ~CCIFG;
+            return 2 * n;
+        }
+    }
+    if ((TA1CTL & TAIE) && (TA1CTL & TAIFG)) {
+        TA1CTL &= ~TAIFG;
+        return 0x0E;
+    }
+    return 0;
+}
+
+void cc2520sim_delay(uint32_t cycles)
+{
+    stats.delayNs += cycles * 1000 / (SIM_MCLK_KHZ / 1000);
+    nowNs += (uint64_t)cycles * 1000 / (SIM_MCLK_KHZ / 1000);
+    simDeliver();
+}
+
+void cc2520sim_setGie(unsigned short on)
+{
+    gie = on ? 1 : 0;
+    simDeliver();
+}
+
+unsigned short cc2520sim_getGie(void)
+{
+    return gie;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_sleep
+*
+* @brief   Low power mode entry: set GIE if asked and run interrupts, moving
+*          time on to the next timer compare or end of transmission, until
+*          a handler calls __bic_SR_register_on_exit(). Returns at once
+*          when nothing is pending that could end the sleep.
+*
+* @param   unsigned short bits - status register bits
+*
+* @return  none
+*/
+void cc2520sim_sleep(unsigned short bits)
+{
+    uint64_t target, event;
+    uint32_t ticks;
+
+    if (bits & GIE)
+        gie = 1;
+    if (!(bits & CPUOFF)) {
+        simDeliver();
+        return;
+    }
+    woken = FALSE;
+    simMoveTx();
+    simRunDma();
+    simUpdatePins();
+    simDeliver();
+    while (!woken && gie) {
+        ticks = simTimerNext();
+        event = simNextEvent();
+        if (ticks) {
+            // First nanosecond of the compare tick
+            target = simTicks() + ticks;
+            target = (target * 1000000000ULL + SIM_ACLK_HZ - 1) / SIM_ACLK_HZ;
+            if (event && event < target)
+                target = event;
+        } else if (event) {
+            target = event;
+        } else {
+            break;
+        }
+        nowNs = target;
+        simDeliver();
+    }
+    woken = FALSE;
+}
+
+void cc2520sim_wake(void)
+{
+    woken = TRUE;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_reset
+*
+* @brief   Reset the radio model, bus state and counters
+*
+* @param   none
+*
+* @return  none
+*/
+void cc2520sim_reset(void)
+{
+    regTx = regRx = 0;
+    regIfg = UCTXIFG;
+    regP5out = SIM_CS_PIN;
+    regDma0ctl = 0;
+    txPending = FALSE;
+    csSeenHigh = TRUE;
+    inReset = FALSE;
+    cca = TRUE;
+    peerAck = peerMiss = 0;
+    peerIntervalNs = peerAwakeNs = 0;
+    xoscFail = FALSE;
+    lfsr = 0xACE1;
+    memset(noiseFloor, -100, sizeof(noiseFloor));
+    memset(noisePeak, -100, sizeof(noisePeak));
+    memset(noiseBusy, 0, sizeof(noiseBusy));
+    P2IFG = 0;
+    pinLevel = 0;
+    simRadioReset();
+    P2IFG = 0;
+    memset(&stats, 0, sizeof(stats));
+    TA1CTL = 0;
+    FCTL1 = 0;
+    FCTL3 = LOCK;
+    memset((void *)cc2520simTa1cctl, 0, sizeof(cc2520simTa1cctl));
+    memset((void *)cc2520simTa1ccr, 0, sizeof(cc2520simTa1ccr));
+    timerBase = timerSeen = simTicks();
+    woken = FALSE;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_setIsr
+*
+* @brief   Handler run by the model for interrupt source irq
+*
+* @param   uint8_t irq - CC2520SIM_IRQ_xxx
+*          cc2520sim_isr_t isr - handler, NULL to disable
+*
+* @return  none
+*/
+void cc2520sim_setIsr(uint8_t irq, cc2520sim_isr_t handler)
+{
+    if (irq < CC2520SIM_IRQ_COUNT)
+        isr[irq] = handler;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_service
+*
+* @brief   Finish pending bus activity and deliver pending interrupts, as the
+*          MCU would while idling in a low power mode
+*
+* @param   none
+*
+* @return  none
+*/
+void cc2520sim_service(void)
+{
+    simMoveTx();
+    simRunDma();
+    simUpdatePins();
+    simDeliver();
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_setTxHook
+*
+* @brief   Callback run with every transmitted frame (PHR and MPDU without FCS)
+*
+* @param   cc2520sim_txHook_t hook
+*
+* @return  none
+*/
+void cc2520sim_setTxHook(cc2520sim_txHook_t hook)
+{
+    txHook = hook;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_setPeerAck
+*
+* @brief   Have a peer acknowledge every sent frame that requests an ACK.
+*          The ACK arrives a turnaround time after the end of the frame.
+*
+* @param   uint8_t enable - TRUE to send ACKs
+*          uint8_t miss - number of frames to leave unacknowledged first
+*
+* @return  none
+*/
+void cc2520sim_setPeerAck(uint8_t enable, uint8_t miss)
+{
+    peerAck = enable;
+    peerMiss = miss;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_setPeerLpl
+*
+* @brief   Make the acknowledging peer a low-power listener: it wakes every
+*          interval, phase after the start of the simulation, listens for a
+*          while and only acknowledges frames it receives whole
+*
+* @param   uint32_t intervalUs - wake interval, 0 for an always-on peer
+*          uint32_t listenUs - listening time per wake-up
+*          uint32_t phaseUs - first wake-up
+*
+* @return  none
+*/
+void cc2520sim_setPeerLpl(uint32_t intervalUs, uint32_t listenUs, uint32_t phaseUs)
+{
+    peerIntervalNs = (uint64_t)intervalUs * 1000;
+    peerListenNs = (uint64_t)listenUs * 1000;
+    peerPhaseNs = (uint64_t)phaseUs * 1000;
+    peerAwakeNs = 0;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_setXoscFail
+*
+* @brief   Keep the crystal oscillator from ever becoming stable
+*
+* @param   uint8_t fail - TRUE for a dead crystal
+*
+* @return  none
+*/
+void cc2520sim_setXoscFail(uint8_t fail)
+{
+    xoscFail = fail;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_setCca
+*
+* @brief   Set the CCA outcome for STXONCCA and SSAMPLECCA
+*
+* @param   uint8_t clear - TRUE if the channel is clear
+*
+* @return  none
+*/
+void cc2520sim_setCca(uint8_t clear)
+{
+    cca = clear;
+    simUpdatePins();
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_setNoise
+*
+* @brief   Set the energy seen on a channel: a steady noise floor, and an
+*          interferer (e.g. Wi-Fi) at peakDbm during busyPct % of the RSSI
+*          samples
+*
+* @param   uint8_t channel - 11-26
+*          int8_t floorDbm
+*          int8_t peakDbm
+*          uint8_t busyPct
+*
+* @return  none
+*/
+void cc2520sim_setNoise(uint8_t channel, int8_t floorDbm, int8_t peakDbm, uint8_t busyPct)
+{
+    noiseFloor[(channel - 11) & 0x0F] = floorDbm;
+    noisePeak[(channel - 11) & 0x0F] = peakDbm;
+    noiseBusy[(channel - 11) & 0x0F] = busyPct;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_rxFrame
+*
+* @brief   Receive a frame over the air, its last byte arriving now. The RX
+*          FIFO gets the PHR, the MPDU and the two status bytes that replace
+*          the FCS.
+*
+* @param   const uint8_t *pFrame - MPDU without FCS
+*          uint8_t len - MPDU length
+*          int8_t rssi - RSSI byte
+*          uint8_t crcOk - CRC result
+*
+* @return  uint8_t - TRUE if the frame was stored, FALSE if RX is off or the
+*          FIFO overflowed
+*/
+uint8_t cc2520sim_rxFrame(const uint8_t *pFrame, uint8_t len, int8_t rssi, uint8_t crcOk)
+{
+    uint8_t i, tail;
+
+    if (state != SIM_STATE_RX || len + 2 > CC2520_PLD_LEN_MASK)
+        return FALSE;
+    // The frame ends now; its SFD was on air before the PHR and PSDU
+    simTimerUpdate();
+    simCapture(nowNs - (uint64_t)(len + 3) * SIM_BYTE_US * 1000);
+    if (!simFilter(pFrame, len)) {
+        stats.rxFiltered++;
+        simExcSet(CC2520_EXC_SFD);
+        simExcSet(CC2520_EXC_RX_FRM_ABORTED);
+        simUpdatePins();
+        return FALSE;
+    }
+    if (rxCount + len + 3 > SIM_FIFO_LEN) {
+        stats.rxOverflows++;
+        simExcSet(CC2520_EXC_RX_OVERFLOW);
+        simUpdatePins();
+        return FALSE;
+    }
+    tail = (rxHead + rxCount) % SIM_FIFO_LEN;
+    rxFifo[tail] = len + 2;
+    for (i = 0; i < len; i++) {
+        rxFifo[(tail + 1 + i) % SIM_FIFO_LEN] = pFrame[i];
+    }
+    rxFifo[(tail + 1 + len) % SIM_FIFO_LEN] = (uint8_t)rssi;
+    rxFifo[(tail + 2 + len) % SIM_FIFO_LEN] = (crcOk ? CC2520_CRC_OK_BM : 0) | 0x6C;
+    rxCount += len + 3;
+    stats.rxFrames++;
+    simExcSet(CC2520_EXC_SFD);
+    simExcSet(CC2520_EXC_RX_FRM_ACCEPTED);
+    simExcSet(CC2520_EXC_FIFOP);
+    simExcSet(CC2520_EXC_RX_FRM_DONE);
+    simUpdatePins();
+    return TRUE;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_readMem / cc2520sim_writeMem
+*
+* @brief   Backdoor access to registers and RAM, without SPI traffic
+*/
+uint8_t cc2520sim_readMem(uint16_t addr)
+{
+    return simRegRead(addr);
+}
+
+void cc2520sim_writeMem(uint16_t addr, uint8_t value)
+{
+    mem[addr & (SIM_MEM_LEN - 1)] = value;
+    simUpdatePins();
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_flashRead / cc2520sim_flashWrite
+*
+* @brief   Word access to information memory. A write with LOCK set only sets
+*          ACCVIFG; with ERASE it erases the segment, with WRT it clears the
+*          bits that are 0 in value. Both take the programming time with
+*          interrupts held off. The contents outlive cc2520sim_reset(), as
+*          flash outlives a reset of the MCU; cc2520sim_flashClear() erases
+*          all of it.
+*/
+uint16_t cc2520sim_flashRead(uint16_t addr)
+{
+    uint16_t i = (addr - SIM_FLASH_BASE) & (SIM_FLASH_LEN - 2);
+
+    return (uint16_t)~(flashInv[i] | (flashInv[i + 1] << 8));
+}
+
+void cc2520sim_flashWrite(uint16_t addr, uint16_t value)
+{
+    uint16_t i = (addr - SIM_FLASH_BASE) & (SIM_FLASH_LEN - 2);
+
+    if (FCTL3 & LOCK) {
+        FCTL3 |= ACCVIFG;
+        return;
+    }
+    if (FCTL1 & ERASE) {
+        memset(flashInv + (i & ~(SIM_FLASH_SEG_LEN - 1)), 0, SIM_FLASH_SEG_LEN);
+        nowNs += (uint64_t)SIM_FLASH_ERASE_US * 1000;
+        stats.flashErases++;
+    } else if (FCTL1 & WRT) {
+        flashInv[i] |= (uint8_t)~value;
+        flashInv[i + 1] |= (uint8_t)~(value >> 8);
+        nowNs += (uint64_t)SIM_FLASH_WRITE_US * 1000;
+        stats.flashWrites++;
+    }
+}
+
+void cc2520sim_flashClear(void)
+{
+    memset(flashInv, 0, sizeof(flashInv));
+}
+
+uint8_t cc2520sim_rxFifoCount(void)
+{
+    return rxCount;
+}
+
+uint8_t cc2520sim_txFifoCount(void)
+{
+    return txCount;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_getStats
+*
+* @brief   Copy the bus and radio counters. Take a copy before and after an
+*          API call to get the cost of that call.
+*
+* @param   cc2520sim_stats_t *pStats
+*
+* @return  none
+*/
+void cc2520sim_getStats(cc2520sim_stats_t *pStats)
+{
+    *pStats = stats;
+    if (xoscOn)
+        pStats->xoscOnUs += (uint32_t)((nowNs - xoscOnNs) / 1000);
+}
+
+void cc2520sim_resetStats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    xoscOnNs = nowNs;
+}
+
+/***********************************************************************************
+* @fn      cc2520sim_now / cc2520sim_advance
+*
+* @brief   Simulated time, and letting it pass with interrupts delivered as
+*          they come due
+*/
+uint64_t cc2520sim_now(void)
+{
+    return nowNs;
+}
+
+void cc2520sim_advance(uint32_t us)
+{
+    uint64_t end = nowNs + (uint64_t)us * 1000;
+    uint32_t ticks;
+    uint64_t next, event;
+
+    for (;;) {
+        ticks = simTimerNext();
+        next = ticks ? ((simTicks() + ticks) * 1000000000ULL + SIM_ACLK_HZ - 1) / SIM_ACLK_HZ : end;
+        event = simNextEvent();
+        if (event && event < next)
+            next = event;
+        if (next > end)
+            next = end;
+        nowNs = next;
+        simDeliver();
+        if (nowNs >= end)
+            break;
+    }
+}
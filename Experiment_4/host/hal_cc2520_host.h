@@ -0,0 +1,205 @@
+/***********************************************************************************
+
+  Filename:     hal_cc2520_host.h
+
+  Description:  Host (Linux) backend for the CC2520 radio HAL. Replaces the
+                MSP430F5435 register and intrinsic definitions used by
+                hal_cc2520.c and cc2520ll.c with a simulated CC2520 behind a
+                simulated USCI_A1, DMA controller, Timer_A1 and port 2/5 pins.
+
+                Selected by building with -DCC2520_HOST; see host/Makefile.
+
+***********************************************************************************/
+#ifndef HAL_CC2520_HOST_H
+#define HAL_CC2520_HOST_H
+
+/***********************************************************************************
+* INCLUDES
+*/
+#include <stdint.h>
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+#define BIT0                (0x0001)
+#define BIT1                (0x0002)
+#define BIT2                (0x0004)
+#define BIT3                (0x0008)
+#define BIT4                (0x0010)
+#define BIT5                (0x0020)
+#define BIT6                (0x0040)
+#define BIT7                (0x0080)
+
+// USCI_Ax
+#define UCSWRST             (0x01)
+#define UCSSEL0             (0x40)
+#define UCSSEL1             (0x80)
+#define UCSYNC              (0x01)
+#define UCMST               (0x08)
+#define UCMSB               (0x20)
+#define UCCKPH              (0x80)
+#define UCRXIFG             (0x01)
+#define UCTXIFG             (0x02)
+#define UCRXIE              (0x01)
+
+// DMA
+#define DMAEN               (0x0010)
+#define DMAIE               (0x0004)
+#define DMAIFG              (0x0008)
+#define DMADT_0             (0x0000)
+#define DMASRCBYTE          (0x0040)
+#define DMADSTBYTE          (0x0080)
+#define DMASRCINCR_0        (0x0000)
+#define DMASRCINCR_3        (0x0300)
+#define DMADSTINCR_0        (0x0000)
+#define DMADSTINCR_3        (0x0C00)
+#define DMARMWDIS           (0x0004)
+
+// Timer_A
+#define TASSEL_1            (0x0100)
+#define ID_0                (0x0000)
+#define MC_2                (0x0020)
+#define TACLR               (0x0004)
+#define TAIE                (0x0002)
+#define TAIFG               (0x0001)
+#define CM_1                (0x4000)
+#define CCIS_0              (0x0000)
+#define SCS                 (0x0800)
+#define CAP                 (0x0100)
+#define CCI                 (0x0008)
+#define CCIE                (0x0010)
+#define COV                 (0x0002)
+#define CCIFG               (0x0001)
+
+// Flash controller
+#define FWKEY               (0xA500)
+#define ERASE               (0x0002)
+#define WRT                 (0x0040)
+#define BUSY                (0x0001)
+#define ACCVIFG             (0x0004)
+#define LOCK                (0x0010)
+
+// Status register
+#define GIE                 (0x0008)
+#define CPUOFF              (0x0010)
+#define LPM0_bits           (CPUOFF)
+
+/***********************************************************************************
+* REGISTERS
+*
+* Registers the model has to observe are accessed through a function, so every
+* read or write of them lets the simulator move the SPI bus forward.
+*/
+#define UCA1TXBUF           (*cc2520sim_txbuf())
+#define UCA1RXBUF           (*cc2520sim_rxbuf())
+#define UCA1IFG             (*cc2520sim_ifg())
+#define P5OUT               (*cc2520sim_p5out())
+#define P5IN                (cc2520sim_p5in())
+#define P2IN                (cc2520sim_p2in())
+#define DMA0CTL             (*cc2520sim_dma0ctl())
+#define TA1R                (*cc2520sim_ta1r())
+#define TA1IV               (cc2520sim_ta1iv())
+#define TA1CCTL0            (cc2520simTa1cctl[0])
+#define TA1CCR0             (cc2520simTa1ccr[0])
+
+extern volatile uint8_t UCA1CTL0, UCA1CTL1, UCA1BR0, UCA1BR1, UCA1IE;
+extern volatile uint8_t P2OUT, P2DIR, P2SEL, P2IE, P2IES, P2IFG;
+extern volatile uint8_t P3OUT, P3DIR, P3SEL;
+extern volatile uint8_t P4OUT, P4DIR;
+extern volatile uint8_t P5DIR, P5SEL;
+extern volatile uint16_t DMACTL0, DMACTL4, DMA1CTL, DMA0SZ, DMA1SZ;
+extern volatile uintptr_t DMA0SA, DMA0DA, DMA1SA, DMA1DA;
+extern volatile uint16_t TA1CTL, cc2520simTa1cctl[3], cc2520simTa1ccr[3];
+extern volatile uint16_t FCTL1, FCTL3;
+
+// Information memory (infomem.h), through the flash controller model
+#define INFOMEM_RD16(addr)          cc2520sim_flashRead(addr)
+#define INFOMEM_WR16(addr, v)       cc2520sim_flashWrite(addr, v)
+
+/***********************************************************************************
+* INTRINSICS
+*/
+#define __delay_cycles(n)           cc2520sim_delay(n)
+#define __disable_interrupt()       cc2520sim_setGie(0)
+#define __enable_interrupt()        cc2520sim_setGie(1)
+#define _disable_interrupts()       cc2520sim_setGie(0)
+#define _enable_interrupts()        cc2520sim_setGie(1)
+#define __get_interrupt_state()     cc2520sim_getGie()
+#define __set_interrupt_state(s)    cc2520sim_setGie(s)
+#define __bis_SR_register(bits)     cc2520sim_sleep(bits)
+#define __bic_SR_register_on_exit(bits) cc2520sim_wake()
+
+/***********************************************************************************
+* TYPEDEFS
+*/
+// Bus and radio counters, reset with cc2520sim_resetStats()
+typedef struct {
+    uint32_t spiBytes;          // Bytes clocked with CSn low
+    uint32_t spiTransactions;   // CSn low periods that moved at least one byte
+    uint32_t busNs;             // Modeled SPI time for those bytes
+    uint32_t delayNs;           // Time spent in __delay_cycles
+    uint32_t txFrames;
+    uint32_t rxFrames;
+    uint32_t rxOverflows;
+    uint32_t rxFiltered;        // Frames rejected by the frame filter
+    uint32_t xoscOnUs;          // Time with the crystal oscillator on
+    uint32_t flashWrites;       // Information memory words written
+    uint32_t flashErases;       // Information memory segments erased
+} cc2520sim_stats_t;
+
+typedef void (*cc2520sim_isr_t)(void);
+typedef void (*cc2520sim_txHook_t)(const uint8_t *pFrame, uint8_t len);
+
+// Interrupt sources that cc2520sim_service() can deliver
+#define CC2520SIM_IRQ_PORT2         0
+#define CC2520SIM_IRQ_USCI_A1       1
+#define CC2520SIM_IRQ_DMA           2
+#define CC2520SIM_IRQ_TIMER1_A0     3       // TA1CCR0
+#define CC2520SIM_IRQ_TIMER1_A1     4       // TA1CCR1, TA1CCR2, overflow
+#define CC2520SIM_IRQ_COUNT         5
+
+/***********************************************************************************
+* GLOBAL FUNCTIONS
+*/
+// Register access hooks used by the macros above
+volatile uint8_t  *cc2520sim_txbuf(void);
+volatile uint8_t  *cc2520sim_rxbuf(void);
+volatile uint8_t  *cc2520sim_ifg(void);
+volatile uint8_t  *cc2520sim_p5out(void);
+volatile uint16_t *cc2520sim_dma0ctl(void);
+volatile uint16_t *cc2520sim_ta1r(void);
+uint16_t cc2520sim_ta1iv(void);
+volatile uint8_t  *cc2520sim_txbufAddr(void);      // DMA address, no bus activity
+volatile uint8_t  *cc2520sim_rxbufAddr(void);
+uint8_t  cc2520sim_p5in(void);
+uint8_t  cc2520sim_p2in(void);
+void     cc2520sim_delay(uint32_t cycles);
+void     cc2520sim_setGie(unsigned short on);
+unsigned short cc2520sim_getGie(void);
+void     cc2520sim_sleep(unsigned short bits);
+void     cc2520sim_wake(void);
+
+// Simulator control
+void     cc2520sim_reset(void);
+void     cc2520sim_setIsr(uint8_t irq, cc2520sim_isr_t isr);
+void     cc2520sim_service(void);
+void     cc2520sim_setTxHook(cc2520sim_txHook_t hook);
+void     cc2520sim_setCca(uint8_t clear);
+void     cc2520sim_setPeerAck(uint8_t enable, uint8_t miss);
+void     cc2520sim_setPeerLpl(uint32_t intervalUs, uint32_t listenUs, uint32_t phaseUs);
+void     cc2520sim_setXoscFail(uint8_t fail);
+void     cc2520sim_setNoise(uint8_t channel, int8_t floorDbm, int8_t peakDbm, uint8_t busyPct);
+uint8_t  cc2520sim_rxFrame(const uint8_t *pFrame, uint8_t len, int8_t rssi, uint8_t crcOk);
+uint8_t  cc2520sim_readMem(uint16_t addr);
+void     cc2520sim_writeMem(uint16_t addr, uint8_t value);
+uint16_t cc2520sim_flashRead(uint16_t addr);
+void     cc2520sim_flashWrite(uint16_t addr, uint16_t value);
+void     cc2520sim_flashClear(void);                // Erase, as a new device
+uint8_t  cc2520sim_rxFifoCount(void);
+uint8_t  cc2520sim_txFifoCount(void);
+void     cc2520sim_getStats(cc2520sim_stats_t *pStats);
+void     cc2520sim_resetStats(void);
+uint64_t cc2520sim_now(void);                       // Simulated time, ns
+void     cc2520sim_advance(uint32_t us);
+
+#endif
@@ -0,0 +1,71 @@
+/***********************************************************************************
+
+  Filename:     host_test.h
+
+  Description:  Checks shared by the host tests run with "make test". A test
+                reports each failed check with its line, goes on, and exits
+                non-zero if any check failed. Benchmarks time code with
+                HOST_CYCLES(): the time stamp counter on x86, nanoseconds
+                elsewhere.
+
+***********************************************************************************/
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+/***********************************************************************************
+* INCLUDES
+*/
+#include <stdio.h>
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/***********************************************************************************
+* MACROS
+*/
+static int testFailures;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);     \
+            testFailures++;                                                     \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                          \
+    do {                                                                        \
+        long long va_ = (long long)(a), vb_ = (long long)(b);                   \
+        if (va_ != vb_) {                                                       \
+            printf("%s:%d: check failed: %s == %s (%lld != %lld)\n",            \
+                __FILE__, __LINE__, #a, #b, va_, vb_);                          \
+            testFailures++;                                                     \
+        }                                                                       \
+    } while (0)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HOST_CYCLES()           ((uint64_t)__rdtsc())
+#define HOST_CYCLE_UNIT         "cycles"
+#else
+static inline uint64_t hostNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#define HOST_CYCLES()           hostNs()
+#define HOST_CYCLE_UNIT         "ns"
+#endif
+
+// Last statement of main()
+#define TEST_DONE(name)                                                         \
+    do {                                                                        \
+        printf("%s: %s\n", name, testFailures ? "FAILED" : "ok");               \
+        return testFailures ? 1 : 0;                                            \
+    } while (0)
+
+#endif
@@ -0,0 +1,253 @@
+/***********************************************************************************
+
+  Filename:     test_async.c
+
+  Description:  Stress test of the USCI_A1 instruction queue (CC2520_SPI_ASYNC).
+                Main context queues thousands of radio RAM reads and writes of
+                random length, mixed with blocking instructions and with bus
+                holds that nest. A timer interrupt queues its own reads and
+                writes meanwhile, and now and then issues blocking ones. Each
+                source works on its own RAM area against a model: every read
+                must return what the instructions queued before it left,
+                callbacks must come in submission order, nothing queued may
+                run while the bus is held, and the timer must not run inside
+                a bus hold of main. A timer instruction inside one of main's
+                would break both reads.
+
+***********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cc2520ll.h"
+#include "rtimer.h"
+#include "host_test.h"
+
+#define MAIN_BASE       0x200       // RAM used by main context
+#define ISR_BASE        0x300       // RAM used by the timer interrupt
+#define AREA_LEN        0x100
+#define MAX_LEN         32
+#define RECS            16          // More than CC2520_SPI_QUEUE_LEN
+#define MAIN_OPS        5000
+#define ISR_PERIOD      3           // Ticks between timer submissions
+#define ISR_BLOCKING    16          // One timer run in this many blocks
+#define WATCHDOG_S      30          // A stuck queue ends the test
+
+typedef struct {
+    uint8_t read;
+    uint8_t len;
+    uint8_t expect[MAX_LEN];        // Data a read must return
+    uint8_t data[MAX_LEN];          // Written, or read into
+} op_t;
+
+typedef struct {
+    uint8_t model[AREA_LEN];
+    op_t recs[RECS];
+    uint16_t head, tail;            // Submitted, completed
+    uint32_t done;
+} source_t;
+
+static source_t mainSrc, isrSrc;
+static volatile uint8_t held;       // Main holds the bus
+static uint32_t isrHeldRuns;        // Timer runs while main held the bus
+static uint32_t blockingCount;      // Blocking instructions
+static uint32_t isrBlockingCount;   // Blocking instructions of the timer
+
+/***********************************************************************************
+* @fn      complete
+*
+* @brief   Callback side: the oldest submitted operation of a source is done
+*/
+static void complete(source_t *pSrc)
+{
+    op_t *pOp = &pSrc->recs[pSrc->tail % RECS];
+
+    CHECK(pSrc->tail != pSrc->head);
+    CHECK(!held);
+    if (pOp->read)
+        CHECK(memcmp(pOp->data, pOp->expect, pOp->len) == 0);
+    pSrc->tail++;
+    pSrc->done++;
+}
+
+static void mainDone(uint8_t status)
+{
+    complete(&mainSrc);
+}
+
+static void isrDone(uint8_t status)
+{
+    complete(&isrSrc);
+}
+
+/***********************************************************************************
+* @fn      submit
+*
+* @brief   Queue a random RAM read or write for a source and update its model.
+*          Runs with interrupts disabled, so model and queue order agree.
+*
+* @return  uint8_t - TRUE if queued
+*/
+static uint8_t submit(source_t *pSrc, uint16_t base, cc2520_spiCallback_t cb)
+{
+    op_t *pOp;
+    uint16_t offset;
+    uint8_t i, ok;
+
+    if (pSrc->head - pSrc->tail == RECS)
+        return FALSE;
+    pOp = &pSrc->recs[pSrc->head % RECS];
+    pOp->read = rand() & 1;
+    pOp->len = 1 + rand() % MAX_LEN;
+    offset = rand() % (AREA_LEN - pOp->len + 1);
+    if (pOp->read) {
+        memcpy(pOp->expect, pSrc->model + offset, pOp->len);
+        memset(pOp->data, 0, pOp->len);
+        ok = CC2520_MEMRD_ASYNC(base + offset, pOp->len, pOp->data, cb);
+    } else {
+        for (i = 0; i < pOp->len; i++) {
+            pOp->data[i] = (uint8_t)rand();
+        }
+        ok = CC2520_MEMWR_ASYNC(base + offset, pOp->len, pOp->data, cb);
+        if (ok)
+            memcpy(pSrc->model + offset, pOp->data, pOp->len);
+    }
+    if (ok)
+        pSrc->head++;
+    return ok;
+}
+
+/***********************************************************************************
+* @fn      readWrite
+*
+* @brief   A blocking read and write of a source's area. Every operation the
+*          source queued before has completed.
+*/
+static void readWrite(source_t *pSrc, uint16_t base)
+{
+    uint8_t buf[MAX_LEN];
+    uint16_t offset = rand() % (AREA_LEN - MAX_LEN);
+    uint8_t i;
+
+    CC2520_MEMRD(base + offset, MAX_LEN, buf);
+    CHECK_EQ(pSrc->tail, pSrc->head);
+    CHECK(memcmp(buf, pSrc->model + offset, MAX_LEN) == 0);
+    for (i = 0; i < MAX_LEN; i++) {
+        buf[i] = (uint8_t)rand();
+    }
+    CC2520_MEMWR(base + offset, MAX_LEN, buf);
+    memcpy(pSrc->model + offset, buf, MAX_LEN);
+}
+
+/***********************************************************************************
+* @fn      timerSubmit
+*
+* @brief   Timer callback: queue an operation, sometimes block on one, and run
+*          again ISR_PERIOD ticks on
+*/
+static void timerSubmit(void)
+{
+    if (held)
+        isrHeldRuns++;
+    submit(&isrSrc, ISR_BASE, isrDone);
+    if (rand() % ISR_BLOCKING == 0) {
+        readWrite(&isrSrc, ISR_BASE);
+        isrBlockingCount += 2;
+    }
+    rtimer_set(RTIMER_MAC, rtimer_now() + ISR_PERIOD, timerSubmit);
+}
+
+/***********************************************************************************
+* @fn      blocking
+*
+* @brief   A blocking read and write of main's area, optionally inside a bus
+*          hold of its own
+*/
+static void blocking(uint8_t nest)
+{
+    unsigned short istate;
+
+    if (nest) {
+        istate = CC2520_SPI_ACQUIRE();
+        held = TRUE;
+    }
+    readWrite(&mainSrc, MAIN_BASE);
+    blockingCount += 2;
+    if (nest) {
+        // Time passes with the bus held: the timer waits, nothing queued runs
+        cc2520sim_advance(200);
+        held = FALSE;
+        CC2520_SPI_RELEASE(istate);
+    }
+}
+
+static void usci(void)
+{
+    if (UCA1IFG & UCRXIFG)
+        CC2520_SPI_ASYNC_ISR();
+}
+
+static void dma(void)
+{
+    CC2520_SPI_DMA_ISR();
+}
+
+static void timer0(void)
+{
+    rtimer_isr_ccr0();
+}
+
+int main(void)
+{
+    cc2520sim_stats_t stats;
+    uint32_t ops = 0;
+    uint16_t i;
+
+    alarm(WATCHDOG_S);
+    srand(1);
+    cc2520sim_reset();
+    cc2520sim_setIsr(CC2520SIM_IRQ_USCI_A1, usci);
+    cc2520sim_setIsr(CC2520SIM_IRQ_DMA, dma);
+    cc2520sim_setIsr(CC2520SIM_IRQ_TIMER1_A0, timer0);
+    CHECK_EQ(cc2520ll_init(), SUCCESS);
+    for (i = 0; i < AREA_LEN; i++) {
+        cc2520sim_writeMem(MAIN_BASE + i, 0);
+        cc2520sim_writeMem(ISR_BASE + i, 0);
+    }
+    cc2520sim_resetStats();
+    _enable_interrupts();
+    rtimer_set(RTIMER_MAC, rtimer_now() + ISR_PERIOD, timerSubmit);
+
+    while (ops < MAIN_OPS) {
+        _disable_interrupts();
+        if (submit(&mainSrc, MAIN_BASE, mainDone))
+            ops++;
+        _enable_interrupts();
+        // Let the queue move on, sometimes not at all
+        cc2520sim_advance(rand() % 8);
+        if (rand() % 64 == 0)
+            blocking(rand() & 1);
+    }
+    rtimer_cancel(RTIMER_MAC);
+    CC2520_SPI_ASYNC_FLUSH();
+    CHECK_EQ(CC2520_SPI_ASYNC_PENDING(), 0);
+    CHECK_EQ(mainSrc.tail, mainSrc.head);
+    CHECK_EQ(isrSrc.tail, isrSrc.head);
+
+    for (i = 0; i < AREA_LEN; i++) {
+        if (cc2520sim_readMem(MAIN_BASE + i) != mainSrc.model[i] || \
+            cc2520sim_readMem(ISR_BASE + i) != isrSrc.model[i])
+            break;
+    }
+    CHECK_EQ(i, AREA_LEN);
+    CHECK(isrSrc.done > 1000);
+    CHECK(isrBlockingCount > 0);
+    CHECK_EQ(isrHeldRuns, 0);
+
+    // One CSn frame per instruction
+    cc2520sim_getStats(&stats);
+    CHECK_EQ(stats.spiTransactions, mainSrc.done + isrSrc.done + blockingCount + isrBlockingCount);
+    printf("%u main and %u timer instructions queued, %u and %u blocking, %u transactions\n", \
+        (unsigned)mainSrc.done, (unsigned)isrSrc.done, (unsigned)blockingCount, (unsigned)isrBlockingCount, \
+        (unsigned)stats.spiTransactions);
+    TEST_DONE("test_async");
+}
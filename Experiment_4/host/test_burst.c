@@ -0,0 +1,80 @@
+/***********************************************************************************
+
+  Filename:     test_burst.c
+
+  Description:  Register set-up in bursts (cc2520ll_config): the register file
+                it leaves is the one a write per table entry leaves, and it
+                takes one transaction per run of consecutive addresses plus
+                one read-back, against one per entry plus the single-register
+                check it replaced.
+
+***********************************************************************************/
+#include <string.h>
+#include "cc2520ll.h"
+#include "host_test.h"
+
+#define REG_SPACE       0x80        // FREG and SREG
+
+extern void cc2520ll_spiInit(void);
+
+static void snapshot(uint8_t *pRegs)
+{
+    uint8_t i;
+
+    for (i = 0; i < REG_SPACE; i++) {
+        pRegs[i] = cc2520sim_readMem(i);
+    }
+}
+
+int main(void)
+{
+    uint8_t burstRegs[REG_SPACE], singleRegs[REG_SPACE];
+    const regVal_t *pTable;
+    cc2520sim_stats_t stats;
+    uint32_t burst, single;
+    uint8_t n, i, runs, len;
+    unsigned short istate;
+
+    pTable = cc2520ll_regTable(&n);
+    runs = 0;
+    for (i = 0; i < n; i += len) {
+        for (len = 1; i + len < n && len < CC2520_REG_BURST_LEN && \
+             pTable[i + len].reg == pTable[i].reg + len; len++);
+        runs++;
+    }
+
+    // Now: bursts and one read-back
+    cc2520sim_reset();
+    cc2520ll_spiInit();
+    cc2520sim_resetStats();
+    CHECK_EQ(cc2520ll_config(), SUCCESS);
+    cc2520sim_getStats(&stats);
+    burst = stats.spiTransactions;
+    CHECK_EQ(burst, runs + 1);
+    snapshot(burstRegs);
+    for (i = 0; i < n; i++) {
+        CHECK_EQ(burstRegs[pTable[i].reg], pTable[i].val);
+    }
+
+    // Before: one MEMWR8 per entry and a check of MDMCTRL0, from reset values
+    CC2520_SPI_BEGIN(istate);
+    CC2520_SPI_TX(CC2520_INS_SRES);
+    CC2520_SPI_WAIT_RXRDY();
+    CC2520_SPI_TX(0x00);
+    CC2520_SPI_WAIT_RXRDY();
+    CC2520_SPI_END(istate);
+    cc2520sim_resetStats();
+    for (i = 0; i < n; i++) {
+        CC2520_MEMWR8(pTable[i].reg, pTable[i].val);
+    }
+    CHECK_EQ(CC2520_MEMRD8(CC2520_MDMCTRL0), burstRegs[CC2520_MDMCTRL0]);
+    cc2520sim_getStats(&stats);
+    single = stats.spiTransactions;
+    CHECK_EQ(single, n + 1);
+    snapshot(singleRegs);
+    CHECK(memcmp(burstRegs, singleRegs, REG_SPACE) == 0);
+
+    printf("%u table entries in %u runs: %u transactions, %u before\n", n, runs, \
+        (unsigned)burst, (unsigned)single);
+    TEST_DONE("test_burst");
+}
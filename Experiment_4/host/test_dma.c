@@ -0,0 +1,168 @@
+/***********************************************************************************
+
+  Filename:     test_dma.c
+
+  Description:  DMA transfer engine (CC2520_SPI_DMA): every bulk instruction
+                moves exactly the bytes asked for, in order, in one CSn
+                frame, on both sides of CC2520_DMA_MIN_COUNT; non-blocking
+                transfers call back once with the status byte. Prints the
+                modeled bus time of a 127-byte transfer.
+
+***********************************************************************************/
+#include <string.h>
+#include "cc2520ll.h"
+#include "host_test.h"
+
+#define RAM_ADDR        0x200
+#define GUARD           0xA5
+
+static uint8_t sentFrame[128], sentLen;
+static int callbacks;
+static uint8_t callbackStatus;
+
+static void txHook(const uint8_t *pFrame, uint8_t len)
+{
+    memcpy(sentFrame, pFrame, len);
+    sentLen = len;
+}
+
+static void dmaDone(uint8_t status)
+{
+    callbacks++;
+    callbackStatus = status;
+}
+
+/***********************************************************************************
+* @fn      testMem
+*
+* @brief   MEMWR and MEMRD of count bytes, with a guard byte after the data on
+*          both sides
+*/
+static void testMem(uint16_t count)
+{
+    static uint8_t buf[301];
+    cc2520sim_stats_t stats;
+    uint16_t i;
+
+    for (i = 0; i < count; i++) {
+        buf[i] = (uint8_t)(i * 7 + count);
+    }
+    cc2520sim_writeMem(RAM_ADDR + count, GUARD);
+    cc2520sim_resetStats();
+    CC2520_MEMWR(RAM_ADDR, count, buf);
+    cc2520sim_getStats(&stats);
+    CHECK_EQ(stats.spiBytes, 2 + count);
+    CHECK_EQ(stats.spiTransactions, 1);
+    for (i = 0; i < count; i++) {
+        if (cc2520sim_readMem(RAM_ADDR + i) != buf[i])
+            break;
+    }
+    CHECK_EQ(i, count);
+    CHECK_EQ(cc2520sim_readMem(RAM_ADDR + count), GUARD);
+
+    for (i = 0; i < count; i++) {
+        cc2520sim_writeMem(RAM_ADDR + i, (uint8_t)(0xFF - i));
+    }
+    memset(buf, GUARD, sizeof(buf));
+    cc2520sim_resetStats();
+    CC2520_MEMRD(RAM_ADDR, count, buf);
+    cc2520sim_getStats(&stats);
+    CHECK_EQ(stats.spiBytes, 2 + count);
+    CHECK_EQ(stats.spiTransactions, 1);
+    for (i = 0; i < count; i++) {
+        if (buf[i] != (uint8_t)(0xFF - i))
+            break;
+    }
+    CHECK_EQ(i, count);
+    CHECK_EQ(buf[count], GUARD);
+}
+
+/***********************************************************************************
+* @fn      testFifo
+*
+* @brief   TXBUF a frame and send it; RXBUF a received frame
+*/
+static void testFifo(uint8_t len)
+{
+    uint8_t frame[128], buf[129];
+    cc2520sim_stats_t stats;
+    uint8_t i;
+
+    // PHR counts the FCS the radio appends
+    frame[0] = len + 2;
+    for (i = 1; i <= len; i++) {
+        frame[i] = (uint8_t)(i ^ len);
+    }
+    CC2520_INS_STROBE(CC2520_INS_SFLUSHTX);
+    cc2520sim_resetStats();
+    CC2520_TXBUF(len + 1, frame);
+    cc2520sim_getStats(&stats);
+    CHECK_EQ(stats.spiBytes, 2 + len);
+    CHECK_EQ(stats.spiTransactions, 1);
+    CHECK_EQ(cc2520sim_txFifoCount(), len + 1);
+    sentLen = 0;
+    CC2520_INS_STROBE(CC2520_INS_STXON);
+    cc2520sim_advance(5000);
+    CHECK_EQ(sentLen, len + 1);
+    CHECK(memcmp(sentFrame, frame, len + 1) == 0);
+
+    CC2520_INS_STROBE(CC2520_INS_SRXON);
+    CHECK(cc2520sim_rxFrame(frame + 1, len, -40, 1));
+    memset(buf, GUARD, sizeof(buf));
+    cc2520sim_resetStats();
+    CC2520_RXBUF(len + 1, buf);
+    cc2520sim_getStats(&stats);
+    CHECK_EQ(stats.spiBytes, 2 + len);
+    CHECK_EQ(buf[0], len + 2);
+    CHECK(memcmp(buf + 1, frame + 1, len) == 0);
+    CHECK_EQ(buf[len + 1], GUARD);
+    CC2520_INS_STROBE(CC2520_INS_SFLUSHRX);
+}
+
+int main(void)
+{
+    static const uint16_t counts[] = { 1, CC2520_DMA_MIN_COUNT - 1, CC2520_DMA_MIN_COUNT, \
+        CC2520_DMA_MIN_COUNT + 1, 64, 127, 300 };
+    uint8_t buf[127], status;
+    cc2520sim_stats_t stats;
+    cc2520ll_filter_t filter;
+    uint8_t i;
+
+    cc2520sim_reset();
+    cc2520sim_setIsr(CC2520SIM_IRQ_DMA, CC2520_SPI_DMA_ISR);
+    cc2520sim_setTxHook(txHook);
+    CHECK_EQ(cc2520ll_init(), SUCCESS);
+    // Frames of any content, read here rather than by the RX interrupt
+    cc2520ll_getFilter(&filter);
+    filter.enable = FALSE;
+    cc2520ll_setFilter(&filter);
+    _enable_interrupts();
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        testMem(counts[i]);
+    }
+    testFifo(1);
+    testFifo(CC2520_DMA_MIN_COUNT);
+    testFifo(125);
+
+    // Non-blocking: one callback with the instruction status byte
+    for (i = 0; i < sizeof(buf); i++) {
+        cc2520sim_writeMem(RAM_ADDR + i, i);
+    }
+    status = CC2520_MEMRD_DMA(RAM_ADDR, sizeof(buf), buf, dmaDone);
+    CC2520_SPI_DMA_WAIT();
+    CHECK_EQ(callbacks, 1);
+    CHECK_EQ(callbackStatus, status);
+    CHECK(!CC2520_SPI_DMA_BUSY());
+    for (i = 0; i < sizeof(buf) && buf[i] == i; i++);
+    CHECK_EQ(i, sizeof(buf));
+    status = CC2520_MEMWR_DMA(RAM_ADDR, 0, buf, dmaDone);
+    CHECK_EQ(callbacks, 2);
+
+    cc2520sim_resetStats();
+    CC2520_MEMRD(RAM_ADDR, sizeof(buf), buf);
+    cc2520sim_getStats(&stats);
+    printf("127-byte MEMRD: %u bytes, %u ns on the bus\n", stats.spiBytes, stats.busNs);
+
+    TEST_DONE("test_dma");
+}
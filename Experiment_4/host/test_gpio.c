@@ -0,0 +1,101 @@
+/***********************************************************************************
+
+  Filename:     test_gpio.c
+
+  Description:  GPIO mux writes per transmitted frame with INCLUDE_PA. GPIO2
+                carries TX_FRM_DONE while a frame is sent and RSSI_VALID
+                otherwise: outside TX mode that is two GPIOCTRL2 writes per
+                frame, in TX mode one on entry and one on leaving, however
+                many frames go out in between. The shadow must agree with the
+                register after each frame. Prints the SPI transactions of
+                both runs.
+
+***********************************************************************************/
+#include "cc2520ll.h"
+#include "rtimer.h"
+#include "host_test.h"
+
+#define FRAMES          20
+#define FRAME_LEN       40
+
+static void port2(void)
+{
+    if (P2IFG & (1 << CC2520_INT_PIN))
+        cc2520ll_packetReceivedISR();
+    if (P2IFG & (1 << CC2520_TX_INT_PIN))
+        cc2520ll_txFrameDoneISR();
+    __bic_SR_register_on_exit(LPM0_bits);
+}
+
+static void timer0(void)
+{
+    rtimer_isr_ccr0();
+    __bic_SR_register_on_exit(LPM0_bits);
+}
+
+static void timer1(void)
+{
+    rtimer_isr_ccr();
+    __bic_SR_register_on_exit(LPM0_bits);
+}
+
+// Send FRAMES frames; returns the GPIOCTRLn writes and SPI transactions
+static uint16_t sendFrames(uint32_t *pTransactions)
+{
+    uint8_t pkt[FRAME_LEN];
+    cc2520sim_stats_t stats;
+    uint16_t writes;
+    uint8_t i, k;
+
+    for (i = 0; i < FRAME_LEN; i++)
+        pkt[i] = i;
+    cc2520sim_resetStats();
+    writes = CC2520_GPIO_WRITES();
+    for (k = 0; k < FRAMES; k++) {
+        pkt[0] = k;
+        CHECK_EQ(cc2520ll_packetSend(pkt, FRAME_LEN), SUCCESS);
+        CHECK_EQ(cc2520sim_readMem(CC2520_GPIOCTRL2), CC2520_GPIO_GET_FUNC(2));
+    }
+    cc2520sim_getStats(&stats);
+    CHECK_EQ(stats.txFrames, FRAMES);
+    *pTransactions = stats.spiTransactions;
+    return CC2520_GPIO_WRITES() - writes;
+}
+
+int main(void)
+{
+    uint32_t plainTrans, txModeTrans;
+    uint16_t plain, txMode, writes;
+
+    cc2520sim_reset();
+    cc2520sim_setIsr(CC2520SIM_IRQ_PORT2, port2);
+    cc2520sim_setIsr(CC2520SIM_IRQ_TIMER1_A0, timer0);
+    cc2520sim_setIsr(CC2520SIM_IRQ_TIMER1_A1, timer1);
+    CHECK_EQ(cc2520ll_init(), SUCCESS);
+    _enable_interrupts();
+    cc2520ll_receiveOn();
+    CHECK_EQ(CC2520_GPIO_GET_FUNC(2), CC2520_GPIO_RSSI_VALID);
+
+    // GPIO2 goes to TX_FRM_DONE and back for every frame
+    plain = sendFrames(&plainTrans);
+    CHECK_EQ(plain, 2 * FRAMES);
+    CHECK_EQ(CC2520_GPIO_GET_FUNC(2), CC2520_GPIO_RSSI_VALID);
+
+    // TX mode: GPIO2 is moved once and stays
+    cc2520ll_setTxMode(TRUE);
+    txMode = sendFrames(&txModeTrans);
+    CHECK_EQ(txMode, 1);
+    CHECK_EQ(CC2520_GPIO_GET_FUNC(2), 1 + CC2520_EXC_TX_FRM_DONE);
+    // Less than the writes saved: their status bytes also refreshed the
+    // status shadow, and a frame now starts with an SNOP instead
+    CHECK(txModeTrans < plainTrans);
+    writes = CC2520_GPIO_WRITES();
+    cc2520ll_setTxMode(FALSE);
+    CHECK_EQ(CC2520_GPIO_WRITES() - writes, 1);
+    CHECK_EQ(CC2520_GPIO_GET_FUNC(2), CC2520_GPIO_RSSI_VALID);
+    CHECK_EQ(cc2520sim_readMem(CC2520_GPIOCTRL2), CC2520_GPIO_RSSI_VALID);
+
+    printf("%u frames: %u GPIO writes, %u in TX mode; %u and %u SPI transactions\n", \
+        FRAMES, plain, txMode, (unsigned)plainTrans, (unsigned)txModeTrans);
+    TEST_DONE("test_gpio");
+}
@@ -0,0 +1,125 @@
+/***********************************************************************************
+
+  Filename:     test_spsc.c
+
+  Description:  Stress test of the single producer, single consumer ring
+                buffer in sense_utils with a real producer thread standing
+                in for the ISR. The producer bufPut()s a byte stream in
+                blocks of random length and retries a block that does not
+                fit; the consumer bufPeek()s and bufGet()s blocks of random
+                length and checks every byte against the stream. A peek must
+                match the start of the get that follows it, and neither side
+                may see more than len - 1 bytes in the buffer. The odd
+                buffer length moves the wrap point through the stream.
+                A timer signal makes whichever thread it lands in yield every
+                PREEMPT_US, so the threads also interleave mid-operation on a
+                single CPU; a side that cannot move yields too.
+
+***********************************************************************************/
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include "sense_utils.h"
+#include "host_test.h"
+
+#define STREAM_LEN      32000000UL
+#define RING_LEN        517
+#define MAX_BLOCK       127
+#define WATCHDOG_S      30
+#define PREEMPT_US      50
+
+static uint8_t ringData[RING_LEN];
+static ringBuf_t ring;
+static volatile uint32_t producerBad;
+
+static uint8_t streamByte(uint32_t i)
+{
+    return (uint8_t)(i * 131 + (i >> 8) + 7);
+}
+
+// Switch threads wherever the running one happens to be
+static void preempt(int sig)
+{
+    (void)sig;
+    sched_yield();
+}
+
+static void *producer(void *arg)
+{
+    uint8_t block[MAX_BLOCK];
+    uint32_t sent;
+    uint16_t n, i;
+    unsigned seed = 1;
+
+    (void)arg;
+    for (sent = 0; sent < STREAM_LEN; sent += n) {
+        n = 1 + rand_r(&seed) % MAX_BLOCK;
+        if (sent + n > STREAM_LEN)
+            n = STREAM_LEN - sent;
+        for (i = 0; i < n; i++)
+            block[i] = streamByte(sent + i);
+        while (bufPut(&ring, block, n) == 0) {
+            if (bufNumBytes(&ring) >= RING_LEN)
+                producerBad++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    uint8_t block[MAX_BLOCK], peek[MAX_BLOCK];
+    uint32_t got, bad, emptyGets;
+    uint16_t want, n, p, i;
+    unsigned seed = 2;
+    pthread_t thread;
+    struct sigevent event = { .sigev_notify = SIGEV_SIGNAL, .sigev_signo = SIGPROF };
+    struct itimerspec period = { { 0, PREEMPT_US * 1000 }, { 0, PREEMPT_US * 1000 } };
+    timer_t timer;
+
+    alarm(WATCHDOG_S);
+    signal(SIGPROF, preempt);
+    CHECK_EQ(timer_create(CLOCK_MONOTONIC, &event, &timer), 0);
+    timer_settime(timer, 0, &period, NULL);
+    bufInit(&ring, ringData, RING_LEN);
+    CHECK_EQ(pthread_create(&thread, NULL, producer, NULL), 0);
+
+    got = bad = emptyGets = 0;
+    while (got < STREAM_LEN) {
+        want = 1 + rand_r(&seed) % MAX_BLOCK;
+        p = bufPeek(&ring, peek, want);
+        n = bufGet(&ring, block, want);
+        // The producer can only add bytes between the two
+        if (n < p)
+            bad++;
+        for (i = 0; i < p && i < n; i++) {
+            if (peek[i] != block[i])
+                bad++;
+        }
+        for (i = 0; i < n; i++) {
+            if (block[i] != streamByte(got + i))
+                bad++;
+        }
+        if (n == 0) {
+            emptyGets++;
+            sched_yield();
+        }
+        got += n;
+        if (bufNumBytes(&ring) >= RING_LEN)
+            bad++;
+    }
+    CHECK_EQ(pthread_join(thread, NULL), 0);
+    timer_delete(timer);
+
+    CHECK_EQ(got, STREAM_LEN);
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(producerBad, 0);
+    CHECK_EQ(bufNumBytes(&ring), 0);
+    printf("%lu bytes through a %u-byte ring, %u gets found it empty\n", STREAM_LEN, RING_LEN, \
+        (unsigned)emptyGets);
+    TEST_DONE("test_spsc");
+}
@@ -0,0 +1,142 @@
+/***********************************************************************************
+
+  Filename:     test_status.c
+
+  Description:  Status byte shadow (CC2520_STATUS_QUERY) against the simulated
+                radio FSM. Random strobes, register and memory accesses,
+                transmissions, received frames and idle time move the radio
+                between its states. After each step a query for random bits
+                either reads the status byte once or is counted as saved and
+                agrees with an SNOP read. Counts the reads saved by
+                cc2520ll_rx_active() and cc2520ll_tx_active() polled with the
+                receiver on and off; with it on, FSMSTAT1 is read once per
+                rtimer tick.
+
+***********************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "cc2520ll.h"
+#include "rtimer.h"
+#include "host_test.h"
+
+#define STEPS           5000
+#define POLLS           1000
+#define POLL_US         5           // Between polls
+
+static const uint8_t frame[] = { 0x41, 0x88, 0x01, 0xcd, 0xab, 0xff, 0xff, 0x34, 0x12, 1, 2, 3 };
+
+/***********************************************************************************
+* @fn      step
+*
+* @brief   One random action on the radio
+*/
+static void step(void)
+{
+    uint8_t buf[sizeof(frame) + 1];
+
+    switch (rand() % 9) {
+    case 0:
+        CC2520_INS_STROBE(CC2520_INS_SRXON);
+        break;
+    case 1:
+        CC2520_INS_STROBE(CC2520_INS_SRFOFF);
+        break;
+    case 2:
+        // Load and send a frame
+        buf[0] = sizeof(frame) + 2;
+        memcpy(buf + 1, frame, sizeof(frame));
+        CC2520_INS_STROBE(CC2520_INS_SFLUSHTX);
+        CC2520_TXBUF(sizeof(buf), buf);
+        CC2520_INS_STROBE(CC2520_INS_STXON);
+        break;
+    case 3:
+        cc2520sim_rxFrame(frame, sizeof(frame), -50, 1);
+        break;
+    case 4:
+        CC2520_INS_STROBE(CC2520_INS_SFLUSHRX);
+        break;
+    case 5:
+        CC2520_REGRD8(CC2520_FSMSTAT1);
+        break;
+    case 6:
+        CC2520_MEMRD8(0x200);
+        break;
+    case 7:
+        CC2520_REGWR8(CC2520_EXCFLAG0, 0);
+        CC2520_REGWR8(CC2520_EXCFLAG1, 0);
+        break;
+    default:
+        cc2520sim_advance(rand() % 2000);
+        break;
+    }
+}
+
+int main(void)
+{
+    cc2520sim_stats_t before, after;
+    uint32_t saved, queries, n, ticks;
+    rtimer_clock_t last;
+    uint8_t mask, s;
+    uint16_t i;
+
+    srand(1);
+    cc2520sim_reset();
+    CHECK_EQ(cc2520ll_init(), SUCCESS);
+
+    // The shadow agrees with the radio, and each query is one read or saved
+    queries = 0;
+    saved = CC2520_STATUS_SAVED();
+    cc2520sim_resetStats();
+    for (i = 0; i < STEPS; i++) {
+        step();
+        mask = (uint8_t)rand();
+        cc2520sim_getStats(&before);
+        n = CC2520_STATUS_SAVED();
+        s = CC2520_STATUS_QUERY(mask);
+        cc2520sim_getStats(&after);
+        queries++;
+        if (after.spiTransactions == before.spiTransactions) {
+            // From the shadow: counted, and what the radio would have said
+            CHECK_EQ(CC2520_STATUS_SAVED(), n + 1);
+            CHECK_EQ(s, CC2520_SNOP() & mask);
+        } else {
+            CHECK_EQ(after.spiTransactions, before.spiTransactions + 1);
+            CHECK_EQ(CC2520_STATUS_SAVED(), n);
+        }
+    }
+    saved = CC2520_STATUS_SAVED() - saved;
+    CHECK(saved > 0);
+    printf("random: %u of %u queries from the shadow\n", (unsigned)saved, (unsigned)queries);
+
+    // Polling the way the driver waits for the end of a frame. With the
+    // receiver on, cc2520ll_rx_active() reads FSMSTAT1 for the SFD bit once
+    // per rtimer tick; with it off the status byte answers. Before the
+    // shadow every query was a FSMSTAT1 read.
+    cc2520sim_advance(5000);
+    CC2520_INS_STROBE(CC2520_INS_SFLUSHRX);
+    for (s = 0; s < 2; s++) {
+        CC2520_INS_STROBE(s ? CC2520_INS_SRFOFF : CC2520_INS_SRXON);
+        CC2520_REGRD8(CC2520_FSMSTAT1);
+        saved = CC2520_STATUS_SAVED();
+        cc2520sim_resetStats();
+        ticks = 0;
+        last = rtimer_now() - 1;
+        for (i = 0; i < POLLS; i++) {
+            CHECK(!cc2520ll_tx_active());
+            if (rtimer_now() != last) {
+                last = rtimer_now();
+                ticks++;
+            }
+            CHECK(!cc2520ll_rx_active());
+            cc2520sim_advance(POLL_US);
+        }
+        cc2520sim_getStats(&after);
+        saved = CC2520_STATUS_SAVED() - saved;
+        CHECK_EQ(saved, 2 * POLLS);
+        CHECK_EQ(after.spiTransactions, s ? 0 : ticks);
+        CHECK(ticks < POLLS / 4);
+        printf("polling, receiver %s: %u of %u status reads saved, %u transactions\n", \
+            s ? "off" : "on", (unsigned)saved, 2 * POLLS, (unsigned)after.spiTransactions);
+    }
+    TEST_DONE("test_status");
+}
@@ -0,0 +1,70 @@
+#include "infomem.h"
+
+/***********************************************************************************
+* @fn      infomem_read32
+*
+* @brief   Read a 32-bit word, low word first
+*
+* @param   uint16_t addr - word aligned address in information memory
+*
+* @return  uint32_t - the word, INFOMEM_ERASED32 if erased
+*/
+uint32_t infomem_read32(uint16_t addr)
+{
+    return INFOMEM_RD16(addr) | ((uint32_t)INFOMEM_RD16(addr + 2) << 16);
+}
+
+/***********************************************************************************
+* @fn      infomem_erase
+*
+* @brief   Erase a segment to 0xFF. The CPU is held for the erase time, up to
+*          32 ms, and interrupts stay disabled throughout: the interrupt
+*          vectors are in flash too.
+*
+* @param   uint16_t seg - any address in the segment
+*
+* @return  none
+*/
+void infomem_erase(uint16_t seg)
+{
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    FCTL3 = FWKEY;
+    FCTL1 = FWKEY | ERASE;
+    INFOMEM_WR16(seg & ~(INFOMEM_SEG_LEN - 1), 0);     // Dummy write starts the erase
+    while (FCTL3 & BUSY);
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY | LOCK;
+    __set_interrupt_state(istate);
+}
+
+/***********************************************************************************
+* @fn      infomem_write32
+*
+* @brief   Write a 32-bit word to erased flash and read it back. Each of the
+*          two word writes holds the CPU for up to 85 us with interrupts
+*          disabled.
+*
+* @param   uint16_t addr - word aligned address in information memory
+*          uint32_t value
+*
+* @return  uint8_t - 1 if the word reads back, 0 if not
+*/
+uint8_t infomem_write32(uint16_t addr, uint32_t value)
+{
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    FCTL3 = FWKEY;
+    FCTL1 = FWKEY | WRT;
+    INFOMEM_WR16(addr, (uint16_t)value);
+    INFOMEM_WR16(addr + 2, (uint16_t)(value >> 16));
+    while (FCTL3 & BUSY);
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY | LOCK;
+    __set_interrupt_state(istate);
+    return infomem_read32(addr) == value;
+}
@@ -0,0 +1,48 @@
+/***********************************************************************************
+  Filename:     infomem.h
+
+  Description:  Information memory of the MSP430F5435: four 128-byte flash
+                segments, D at 0x1800 up to A at 0x1980, kept over resets
+                and reprogramming of main memory. Segments are erased to
+                0xFF as a whole; a write can only clear bits. Segment A is
+                locked by LOCKA and not used here.
+
+***********************************************************************************/
+#ifndef INFOMEM_H_
+#define INFOMEM_H_
+
+/***********************************************************************************
+* INCLUDES
+*/
+#include <inttypes.h>
+#ifdef CC2520_HOST
+#include "host/hal_cc2520_host.h"
+#else
+#include <msp430f5435.h>
+#endif
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+#define INFOMEM_SEG_LEN             128
+#define INFOMEM_D                   0x1800
+#define INFOMEM_C                   0x1880
+#define INFOMEM_B                   0x1900
+
+// Word access; the host build routes it through the simulated flash controller
+#ifndef CC2520_HOST
+#define INFOMEM_RD16(addr)          (*(const volatile uint16_t *)(addr))
+#define INFOMEM_WR16(addr, v)       (*(volatile uint16_t *)(addr) = (v))
+#endif
+
+// Content of an erased word
+#define INFOMEM_ERASED32            0xFFFFFFFFUL
+
+/***********************************************************************************
+* GLOBAL FUNCTIONS
+*/
+uint32_t infomem_read32(uint16_t addr);
+void infomem_erase(uint16_t seg);
+uint8_t infomem_write32(uint16_t addr, uint32_t value);
+
+#endif /*INFOMEM_H_*/
@@ -0,0 +1,288 @@
+#include "rtimer.h"
+
+/***********************************************************************************
+* LOCAL VARIABLES
+*/
+static rtimer_callback_t callbacks[RTIMER_CHANNELS];
+static uint8_t captures;                    // Channels in capture mode, one bit each
+static volatile uint16_t wraps;             // Overflows, the high word of rtimer_now32()
+static rtimer_callback_t wrapCallback;
+
+// TA1CCTLn and TA1CCRn are consecutive words
+#define RTIMER_CCTL(ch)     ((&TA1CCTL0)[ch])
+#define RTIMER_CCR(ch)      ((&TA1CCR0)[ch])
+
+/***********************************************************************************
+* @fn      rtimer_init
+*
+* @brief   Start Timer_A1 from ACLK in continuous mode with every channel off
+*          and the overflow interrupt on. Calling it again leaves a running
+*          timer and its channels alone.
+*
+* @param   none
+*
+* @return  none
+*/
+void rtimer_init(void)
+{
+    uint8_t ch;
+
+    if (TA1CTL & MC_2)
+        return;
+    for (ch = 0; ch < RTIMER_CHANNELS; ch++) {
+        RTIMER_CCTL(ch) = 0;
+        callbacks[ch] = NULL;
+    }
+    captures = 0;
+    wraps = 0;
+    TA1CTL = TASSEL_1 | ID_0 | MC_2 | TACLR | TAIE;
+}
+
+/***********************************************************************************
+* @fn      rtimer_now
+*
+* @brief   Current time. TA1R counts from an asynchronous clock, so it is read
+*          until two reads agree.
+*
+* @param   none
+*
+* @return  rtimer_clock_t - ticks
+*/
+rtimer_clock_t rtimer_now(void)
+{
+    rtimer_clock_t t1, t2;
+
+    t1 = TA1R;
+    do {
+        t2 = t1;
+        t1 = TA1R;
+    } while (t1 != t2);
+    return t1;
+}
+
+/***********************************************************************************
+* @fn      rtimer_set
+*
+* @brief   Run callback from the timer interrupt at the given time. A time
+*          already past fires at once. Replaces whatever the channel held.
+*
+* @param   uint8_t ch - channel, RTIMER_xxx
+*          rtimer_clock_t time - absolute time
+*          rtimer_callback_t callback
+*
+* @return  none
+*/
+void rtimer_set(uint8_t ch, rtimer_clock_t time, rtimer_callback_t callback)
+{
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    captures &= ~(1 << ch);
+    callbacks[ch] = callback;
+    RTIMER_CCR(ch) = time;
+    RTIMER_CCTL(ch) = CCIE;
+    if (!RTIMER_CLOCK_LT(rtimer_now(), time)) {
+        // Missed the compare: raise the interrupt by hand
+        RTIMER_CCTL(ch) |= CCIFG;
+    }
+    __set_interrupt_state(istate);
+}
+
+/***********************************************************************************
+* @fn      rtimer_cancel
+*
+* @brief   Stop a channel without running its callback
+*
+* @param   uint8_t ch - channel
+*
+* @return  none
+*/
+void rtimer_cancel(uint8_t ch)
+{
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    RTIMER_CCTL(ch) = 0;
+    captures &= ~(1 << ch);
+    callbacks[ch] = NULL;
+    __set_interrupt_state(istate);
+}
+
+/***********************************************************************************
+* @fn      rtimer_pending
+*
+* @brief   Is a callback waiting on the channel?
+*
+* @param   uint8_t ch - channel
+*
+* @return  uint8_t - TRUE if the channel is armed
+*/
+uint8_t rtimer_pending(uint8_t ch)
+{
+    return callbacks[ch] != NULL;
+}
+
+/***********************************************************************************
+* @fn      rtimer_now32
+*
+* @brief   Current time extended to 32 bits with the overflow count. An
+*          overflow whose interrupt has not run yet is counted here.
+*
+* @param   none
+*
+* @return  uint32_t - ticks, wrapping after 36 hours
+*/
+uint32_t rtimer_now32(void)
+{
+    unsigned short istate;
+    uint16_t hi;
+    rtimer_clock_t t;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    hi = wraps;
+    t = rtimer_now();
+    if ((TA1CTL & TAIFG) && !(t & 0x8000))
+        hi++;
+    __set_interrupt_state(istate);
+    return ((uint32_t)hi << 16) | t;
+}
+
+/***********************************************************************************
+* @fn      rtimer_extend
+*
+* @brief   Extend a time taken within the last 2 s, such as a capture, to 32
+*          bits
+*
+* @param   rtimer_clock_t time - ticks, not in the future
+*
+* @return  uint32_t - ticks on the rtimer_now32() scale
+*/
+uint32_t rtimer_extend(rtimer_clock_t time)
+{
+    uint32_t now = rtimer_now32();
+
+    return now - (rtimer_clock_t)((rtimer_clock_t)now - time);
+}
+
+/***********************************************************************************
+* @fn      rtimer_capture
+*
+* @brief   Put a channel in capture mode: the rising edge of its CCIxA input
+*          latches the timer and callback runs from the timer interrupt. The
+*          channel stays armed until rtimer_cancel().
+*
+* @param   uint8_t ch - channel whose CCIxA pin is selected in PxSEL
+*          rtimer_callback_t callback - reads rtimer_captureTime(ch)
+*
+* @return  none
+*/
+void rtimer_capture(uint8_t ch, rtimer_callback_t callback)
+{
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    callbacks[ch] = callback;
+    captures |= 1 << ch;
+    RTIMER_CCTL(ch) = CM_1 | CCIS_0 | SCS | CAP | CCIE;
+    __set_interrupt_state(istate);
+}
+
+/***********************************************************************************
+* @fn      rtimer_captureTime
+*
+* @brief   Time of the last edge captured on a channel
+*
+* @param   uint8_t ch - channel in capture mode
+*
+* @return  uint32_t - ticks on the rtimer_now32() scale
+*/
+uint32_t rtimer_captureTime(uint8_t ch)
+{
+    return rtimer_extend(RTIMER_CCR(ch));
+}
+
+/***********************************************************************************
+* @fn      rtimer_setWrap
+*
+* @brief   Run callback from the timer interrupt at every overflow, once per
+*          RTIMER_WRAP_SECONDS
+*
+* @param   rtimer_callback_t callback - NULL to stop
+*
+* @return  none
+*/
+void rtimer_setWrap(rtimer_callback_t callback)
+{
+    unsigned short istate;
+
+    istate = __get_interrupt_state();
+    __disable_interrupt();
+    wrapCallback = callback;
+    __set_interrupt_state(istate);
+}
+
+/***********************************************************************************
+* @fn      rtimer_fire
+*
+* @brief   Disarm a channel and run its callback, which may arm it again. A
+*          capture channel stays armed.
+*/
+static void rtimer_fire(uint8_t ch)
+{
+    rtimer_callback_t callback;
+
+    if (captures & (1 << ch)) {
+        RTIMER_CCTL(ch) &= ~(CCIFG | COV);
+        if (callbacks[ch])
+            callbacks[ch]();
+        return;
+    }
+    RTIMER_CCTL(ch) = 0;
+    callback = callbacks[ch];
+    callbacks[ch] = NULL;
+    if (callback)
+        callback();
+}
+
+/***********************************************************************************
+* @fn      rtimer_isr_ccr0
+*
+* @brief   TIMER1_A0_VECTOR: channel 0. CCIFG is cleared by the vector.
+*
+* @return  none
+*/
+void rtimer_isr_ccr0(void)
+{
+    rtimer_fire(0);
+}
+
+/***********************************************************************************
+* @fn      rtimer_isr_ccr
+*
+* @brief   TIMER1_A1_VECTOR: channels 1 and 2 and the overflow. Reading TA1IV
+*          clears the flag it reports.
+*
+* @return  none
+*/
+void rtimer_isr_ccr(void)
+{
+    switch (TA1IV) {
+    case RTIMER_IV_CCR1:
+        rtimer_fire(1);
+        break;
+    case RTIMER_IV_CCR2:
+        rtimer_fire(2);
+        break;
+    case RTIMER_IV_OVERFLOW:
+        wraps++;
+        if (wrapCallback)
+            wrapCallback();
+        break;
+    default:
+        break;
+    }
+}
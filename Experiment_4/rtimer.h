@@ -0,0 +1,87 @@
+/***********************************************************************************
+  Filename:     rtimer.h
+
+  Description:  One-shot real-time timers on Timer_A1, clocked from ACLK
+                (32768 Hz XT1). The timer runs in continuous mode and keeps
+                running in LPM0-LPM3; each capture/compare register is one
+                timer channel. The overflow interrupt counts wraps, which
+                extends the 16-bit count to 32 bits (rtimer_now32).
+
+***********************************************************************************/
+#ifndef RTIMER_H_
+#define RTIMER_H_
+
+/***********************************************************************************
+* INCLUDES
+*/
+#include <inttypes.h>
+#include <stddef.h>
+#ifdef CC2520_HOST
+#include <assert.h>
+#include "host/hal_cc2520_host.h"
+#else
+#include <msp430f5435.h>
+#endif
+
+/***********************************************************************************
+* CONSTANTS AND DEFINES
+*/
+#define RTIMER_SECOND               32768UL
+
+// Channels (TA1CCR0-TA1CCR2)
+#define RTIMER_MAC                  0       // CSMA-CA backoffs and TX timeout (cc2520ll)
+#define RTIMER_LPL                  1       // Wake-ups and strobes (cc2520ll_lpl)
+#define RTIMER_TSCH                 1       // Slots (cc2520ll_tsch), instead of RTIMER_LPL
+#define RTIMER_SFD                  2       // SFD capture on P2.3/TA1.2 (cc2520ll)
+#define RTIMER_CHANNELS             3
+
+// TA1IV values
+#define RTIMER_IV_CCR1              0x02
+#define RTIMER_IV_CCR2              0x04
+#define RTIMER_IV_OVERFLOW          0x0E
+
+// Time between overflows, in seconds
+#define RTIMER_WRAP_SECONDS         2
+
+// Time conversions, rounded to the nearest tick. us * RTIMER_SECOND must fit
+// in 32 bits, so RTIMER_US_TO_TICKS takes at most RTIMER_US_MAX (about
+// 131 ms); use RTIMER_MS_TO_TICKS for longer times. Host builds assert it.
+#define RTIMER_US_MAX               (0xFFFFFFFFUL / RTIMER_SECOND)
+#ifdef CC2520_HOST
+#define RTIMER_US_CHECK(us)         assert((uint32_t)(us) <= RTIMER_US_MAX)
+#else
+#define RTIMER_US_CHECK(us)         ((void)0)
+#endif
+#define RTIMER_US_TO_TICKS(us)      (RTIMER_US_CHECK(us), \
+                                     (rtimer_clock_t)(((uint32_t)(us) * RTIMER_SECOND + 500000UL) / 1000000UL))
+#define RTIMER_MS_TO_TICKS(ms)      ((rtimer_clock_t)(((uint32_t)(ms) * RTIMER_SECOND + 500UL) / 1000UL))
+#define RTIMER_TICKS_TO_US(t)       ((uint32_t)(((uint32_t)(t) * 1000000UL + RTIMER_SECOND / 2) / RTIMER_SECOND))
+
+// Is a before b? Valid for times less than half a wrap (1 s) apart.
+#define RTIMER_CLOCK_LT(a, b)       ((int16_t)((a) - (b)) < 0)
+
+/***********************************************************************************
+* TYPEDEFS
+*/
+typedef uint16_t rtimer_clock_t;
+typedef void (*rtimer_callback_t)(void);
+
+/***********************************************************************************
+* GLOBAL FUNCTIONS
+*/
+void rtimer_init(void);
+rtimer_clock_t rtimer_now(void);
+void rtimer_set(uint8_t ch, rtimer_clock_t time, rtimer_callback_t callback);
+void rtimer_cancel(uint8_t ch);
+uint8_t rtimer_pending(uint8_t ch);
+uint32_t rtimer_now32(void);
+uint32_t rtimer_extend(rtimer_clock_t time);
+void rtimer_capture(uint8_t ch, rtimer_callback_t callback);
+uint32_t rtimer_captureTime(uint8_t ch);
+void rtimer_setWrap(rtimer_callback_t callback);
+
+// Interrupt handler routines (TIMER1_A0_VECTOR and TIMER1_A1_VECTOR)
+void rtimer_isr_ccr0(void);
+void rtimer_isr_ccr(void);
+
+#endif /*RTIMER_H_*/
@@ -1,4 +1,25 @@
+#include <string.h>
 #include "sense_utils.h"
+#ifdef BUF_DMA
+#include <msp430f5435.h>
+#endif
+
+// Shorter blocks are copied inline
+#define BUF_MEMCPY_MIN  8
+
+// Keeps the compiler from sinking the copy below the store that publishes
+// the new index. Compilers without a memory clobber (TI CCS) get a call
+// through a volatile pointer: it can not be inlined or analysed, so the
+// compiler must assume it reads the buffer and finish the copy first.
+#ifdef __GNUC__
+#define BUF_BARRIER()   __asm__ __volatile__("" : : : "memory")
+#else
+static void bufFence(void)
+{
+}
+static void (* volatile bufFencePtr)(void) = bufFence;
+#define BUF_BARRIER()   bufFencePtr()
+#endif
 
 /***********************************************************************************
 * @fn      bufInit
@@ -14,50 +35,148 @@
 */
 void bufInit(ringBuf_t *pBuf, uint8_t *buffer, uint16_t len)
 {        
-    pBuf->nBytes = 0;
     pBuf->iHead = 0;
     pBuf->iTail = 0;
     pBuf->pData = buffer;
     pBuf->len = len;
 }
 
+/***********************************************************************************
+* @fn      bufCount
+*
+* @brief   Bytes between a head and a tail index
+*
+* @param   pBuf - pointer to the ringbuffer
+*          head - read index
+*          tail - write index
+*
+* @return  Number of bytes
+*/
+static uint16_t bufCount(ringBuf_t *pBuf, uint16_t head, uint16_t tail)
+{
+    return (tail >= head) ? tail - head : pBuf->len - head + tail;
+}
+
+/***********************************************************************************
+* @fn      bufCopy
+*
+* @brief   Copy a contiguous block. With BUF_DMA, large blocks go through DMA
+*          channel 2 in block mode, which holds the CPU for two cycles per
+*          byte. Channels 0 and 1 belong to the CC2520 SPI and a block
+*          transfer would hold them off too, so the CPU copies while either
+*          is armed.
+*
+* @param   pDst - destination
+*          pSrc - source
+*          n - number of bytes
+*
+* @return  none
+*/
+static void bufCopy(uint8_t *pDst, const uint8_t *pSrc, uint16_t n)
+{
+#ifdef BUF_DMA
+    unsigned short istate;
+
+    if (n >= BUF_DMA_MIN) {
+        istate = __get_interrupt_state();
+        __disable_interrupt();
+        if (!(DMA0CTL & DMAEN) && !(DMA1CTL & DMAEN)) {
+            DMACTL1 &= 0xFF00;          // DMA2TSEL = DMAREQ
+            __data16_write_addr((unsigned short)&DMA2SA, (unsigned long)pSrc);
+            __data16_write_addr((unsigned short)&DMA2DA, (unsigned long)pDst);
+            DMA2SZ = n;
+            DMA2CTL = DMADT_1 | DMASRCINCR_3 | DMADSTINCR_3 | DMASRCBYTE | DMADSTBYTE | DMAEN;
+            DMA2CTL |= DMAREQ;
+            __set_interrupt_state(istate);
+            return;
+        }
+        __set_interrupt_state(istate);
+    }
+#endif
+    if (n < BUF_MEMCPY_MIN) {
+        // Length bytes and other short pieces: not worth a call
+        while (n--)
+            *pDst++ = *pSrc++;
+        return;
+    }
+    memcpy(pDst, pSrc, n);
+}
+
+/***********************************************************************************
+* @fn      bufRead
+*
+* @brief   Copy n bytes starting at index head out of the buffer, in at most
+*          two blocks
+*
+* @param   pBuf - pointer to the ringbuffer
+*          head - read index
+*          pData - destination
+*          n - number of bytes, no more than the buffer holds
+*
+* @return  Index after the last byte read
+*/
+static uint16_t bufRead(ringBuf_t *pBuf, uint16_t head, uint8_t *pData, uint16_t n)
+{
+    uint16_t first;
+
+    first = pBuf->len - head;
+    if (first > n)
+        first = n;
+    bufCopy(pData, &pBuf->pData[head], first);
+    if (n > first)
+        bufCopy(pData + first, pBuf->pData, n - first);
+    head += n;
+    if (head >= pBuf->len)
+        head -= pBuf->len;
+    return head;
+}
+
 /***********************************************************************************
 * @fn      bufPut
 *
-* @brief   Add bytes to the buffer.
+* @brief   Add bytes to the buffer. Producer side: the bytes are written
+*          before the new tail is published, so the consumer never sees
+*          them half written.
 *
 * @param   pBuf - pointer to the ringbuffer
 *          pData - pointer to data to be appended to the buffer
 *          nBytes - number of bytes
 *
-* @return  Number of bytes copied to the buffer
+* @return  Number of bytes copied to the buffer, 0 if they do not all fit
 */
 uint16_t bufPut(ringBuf_t *pBuf, const uint8_t *pData, uint16_t nBytes)
 {
-	uint16_t i;
+	uint16_t first, tail;
     
-	if (pBuf->nBytes + nBytes < pBuf->len) {
-		i = 0;
-	    while(i < nBytes) {
-	    	pBuf->pData[pBuf->iTail] = pData[i];
-	    	pBuf->iTail++;
-	    	if (pBuf->iTail == pBuf->len) {
-	    		pBuf->iTail= 0;
-	    	}
-	    	i++;
-	    }
-	    pBuf->nBytes += i;
-    } else {
-    	i = 0;
-    }
-    return i;
+	tail = pBuf->iTail;
+	if (bufCount(pBuf, pBuf->iHead, tail) + nBytes >= pBuf->len) {
+		return 0;
+	}
+	// Up to the end of the buffer, then the rest from its start
+	first = pBuf->len - tail;
+	if (first > nBytes) {
+		first = nBytes;
+	}
+	bufCopy(&pBuf->pData[tail], pData, first);
+	if (nBytes > first) {
+		bufCopy(pBuf->pData, pData + first, nBytes - first);
+	}
+	tail += nBytes;
+	if (tail >= pBuf->len) {
+		tail -= pBuf->len;
+	}
+	BUF_BARRIER();
+	pBuf->iTail = tail;
+    return nBytes;
 }
 
 
 /***********************************************************************************
 * @fn      bufGet
 *
-* @brief   Extract bytes from the buffer.
+* @brief   Extract bytes from the buffer. Consumer side: the bytes are read
+*          before the new head is published, so the producer never
+*          overwrites them early.
 *
 * @param   pBuf   - pointer to the ringbuffer
 *          pData  - pointer to data to be extracted
@@ -67,26 +186,25 @@ uint16_t bufPut(ringBuf_t *pBuf, const uint8_t *pData, uint16_t nBytes)
 */
 uint16_t bufGet(ringBuf_t *pBuf, uint8_t *pData, uint16_t nBytes)
 {
-    uint16_t i;
+    uint16_t head, n;
     
-    i = 0;
-    while(i < nBytes && i < pBuf->nBytes) {
-        pData[i] = pBuf->pData[pBuf->iHead];
-        pBuf->iHead++;
-        if (pBuf->iHead == pBuf->len)
-            pBuf->iHead = 0;
-        i++;
-    }
-    pBuf->nBytes-= i;
+    head = pBuf->iHead;
+    n = bufCount(pBuf, head, pBuf->iTail);
+    if (n > nBytes)
+        n = nBytes;
+    head = bufRead(pBuf, head, pData, n);
+    BUF_BARRIER();
+    pBuf->iHead = head;
 
-    return i;
+    return n;
 }
 
 
 /***********************************************************************************
 * @fn      bufPeek
 *
-* @brief   Read bytes from the buffer but leave them in the queue.
+* @brief   Read bytes from the buffer but leave them in the queue. Consumer
+*          side.
 *
 * @param   pBuf   - pointer to the ringbuffer
 *          pData  - pointer to data to be extracted
@@ -96,25 +214,23 @@ uint16_t bufGet(ringBuf_t *pBuf, uint8_t *pData, uint16_t nBytes)
 */
 uint16_t bufPeek(ringBuf_t *pBuf, uint8_t *pData, uint16_t nBytes)
 {
-    uint16_t i,j;
-
-    i = 0;
-    j = pBuf->iHead;
-    while(i < nBytes && i < pBuf->nBytes) {
-        pData[i]= pBuf->pData[j];
-        j++;
-        if (j == pBuf->len)
-            j = 0;
-        i++;
-    }
+    uint16_t head, n;
+
+    head = pBuf->iHead;
+    n = bufCount(pBuf, head, pBuf->iTail);
+    if (n > nBytes)
+        n = nBytes;
+    bufRead(pBuf, head, pData, n);
 
-    return i;
+    return n;
 }
 
 /***********************************************************************************
 * @fn      bufNumBytes
 *
-* @brief   Return the byte count for the ring buffer.
+* @brief   Return the byte count for the ring buffer. Either side may call
+*          it; the other side can only make the count grow (consumer) or
+*          shrink (producer) meanwhile.
 *
 * @param   pBuf- pointer to the buffer
 *
@@ -122,17 +238,18 @@ uint16_t bufPeek(ringBuf_t *pBuf, uint8_t *pData, uint16_t nBytes)
 */
 uint16_t bufNumBytes(ringBuf_t *pBuf)
 {
-    return pBuf->nBytes;
+    return bufCount(pBuf, pBuf->iHead, pBuf->iTail);
 }
 
 /***********************************************************************************
 * @fn      bufFlush
 *
-* @brief   Flush the buffer.
+* @brief   Flush the buffer. Consumer side: drops what the producer has
+*          published so far.
 *
 * @param   pBuf- pointer to the buffer
 */
 void bufFlush(ringBuf_t *pBuf)
 {
-//	bufInit(pBuf, pBuf->pData, pBuf->len);	
+    pBuf->iHead = pBuf->iTail;
 }
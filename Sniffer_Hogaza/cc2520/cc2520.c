@@ -2,6 +2,9 @@
 #include "utils/sense_utils.h"
 #include "utils/uip.h"
 #include "enc28j60/enc28j60.h"
+#ifdef CC2520_HOST
+#include <assert.h>
+#endif
 /***********************************************************************************
 * LOCAL VARIABLES
 */
@@ -13,52 +16,56 @@ static cc2520_cfg_t pConfig;
 static uint8_t rxMpdu[128];
 
 static uint8_t eth_tx_buf[256];
+static cc2520_rxStats_t rxStats;
 
-// Recommended register settings which differ from the data sheet
+// Recommended register settings which differ from the data sheet.
+// Keep the table sorted by address: consecutive registers are written in one burst.
 
-static regVal_t regval[]= {   
-							 
-    // Tuning settings
+static regVal_t regval[]= {
+    { CC2520_FRMFILT0,	0 },		// enables promiscuous mode
+
+    // Configuration for applications using halRfInit()
+    { CC2520_FRMCTRL0,    0x0 },               // Auto-ack
+    { CC2520_EXCMASKA0,   1 << CC2520_EXC_RX_OVERFLOW },
+    { CC2520_EXCMASKA1,   1 << (CC2520_EXC_RX_FRM_DONE - 8) },
+    { CC2520_GPIOCTRL0,   CC2520_GPIO_EXC_CH_A },   // RX_FRM_DONE or RX_OVERFLOW
+    { CC2520_GPIOCTRL1,   CC2520_GPIO_SAMPLED_CCA },
+    { CC2520_GPIOCTRL2,   CC2520_GPIO_RSSI_VALID },
 #ifdef INCLUDE_PA
-    CC2520_TXPOWER,     0xF9,       // Max TX output power
-    CC2520_TXCTRL,      0xC1,
+    { CC2520_GPIOCTRL3,   CC2520_GPIO_HIGH },   // CC2590 HGM
+    { CC2520_GPIOCTRL4,   0x46 },               // EN set to lna_pd[1] inverted
+    { CC2520_GPIOCTRL5,   0x47 },               // PAEN set to pa_pd inverted
+    { CC2520_GPIOPOLARITY,0x0F },               // Invert GPIO4 and GPIO5
 #else
-    CC2520_TXPOWER,     0xF7,       // Max TX output power
+    { CC2520_GPIOCTRL3,   CC2520_GPIO_SFD },
+    { CC2520_GPIOCTRL4,   CC2520_GPIO_SNIFFER_DATA },
+    { CC2520_GPIOCTRL5,   CC2520_GPIO_SNIFFER_CLK },
 #endif
-    CC2520_CCACTRL0,    0xF8,       // CCA threshold -80dBm
 
-    // Recommended RX settings
-    CC2520_MDMCTRL0,    0x85,
-    CC2520_MDMCTRL1,    0x14,
-    CC2520_RXCTRL,      0x3F,
-    CC2520_FSCTRL,      0x5A,
-    CC2520_FSCAL1,      0x03,
-    CC2520_FRMFILT0,	0,		// enables promiscuous mode
+    // Tuning settings
 #ifdef INCLUDE_PA
-    CC2520_AGCCTRL1,    0x16,
+    { CC2520_TXPOWER,     0xF9 },       // Max TX output power
+    { CC2520_TXCTRL,      0xC1 },
 #else
-    CC2520_AGCCTRL1,    0x11,
+    { CC2520_TXPOWER,     0xF7 },       // Max TX output power
 #endif
-    CC2520_ADCTEST0,    0x10,
-    CC2520_ADCTEST1,    0x0E,
-    CC2520_ADCTEST2,    0x03, 
+    { CC2520_CCACTRL0,    0xF8 },       // CCA threshold -80dBm
+    { CC2520_EXTCLOCK,    0x00 },
 
-    // Configuration for applications using halRfInit()
-    CC2520_FRMCTRL0,    0x0,               // Auto-ack
-    CC2520_EXTCLOCK,    0x00,
-    CC2520_GPIOCTRL0,   1 + CC2520_EXC_RX_FRM_DONE, 
-    CC2520_GPIOCTRL1,   CC2520_GPIO_SAMPLED_CCA,
-    CC2520_GPIOCTRL2,   CC2520_GPIO_RSSI_VALID,
+    // Recommended RX settings
+    { CC2520_MDMCTRL0,    0x85 },
+    { CC2520_MDMCTRL1,    0x14 },
+    { CC2520_RXCTRL,      0x3F },
+    { CC2520_FSCTRL,      0x5A },
+    { CC2520_FSCAL1,      0x03 },
 #ifdef INCLUDE_PA
-    CC2520_GPIOCTRL3,   CC2520_GPIO_HIGH,   // CC2590 HGM
-    CC2520_GPIOCTRL4,   0x46,               // EN set to lna_pd[1] inverted
-    CC2520_GPIOCTRL5,   0x47,               // PAEN set to pa_pd inverted
-    CC2520_GPIOPOLARITY,0x0F,               // Invert GPIO4 and GPIO5
+    { CC2520_AGCCTRL1,    0x16 },
 #else
-    CC2520_GPIOCTRL3,   CC2520_GPIO_SFD,
-    CC2520_GPIOCTRL4,   CC2520_GPIO_SNIFFER_DATA,
-    CC2520_GPIOCTRL5,   CC2520_GPIO_SNIFFER_CLK,
+    { CC2520_AGCCTRL1,    0x11 },
 #endif
+    { CC2520_ADCTEST0,    0x10 },
+    { CC2520_ADCTEST1,    0x0E },
+    { CC2520_ADCTEST2,    0x03 },
 
 };
 
@@ -165,6 +172,64 @@ void cc2520_interfaceInit(void)
     P5OUT |= CC2520_CS_PIN;		// Set cs high
 }
 
+/***********************************************************************************
+* @fn      cc2520_writeRegTable
+*
+* @brief   Write a register table sorted by address. Every run of consecutive
+*          addresses is written with a single REGWR or MEMWR burst.
+*
+* @param   const regVal_t *pTable - register table
+*          uint8_t n - number of entries
+*
+* @return  none
+*/
+static void cc2520_writeRegTable(const regVal_t *pTable, uint8_t n)
+{
+    uint8_t buf[CC2520_REG_BURST_LEN];
+    uint8_t i, count;
+
+    for (i = 0; i < n; i += count) {
+        count = 0;
+        do {
+            buf[count] = pTable[i + count].val;
+            count++;
+        } while (i + count < n && count < CC2520_REG_BURST_LEN &&
+                 pTable[i + count].reg == pTable[i].reg + count);
+
+        // REGWR saves the address byte but only reaches the FREG space
+        if (pTable[i].reg + count <= CC2520_CHIPID) {
+            CC2520_REGWR(pTable[i].reg, count, buf);
+        } else {
+            CC2520_MEMWR(pTable[i].reg, count, buf);
+        }
+    }
+}
+
+/***********************************************************************************
+* @fn      cc2520_verifyRegTable
+*
+* @brief   Read back the whole address span of a sorted register table in one
+*          burst and compare it with the table.
+*
+* @param   const regVal_t *pTable - register table
+*          uint8_t n - number of entries
+*
+* @return  SUCCESS if every register holds its value, FAILED otherwise
+*/
+static uint8_t cc2520_verifyRegTable(const regVal_t *pTable, uint8_t n)
+{
+    uint8_t regs[0x80];         // FREG and SREG space
+    uint8_t first, i;
+
+    first = pTable[0].reg;
+    CC2520_MEMRD(first, pTable[n - 1].reg - first + 1, regs);
+    for (i = 0; i < n; i++) {
+        if (regs[pTable[i].reg - first] != pTable[i].val)
+            return FAILED;
+    }
+    return SUCCESS;
+}
+
 /***********************************************************************************
 * @fn      cc2520_config
 *
@@ -177,8 +242,9 @@ void cc2520_interfaceInit(void)
 */
 uint8_t cc2520_config(void)
 {
-    uint8_t val;
-    int i = 0;
+#ifdef CC2520_HOST
+    uint8_t i;
+#endif
 
     // Avoid GPIO0 interrupts during reset
     P2IE &= ~(CC2520_INT_PIN);
@@ -200,15 +266,18 @@ uint8_t cc2520_config(void)
     if (cc2520_waitRadioReady()==FAILED)
         return FAILED;
 
-    // Write non-default register values
-    for (i = 0; i < sizeof(regval)/sizeof(regVal_t); i++) {
-        CC2520_MEMWR8(regval[i].reg, regval[i].val);
+#ifdef CC2520_HOST
+    // The burst writer and the read-back both need the table in address order
+    for (i = 1; i < sizeof(regval)/sizeof(regVal_t); i++) {
+        assert(regval[i].reg > regval[i - 1].reg);
     }
+#endif
 
-    // Verify a register
-    val= CC2520_MEMRD8(CC2520_MDMCTRL0);
+    // Write non-default register values
+    cc2520_writeRegTable(regval, sizeof(regval)/sizeof(regVal_t));
 
-    return val==0x85? SUCCESS : FAILED;
+    // Verify all of them
+    return cc2520_verifyRegTable(regval, sizeof(regval)/sizeof(regVal_t));
 }
 
 /***********************************************************************************
@@ -310,8 +379,9 @@ cc2520_init()
     P2IFG &= ~(CC2520_INT_PIN); 
     P2IE |= CC2520_INT_PIN;
 
-    // Clear the exception
+    // Clear the exceptions
     CLEAR_EXC_RX_FRM_DONE();
+    CC2520_CLEAR_EXC(CC2520_EXC_RX_OVERFLOW);
     
     // Enable general interrupts
     _enable_interrupts();
@@ -586,40 +656,71 @@ void cc2520_enableRxInterrupt(void)
 /***********************************************************************************
 * @fn          cc2520_packetReceivedISR
 *
-* @brief       Interrupt service routine for received frame from radio
-*              (either data or acknowlegdement)
+* @brief       Interrupt service routine for received frames from radio
+*              (either data or acknowlegdement). Every complete frame in the
+*              RX FIFO is forwarded; a frame still arriving is left for the
+*              next RX_FRM_DONE. The FIFO is only flushed after an overflow.
 *
-* @param       rxi - file scope variable info extracted from the last incoming
-*                    frame
-*              txState - file scope variable that keeps tx state info
+* @param       rxStats - file scope RX interrupt counters
 *
 * @return      none
 */
 static void cc2520_packetReceivedISR(void)
 {
-    uint8_t len;
+    uint8_t fifo[3];    // RXFIRST, reserved, RXFIFOCNT
+    uint8_t len, n = 0;
     
     // Clear interrupt and disable new RX frame done interrupt
     cc2520_disableRxInterrupt();
-    // Read payload length.
-    cc2520_readRxBuf(&len, 1);
-    len &= CC2520_PLD_LEN_MASK;	 // Ignore MSB
-    cc2520_readRxBuf(&eth_tx_buf[14], len);
-    enc28j60PacketSend(len + 14, &eth_tx_buf[0]);
-    // Flush the cc2520 rx buffer to prevent residual data
-    CC2520_SFLUSHRX();
+    for (;;) {
+        CC2520_REGRD(CC2520_RXFIRST, sizeof(fifo), fifo);
+        len = fifo[0] & CC2520_PLD_LEN_MASK;
+        if (fifo[2] == 0 || fifo[2] < len + 1)
+            break;
+        // Read payload length.
+        cc2520_readRxBuf(&len, 1);
+        len &= CC2520_PLD_LEN_MASK;	 // Ignore MSB
+        cc2520_readRxBuf(&eth_tx_buf[14], len);
+        enc28j60PacketSend(len + 14, &eth_tx_buf[0]);
+        n++;
+    }
+    rxStats.interrupts++;
+    rxStats.frames += n;
+    if (n > rxStats.maxPerInterrupt)
+        rxStats.maxPerInterrupt = n;
+    // The radio stops receiving on overflow until the FIFO is flushed
+    if (CC2520_GET_FSM_STATE() == CC2520_FSM_RX_OVERFLOW) {
+        CC2520_SFLUSHRX();
+        CC2520_CLEAR_EXC(CC2520_EXC_RX_OVERFLOW);
+        rxStats.overflows++;
+    }
     // Enable RX frame done interrupt again   
     cc2520_enableRxInterrupt();
 }
 
+/***********************************************************************************
+* @fn          cc2520_getRxStats
+*
+* @brief       Copy the RX interrupt counters
+*
+* @param       cc2520_rxStats_t *pStats
+*
+* @return      none
+*/
+void cc2520_getRxStats(cc2520_rxStats_t *pStats)
+{
+    *pStats = rxStats;
+}
+
 void port2_interrupt(void);
 #pragma vector = PORT2_VECTOR 
 interrupt void port2_interrupt(void)
 {
   if (P2IFG) {
   	if ((P2IFG & CC2520_INT_PIN) && (P2IE & CC2520_INT_PIN)) {
+     	// The ISR clears the flag before reading the FIFO, so a frame
+     	// completed meanwhile interrupts again
      	cc2520_packetReceivedISR();
-      P2IFG &= ~(CC2520_INT_PIN);
     }
   }
 }
@@ -26,6 +26,8 @@
 #define MSP430_MSECOND			16000
 /* Ring buffer length */
 #define CC2520_BUF_LEN					512
+/* Longest register run written in one burst by cc2520_config() */
+#define CC2520_REG_BURST_LEN			8
 /* Startup time values (in microseconds) */
 #define CC2520_XOSC_MAX_STARTUP_TIME        300
 #define CC2520_VREG_MAX_STARTUP_TIME        200
@@ -154,6 +156,14 @@ typedef struct {
     #endif
 } cc2520_packetHdr_t;
 
+// RX interrupt counters
+typedef struct {
+    uint16_t interrupts;        // RX interrupts served
+    uint16_t frames;            // Frames taken from the RX FIFO
+    uint8_t maxPerInterrupt;    // Most frames taken in one interrupt
+    uint16_t overflows;         // RX FIFO overflows, each losing the frame that did not fit
+} cc2520_rxStats_t;
+
 /* External functions */
 
 uint8_t cc2520_init();
@@ -164,5 +174,6 @@ void cc2520_receiveOn(void);
 void cc2520_receiveOff(void);
 void cc2520_disableRxInterrupt(void);
 void cc2520_enableRxInterrupt(void);
+void cc2520_getRxStats(cc2520_rxStats_t *pStats);
 
 #endif /*CC2520_H_*/
@@ -3,12 +3,21 @@
 
 #include <inttypes.h>
 
+// Define BUF_DMA to let the MSP430 DMA (channel 2) copy blocks of at least
+// BUF_DMA_MIN bytes in and out of ring buffers
+//#define BUF_DMA
+#define BUF_DMA_MIN     32
+
+// Single producer, single consumer ring buffer. Only bufPut() writes iTail
+// and only bufGet()/bufFlush() write iHead, so an ISR and the main loop can
+// share one buffer without disabling interrupts, as long as each side stays
+// on its own end. One byte is kept free to tell a full buffer from an empty
+// one, so it holds at most len - 1 bytes.
 typedef struct {
-    volatile uint8_t *pData;
-    volatile uint16_t nBytes;
-    volatile uint16_t iHead;
-    volatile uint16_t iTail;
-    volatile uint16_t len;    
+    uint8_t *pData;
+    volatile uint16_t iHead;    // Next byte to read (consumer)
+    volatile uint16_t iTail;    // Next byte to write (producer)
+    uint16_t len;    
 } ringBuf_t;
 
 /***********************************************************************************